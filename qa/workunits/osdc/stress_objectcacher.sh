@@ -23,4 +23,64 @@ do
     done
 done
 
+# flushes that cover several extents of an object at once
+for i in $(seq 1 10)
+do
+    for DELAY in 0 1000
+    do
+        for READS in 0.90 0.50 0.10
+        do
+            for OP_SIZE in 4096 131072
+            do
+                ceph_test_objectcacher_stress --ops 10000 --percent-read $READS --delay-ns $DELAY --objects 10 --max-op-size $OP_SIZE --client-oc-max-dirty 25165824 --scattered-writes > /dev/null 2>&1
+            done
+        done
+    done
+done
+
+# reads that miss complete from the finisher, without the cache lock
+for i in $(seq 1 10)
+do
+    for DELAY in 0 1000
+    do
+        for READS in 0.90 0.50 0.10
+        do
+            for MAX_DIRTY in 0 25165824
+            do
+                ceph_test_objectcacher_stress --ops 10000 --percent-read $READS --delay-ns $DELAY --objects 50 --max-op-size 131072 --client-oc-max-dirty $MAX_DIRTY --unlocked-read-completions > /dev/null 2>&1
+            done
+        done
+    done
+done
+
+# scans mixed with rereads under the 2q replacement policy
+for i in $(seq 1 10)
+do
+    for DELAY in 0 1000
+    do
+        for OBJECTS in 10 100
+        do
+            for READS in 0.90 0.50
+            do
+                ceph_test_objectcacher_stress --ops 10000 --percent-read $READS --delay-ns $DELAY --objects $OBJECTS --max-op-size 131072 --client-oc-size 8388608 --client-oc-policy 2q > /dev/null 2>&1
+            done
+        done
+    done
+done
+
+# hits served without the cache lock, alongside everything else
+for i in $(seq 1 10)
+do
+    for DELAY in 0 1000
+    do
+        for READS in 0.90 0.50
+        do
+            for MAX_DIRTY in 0 25165824
+            do
+                ceph_test_objectcacher_stress --ops 10000 --percent-read $READS --delay-ns $DELAY --objects 10 --max-op-size 131072 --client-oc-max-dirty $MAX_DIRTY --unlocked-read-completions --hit-threads 4 > /dev/null 2>&1
+            done
+        done
+    done
+done
+
 echo OK
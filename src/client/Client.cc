@@ -215,6 +215,7 @@ Client::Client(Messenger *m, MonClient *mc)
 				  cct->_conf->client_oc_target_dirty,
 				  cct->_conf->client_oc_max_dirty_age,
 				  true);
+  objectcacher->set_policy(cct->_conf->client_oc_policy);
   objecter_finisher.start();
   filer = new Filer(objecter, &objecter_finisher);
 }
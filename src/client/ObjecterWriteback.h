@@ -29,6 +29,7 @@ class ObjecterWriteback : public WritebackHandler {
     return false;
   }
 
+  using WritebackHandler::write;
   virtual ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
 		      uint64_t off, uint64_t len, const SnapContext& snapc,
 		      const bufferlist &bl, utime_t mtime, uint64_t trunc_size,
@@ -37,12 +37,15 @@
 #include <sstream>
 #include <vector>
 
+#include "common/bit_vector.hpp"
 #include "common/errno.h"
 #include "objclass/objclass.h"
 #include "include/rbd_types.h"
 
 #include "cls/rbd/cls_rbd.h"
 
+using ceph::BitVector;
+
 
 /*
  * Object keys:
@@ -90,6 +93,9 @@ cls_method_handle_t h_dir_list;
 cls_method_handle_t h_dir_add_image;
 cls_method_handle_t h_dir_remove_image;
 cls_method_handle_t h_dir_rename_image;
+cls_method_handle_t h_object_map_load;
+cls_method_handle_t h_object_map_resize;
+cls_method_handle_t h_object_map_update;
 cls_method_handle_t h_old_snapshots_list;
 cls_method_handle_t h_old_snapshot_add;
 cls_method_handle_t h_old_snapshot_remove;
@@ -1790,6 +1796,194 @@ int dir_remove_image(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
   return dir_remove_image_helper(hctx, name, id);
 }
 
+/*************************** object map methods **************************/
+
+static int object_map_read(cls_method_context_t hctx,
+			   BitVector<2> &object_map)
+{
+  uint64_t size;
+  int r = cls_cxx_stat(hctx, &size, NULL);
+  if (r < 0)
+    return r;
+
+  bufferlist bl;
+  r = cls_cxx_read(hctx, 0, size, &bl);
+  if (r < 0)
+    return r;
+
+  try {
+    bufferlist::iterator iter = bl.begin();
+    ::decode(object_map, iter);
+  } catch (const buffer::error &err) {
+    CLS_ERR("failed to decode object map: %s", err.what());
+    return -EINVAL;
+  }
+  return 0;
+}
+
+/**
+ * Load an image's object map.
+ *
+ * Input:
+ * none
+ *
+ * Output:
+ * @param object_map bit vector of object states
+ * @returns 0 on success, negative error code on failure
+ */
+int object_map_load(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  BitVector<2> object_map;
+  int r = object_map_read(hctx, object_map);
+  if (r < 0)
+    return r;
+
+  ::encode(object_map, *out);
+  return 0;
+}
+
+/**
+ * Resize an image's object map, creating it if needed.  Shrinking
+ * fails if an object being dropped from the map still exists.
+ *
+ * Input:
+ * @param object_count the new number of objects (uint64_t)
+ * @param default_state state of any new objects (uint8_t)
+ *
+ * Output:
+ * @returns -ESTALE if a dropped object is not in default_state
+ * @returns 0 on success, negative error code on failure
+ */
+int object_map_resize(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  uint64_t object_count;
+  uint8_t default_state;
+  try {
+    bufferlist::iterator iter = in->begin();
+    ::decode(object_count, iter);
+    ::decode(default_state, iter);
+  } catch (const buffer::error &err) {
+    return -EINVAL;
+  }
+
+  BitVector<2> object_map;
+  int r = object_map_read(hctx, object_map);
+  if (r < 0 && r != -ENOENT)
+    return r;
+
+  uint64_t orig_object_count = object_map.size();
+  for (uint64_t i = object_count; i < orig_object_count; ++i) {
+    if (object_map[i] != default_state) {
+      CLS_ERR("object map indicates object still exists: %llu",
+	      (unsigned long long)i);
+      return -ESTALE;
+    }
+  }
+
+  object_map.resize(object_count);
+  for (uint64_t i = orig_object_count; i < object_count; ++i)
+    object_map[i] = default_state;
+
+  bufferlist map;
+  ::encode(object_map, map);
+  CLS_LOG(20, "object_map_resize: %llu -> %llu objects",
+	  (unsigned long long)orig_object_count,
+	  (unsigned long long)object_count);
+  return cls_cxx_write_full(hctx, &map);
+}
+
+/**
+ * Update the state of a range of objects.  Only the bytes of the map
+ * backing the range are read and rewritten.
+ *
+ * Input:
+ * @param start_object_no first object to update (uint64_t)
+ * @param end_object_no one past the last object to update (uint64_t)
+ * @param new_state the new state (uint8_t)
+ * @param current_state if set, only update objects in this state
+ *        (boost::optional<uint8_t>)
+ *
+ * Output:
+ * @returns 0 on success, negative error code on failure
+ */
+int object_map_update(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  uint64_t start_object_no, end_object_no;
+  uint8_t new_state;
+  boost::optional<uint8_t> current_state;
+  try {
+    bufferlist::iterator iter = in->begin();
+    ::decode(start_object_no, iter);
+    ::decode(end_object_no, iter);
+    ::decode(new_state, iter);
+    ::decode(current_state, iter);
+  } catch (const buffer::error &err) {
+    return -EINVAL;
+  }
+
+  uint64_t header_len = BitVector<2>::get_header_length();
+  bufferlist header_bl;
+  int r = cls_cxx_read(hctx, 0, header_len, &header_bl);
+  if (r < 0)
+    return r;
+
+  BitVector<2> object_map;
+  try {
+    bufferlist::iterator iter = header_bl.begin();
+    object_map.decode_header(iter);
+  } catch (const buffer::error &err) {
+    CLS_ERR("failed to decode object map header: %s", err.what());
+    return -EINVAL;
+  }
+
+  if (start_object_no >= end_object_no ||
+      end_object_no > object_map.size()) {
+    CLS_ERR("object map range %llu~%llu out of bounds (%llu objects)",
+	    (unsigned long long)start_object_no,
+	    (unsigned long long)end_object_no,
+	    (unsigned long long)object_map.size());
+    return -ERANGE;
+  }
+
+  uint64_t byte_offset, byte_length;
+  BitVector<2>::get_data_extents(start_object_no,
+				 end_object_no - start_object_no,
+				 &byte_offset, &byte_length);
+
+  bufferlist data_bl;
+  r = cls_cxx_read(hctx, header_len + byte_offset, byte_length, &data_bl);
+  if (r < 0)
+    return r;
+  if (data_bl.length() != byte_length) {
+    CLS_ERR("object map truncated");
+    return -EINVAL;
+  }
+
+  bufferlist::iterator data_iter = data_bl.begin();
+  object_map.decode_data(data_iter, byte_offset, byte_length);
+
+  bool updated = false;
+  for (uint64_t i = start_object_no; i < end_object_no; ++i) {
+    uint8_t state = object_map[i];
+    if (state != new_state &&
+	(!current_state || state == *current_state)) {
+      object_map[i] = new_state;
+      updated = true;
+    }
+  }
+
+  if (!updated)
+    return 0;
+
+  CLS_LOG(20, "object_map_update: %llu~%llu -> %d",
+	  (unsigned long long)start_object_no,
+	  (unsigned long long)end_object_no, (int)new_state);
+  bufferlist update_bl;
+  object_map.encode_data(update_bl, byte_offset, byte_length);
+  return cls_cxx_write(hctx, header_len + byte_offset, update_bl.length(),
+		       &update_bl);
+}
+
 /****************************** Old format *******************************/
 
 int old_snapshots_list(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
@@ -2085,6 +2279,17 @@ void __cls_init()
 			  CLS_METHOD_RD | CLS_METHOD_WR,
 			  dir_rename_image, &h_dir_rename_image);
 
+  /* methods for the rbd_object_map.$image_id objects */
+  cls_register_cxx_method(h_class, "object_map_load",
+			  CLS_METHOD_RD,
+			  object_map_load, &h_object_map_load);
+  cls_register_cxx_method(h_class, "object_map_resize",
+			  CLS_METHOD_RD | CLS_METHOD_WR,
+			  object_map_resize, &h_object_map_resize);
+  cls_register_cxx_method(h_class, "object_map_update",
+			  CLS_METHOD_RD | CLS_METHOD_WR,
+			  object_map_update, &h_object_map_update);
+
   /* methods for the old format */
   cls_register_cxx_method(h_class, "snap_list",
 			  CLS_METHOD_RD,
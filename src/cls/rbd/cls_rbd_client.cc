@@ -394,6 +394,45 @@ namespace librbd {
       return 0;
     }
 
+    int object_map_load(librados::IoCtx *ioctx, const std::string &oid,
+			ceph::BitVector<2> *object_map)
+    {
+      bufferlist in, out;
+      int r = ioctx->exec(oid, "rbd", "object_map_load", in, out);
+      if (r < 0)
+	return r;
+
+      try {
+	bufferlist::iterator iter = out.begin();
+	::decode(*object_map, iter);
+      } catch (const buffer::error &err) {
+	return -EBADMSG;
+      }
+      return 0;
+    }
+
+    void object_map_resize(librados::ObjectWriteOperation *rados_op,
+			   uint64_t object_count, uint8_t default_state)
+    {
+      bufferlist in;
+      ::encode(object_count, in);
+      ::encode(default_state, in);
+      rados_op->exec("rbd", "object_map_resize", in);
+    }
+
+    void object_map_update(librados::ObjectWriteOperation *rados_op,
+			   uint64_t start_object_no, uint64_t end_object_no,
+			   uint8_t new_state,
+			   const boost::optional<uint8_t> &current_state)
+    {
+      bufferlist in;
+      ::encode(start_object_no, in);
+      ::encode(end_object_no, in);
+      ::encode(new_state, in);
+      ::encode(current_state, in);
+      rados_op->exec("rbd", "object_map_update", in);
+    }
+
     int old_snapshot_add(librados::IoCtx *ioctx, const std::string &oid,
 			 snapid_t snap_id, const std::string &snap_name)
     {
@@ -5,6 +5,7 @@
 #define CEPH_LIBRBD_CLS_RBD_CLIENT_H
 
 #include "cls/lock/cls_lock_types.h"
+#include "common/bit_vector.hpp"
 #include "common/snap_types.h"
 #include "include/rados/librados.hpp"
 #include "include/types.h"
@@ -99,6 +100,16 @@ namespace librbd {
 			 const std::string &src, const std::string &dest,
 			 const std::string &id);
 
+    // operations on rbd_object_map.$image_id objects
+    int object_map_load(librados::IoCtx *ioctx, const std::string &oid,
+			ceph::BitVector<2> *object_map);
+    void object_map_resize(librados::ObjectWriteOperation *rados_op,
+			   uint64_t object_count, uint8_t default_state);
+    void object_map_update(librados::ObjectWriteOperation *rados_op,
+			   uint64_t start_object_no, uint64_t end_object_no,
+			   uint8_t new_state,
+			   const boost::optional<uint8_t> &current_state);
+
     // class operations on the old format, kept for
     // backwards compatability
     int old_snapshot_add(librados::IoCtx *ioctx, const std::string &oid,
@@ -0,0 +1,93 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * Size tracking for libradosstriper.
+ *
+ * The size of a striped object is kept as a decimal string in the
+ * "striper.size" xattr of its first rados object.  Writers update it
+ * with update_size in the same operation as they take the shared
+ * "striper.lock" on that object, saving a round trip, and appenders
+ * use it to atomically reserve their range.  That lock is what keeps
+ * truncation and removal out, so this class does not look at it.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "include/types.h"
+#include "objclass/objclass.h"
+#include "cls/striper/cls_striper_ops.h"
+
+CLS_VER(1,0)
+CLS_NAME(striper)
+
+cls_handle_t h_class;
+cls_method_handle_t h_update_size;
+
+/* this must match libradosstriper */
+#define SIZE_ATTR "striper.size"
+
+static int read_size(cls_method_context_t hctx, uint64_t *size)
+{
+  bufferlist bl;
+  int r = cls_cxx_getxattr(hctx, SIZE_ATTR, &bl);
+  if (r == -ENODATA)
+    return -ENOENT;  // not a striped object
+  if (r < 0)
+    return r;
+  std::string s(bl.c_str(), bl.length());
+  char *end;
+  *size = strtoull(s.c_str(), &end, 10);
+  if (s.empty() || *end) {
+    CLS_LOG(1, "ERROR: read_size(): bad size '%s'", s.c_str());
+    return -EIO;
+  }
+  return 0;
+}
+
+static int cls_striper_update_size(cls_method_context_t hctx, bufferlist *in, bufferlist *out)
+{
+  bufferlist::iterator in_iter = in->begin();
+
+  cls_striper_update_size_op op;
+  try {
+    ::decode(op, in_iter);
+  } catch (buffer::error& err) {
+    CLS_LOG(1, "ERROR: cls_striper_update_size(): failed to decode entry\n");
+    return -EINVAL;
+  }
+
+  uint64_t size;
+  int ret = read_size(hctx, &size);
+  if (ret < 0)
+    return ret;
+
+  if (op.has_old_size && size != op.old_size) {
+    CLS_LOG(20, "size is %llu, not %llu", (unsigned long long)size,
+	    (unsigned long long)op.old_size);
+    return -ECANCELED;
+  }
+  if (op.size <= size)
+    return 0;
+
+  std::ostringstream oss;
+  oss << op.size;
+  bufferlist bl;
+  bl.append(oss.str());
+  return cls_cxx_setxattr(hctx, SIZE_ATTR, &bl);
+}
+
+void __cls_init()
+{
+  CLS_LOG(1, "Loaded striper class!");
+
+  cls_register("striper", &h_class);
+
+  cls_register_cxx_method(h_class, "update_size", CLS_METHOD_RD | CLS_METHOD_WR, cls_striper_update_size, &h_update_size);
+
+  return;
+}
@@ -0,0 +1,28 @@
+#include <errno.h>
+
+#include "include/types.h"
+#include "cls/striper/cls_striper_ops.h"
+#include "cls/striper/cls_striper_client.h"
+#include "include/rados/librados.hpp"
+
+
+void cls_striper_update_size(librados::ObjectWriteOperation& op, uint64_t size)
+{
+  bufferlist in;
+  cls_striper_update_size_op call;
+  call.size = size;
+  ::encode(call, in);
+  op.exec("striper", "update_size", in);
+}
+
+void cls_striper_update_size(librados::ObjectWriteOperation& op, uint64_t old_size,
+			     uint64_t size)
+{
+  bufferlist in;
+  cls_striper_update_size_op call;
+  call.size = size;
+  call.has_old_size = true;
+  call.old_size = old_size;
+  ::encode(call, in);
+  op.exec("striper", "update_size", in);
+}
@@ -0,0 +1,18 @@
+#ifndef CEPH_CLS_STRIPER_CLIENT_H
+#define CEPH_CLS_STRIPER_CLIENT_H
+
+#include "include/types.h"
+#include "include/rados/librados.hpp"
+
+/*
+ * striper objclass, run on the first object of a striped object
+ */
+
+/* grow the striped object's size to size, never shrinking it */
+void cls_striper_update_size(librados::ObjectWriteOperation& op, uint64_t size);
+
+/* set the size to size if it is still old_size, return -ECANCELED otherwise */
+void cls_striper_update_size(librados::ObjectWriteOperation& op, uint64_t old_size,
+			     uint64_t size);
+
+#endif
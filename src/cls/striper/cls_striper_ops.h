@@ -0,0 +1,34 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#ifndef CEPH_CLS_STRIPER_OPS_H
+#define CEPH_CLS_STRIPER_OPS_H
+
+#include "include/types.h"
+
+struct cls_striper_update_size_op {
+  uint64_t size;          // new size of the striped object
+  bool has_old_size;      // only update if the size is still old_size
+  uint64_t old_size;
+
+  cls_striper_update_size_op() : size(0), has_old_size(false), old_size(0) {}
+
+  void encode(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(size, bl);
+    ::encode(has_old_size, bl);
+    ::encode(old_size, bl);
+    ENCODE_FINISH(bl);
+  }
+
+  void decode(bufferlist::iterator& bl) {
+    DECODE_START(1, bl);
+    ::decode(size, bl);
+    ::decode(has_old_size, bl);
+    ::decode(old_size, bl);
+    DECODE_FINISH(bl);
+  }
+};
+WRITE_CLASS_ENCODER(cls_striper_update_size_op)
+
+#endif
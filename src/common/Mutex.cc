@@ -24,7 +24,7 @@ Mutex::Mutex(const char *n, bool r, bool ld,
 	     bool bt,
 	     CephContext *cct) :
   name(n), id(-1), recursive(r), lockdep(ld), backtrace(bt),
-  nlock(0), locked_by(0), cct(cct), logger(0)
+  nlock(0), locked_by(0), cct(cct), logger(0), lstat(0), locked_at(0)
 {
   if (cct) {
     PerfCountersBuilder b(cct, string("mutex-") + name,
@@ -78,6 +78,7 @@ Mutex::~Mutex() {
 
 void Mutex::Lock(bool no_lockdep) {
   utime_t start;
+  uint64_t wait_start = 0;
   int r;
 
   if (lockdep && g_lockdep && !no_lockdep) _will_lock();
@@ -88,11 +89,15 @@ void Mutex::Lock(bool no_lockdep) {
 
   if (logger && cct && cct->_conf->mutex_perf_counter)
     start = ceph_clock_now(cct);
+  if (g_lockstat)
+    wait_start = lockstat_now();
   r = pthread_mutex_lock(&_m);
   if (logger && cct && cct->_conf->mutex_perf_counter)
     logger->tinc(l_mutex_wait,
 		 ceph_clock_now(cct) - start);
   assert(r == 0);
+  if (wait_start)
+    lockstat_wait(_lockstat(), lockstat_now() - wait_start, true);
   if (lockdep && g_lockdep) _locked();
   _post_lock();
 
@@ -17,6 +17,7 @@
 
 #include "include/assert.h"
 #include "lockdep.h"
+#include "lockstat.h"
 #include "common/ceph_context.h"
 
 #include <pthread.h>
@@ -44,6 +45,8 @@ private:
   pthread_t locked_by;
   CephContext *cct;
   PerfCounters *logger;
+  lockstat_entry_t *lstat;
+  uint64_t locked_at;  // for lockstat hold time; 0 if not tracked
 
   // don't allow copying.
   void operator=(const Mutex &M);
@@ -61,6 +64,15 @@ private:
   void _will_unlock() {  // about to unlock
     id = lockdep_will_unlock(name, id);
   }
+  lockstat_entry_t *_lockstat() {  // only called with the mutex held
+    if (!lstat)
+      lstat = lockstat_lookup(name);
+    return lstat;
+  }
+  void _lockstat_unlocked() {
+    lockstat_hold(_lockstat(), lockstat_now() - locked_at);
+    locked_at = 0;
+  }
 
 public:
   Mutex(const char *n, bool r = false, bool ld=true, bool bt=false,
@@ -89,12 +101,16 @@ public:
       assert(nlock == 0);
       locked_by = pthread_self();
     };
+    if (nlock == 0 && g_lockstat)
+      locked_at = lockstat_now();
     nlock++;
   }
 
   void _pre_unlock() {
     assert(nlock > 0);
     --nlock;
+    if (nlock == 0 && locked_at)
+      _lockstat_unlocked();
     if (!recursive) {
       assert(locked_by == pthread_self());
       locked_by = 0;
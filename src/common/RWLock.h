@@ -20,6 +20,7 @@
 #include <pthread.h>
 #include <include/assert.h>
 #include "lockdep.h"
+#include "lockstat.h"
 #include "include/atomic.h"
 
 class RWLock
@@ -28,12 +29,39 @@ class RWLock
   const char *name;
   mutable int id;
   mutable atomic_t nrlock, nwlock;
+  mutable lockstat_entry_t *lstat;
+  mutable uint64_t wlocked_at;  // for lockstat write hold time; 0 if not tracked
+
+  lockstat_entry_t *_lockstat() const {
+    if (!lstat)
+      lstat = lockstat_lookup(name);
+    return lstat;
+  }
+  int _lockstat_rdlock() const {
+    if (pthread_rwlock_tryrdlock(&L) == 0)
+      return 0;
+    uint64_t start = lockstat_now();
+    int r = pthread_rwlock_rdlock(&L);
+    lockstat_wait(_lockstat(), lockstat_now() - start, false);
+    return r;
+  }
+  int _lockstat_wrlock() {
+    int r = pthread_rwlock_trywrlock(&L);
+    if (r != 0) {
+      uint64_t start = lockstat_now();
+      r = pthread_rwlock_wrlock(&L);
+      lockstat_wait(_lockstat(), lockstat_now() - start, true);
+    }
+    wlocked_at = lockstat_now();
+    return r;
+  }
 
 public:
   RWLock(const RWLock& other);
   const RWLock& operator=(const RWLock& other);
 
-  RWLock(const char *n) : name(n), id(-1), nrlock(0), nwlock(0) {
+  RWLock(const char *n) : name(n), id(-1), nrlock(0), nwlock(0),
+			  lstat(0), wlocked_at(0) {
     pthread_rwlock_init(&L, NULL);
     if (g_lockdep) id = lockdep_register(name);
   }
@@ -54,6 +82,10 @@ public:
 
   void unlock(bool lockdep=true) const {
     if (nwlock.read() > 0) {
+      if (wlocked_at) {
+	lockstat_hold(_lockstat(), lockstat_now() - wlocked_at);
+	wlocked_at = 0;
+      }
       nwlock.dec();
     } else {
       assert(nrlock.read() > 0);
@@ -67,7 +99,11 @@ public:
   // read
   void get_read() const {
     if (g_lockdep) id = lockdep_will_lock(name, id);
-    int r = pthread_rwlock_rdlock(&L);
+    int r;
+    if (g_lockstat)
+      r = _lockstat_rdlock();
+    else
+      r = pthread_rwlock_rdlock(&L);
     assert(r == 0);
     if (g_lockdep) id = lockdep_locked(name, id);
     nrlock.inc();
@@ -87,7 +123,11 @@ public:
   // write
   void get_write(bool lockdep=true) {
     if (lockdep && g_lockdep) id = lockdep_will_lock(name, id);
-    int r = pthread_rwlock_wrlock(&L);
+    int r;
+    if (g_lockstat)
+      r = _lockstat_wrlock();
+    else
+      r = pthread_rwlock_wrlock(&L);
     assert(r == 0);
     if (g_lockdep) id = lockdep_locked(name, id);
     nwlock.inc();
@@ -95,6 +135,7 @@ public:
   }
   bool try_get_write(bool lockdep=true) {
     if (pthread_rwlock_trywrlock(&L) == 0) {
+      if (g_lockstat) wlocked_at = lockstat_now();
       if (lockdep && g_lockdep) id = lockdep_locked(name, id);
       nwlock.inc();
       return true;
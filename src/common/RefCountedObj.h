@@ -51,6 +51,9 @@ public:
   void set_cct(CephContext *c) {
     cct = c;
   }
+  CephContext *get_cct() const {
+    return cct;
+  }
 
   uint64_t get_nref() {
     return nref.read();
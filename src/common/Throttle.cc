@@ -274,3 +274,118 @@ int SimpleThrottle::wait_for_ret()
     m_cond.Wait(m_lock);
   return m_ret;
 }
+
+void C_OrderedThrottle::finish(int r)
+{
+  m_throttle->end_op(m_tid, r);
+}
+
+OrderedThrottle::OrderedThrottle(uint64_t max_ops, uint64_t max_bytes,
+				 bool ignore_enoent)
+  : m_lock("OrderedThrottle::m_lock"),
+    m_max_ops(max_ops),
+    m_max_bytes(max_bytes),
+    m_current_bytes(0),
+    m_ret(0),
+    m_ignore_enoent(ignore_enoent),
+    m_next_tid(0),
+    m_complete_tid(0)
+{
+}
+
+OrderedThrottle::~OrderedThrottle()
+{
+  Mutex::Locker l(m_lock);
+  assert(m_tid_result.empty());
+}
+
+C_OrderedThrottle *OrderedThrottle::start_op(Context *on_finish,
+					     uint64_t bytes)
+{
+  Mutex::Locker l(m_lock);
+  complete_pending_ops();
+  while (is_full(bytes)) {
+    m_cond.Wait(m_lock);
+    complete_pending_ops();
+  }
+
+  uint64_t tid = m_next_tid++;
+  Result &result = m_tid_result[tid];
+  result.finished = false;
+  result.ret_val = 0;
+  result.bytes = bytes;
+  result.on_finish = on_finish;
+  m_current_bytes += bytes;
+  return new C_OrderedThrottle(this, tid);
+}
+
+void OrderedThrottle::fail(int r)
+{
+  Mutex::Locker l(m_lock);
+  set_error(r);
+}
+
+bool OrderedThrottle::pending_error() const
+{
+  Mutex::Locker l(m_lock);
+  return m_ret < 0;
+}
+
+int OrderedThrottle::wait_for_ret()
+{
+  Mutex::Locker l(m_lock);
+  complete_pending_ops();
+  while (!m_tid_result.empty()) {
+    m_cond.Wait(m_lock);
+    complete_pending_ops();
+  }
+  return m_ret;
+}
+
+void OrderedThrottle::end_op(uint64_t tid, int r)
+{
+  Mutex::Locker l(m_lock);
+  TidResult::iterator it = m_tid_result.find(tid);
+  assert(it != m_tid_result.end());
+  it->second.finished = true;
+  it->second.ret_val = r;
+  set_error(r);
+  m_cond.Signal();
+}
+
+void OrderedThrottle::set_error(int r)
+{
+  assert(m_lock.is_locked());
+  if (r < 0 && !m_ret && !(r == -ENOENT && m_ignore_enoent))
+    m_ret = r;
+}
+
+bool OrderedThrottle::is_full(uint64_t bytes) const
+{
+  if (m_tid_result.size() >= m_max_ops)
+    return true;
+  return m_max_bytes > 0 && m_current_bytes > 0 &&
+    m_current_bytes + bytes > m_max_bytes;
+}
+
+void OrderedThrottle::complete_pending_ops()
+{
+  assert(m_lock.is_locked());
+  while (!m_tid_result.empty()) {
+    TidResult::iterator it = m_tid_result.begin();
+    if (it->first != m_complete_tid || !it->second.finished)
+      break;
+
+    Result result = it->second;
+    m_tid_result.erase(it);
+    ++m_complete_tid;
+    m_current_bytes -= result.bytes;
+
+    // completions may start more ops
+    if (result.on_finish != NULL) {
+      m_lock.Unlock();
+      result.on_finish->complete(result.ret_val);
+      m_lock.Lock();
+    }
+  }
+}
@@ -7,6 +7,7 @@
 #include "Mutex.h"
 #include "Cond.h"
 #include <list>
+#include <map>
 #include "include/atomic.h"
 
 class CephContext;
@@ -98,4 +99,74 @@ private:
   SimpleThrottle *m_throttle;
 };
 
+class OrderedThrottle;
+
+class C_OrderedThrottle : public Context {
+public:
+  C_OrderedThrottle(OrderedThrottle *throttle, uint64_t tid)
+    : m_throttle(throttle), m_tid(tid) {}
+  virtual void finish(int r);
+private:
+  OrderedThrottle *m_throttle;
+  uint64_t m_tid;
+};
+
+/**
+ * @class OrderedThrottle
+ * Bounds the number of concurrent operations and the bytes they hold,
+ * and runs their completions in the order the operations were started.
+ *
+ * Completions run in the thread calling start_op() or wait_for_ret(),
+ * so a pipeline can keep many reads in flight and still consume their
+ * results sequentially from a single thread.  An operation holds its
+ * slot until its completion runs.
+ *
+ * Like SimpleThrottle, it tracks the first error, whether from an
+ * operation or reported by a completion through fail().
+ */
+class OrderedThrottle {
+public:
+  /// max_bytes of 0 means no limit; a larger op may run on its own
+  OrderedThrottle(uint64_t max_ops, uint64_t max_bytes, bool ignore_enoent);
+  ~OrderedThrottle();
+
+  /**
+   * Wait for room for an operation.
+   *
+   * @param on_finish run in order with the operation's result, may be NULL
+   * @returns the context to complete when the operation is done
+   */
+  C_OrderedThrottle *start_op(Context *on_finish, uint64_t bytes = 0);
+  void fail(int r);
+  bool pending_error() const;
+  int wait_for_ret();
+
+private:
+  friend class C_OrderedThrottle;
+
+  struct Result {
+    bool finished;
+    int ret_val;
+    uint64_t bytes;
+    Context *on_finish;
+  };
+  typedef std::map<uint64_t, Result> TidResult;
+
+  mutable Mutex m_lock;
+  Cond m_cond;
+  uint64_t m_max_ops;
+  uint64_t m_max_bytes;
+  uint64_t m_current_bytes;
+  int m_ret;
+  bool m_ignore_enoent;
+  uint64_t m_next_tid;
+  uint64_t m_complete_tid;
+  TidResult m_tid_result;
+
+  void end_op(uint64_t tid, int r);
+  void set_error(int r);
+  bool is_full(uint64_t bytes) const;
+  void complete_pending_ops();
+};
+
 #endif
@@ -88,6 +88,50 @@ void OpHistory::dump_ops(utime_t now, Formatter *f)
   f->close_section();
 }
 
+void OpStageHistogram::add(unsigned stage, utime_t latency)
+{
+  assert(stage < num_stages);
+  uint64_t us = latency.to_nsec() / 1000;
+  unsigned bin = 0;
+  for (uint64_t v = us; v > 0 && bin < BINS - 1; v >>= 1)
+    ++bin;
+  count[stage].inc();
+  total_us[stage].add(us);
+  hist[stage][bin].inc();
+}
+
+void OpStageHistogram::dump(Formatter *f) const
+{
+  f->open_object_section("op_stage_latency");
+  for (unsigned i = 0; i < num_stages; ++i) {
+    f->open_object_section(stage_names[i]);
+    uint64_t n = count[i].read();
+    uint64_t total = total_us[i].read();
+    f->dump_unsigned("count", n);
+    f->dump_unsigned("total_us", total);
+    f->dump_unsigned("avg_us", n ? total / n : 0);
+    unsigned bins = BINS;
+    while (bins > 0 && hist[i][bins-1].read() == 0)
+      --bins;
+    f->open_array_section("histogram_us");
+    for (unsigned b = 0; b < bins; ++b)
+      f->dump_unsigned("count", hist[i][b].read());
+    f->close_section();
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void OpStageHistogram::reset()
+{
+  for (unsigned i = 0; i < MAX_STAGES; ++i) {
+    count[i].set(0);
+    total_us[i].set(0);
+    for (unsigned b = 0; b < BINS; ++b)
+      hist[i][b].set(0);
+  }
+}
+
 void OpTracker::dump_historic_ops(Formatter *f)
 {
   utime_t now = ceph_clock_now(cct);
@@ -51,6 +51,39 @@ public:
   }
 };
 
+/**
+ * Latency histograms for the stages of a TrackedOp.
+ *
+ * Stages are small integers defined by the TrackedOp subclass, which
+ * feeds the time spent reaching each stage (from the previous stage
+ * it reached) as the op completes.  Counters are atomic so that every
+ * op can be accounted without taking a lock.
+ */
+class OpStageHistogram {
+public:
+  static const unsigned MAX_STAGES = 16;
+  static const unsigned BINS = 32;  ///< bin i holds latencies < 2^i usec
+
+private:
+  const char * const *stage_names;
+  unsigned num_stages;
+  atomic64_t count[MAX_STAGES];
+  atomic64_t total_us[MAX_STAGES];
+  atomic64_t hist[MAX_STAGES][BINS];
+
+public:
+  OpStageHistogram() : stage_names(NULL), num_stages(0) {}
+
+  void set_stages(const char * const *names, unsigned n) {
+    assert(n <= MAX_STAGES);
+    stage_names = names;
+    num_stages = n;
+  }
+  void add(unsigned stage, utime_t latency);
+  void dump(Formatter *f) const;
+  void reset();
+};
+
 class OpTracker {
   class RemoveOnDelete {
     OpTracker *tracker;
@@ -70,6 +103,7 @@ class OpTracker {
   vector<ShardedTrackingData*> sharded_in_flight_list;
   uint32_t num_optracker_shards;
   OpHistory history;
+  OpStageHistogram stage_histogram;
   float complaint_time;
   int log_threshold;
   void _mark_event(TrackedOp *op, const string &evt, utime_t now);
@@ -99,6 +133,15 @@ public:
   }
   void dump_ops_in_flight(Formatter *f);
   void dump_historic_ops(Formatter *f);
+  void set_stages(const char * const *names, unsigned n) {
+    stage_histogram.set_stages(names, n);
+  }
+  void add_stage_latency(unsigned stage, utime_t latency) {
+    stage_histogram.add(stage, latency);
+  }
+  void dump_stage_latency(Formatter *f) {
+    stage_histogram.dump(f);
+  }
   void register_inflight_op(xlist<TrackedOp*>::item *i);
   void unregister_inflight_op(TrackedOp *i);
 
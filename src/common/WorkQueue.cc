@@ -21,6 +21,7 @@
 
 #include "common/config.h"
 #include "common/HeartbeatMap.h"
+#include "common/profile_tag.h"
 
 #define dout_subsys ceph_subsys_tp
 #undef dout_prefix
@@ -96,6 +97,7 @@ void ThreadPool::worker(WorkThread *wt)
   std::stringstream ss;
   ss << name << " thread " << (void*)pthread_self();
   heartbeat_handle_d *hb = cct->get_heartbeat_map()->add_worker(ss.str());
+  profile_tag_set_wq(name.c_str());
 
   while (!_stop) {
 
@@ -125,7 +127,9 @@ void ThreadPool::worker(WorkThread *wt)
 	  TPHandle tp_handle(cct, hb, wq->timeout_interval, wq->suicide_interval);
 	  tp_handle.reset_tp_timeout();
 	  _lock.Unlock();
+	  profile_tag_set_wq(wq->name.c_str());
 	  wq->_void_process(item, tp_handle);
+	  profile_tag_set_wq(name.c_str());
 	  _lock.Lock();
 	  wq->_void_process_finish(item);
 	  processing--;
@@ -294,6 +298,7 @@ void ShardedThreadPool::shardedthreadpool_worker(uint32_t thread_index)
   std::stringstream ss;
   ss << name << " thread " << (void*)pthread_self();
   heartbeat_handle_d *hb = cct->get_heartbeat_map()->add_worker(ss.str());
+  profile_tag_set_wq(name.c_str());
 
   while (!stop_threads.read()) {
     if(pause_threads.read()) {
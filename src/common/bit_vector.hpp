@@ -0,0 +1,219 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMMON_BIT_VECTOR_HPP
+#define CEPH_COMMON_BIT_VECTOR_HPP
+
+#include "include/int_types.h"
+#include "include/encoding.h"
+#include "common/Formatter.h"
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <list>
+#include <string.h>
+
+namespace ceph {
+
+/**
+ * A packed vector of _bit_count-bit elements.
+ *
+ * The encoding is a fixed-length header followed by the raw element
+ * bytes, so a holder of the encoded form (e.g. an object class) can
+ * read or rewrite the bytes backing a range of elements in place;
+ * see get_header_length() and get_data_extents().
+ */
+template <uint8_t _bit_count>
+class BitVector
+{
+  BOOST_STATIC_ASSERT(_bit_count != 0 && (_bit_count & (_bit_count - 1)) == 0);
+  BOOST_STATIC_ASSERT(_bit_count <= 8);
+
+  static const uint32_t ELEMENTS_PER_BYTE = 8 / _bit_count;
+  static const uint8_t MASK = (1 << _bit_count) - 1;
+
+public:
+  class ConstReference {
+  public:
+    operator uint8_t() const {
+      return (*m_byte >> m_shift) & MASK;
+    }
+  private:
+    friend class BitVector;
+    const uint8_t *m_byte;
+    uint8_t m_shift;
+    ConstReference(const uint8_t *byte, uint8_t shift)
+      : m_byte(byte), m_shift(shift) {}
+  };
+
+  class Reference {
+  public:
+    operator uint8_t() const {
+      return (*m_byte >> m_shift) & MASK;
+    }
+    Reference& operator=(uint8_t v) {
+      *m_byte = (*m_byte & ~(MASK << m_shift)) | ((v & MASK) << m_shift);
+      return *this;
+    }
+  private:
+    friend class BitVector;
+    uint8_t *m_byte;
+    uint8_t m_shift;
+    Reference(uint8_t *byte, uint8_t shift)
+      : m_byte(byte), m_shift(shift) {}
+  };
+
+  BitVector() : m_size(0) {}
+
+  void clear() {
+    m_data = bufferptr();
+    m_size = 0;
+  }
+
+  void swap(BitVector &other) {
+    m_data.swap(other.m_data);
+    std::swap(m_size, other.m_size);
+  }
+
+  /// resize, zeroing any new elements
+  void resize(uint64_t elements) {
+    uint64_t bytes = byte_length(elements);
+    bufferptr p = buffer::create(bytes);
+    p.zero();
+    uint64_t keep = MIN(bytes, (uint64_t)m_data.length());
+    if (keep)
+      memcpy(p.c_str(), m_data.c_str(), keep);
+    m_data.swap(p);
+    m_size = elements;
+
+    // a shrink may leave stale elements in the last byte
+    for (uint64_t i = elements; i < bytes * ELEMENTS_PER_BYTE; ++i)
+      (*this)[i] = 0;
+  }
+
+  uint64_t size() const {
+    return m_size;
+  }
+
+  ConstReference operator[](uint64_t offset) const {
+    assert(offset < m_data.length() * ELEMENTS_PER_BYTE);
+    return ConstReference(
+      reinterpret_cast<const uint8_t*>(m_data.c_str()) + offset / ELEMENTS_PER_BYTE,
+      (offset % ELEMENTS_PER_BYTE) * _bit_count);
+  }
+
+  Reference operator[](uint64_t offset) {
+    assert(offset < m_data.length() * ELEMENTS_PER_BYTE);
+    return Reference(
+      reinterpret_cast<uint8_t*>(m_data.c_str()) + offset / ELEMENTS_PER_BYTE,
+      (offset % ELEMENTS_PER_BYTE) * _bit_count);
+  }
+
+  /// number of bytes backing the given number of elements
+  static uint64_t byte_length(uint64_t elements) {
+    return (elements + ELEMENTS_PER_BYTE - 1) / ELEMENTS_PER_BYTE;
+  }
+
+  /// byte range of the data section covering elements [offset, offset+length)
+  static void get_data_extents(uint64_t offset, uint64_t length,
+			       uint64_t *byte_offset, uint64_t *byte_len) {
+    *byte_offset = offset / ELEMENTS_PER_BYTE;
+    *byte_len = byte_length(offset + length) - *byte_offset;
+  }
+
+  static uint64_t get_header_length() {
+    // ENCODE_START framing plus the element count
+    return sizeof(__u8) + sizeof(__u8) + sizeof(__u32) + sizeof(uint64_t);
+  }
+
+  void encode_header(bufferlist& bl) const {
+    ENCODE_START(1, 1, bl);
+    ::encode(m_size, bl);
+    ENCODE_FINISH(bl);
+  }
+
+  /// decode the header; the element bytes are left zeroed
+  void decode_header(bufferlist::iterator& it) {
+    uint64_t elements;
+    DECODE_START(1, it);
+    ::decode(elements, it);
+    DECODE_FINISH(it);
+    clear();
+    resize(elements);
+  }
+
+  void encode_data(bufferlist& bl, uint64_t byte_offset,
+		   uint64_t byte_len) const {
+    assert(byte_offset + byte_len <= m_data.length());
+    bl.append(m_data.c_str() + byte_offset, byte_len);
+  }
+
+  void decode_data(bufferlist::iterator& it, uint64_t byte_offset,
+		   uint64_t byte_len) {
+    assert(byte_offset + byte_len <= m_data.length());
+    it.copy(byte_len, m_data.c_str() + byte_offset);
+  }
+
+  void encode(bufferlist& bl) const {
+    encode_header(bl);
+    if (m_data.length())
+      bl.append(m_data);
+  }
+
+  void decode(bufferlist::iterator& it) {
+    decode_header(it);
+    if (m_data.length())
+      decode_data(it, 0, m_data.length());
+  }
+
+  void dump(Formatter *f) const {
+    f->dump_unsigned("size", m_size);
+    f->open_array_section("bit_table");
+    for (unsigned i = 0; i < m_data.length(); ++i)
+      f->dump_format("byte", "0x%02hhX", (uint8_t)m_data.c_str()[i]);
+    f->close_section();
+  }
+
+  bool operator==(const BitVector& b) const {
+    return m_size == b.m_size && m_data.length() == b.m_data.length() &&
+      (m_data.length() == 0 ||
+       memcmp(m_data.c_str(), b.m_data.c_str(), m_data.length()) == 0);
+  }
+
+  static void generate_test_instances(std::list<BitVector*>& o) {
+    o.push_back(new BitVector());
+    BitVector *b = new BitVector();
+    const uint64_t radix = 1 << _bit_count;
+    const uint64_t size = 1024;
+    b->resize(size);
+    for (uint64_t i = 0; i < size; ++i)
+      (*b)[i] = rand() % radix;
+    o.push_back(b);
+  }
+
+private:
+  bufferptr m_data;
+  uint64_t m_size;
+};
+
+}
+
+template <uint8_t _b>
+inline void encode(const ceph::BitVector<_b>& v, bufferlist& bl) {
+  v.encode(bl);
+}
+
+template <uint8_t _b>
+inline void decode(ceph::BitVector<_b>& v, bufferlist::iterator& p) {
+  v.decode(p);
+}
+
+#endif // CEPH_COMMON_BIT_VECTOR_HPP
@@ -828,6 +828,23 @@ static simple_spinlock_t buffer_debug_lock = SIMPLE_SPINLOCK_INITIALIZER;
     return ptr(*p, p_off, p->length() - p_off);
   }
   
+  buffer::ptr buffer::list::iterator::get_contiguous(unsigned len)
+  {
+    if (p == ls->end()) seek(off);
+    if (len == 0)
+      return ptr();
+    if (p == ls->end() || len > get_remaining())
+      throw end_of_buffer();
+    if (p->length() - p_off >= len) {
+      ptr r(*p, p_off, len);
+      advance(len);
+      return r;
+    }
+    ptr r = create(len);
+    copy(len, r.c_str());
+    return r;
+  }
+
   // copy data out.
   // note that these all _append_ to dest!
   
@@ -1274,6 +1291,27 @@ void buffer::list::rebuild_page_aligned()
     }
   }
 
+  char *buffer::list::obtain_contiguous_space(unsigned len)
+  {
+    if (!append_buffer.have_raw() || append_buffer.unused_tail_length() < len) {
+      unsigned alen = CEPH_PAGE_SIZE * ((len + CEPH_PAGE_SIZE - 1) / CEPH_PAGE_SIZE);
+      if (alen == 0)
+	alen = CEPH_PAGE_SIZE;
+      append_buffer = create_page_aligned(alen);
+      append_buffer.set_length(0);   // unused, so far.
+    }
+    return append_buffer.c_str() + append_buffer.length();
+  }
+
+  void buffer::list::commit_contiguous_space(unsigned len)
+  {
+    if (len == 0)
+      return;
+    assert(len <= append_buffer.unused_tail_length());
+    append_buffer.set_length(append_buffer.length() + len);
+    append(append_buffer, append_buffer.end() - len, len);
+  }
+
   void buffer::list::append(const ptr& bp)
   {
     if (bp.length())
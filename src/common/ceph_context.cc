@@ -25,6 +25,7 @@
 #include "common/HeartbeatMap.h"
 #include "common/errno.h"
 #include "common/lockdep.h"
+#include "common/lockstat.h"
 #include "common/Formatter.h"
 #include "log/Log.h"
 #include "auth/Crypto.h"
@@ -155,6 +156,44 @@ public:
 };
 
 
+/**
+ * observe lock contention profiler config changes
+ *
+ * The profiler state is process-wide; the first context to turn it
+ * on owns it until it is switched off or that context goes away.
+ */
+class LockstatObs : public md_config_obs_t {
+  CephContext *cct;
+
+public:
+  LockstatObs(CephContext *c) : cct(c) {}
+
+  const char** get_tracked_conf_keys() const {
+    static const char *KEYS[] = {
+      "lockstat",
+      "lockstat_backtrace_sample",
+      NULL
+    };
+    return KEYS;
+  }
+
+  void handle_conf_change(const md_config_t *conf,
+                          const std::set <std::string> &changed) {
+    if (changed.count("lockstat_backtrace_sample")) {
+      g_lockstat_backtrace_sample = conf->lockstat_backtrace_sample;
+    }
+    if (changed.count("lockstat")) {
+      if (conf->lockstat) {
+	lockstat_register_ceph_context(cct);
+	g_lockstat = true;
+      } else {
+	lockstat_unregister_ceph_context(cct);
+      }
+    }
+  }
+};
+
+
 // perfcounter hooks
 
 class CephContextHook : public AdminSocketHook {
@@ -201,6 +240,12 @@ void CephContext::do_command(std::string command, cmdmap_t& cmdmap,
         f->dump_stream("error") << "Not find: " << var;
     }
   }
+  else if (command == "dump_lock_contention") {
+    lockstat_dump(f);
+  }
+  else if (command == "reset_lock_contention") {
+    lockstat_reset();
+  }
   else {
     string section = command;
     boost::replace_all(section, " ", "_");
@@ -302,6 +347,7 @@ CephContext::CephContext(uint32_t module_type_)
     _module_type(module_type_),
     _service_thread(NULL),
     _log_obs(NULL),
+    _lockstat_obs(NULL),
     _admin_socket(NULL),
     _perf_counters_collection(NULL),
     _perf_counters_conf_obs(NULL),
@@ -318,6 +364,9 @@ CephContext::CephContext(uint32_t module_type_)
   _log_obs = new LogObs(_log);
   _conf->add_observer(_log_obs);
 
+  _lockstat_obs = new LockstatObs(this);
+  _conf->add_observer(_lockstat_obs);
+
   _perf_counters_collection = new PerfCountersCollection(this);
   _admin_socket = new AdminSocket(this);
   _heartbeat_map = new HeartbeatMap(this);
@@ -339,6 +388,8 @@ CephContext::CephContext(uint32_t module_type_)
   _admin_socket->register_command("log flush", "log flush", _admin_hook, "flush log entries to log file");
   _admin_socket->register_command("log dump", "log dump", _admin_hook, "dump recent log entries to log file");
   _admin_socket->register_command("log reopen", "log reopen", _admin_hook, "reopen log file");
+  _admin_socket->register_command("dump_lock_contention", "dump_lock_contention", _admin_hook, "dump lock wait/hold time histograms and sampled backtraces (requires lockstat = true)");
+  _admin_socket->register_command("reset_lock_contention", "reset_lock_contention", _admin_hook, "reset lock contention statistics");
 
   _crypto_none = new CryptoNone;
   _crypto_aes = new CryptoAES;
@@ -370,6 +421,8 @@ CephContext::~CephContext()
   _admin_socket->unregister_command("log flush");
   _admin_socket->unregister_command("log dump");
   _admin_socket->unregister_command("log reopen");
+  _admin_socket->unregister_command("dump_lock_contention");
+  _admin_socket->unregister_command("reset_lock_contention");
   delete _admin_hook;
   delete _admin_socket;
 
@@ -385,6 +438,11 @@ CephContext::~CephContext()
   delete _log_obs;
   _log_obs = NULL;
 
+  lockstat_unregister_ceph_context(this);
+  _conf->remove_observer(_lockstat_obs);
+  delete _lockstat_obs;
+  _lockstat_obs = NULL;
+
   _log->stop();
   delete _log;
   _log = NULL;
@@ -139,6 +139,9 @@ private:
 
   md_config_obs_t *_log_obs;
 
+  /* observes lockstat config changes */
+  md_config_obs_t *_lockstat_obs;
+
   /* The admin socket associated with this context */
   AdminSocket *_admin_socket;
 
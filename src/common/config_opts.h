@@ -23,6 +23,8 @@ OPTION(num_client, OPT_INT, 1)
 OPTION(monmap, OPT_STR, "")
 OPTION(mon_host, OPT_STR, "")
 OPTION(lockdep, OPT_BOOL, false)
+OPTION(lockstat, OPT_BOOL, false) // record per-lock wait/hold times (dump_lock_contention)
+OPTION(lockstat_backtrace_sample, OPT_INT, 100) // backtrace every N contended acquisitions; 0 = never
 OPTION(run_dir, OPT_STR, "/var/run/ceph")       // the "/var/run/ceph" dir, created on daemon startup
 OPTION(admin_socket, OPT_STR, "$run_dir/$cluster-$name.asok") // default changed by common_preinit()
 
@@ -282,6 +284,7 @@ OPTION(client_oc_max_dirty, OPT_INT, 1024*1024* 100)    // MB * n  (dirty OR tx.
 OPTION(client_oc_target_dirty, OPT_INT, 1024*1024* 8) // target dirty (keep this smallish)
 OPTION(client_oc_max_dirty_age, OPT_DOUBLE, 5.0)      // max age in cache before writeback
 OPTION(client_oc_max_objects, OPT_INT, 1000)      // max objects in cache
+OPTION(client_oc_policy, OPT_STR, "lru")      // replacement policy for clean data: lru or 2q
 OPTION(client_debug_force_sync_read, OPT_BOOL, false)     // always read synchronously (go to osds)
 OPTION(client_debug_inject_tick_delay, OPT_INT, 0) // delay the client tick for a number of seconds
 OPTION(client_max_inline_size, OPT_U64, 4096)
@@ -302,9 +305,13 @@ OPTION(objecter_timeout, OPT_DOUBLE, 10.0)    // before we ask for a map
 OPTION(objecter_inflight_op_bytes, OPT_U64, 1024*1024*100) // max in-flight data (both directions)
 OPTION(objecter_inflight_ops, OPT_U64, 1024)               // max in-flight ios
 OPTION(objecter_completion_locks_per_session, OPT_U64, 32) // num of completion locks per each session, for serializing same object responses
+OPTION(objecter_batch_max_ops, OPT_INT, 64)      // ops queued for one osd that may share a message (1 to disable)
+OPTION(objecter_batch_max_bytes, OPT_U64, 1<<20) // only batch ops until their data reaches this
+OPTION(filer_probe_periods, OPT_INT, 8)   // periods statted at once when probing forward for the end of a file
 OPTION(journaler_allow_split_entries, OPT_BOOL, true)
 OPTION(journaler_write_head_interval, OPT_INT, 15)
 OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size
+OPTION(journaler_replay_prefetch_periods, OPT_INT, 40)   // * journal object size, while replaying (read-only)
 OPTION(journaler_prezero_periods, OPT_INT, 5)     // * journal object size
 OPTION(journaler_batch_interval, OPT_DOUBLE, .001)   // seconds.. max add latency we artificially incur
 OPTION(journaler_batch_max, OPT_U64, 0)  // max bytes we'll delay flushing; disable, for now....
@@ -787,6 +794,8 @@ OPTION(journal_discard, OPT_BOOL, false) //using ssd disk as journal, whether su
 
 OPTION(rados_mon_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from the monitor before returning an error from a rados operation. 0 means on limit.
 OPTION(rados_osd_op_timeout, OPT_DOUBLE, 0) // how many seconds to wait for a response from osds before returning an error from a rados operation. 0 means no limit.
+OPTION(rados_striper_readahead_trigger_requests, OPT_INT, 3) // number of sequential reads of a striped object necessary to trigger readahead
+OPTION(rados_striper_readahead_max_bytes, OPT_LONGLONG, 16 << 20) // most bytes read ahead of a sequential reader of a striped object. 0 disables readahead
 
 OPTION(rbd_cache, OPT_BOOL, true) // whether to enable caching (writeback unless rbd_cache_max_dirty is 0)
 OPTION(rbd_cache_writethrough_until_flush, OPT_BOOL, true) // whether to make writeback caching writethrough until flush is called, to be sure the user of librbd will send flushs so that writeback is safe
@@ -795,8 +804,14 @@ OPTION(rbd_cache_max_dirty, OPT_LONGLONG, 24<<20)    // dirty limit in bytes - s
 OPTION(rbd_cache_target_dirty, OPT_LONGLONG, 16<<20) // target dirty limit in bytes
 OPTION(rbd_cache_max_dirty_age, OPT_FLOAT, 1.0)      // seconds in cache before writeback starts
 OPTION(rbd_cache_max_dirty_object, OPT_INT, 0)       // dirty limit for objects - set to 0 for auto calculate from rbd_cache_size
+OPTION(rbd_cache_policy, OPT_STR, "lru")  // replacement policy for clean data: lru, or 2q to keep scans from flushing the cache
 OPTION(rbd_cache_block_writes_upfront, OPT_BOOL, false) // whether to block writes to the cache before the aio_write call completes (true), or block before the aio completion is called (false)
+OPTION(rbd_clone_copy_on_read, OPT_BOOL, false) // copy up objects of a clone that are read from its parent
+OPTION(rbd_clone_copy_on_read_max_ops, OPT_INT, 2) // how many copy-on-read copyups can be in flight per image
+OPTION(rbd_clone_copy_on_read_max_queued, OPT_INT, 128) // how many copy-on-read copyups can wait per image before more are dropped
+OPTION(rbd_parent_cache_size, OPT_U64, 0) // bytes of parent snapshot objects cached by each client, shared by all of its clones; 0 disables the cache
 OPTION(rbd_concurrent_management_ops, OPT_INT, 10) // how many operations can be in flight for a management operation like deleting or resizing an image
+OPTION(rbd_concurrent_management_bytes, OPT_U64, 64 << 20) // how many bytes of data a management operation like copying or exporting an image can have in flight
 OPTION(rbd_balance_snap_reads, OPT_BOOL, false)
 OPTION(rbd_localize_snap_reads, OPT_BOOL, false)
 OPTION(rbd_balance_parent_reads, OPT_BOOL, false)
@@ -804,6 +819,12 @@ OPTION(rbd_localize_parent_reads, OPT_BOOL, true)
 OPTION(rbd_readahead_trigger_requests, OPT_INT, 10) // number of sequential requests necessary to trigger readahead
 OPTION(rbd_readahead_max_bytes, OPT_LONGLONG, 512 * 1024) // set to 0 to disable readahead
 OPTION(rbd_readahead_disable_after_bytes, OPT_LONGLONG, 50 * 1024 * 1024) // how many bytes are read in total before readahead is disabled
+OPTION(rbd_lock_request_timeout, OPT_DOUBLE, 5.0) // seconds to wait for the exclusive lock owner to release the lock before checking it's still alive
+OPTION(rbd_blacklist_on_break_lock, OPT_BOOL, true) // whether to blacklist clients whose exclusive lock was broken
+OPTION(rbd_blacklist_expire_seconds, OPT_INT, 0) // number of seconds to blacklist - set to 0 for OSD default
+OPTION(rbd_persistent_cache_path, OPT_STR, "") // directory for persistent write-back cache logs - empty to disable. only used with the exclusive lock feature
+OPTION(rbd_persistent_cache_size, OPT_U64, 1 << 30) // size of the log for each image, when it's created
+OPTION(rbd_persistent_cache_max_writeback_ops, OPT_INT, 32) // how many writes from the log can be in flight to the cluster
 
 /*
  * The following options change the behavior for librbd's image creation methods that
@@ -931,6 +952,7 @@ OPTION(rgw_user_quota_sync_wait_time, OPT_INT, 3600 * 24) // min time between tw
 OPTION(rgw_multipart_min_part_size, OPT_INT, 5 * 1024 * 1024) // min size for each part (except for last one) in multipart upload
 
 OPTION(mutex_perf_counter, OPT_BOOL, false) // enable/disable mutex perf counter
+OPTION(sampling_profiler_max_samples, OPT_INT, 65536) // samples kept by the built-in sampling profiler
 OPTION(throttler_perf_counter, OPT_BOOL, true) // enable/disable throttler perf counter
 
 // This will be set to true when it is safe to start threads.
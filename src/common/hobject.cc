@@ -104,19 +104,13 @@ string hobject_t::to_str() const
 
 void hobject_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(4, 3, bl);
-  ::encode(key, bl);
-  ::encode(oid, bl);
-  ::encode(snap, bl);
-  ::encode(hash, bl);
-  ::encode(max, bl);
-  ::encode(nspace, bl);
-  ::encode(pool, bl);
-  ENCODE_FINISH(bl);
+  denc_encode(*this, bl);
 }
 
 void hobject_t::decode(bufferlist::iterator& bl)
 {
+  if (denc_decode(*this, bl, 4))
+    return;
   DECODE_START_LEGACY_COMPAT_LEN(4, 3, 3, bl);
   if (struct_v >= 1)
     ::decode(key, bl);
@@ -134,6 +128,44 @@ void hobject_t::decode(bufferlist::iterator& bl)
   DECODE_FINISH(bl);
 }
 
+void hobject_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(key, p);
+  ::bound_encode(oid, p);
+  ::bound_encode(snap, p);
+  ::bound_encode(hash, p);
+  ::bound_encode(max, p);
+  ::bound_encode(nspace, p);
+  ::bound_encode(pool, p);
+}
+
+void hobject_t::encode(contiguous_appender& p) const
+{
+  DENC_START(4, 3, p);
+  ::encode(key, p);
+  ::encode(oid, p);
+  ::encode(snap, p);
+  ::encode(hash, p);
+  ::encode(max, p);
+  ::encode(nspace, p);
+  ::encode(pool, p);
+  DENC_FINISH(p);
+}
+
+void hobject_t::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(4, 4, p);
+  ::decode(key, p);
+  ::decode(oid, p);
+  ::decode(snap, p);
+  ::decode(hash, p);
+  ::decode(max, p);
+  ::decode(nspace, p);
+  ::decode(pool, p);
+  DENC_DECODE_FINISH(p);
+}
+
 void hobject_t::decode(json_spirit::Value& v)
 {
   using namespace json_spirit;
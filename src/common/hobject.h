@@ -194,6 +194,9 @@ public:
 
   void encode(bufferlist& bl) const;
   void decode(bufferlist::iterator& bl);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void decode(json_spirit::Value& v);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<hobject_t*>& o);
@@ -206,6 +209,7 @@ public:
   friend struct ghobject_t;
 };
 WRITE_CLASS_ENCODER(hobject_t)
+WRITE_CLASS_DENC(hobject_t)
 
 CEPH_HASH_NAMESPACE_START
   template<> struct hash<hobject_t> {
@@ -0,0 +1,236 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#include <execinfo.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "common/dout.h"
+#include "common/Formatter.h"
+#include "include/atomic.h"
+#include "include/types.h"
+#include "lockstat.h"
+
+/******* Constants **********/
+#define lockstat_dout(v) lsubdout(g_lockstat_ceph_ctx, lockdep, v)
+#define LOCKSTAT_BUCKETS 32      // bin i holds times < 2^i usec
+#define LOCKSTAT_MAX_STACKS 32   // distinct backtraces kept per lock
+#define BACKTRACE_DEPTH 16
+#define BACKTRACE_SKIP 2         // lockstat_wait() and the lock method
+
+struct lockstat_entry_t {
+  string name;
+  atomic64_t wait_count, wait_write_count, wait_ns;
+  atomic64_t hold_count, hold_ns;
+  atomic64_t wait_hist[LOCKSTAT_BUCKETS];
+  atomic64_t hold_hist[LOCKSTAT_BUCKETS];
+  atomic_t sample_seq;
+  map<vector<void*>, uint64_t> stacks;   // protected by lockstat_mutex
+
+  lockstat_entry_t(const char *n) : name(n) {}
+
+  void reset() {
+    wait_count.set(0);
+    wait_write_count.set(0);
+    wait_ns.set(0);
+    hold_count.set(0);
+    hold_ns.set(0);
+    for (unsigned i = 0; i < LOCKSTAT_BUCKETS; ++i) {
+      wait_hist[i].set(0);
+      hold_hist[i].set(0);
+    }
+    sample_seq.set(0);
+    stacks.clear();
+  }
+};
+
+/******* Globals **********/
+int g_lockstat = 0;
+int g_lockstat_backtrace_sample = 0;
+static pthread_mutex_t lockstat_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CephContext *g_lockstat_ceph_ctx = NULL;
+// entries are never freed: each lock caches a pointer to its slot
+static map<string, lockstat_entry_t*> lockstat_entries;
+
+/******* Functions **********/
+void lockstat_register_ceph_context(CephContext *cct)
+{
+  pthread_mutex_lock(&lockstat_mutex);
+  if (g_lockstat_ceph_ctx == NULL) {
+    g_lockstat_ceph_ctx = cct;
+    lockstat_dout(0) << "lockstat start" << dendl;
+  }
+  pthread_mutex_unlock(&lockstat_mutex);
+}
+
+void lockstat_unregister_ceph_context(CephContext *cct)
+{
+  pthread_mutex_lock(&lockstat_mutex);
+  if (cct == g_lockstat_ceph_ctx) {
+    lockstat_dout(0) << "lockstat stop" << dendl;
+    // this cct is going away; stop profiling, but keep the entries
+    // around since locks may still point at them.
+    g_lockstat = 0;
+    g_lockstat_ceph_ctx = NULL;
+  }
+  pthread_mutex_unlock(&lockstat_mutex);
+}
+
+uint64_t lockstat_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+lockstat_entry_t *lockstat_lookup(const char *name)
+{
+  pthread_mutex_lock(&lockstat_mutex);
+  lockstat_entry_t *e;
+  map<string, lockstat_entry_t*>::iterator p = lockstat_entries.find(name);
+  if (p == lockstat_entries.end()) {
+    e = new lockstat_entry_t(name);
+    lockstat_entries[name] = e;
+  } else {
+    e = p->second;
+  }
+  pthread_mutex_unlock(&lockstat_mutex);
+  return e;
+}
+
+static unsigned lockstat_bin(uint64_t ns)
+{
+  uint64_t us = ns >> 10;
+  unsigned b = 0;
+  while (us > 0 && b < LOCKSTAT_BUCKETS - 1) {
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+void lockstat_wait(lockstat_entry_t *e, uint64_t wait_ns, bool write)
+{
+  e->wait_count.inc();
+  if (write)
+    e->wait_write_count.inc();
+  e->wait_ns.add(wait_ns);
+  e->wait_hist[lockstat_bin(wait_ns)].inc();
+
+  int sample = g_lockstat_backtrace_sample;
+  if (sample <= 0 || e->sample_seq.inc() % sample)
+    return;
+
+  void *array[BACKTRACE_DEPTH + BACKTRACE_SKIP];
+  int size = backtrace(array, BACKTRACE_DEPTH + BACKTRACE_SKIP);
+  if (size <= BACKTRACE_SKIP)
+    return;
+  vector<void*> frames(array + BACKTRACE_SKIP, array + size);
+
+  pthread_mutex_lock(&lockstat_mutex);
+  map<vector<void*>, uint64_t>::iterator p = e->stacks.find(frames);
+  if (p != e->stacks.end())
+    p->second++;
+  else if (e->stacks.size() < LOCKSTAT_MAX_STACKS)
+    e->stacks[frames] = 1;
+  pthread_mutex_unlock(&lockstat_mutex);
+}
+
+void lockstat_hold(lockstat_entry_t *e, uint64_t hold_ns)
+{
+  e->hold_count.inc();
+  e->hold_ns.add(hold_ns);
+  e->hold_hist[lockstat_bin(hold_ns)].inc();
+}
+
+static bool lockstat_cmp_wait(const lockstat_entry_t *a,
+			      const lockstat_entry_t *b)
+{
+  return a->wait_ns.read() > b->wait_ns.read();
+}
+
+static void lockstat_dump_hist(ceph::Formatter *f, const char *name,
+			       atomic64_t *hist)
+{
+  unsigned n = LOCKSTAT_BUCKETS;
+  while (n > 0 && hist[n-1].read() == 0)
+    --n;
+  f->open_array_section(name);
+  for (unsigned i = 0; i < n; ++i)
+    f->dump_unsigned("count", hist[i].read());
+  f->close_section();
+}
+
+void lockstat_dump(ceph::Formatter *f)
+{
+  pthread_mutex_lock(&lockstat_mutex);
+  vector<lockstat_entry_t*> ls;
+  for (map<string, lockstat_entry_t*>::iterator p = lockstat_entries.begin();
+       p != lockstat_entries.end();
+       ++p) {
+    if (p->second->hold_count.read() || p->second->wait_count.read())
+      ls.push_back(p->second);
+  }
+  std::sort(ls.begin(), ls.end(), lockstat_cmp_wait);
+
+  f->open_object_section("lock_contention");
+  f->dump_bool("enabled", g_lockstat);
+  f->dump_int("backtrace_sample", g_lockstat_backtrace_sample);
+  f->open_array_section("locks");
+  for (vector<lockstat_entry_t*>::iterator p = ls.begin(); p != ls.end(); ++p) {
+    lockstat_entry_t *e = *p;
+    f->open_object_section("lock");
+    f->dump_string("name", e->name);
+    f->dump_unsigned("acquired", e->hold_count.read());
+    f->dump_unsigned("contended", e->wait_count.read());
+    f->dump_unsigned("contended_write", e->wait_write_count.read());
+    f->dump_unsigned("wait_ns", e->wait_ns.read());
+    f->dump_unsigned("hold_ns", e->hold_ns.read());
+    lockstat_dump_hist(f, "wait_histogram_us", e->wait_hist);
+    lockstat_dump_hist(f, "hold_histogram_us", e->hold_hist);
+    f->open_array_section("backtraces");
+    for (map<vector<void*>, uint64_t>::iterator q = e->stacks.begin();
+	 q != e->stacks.end();
+	 ++q) {
+      f->open_object_section("backtrace");
+      f->dump_unsigned("count", q->second);
+      char **strings = backtrace_symbols((void * const *)&q->first[0],
+					 q->first.size());
+      f->open_array_section("frames");
+      for (unsigned i = 0; i < q->first.size(); ++i) {
+	if (strings)
+	  f->dump_string("frame", strings[i]);
+	else
+	  f->dump_format("frame", "%p", q->first[i]);
+      }
+      f->close_section();
+      free(strings);
+      f->close_section();
+    }
+    f->close_section();
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+  pthread_mutex_unlock(&lockstat_mutex);
+}
+
+void lockstat_reset()
+{
+  pthread_mutex_lock(&lockstat_mutex);
+  for (map<string, lockstat_entry_t*>::iterator p = lockstat_entries.begin();
+       p != lockstat_entries.end();
+       ++p)
+    p->second->reset();
+  pthread_mutex_unlock(&lockstat_mutex);
+}
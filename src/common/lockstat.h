@@ -0,0 +1,51 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_LOCKSTAT_H
+#define CEPH_LOCKSTAT_H
+
+#include <stdint.h>
+
+class CephContext;
+namespace ceph {
+  class Formatter;
+}
+
+/**
+ * lock contention profiler
+ *
+ * When g_lockstat is set, Mutex and RWLock record how long each
+ * acquisition waited and how long the lock was held, aggregated per
+ * lock name into power-of-2 histograms.  Every
+ * g_lockstat_backtrace_sample'th contended acquisition of a lock
+ * also captures the caller's backtrace.  Results are dumped by the
+ * 'dump_lock_contention' admin socket command.
+ */
+extern int g_lockstat;
+extern int g_lockstat_backtrace_sample;
+
+struct lockstat_entry_t;
+
+extern void lockstat_register_ceph_context(CephContext *cct);
+extern void lockstat_unregister_ceph_context(CephContext *cct);
+
+/// monotonic timestamp in nanoseconds
+extern uint64_t lockstat_now();
+/// find (or create) the stats slot for lock name @a n
+extern lockstat_entry_t *lockstat_lookup(const char *n);
+extern void lockstat_wait(lockstat_entry_t *e, uint64_t wait_ns, bool write);
+extern void lockstat_hold(lockstat_entry_t *e, uint64_t hold_ns);
+
+extern void lockstat_dump(ceph::Formatter *f);
+extern void lockstat_reset();
+
+#endif
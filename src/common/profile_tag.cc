@@ -0,0 +1,29 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "common/profile_tag.h"
+
+int g_profile_tag = 0;
+__thread profile_tag_t t_profile_tag;
+
+void profile_tag_set_op(const char *fmt, ...)
+{
+  if (!g_profile_tag)
+    return;
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(t_profile_tag.op, sizeof(t_profile_tag.op), fmt, ap);
+  va_end(ap);
+}
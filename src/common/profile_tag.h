@@ -0,0 +1,46 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_PROFILE_TAG_H
+#define CEPH_PROFILE_TAG_H
+
+#define PROFILE_TAG_OP_LEN 64
+
+/**
+ * per-thread attribution for sampling profilers
+ *
+ * Worker threads record the work queue they are serving and, while
+ * a profiler is collecting (g_profile_tag), a short description of
+ * the op being processed.  A profiler's signal handler copies the
+ * interrupted thread's tag into each sample.
+ */
+struct profile_tag_t {
+  const char *wq;                  ///< work queue name, or NULL
+  char op[PROFILE_TAG_OP_LEN];     ///< current op, or empty
+};
+
+extern int g_profile_tag;
+extern __thread profile_tag_t t_profile_tag;
+
+static inline void profile_tag_set_wq(const char *wq) {
+  t_profile_tag.wq = wq;
+}
+
+static inline void profile_tag_clear_op() {
+  t_profile_tag.op[0] = 0;
+}
+
+/// printf-style; a no-op unless a profiler is collecting
+extern void profile_tag_set_op(const char *fmt, ...)
+  __attribute__ ((format (printf, 1, 2)));
+
+#endif
@@ -303,6 +303,10 @@ public:
       iterator& operator++();
       ptr get_current_ptr();
 
+      /// get the next len bytes as a single ptr and advance past them.
+      /// zero-copy if they lie within the current segment.
+      ptr get_contiguous(unsigned len);
+
       // copy data out.
       // note that these all _append_ to dest!
       void copy(unsigned len, char *dest);
@@ -434,6 +438,14 @@ public:
     void append(const list& bl);
     void append(std::istream& in);
     void append_zero(unsigned len);
+
+    /*
+     * reserve len contiguous bytes at the tail of the list and return a
+     * pointer to them.  nothing is added to the list until the caller
+     * commits what it wrote; no other append may happen in between.
+     */
+    char *obtain_contiguous_space(unsigned len);
+    void commit_contiguous_space(unsigned len);
     
     /*
      * get a char
@@ -54,6 +54,10 @@
 #define CEPH_FEATURE_OSD_POOLRESEND    (1ULL<<43)
 #define CEPH_FEATURE_ERASURE_CODE_PLUGINS_V2 (1ULL<<44)
 #define CEPH_FEATURE_OSD_SET_ALLOC_HINT (1ULL<<45)
+#define CEPH_FEATURE_OSD_TRANSACTION_INDEX (1ULL<<46)
+#define CEPH_FEATURE_OSD_OP_BATCH (1ULL<<47)
+#define CEPH_FEATURE_WATCH_NOTIFY_BATCH (1ULL<<48)
+#define CEPH_FEATURE_OSD_WRITESAME (1ULL<<49)
 
 /*
  * The introduction of CEPH_FEATURE_OSD_SNAPMAPPER caused the feature
@@ -128,6 +132,10 @@ static inline unsigned long long ceph_sanitize_features(unsigned long long f) {
 	 CEPH_FEATURE_OSD_POOLRESEND |	\
          CEPH_FEATURE_ERASURE_CODE_PLUGINS_V2 |   \
          CEPH_FEATURE_OSD_SET_ALLOC_HINT |   \
+	 CEPH_FEATURE_OSD_TRANSACTION_INDEX |	\
+	 CEPH_FEATURE_OSD_OP_BATCH |	\
+	 CEPH_FEATURE_WATCH_NOTIFY_BATCH |	\
+	 CEPH_FEATURE_OSD_WRITESAME |	\
 	 0ULL)
 
 #define CEPH_FEATURES_SUPPORTED_DEFAULT  CEPH_FEATURES_ALL
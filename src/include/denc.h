@@ -0,0 +1,449 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_DENC_H
+#define CEPH_DENC_H
+
+/*
+ * Contiguous encode/decode for hot types.
+ *
+ * The encoders in encoding.h go through bufferlist::append() and
+ * bufferlist::iterator::copy() one field at a time, and each call
+ * checks bounds and may have to step to the next bufferptr.  For the
+ * small structs we encode and decode constantly (pg_log_entry_t,
+ * object_info_t, ...) that overhead dominates.
+ *
+ * Here a type first computes an upper bound on its encoded size with
+ * bound_encode(), reserves that much contiguous space in the target
+ * bufferlist with a contiguous_appender, and then stores raw
+ * little-endian fields through a plain pointer.  Decoding grabs the
+ * whole struct as a single bufferptr (zero-copy when it already lies
+ * within one segment) and reads fields off a pointer, with a single
+ * pointer comparison per field.
+ *
+ * The wire format is identical to encoding.h: DENC_START/DENC_FINISH
+ * write the same header as ENCODE_START/ENCODE_FINISH, so either side
+ * can be ported independently.  A type opts in by implementing
+ *
+ *   void bound_encode(size_t& p) const;
+ *   void encode(contiguous_appender& p) const;
+ *   void decode(contiguous_decoder& p);
+ *
+ * and declaring WRITE_CLASS_DENC(type).
+ */
+
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "include/int_types.h"
+#include "byteorder.h"
+#include "buffer.h"
+#include "encoding.h"
+
+/// size of the ENCODE_START/DENC_START header: v, compat, len
+#define DENC_HEADER_LEN (2 + sizeof(ceph_le32))
+
+class contiguous_appender {
+  bufferlist& bl;
+  char *start;
+  char *pos;
+  size_t len;
+
+  contiguous_appender(const contiguous_appender& other);
+  contiguous_appender& operator=(const contiguous_appender& other);
+
+public:
+  /// reserve len bytes at the end of b; what is written is committed on
+  /// destruction.  b must not be appended to in the meantime.
+  contiguous_appender(bufferlist& b, size_t l) : bl(b), len(l) {
+    start = pos = bl.obtain_contiguous_space(len);
+  }
+  ~contiguous_appender() {
+    bl.commit_contiguous_space(pos - start);
+  }
+
+  char *get_pos() {
+    return pos;
+  }
+  /// return the current position and skip n bytes
+  char *get_pos_add(size_t n) {
+    // bound_encode() came up short; stop before writing past the reservation
+    assert(n <= len - (size_t)(pos - start));
+    char *r = pos;
+    pos += n;
+    return r;
+  }
+  void append(const char *p, size_t n) {
+    memcpy(get_pos_add(n), p, n);
+  }
+  void append(const bufferlist& b) {
+    for (std::list<bufferptr>::const_iterator i = b.buffers().begin();
+	 i != b.buffers().end();
+	 ++i)
+      append(i->c_str(), i->length());
+  }
+  size_t get_logical_offset() const {
+    return pos - start;
+  }
+};
+
+class contiguous_decoder {
+  bufferptr bp;
+  const char *pos;
+  const char *end;
+
+public:
+  /// take the next len bytes of p and advance p past them
+  contiguous_decoder(bufferlist::iterator& p, unsigned len)
+    : bp(p.get_contiguous(len)), pos(NULL), end(NULL) {
+    if (bp.length()) {
+      pos = bp.c_str();
+      end = pos + bp.length();
+    }
+  }
+
+  const char *get_pos() const {
+    return pos;
+  }
+  /// return the current position and skip n bytes
+  const char *get_pos_add(size_t n) {
+    if (n > (size_t)(end - pos))
+      throw buffer::end_of_buffer();
+    const char *r = pos;
+    pos += n;
+    return r;
+  }
+  size_t get_remaining() const {
+    return end - pos;
+  }
+  /// skip forward to p, which must lie within the remaining bytes
+  void skip_to(const char *p) {
+    assert(p >= pos && p <= end);
+    pos = p;
+  }
+  /// shallow reference to the next n bytes
+  bufferptr get_ptr(size_t n) {
+    const char *r = get_pos_add(n);
+    return bufferptr(bp, r - bp.c_str(), n);
+  }
+};
+
+
+// --------------------------------------
+// base types
+
+#define WRITE_RAW_DENC(type)						\
+  inline void bound_encode(const type &v, size_t& p) { p += sizeof(type); } \
+  inline void encode(const type &v, contiguous_appender& p) {		\
+    memcpy(p.get_pos_add(sizeof(type)), &v, sizeof(type));		\
+  }									\
+  inline void decode(type &v, contiguous_decoder& p) {			\
+    memcpy(&v, p.get_pos_add(sizeof(type)), sizeof(type));		\
+  }
+
+WRITE_RAW_DENC(__u8)
+WRITE_RAW_DENC(__s8)
+WRITE_RAW_DENC(char)
+WRITE_RAW_DENC(ceph_le64)
+WRITE_RAW_DENC(ceph_le32)
+WRITE_RAW_DENC(ceph_le16)
+
+inline void bound_encode(const bool &v, size_t& p) { p += 1; }
+inline void encode(const bool &v, contiguous_appender& p) {
+  *p.get_pos_add(1) = v;
+}
+inline void decode(bool &v, contiguous_decoder& p) {
+  v = *p.get_pos_add(1);
+}
+
+#define WRITE_INTTYPE_DENC(type, etype)					\
+  inline void bound_encode(type v, size_t& p) { p += sizeof(ceph_##etype); } \
+  inline void encode(type v, contiguous_appender& p) {			\
+    ceph_##etype e;							\
+    e = v;								\
+    memcpy(p.get_pos_add(sizeof(e)), &e, sizeof(e));			\
+  }									\
+  inline void decode(type &v, contiguous_decoder& p) {			\
+    ceph_##etype e;							\
+    memcpy(&e, p.get_pos_add(sizeof(e)), sizeof(e));			\
+    v = e;								\
+  }
+
+WRITE_INTTYPE_DENC(uint64_t, le64)
+WRITE_INTTYPE_DENC(int64_t, le64)
+WRITE_INTTYPE_DENC(uint32_t, le32)
+WRITE_INTTYPE_DENC(int32_t, le32)
+WRITE_INTTYPE_DENC(uint16_t, le16)
+WRITE_INTTYPE_DENC(int16_t, le16)
+
+#define WRITE_CLASS_DENC(cl)						\
+  inline void bound_encode(const cl &c, size_t& p) { c.bound_encode(p); } \
+  inline void encode(const cl &c, contiguous_appender& p) { c.encode(p); } \
+  inline void decode(cl &c, contiguous_decoder& p) { c.decode(p); }
+
+
+// string
+inline void bound_encode(const std::string& s, size_t& p)
+{
+  p += sizeof(ceph_le32) + s.length();
+}
+inline void encode(const std::string& s, contiguous_appender& p)
+{
+  __u32 len = s.length();
+  encode(len, p);
+  p.append(s.data(), len);
+}
+inline void decode(std::string& s, contiguous_decoder& p)
+{
+  __u32 len;
+  decode(len, p);
+  s.assign(p.get_pos_add(len), len);
+}
+
+// bufferlist
+inline void bound_encode(const bufferlist& s, size_t& p)
+{
+  p += sizeof(ceph_le32) + s.length();
+}
+inline void encode(const bufferlist& s, contiguous_appender& p)
+{
+  __u32 len = s.length();
+  encode(len, p);
+  p.append(s);
+}
+inline void decode(bufferlist& s, contiguous_decoder& p)
+{
+  __u32 len;
+  decode(len, p);
+  s.clear();
+  if (len)
+    s.push_back(p.get_ptr(len));
+}
+
+// std::pair<A,B>
+template<class A, class B>
+inline void bound_encode(const std::pair<A,B>& pa, size_t& p)
+{
+  bound_encode(pa.first, p);
+  bound_encode(pa.second, p);
+}
+template<class A, class B>
+inline void encode(const std::pair<A,B>& pa, contiguous_appender& p)
+{
+  encode(pa.first, p);
+  encode(pa.second, p);
+}
+template<class A, class B>
+inline void decode(std::pair<A,B>& pa, contiguous_decoder& p)
+{
+  decode(pa.first, p);
+  decode(pa.second, p);
+}
+
+// std::vector<T>
+template<class T>
+inline void bound_encode(const std::vector<T>& v, size_t& p)
+{
+  p += sizeof(ceph_le32);
+  for (typename std::vector<T>::const_iterator i = v.begin(); i != v.end(); ++i)
+    bound_encode(*i, p);
+}
+template<class T>
+inline void encode(const std::vector<T>& v, contiguous_appender& p)
+{
+  __u32 n = v.size();
+  encode(n, p);
+  for (typename std::vector<T>::const_iterator i = v.begin(); i != v.end(); ++i)
+    encode(*i, p);
+}
+template<class T>
+inline void decode(std::vector<T>& v, contiguous_decoder& p)
+{
+  __u32 n;
+  decode(n, p);
+  v.resize(n);
+  for (__u32 i = 0; i < n; ++i)
+    decode(v[i], p);
+}
+
+// std::map<K,V>
+template<class K, class V>
+inline void bound_encode(const std::map<K,V>& m, size_t& p)
+{
+  p += sizeof(ceph_le32);
+  for (typename std::map<K,V>::const_iterator i = m.begin(); i != m.end(); ++i) {
+    bound_encode(i->first, p);
+    bound_encode(i->second, p);
+  }
+}
+template<class K, class V>
+inline void encode(const std::map<K,V>& m, contiguous_appender& p)
+{
+  __u32 n = m.size();
+  encode(n, p);
+  for (typename std::map<K,V>::const_iterator i = m.begin(); i != m.end(); ++i) {
+    encode(i->first, p);
+    encode(i->second, p);
+  }
+}
+template<class K, class V>
+inline void decode(std::map<K,V>& m, contiguous_decoder& p)
+{
+  __u32 n;
+  decode(n, p);
+  m.clear();
+  while (n--) {
+    K k;
+    decode(k, p);
+    decode(m[k], p);
+  }
+}
+
+
+/*
+ * guards
+ */
+
+/**
+ * start encoding block; same header as ENCODE_START
+ *
+ * @param v current (code) version of the encoding
+ * @param compat oldest code version that can decode it
+ * @param p contiguous_appender to encode to
+ */
+#define DENC_START(v, compat, p)					\
+  __u8 struct_v = v, struct_compat = compat;				\
+  ::encode(struct_v, p);						\
+  char *struct_compat_pos = p.get_pos();				\
+  ::encode(struct_compat, p);						\
+  char *struct_len_pos = p.get_pos_add(sizeof(ceph_le32));		\
+  do {
+
+/**
+ * finish encoding block
+ *
+ * @param p contiguous_appender we were encoding to
+ * @param new_struct_compat struct-compat value to use
+ */
+#define DENC_FINISH_NEW_COMPAT(p, new_struct_compat)			\
+  } while (false);							\
+  {									\
+    ceph_le32 struct_len;						\
+    struct_len = p.get_pos() - struct_len_pos - sizeof(struct_len);	\
+    memcpy(struct_len_pos, &struct_len, sizeof(struct_len));		\
+  }									\
+  if (new_struct_compat) {						\
+    struct_compat = new_struct_compat;					\
+    *struct_compat_pos = struct_compat;					\
+  }
+
+#define DENC_FINISH(p) DENC_FINISH_NEW_COMPAT(p, 0)
+
+/**
+ * start a contiguous decoding block
+ *
+ * Encodings older than minv are rejected with malformed_input; callers
+ * peek at the version with denc_struct_len() and send those through
+ * the legacy bufferlist::iterator decoder instead.
+ *
+ * @param v current version of the encoding that the code supports/encodes
+ * @param minv oldest version this decoder understands
+ * @param p contiguous_decoder for the encoded data
+ */
+#define DENC_DECODE_START(v, minv, p)					\
+  __u8 struct_v, struct_compat;						\
+  ::decode(struct_v, p);						\
+  ::decode(struct_compat, p);						\
+  if (v < struct_compat)						\
+    throw buffer::malformed_input(DECODE_ERR_VERSION(__PRETTY_FUNCTION__, v)); \
+  if (struct_v < minv)							\
+    throw buffer::malformed_input(DECODE_ERR_OLDVERSION(__PRETTY_FUNCTION__, minv)); \
+  __u32 struct_len;							\
+  ::decode(struct_len, p);						\
+  if (struct_len > p.get_remaining())					\
+    throw buffer::malformed_input(DECODE_ERR_PAST(__PRETTY_FUNCTION__)); \
+  const char *struct_end = p.get_pos() + struct_len;			\
+  do {
+
+/**
+ * finish contiguous decode block
+ *
+ * @param p contiguous_decoder we were decoding from
+ */
+#define DENC_DECODE_FINISH(p)						\
+  } while (false);							\
+  if (p.get_pos() > struct_end)						\
+    throw buffer::malformed_input(DECODE_ERR_PAST(__PRETTY_FUNCTION__)); \
+  p.skip_to(struct_end);
+
+/**
+ * peek at the ENCODE_START header at p
+ *
+ * @param p position of the encoded struct; not advanced
+ * @param minv oldest version the contiguous decoder understands
+ * @return full encoded length, header included, or 0 if the struct is
+ *         older than minv and must use the legacy decoder
+ */
+inline unsigned denc_struct_len(bufferlist::iterator p, __u8 minv)
+{
+  if (p.get_remaining() < DENC_HEADER_LEN)
+    return 0;
+  char h[DENC_HEADER_LEN];
+  p.copy(DENC_HEADER_LEN, h);
+  if ((__u8)h[0] < minv)
+    return 0;
+  ceph_le32 len;
+  memcpy(&len, h + 2, sizeof(len));
+  // the length is the peer's word; don't let it size an allocation
+  if ((uint64_t)len > p.get_remaining() - DENC_HEADER_LEN)
+    throw buffer::end_of_buffer();
+  return DENC_HEADER_LEN + len;
+}
+
+/// encode o to bl through a single contiguous reservation
+template<class T>
+inline void denc_encode(const T& o, bufferlist& bl)
+{
+  size_t len = 0;
+  o.bound_encode(len);
+  contiguous_appender p(bl, len);
+  o.encode(p);
+}
+
+/**
+ * decode o from p with the contiguous decoder
+ *
+ * @param minv oldest version the contiguous decoder understands
+ * @return false, with p untouched, if the encoding is older than minv
+ *         (anywhere in the struct) and o must be decoded the slow way
+ */
+template<class T>
+inline bool denc_decode(T& o, bufferlist::iterator& p, __u8 minv)
+{
+  unsigned len = denc_struct_len(p, minv);
+  if (!len)
+    return false;
+  bufferlist::iterator start = p;
+  contiguous_decoder d(p, len);
+  try {
+    o.decode(d);
+  } catch (buffer::malformed_input& e) {
+    p = start;
+    return false;
+  }
+  return true;
+}
+
+#endif
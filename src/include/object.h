@@ -27,6 +27,7 @@ using namespace std;
 
 #include "hash.h"
 #include "encoding.h"
+#include "denc.h"
 #include "ceph_hash.h"
 #include "cmp.h"
 
@@ -50,8 +51,18 @@ struct object_t {
   void decode(bufferlist::iterator &bl) {
     ::decode(name, bl);
   }
+  void bound_encode(size_t& p) const {
+    ::bound_encode(name, p);
+  }
+  void encode(contiguous_appender& p) const {
+    ::encode(name, p);
+  }
+  void decode(contiguous_decoder& p) {
+    ::decode(name, p);
+  }
 };
 WRITE_CLASS_ENCODER(object_t)
+WRITE_CLASS_DENC(object_t)
 
 inline bool operator==(const object_t& l, const object_t& r) {
   return l.name == r.name;
@@ -119,6 +130,9 @@ struct snapid_t {
 
 inline void encode(snapid_t i, bufferlist &bl) { encode(i.val, bl); }
 inline void decode(snapid_t &i, bufferlist::iterator &p) { decode(i.val, p); }
+inline void bound_encode(snapid_t i, size_t& p) { bound_encode(i.val, p); }
+inline void encode(snapid_t i, contiguous_appender& p) { encode(i.val, p); }
+inline void decode(snapid_t &i, contiguous_decoder& p) { decode(i.val, p); }
 
 inline ostream& operator<<(ostream& out, snapid_t s) {
   if (s == CEPH_NOSNAP)
@@ -29,6 +29,7 @@ extern "C" {
 #include "rados_types.h"
 
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #ifndef CEPH_OSD_TMAP_SET
 /* These are also defined in rados.h and objclass.h. Keep them in sync! */
@@ -47,6 +48,7 @@ extern "C" {
 #define LIBRADOS_VERSION_CODE LIBRADOS_VERSION(LIBRADOS_VER_MAJOR, LIBRADOS_VER_MINOR, LIBRADOS_VER_EXTRA)
 
 #define LIBRADOS_SUPPORTS_WATCH 1
+#define LIBRADOS_SUPPORTS_AIO_VECTORED 1
 
 /* RADOS lock flags
  * They are also defined in cls_lock_types.h. Keep them in sync!
@@ -176,6 +178,30 @@ typedef void *rados_ioctx_t;
  */
 typedef void *rados_list_ctx_t;
 
+/**
+ * @typedef rados_object_list_cursor
+ *
+ * A position in a pool, for listing it in ranges that can be listed
+ * independently.  Used with rados_object_list() and
+ * rados_object_list_slice().
+ */
+typedef void *rados_object_list_cursor;
+
+/**
+ * @struct rados_object_list_item
+ *
+ * An object listed by rados_object_list().  The strings aren't
+ * NUL-terminated.
+ */
+typedef struct {
+  size_t oid_length;
+  char *oid;
+  size_t nspace_length;
+  char *nspace;
+  size_t locator_length;
+  char *locator;
+} rados_object_list_item;
+
 /**
  * @typedef rados_snap_t
  * The id of a snapshot.
@@ -244,13 +270,14 @@ struct rados_cluster_stat_t {
  * - Extended attribute manipulation: rados_write_op_cmpxattr()
  *   rados_write_op_cmpxattr(), rados_write_op_setxattr(),
  *   rados_write_op_rmxattr()
+ * - Guarding on object data: rados_write_op_cmpext()
  * - Object map key/value pairs: rados_write_op_omap_set(),
  *   rados_write_op_omap_rm_keys(), rados_write_op_omap_clear(),
  *   rados_write_op_omap_cmp()
  * - Creating objects: rados_write_op_create()
  * - IO on objects: rados_write_op_append(), rados_write_op_write(), rados_write_op_zero
  *   rados_write_op_write_full(), rados_write_op_remove, rados_write_op_truncate(),
- *   rados_write_op_zero()
+ *   rados_write_op_zero(), rados_write_op_writesame()
  * - Hints: rados_write_op_set_alloc_hint()
  * - Performing the operation: rados_write_op_operate(), rados_aio_write_op_operate()
  */
@@ -905,6 +932,154 @@ CEPH_RADOS_API void rados_nobjects_list_close(rados_list_ctx_t ctx);
 
 /** @} New Listing Objects */
 
+/**
+ * @defgroup librados_h_list_range Listing Objects in Ranges
+ *
+ * A pool can be split into ranges with rados_object_list_slice(),
+ * and each range listed by a different thread or process.  Cursors
+ * can be saved as strings and listing resumed from them later.
+ * @{
+ */
+
+/**
+ * Get a cursor at the beginning of a pool
+ *
+ * @param io the pool
+ * @returns a cursor to free with rados_object_list_cursor_free()
+ */
+CEPH_RADOS_API rados_object_list_cursor rados_object_list_begin(
+  rados_ioctx_t io);
+
+/**
+ * Get a cursor at the end of a pool
+ *
+ * @param io the pool
+ * @returns a cursor to free with rados_object_list_cursor_free()
+ */
+CEPH_RADOS_API rados_object_list_cursor rados_object_list_end(
+  rados_ioctx_t io);
+
+/**
+ * Check whether a cursor is at the end of a pool
+ *
+ * @param io the pool
+ * @param cur the cursor
+ * @returns 1 at the end of the pool, 0 otherwise
+ */
+CEPH_RADOS_API int rados_object_list_is_end(rados_ioctx_t io,
+                                            rados_object_list_cursor cur);
+
+/**
+ * Release a cursor
+ *
+ * @param io the pool
+ * @param cur the cursor
+ */
+CEPH_RADOS_API void rados_object_list_cursor_free(
+  rados_ioctx_t io,
+  rados_object_list_cursor cur);
+
+/**
+ * Compare two cursors of the same range
+ *
+ * @param io the pool
+ * @param lhs first cursor
+ * @param rhs second cursor
+ * @returns -1, 0 or 1 if lhs is before, at or after rhs
+ */
+CEPH_RADOS_API int rados_object_list_cursor_cmp(
+  rados_ioctx_t io,
+  rados_object_list_cursor lhs,
+  rados_object_list_cursor rhs);
+
+/**
+ * Save a cursor as a NUL-terminated string
+ *
+ * @param io the pool
+ * @param cur the cursor
+ * @param buf where to store the string
+ * @param len size of buf, set to the size needed
+ * @returns 0 on success, -ERANGE if buf is too small
+ */
+CEPH_RADOS_API int rados_object_list_cursor_to_str(
+  rados_ioctx_t io,
+  rados_object_list_cursor cur,
+  char *buf,
+  size_t *len);
+
+/**
+ * Load a cursor saved with rados_object_list_cursor_to_str()
+ *
+ * @param io the pool
+ * @param str the saved cursor
+ * @param cur where to store a cursor to free with
+ * rados_object_list_cursor_free()
+ * @returns 0 on success, -EINVAL if str isn't a cursor
+ */
+CEPH_RADOS_API int rados_object_list_cursor_from_str(
+  rados_ioctx_t io,
+  const char *str,
+  rados_object_list_cursor *cur);
+
+/**
+ * List objects between two cursors
+ *
+ * Lists the objects of the namespace of the io context (or all of
+ * them, see rados_ioctx_set_namespace()) from start up to, but not
+ * including, finish.
+ *
+ * @param io the pool
+ * @param start where to start listing
+ * @param finish where to stop listing
+ * @param result_size the size of results
+ * @param results where to store the objects, freed with
+ * rados_object_list_free()
+ * @param next where to store a cursor to continue listing from, equal
+ * to finish once the range is done
+ * @returns the number of objects listed, or a negative error code
+ */
+CEPH_RADOS_API int rados_object_list(rados_ioctx_t io,
+                                     const rados_object_list_cursor start,
+                                     const rados_object_list_cursor finish,
+                                     const size_t result_size,
+                                     rados_object_list_item *results,
+                                     rados_object_list_cursor *next);
+
+/**
+ * Free the objects listed by rados_object_list()
+ *
+ * @param result_size the number of objects listed
+ * @param results the objects
+ */
+CEPH_RADOS_API void rados_object_list_free(const size_t result_size,
+                                           rados_object_list_item *results);
+
+/**
+ * Split a range into m ranges of about the same number of objects
+ * and get the nth one
+ *
+ * The ranges are relative to the placement groups the pool has when
+ * the range is first split, and stay valid if those split later.
+ *
+ * @param io the pool
+ * @param start beginning of the range to split
+ * @param finish end of the range to split
+ * @param n which range to get, from 0 to m - 1
+ * @param m how many ranges to split into
+ * @param split_start where to store a cursor at the beginning of range n
+ * @param split_finish where to store a cursor at the end of range n
+ * @returns 0 on success, negative error code on failure
+ */
+CEPH_RADOS_API int rados_object_list_slice(rados_ioctx_t io,
+                                           const rados_object_list_cursor start,
+                                           const rados_object_list_cursor finish,
+                                           const size_t n,
+                                           const size_t m,
+                                           rados_object_list_cursor *split_start,
+                                           rados_object_list_cursor *split_finish);
+
+/** @} Listing Objects in Ranges */
+
 /**
  * @defgroup librados_h_list_obj Deprecated Listing Objects
  *
@@ -1705,6 +1880,28 @@ CEPH_RADOS_API int rados_aio_write(rados_ioctx_t io, const char *oid,
 		                   rados_completion_t completion,
 		                   const char *buf, size_t len, uint64_t off);
 
+/**
+ * Write data from a scatter/gather list to an object asynchronously
+ *
+ * Like rados_aio_write(), but the data is taken from iovcnt buffers
+ * that are written back to back starting at off. The buffers are
+ * sent as they are rather than copied, so they must not be modified
+ * or freed until the write is safe.
+ *
+ * @param io the context in which the write will occur
+ * @param oid name of the object
+ * @param completion what to do when the write is safe and complete
+ * @param iov the buffers to write
+ * @param iovcnt number of buffers in iov
+ * @param off byte offset in the object to begin writing at
+ * @returns 0 on success, -EROFS if the io context specifies a snap_seq
+ * other than LIBRADOS_SNAP_HEAD
+ */
+CEPH_RADOS_API int rados_aio_writev(rados_ioctx_t io, const char *oid,
+		                    rados_completion_t completion,
+		                    const struct iovec *iov, int iovcnt,
+		                    uint64_t off);
+
 /**
  * Asychronously append data to an object
  *
@@ -1787,6 +1984,29 @@ CEPH_RADOS_API int rados_aio_read(rados_ioctx_t io, const char *oid,
 		                  rados_completion_t completion,
 		                  char *buf, size_t len, uint64_t off);
 
+/**
+ * Asychronously read data from an object into a scatter/gather list
+ *
+ * Like rados_aio_read(), but the data read starting at off fills
+ * iovcnt buffers one after the other. Data is received directly
+ * into the buffers where the messenger allows it.
+ *
+ * The return value of the completion will be number of bytes read on
+ * success, negative error code on failure.
+ *
+ * @param io the context in which to perform the read
+ * @param oid the name of the object to read from
+ * @param completion what to do when the read is complete
+ * @param iov the buffers to fill
+ * @param iovcnt number of buffers in iov
+ * @param off the offset to start reading from in the object
+ * @returns 0 on success, negative error code on failure
+ */
+CEPH_RADOS_API int rados_aio_readv(rados_ioctx_t io, const char *oid,
+		                   rados_completion_t completion,
+		                   const struct iovec *iov, int iovcnt,
+		                   uint64_t off);
+
 /**
  * Block until all pending writes in an io context are safe
  *
@@ -2073,6 +2293,24 @@ CEPH_RADOS_API void rados_write_op_create(rados_write_op_t write_op,
                                           int exclusive,
                                           const char* category);
 
+/**
+ * Ensure that an extent of the object matches the given data.
+ * Bytes past the end of the object compare as zeros. If the
+ * comparison fails, the return code of the operation will be
+ * -4095 - (offset of the first mismatching byte from the start of
+ * cmp_buf), and nothing else in the operation is applied
+ * @param write_op operation to add this action to
+ * @param cmp_buf buffer containing bytes to be compared with object contents
+ * @param cmp_len length to compare and size of cmp_buf in bytes
+ * @param off object byte offset at which to start the comparison
+ * @param prval returned result of comparison, as above
+ */
+CEPH_RADOS_API void rados_write_op_cmpext(rados_write_op_t write_op,
+                                          const char *cmp_buf,
+                                          size_t cmp_len,
+                                          uint64_t off,
+                                          int *prval);
+
 /**
  * Write to offset
  * @param write_op operation to add this action to
@@ -2118,6 +2356,22 @@ CEPH_RADOS_API void rados_write_op_remove(rados_write_op_t write_op);
 CEPH_RADOS_API void rados_write_op_truncate(rados_write_op_t write_op,
                                             uint64_t offset);
 
+/**
+ * Write the same buffer repeatedly over part of an object. Only
+ * the buffer is sent to the OSD, which expands it.
+ * @param write_op operation to add this action to
+ * @param buffer bytes to write
+ * @param data_len length of buffer
+ * @param write_len total number of bytes to write; the last copy of
+ * buffer is truncated if it isn't a multiple of data_len
+ * @param offset offset to write to
+ */
+CEPH_RADOS_API void rados_write_op_writesame(rados_write_op_t write_op,
+                                             const char *buffer,
+                                             size_t data_len,
+                                             size_t write_len,
+                                             uint64_t offset);
+
 /**
  * Zero part of an object
  * @param write_op operation to add this action to
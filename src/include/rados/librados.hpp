@@ -115,6 +115,78 @@ namespace librados
     NObjectIteratorImpl *impl;
   };
 
+  /**
+   * A position in a pool, for listing it in ranges
+   *
+   * @see IoCtx::object_list(), IoCtx::object_list_slice()
+   */
+  class CEPH_RADOS_API ObjectCursor
+  {
+  public:
+    ObjectCursor();
+    ObjectCursor(const ObjectCursor &rhs);
+    ObjectCursor& operator=(const ObjectCursor& rhs);
+    ~ObjectCursor();
+
+    bool operator<(const ObjectCursor &rhs) const;
+    bool operator==(const ObjectCursor &rhs) const;
+    bool operator!=(const ObjectCursor &rhs) const;
+
+    /// save the position, to continue listing from it later
+    std::string to_str() const;
+    /// load a position saved with to_str()
+    bool from_str(const std::string& s);
+
+  protected:
+    rados_object_list_cursor c_cursor;
+
+    friend class IoCtx;
+    friend std::ostream& operator<<(std::ostream& out, const ObjectCursor& c);
+  };
+  CEPH_RADOS_API std::ostream& operator<<(std::ostream& out, const ObjectCursor& c);
+
+  /// an object listed by IoCtx::object_list()
+  struct ObjectItem
+  {
+    std::string oid;
+    std::string nspace;
+    std::string locator;
+
+    /// filled in only if an ObjectListFilter asks for them
+    uint64_t size;
+    time_t mtime;
+    std::map<std::string, bufferlist> xattrs;
+
+    ObjectItem() : size(0), mtime(0) {}
+  };
+
+  /**
+   * Conditions the OSDs check before listing an object
+   *
+   * An object is listed only if it matches every condition that's
+   * set.  The want_ members choose what else each ObjectItem carries,
+   * which saves a stat or getxattr per object.
+   */
+  struct CEPH_RADOS_API ObjectListFilter
+  {
+    std::string name_prefix;
+    std::string name_glob;         ///< fnmatch(3) pattern, empty for any
+    uint64_t min_size;
+    uint64_t max_size;
+    time_t min_mtime;
+    time_t max_mtime;              ///< 0 for no bound
+    std::map<std::string, bufferlist> xattrs_equal;
+    std::set<std::string> xattrs_present;
+    bool check_omap_header;
+    bufferlist omap_header_prefix; ///< what the omap header starts with
+
+    bool want_size;
+    bool want_mtime;
+    std::set<std::string> want_xattrs;
+
+    ObjectListFilter();
+  };
+
   // DEPRECATED; Use NObjectIterator
   class CEPH_RADOS_API ObjectIterator : public std::iterator <std::forward_iterator_tag, std::pair<std::string, std::string> > {
   public:
@@ -151,6 +223,15 @@ namespace librados
     virtual void notify(uint8_t opcode, uint64_t ver, bufferlist& bl) = 0;
   };
 
+  /// watch callback that can send a reply back to the notifier
+  class CEPH_RADOS_API WatchReplyCtx {
+  public:
+    virtual ~WatchReplyCtx();
+    /// anything put in reply is returned to the notifier with the ack
+    virtual void notify(uint8_t opcode, uint64_t ver, bufferlist& bl,
+			bufferlist *reply) = 0;
+  };
+
   struct CEPH_RADOS_API AioCompletion {
     AioCompletion(AioCompletionImpl *pc_) : pc(pc_) {}
     int set_complete_callback(void *cb_arg, callback_t cb);
@@ -241,6 +322,19 @@ namespace librados
 
     void cmpxattr(const char *name, uint8_t op, const bufferlist& val);
     void cmpxattr(const char *name, uint8_t op, uint64_t v);
+    /**
+     * Guard operation with a check that an extent of the object
+     * matches cmp_bl (bytes past the end of the object compare as
+     * zeros)
+     *
+     * On a mismatch the operation fails with -4095 - (offset of the
+     * first mismatching byte from off).
+     *
+     * @param off [in] object offset to start comparing at
+     * @param cmp_bl [in] data to compare against
+     * @param prval [out] place the comparison result in prval
+     */
+    void cmpext(uint64_t off, const bufferlist& cmp_bl, int *prval);
     void src_cmpxattr(const std::string& src_oid,
 		      const char *name, int op, const bufferlist& val);
     void src_cmpxattr(const std::string& src_oid,
@@ -317,6 +411,8 @@ namespace librados
     void remove();
     void truncate(uint64_t off);
     void zero(uint64_t off, uint64_t len);
+    /// write bl repeatedly over [off, off + write_len), expanded by the OSD
+    void writesame(uint64_t off, uint64_t write_len, const bufferlist& bl);
     void rmxattr(const char *name);
     void setxattr(const char *name, const bufferlist& bl);
     void tmap_update(const bufferlist& cmdbl);
@@ -731,6 +827,55 @@ namespace librados
     /// Iterator indicating the end of a pool
     const ObjectIterator& objects_end() const;
 
+    /// Cursor at the beginning of the pool
+    ObjectCursor object_list_begin();
+    /// Cursor at the end of the pool
+    ObjectCursor object_list_end();
+    /// Whether a cursor is at the end of the pool
+    bool object_list_is_end(const ObjectCursor &oc);
+
+    /**
+     * List objects between two cursors
+     *
+     * Lists objects of the current namespace, or of all of them, from
+     * start up to, but not including, finish.
+     *
+     * @param start [in] where to start listing
+     * @param finish [in] where to stop listing
+     * @param result_count [in] how many objects to list at most
+     * @param result [out] the objects
+     * @param next [out] where to continue listing, finish once done
+     * @returns 0 on success, negative error code on failure
+     */
+    int object_list(const ObjectCursor &start, const ObjectCursor &finish,
+		    const size_t result_count,
+		    std::vector<ObjectItem> *result,
+		    ObjectCursor *next);
+    /// List the objects between two cursors that match a filter
+    int object_list(const ObjectCursor &start, const ObjectCursor &finish,
+		    const size_t result_count,
+		    const ObjectListFilter &filter,
+		    std::vector<ObjectItem> *result,
+		    ObjectCursor *next);
+
+    /**
+     * Split a range into m ranges of about the same number of objects
+     * and get the nth one, so that each can be listed independently
+     *
+     * @param start [in] beginning of the range to split
+     * @param finish [in] end of the range to split
+     * @param n [in] which range to get, from 0 to m - 1
+     * @param m [in] how many ranges to split into
+     * @param split_start [out] beginning of range n
+     * @param split_finish [out] end of range n
+     * @returns 0 on success, negative error code on failure
+     */
+    int object_list_slice(const ObjectCursor &start,
+			  const ObjectCursor &finish,
+			  const size_t n, const size_t m,
+			  ObjectCursor *split_start,
+			  ObjectCursor *split_finish);
+
     /**
      * List available hit set objects
      *
@@ -890,11 +1035,43 @@ namespace librados
 		    ObjectReadOperation *op, int flags,
 		    bufferlist *pbl);
 
+    /**
+     * Schedule operations on many objects at once
+     *
+     * Each operation runs on its own, as if submitted with
+     * aio_operate(), but operations for objects on the same OSD are
+     * sent to it together.  Read results go wherever the read
+     * operations put them.
+     *
+     * @param ops the objects and what to do to each
+     * @param c what to do when all of them are complete and safe
+     * @param results the result of each operation, set once c completes
+     * @returns 0 on success, negative error code on failure
+     */
+    int aio_operate_batch(
+      const std::vector<std::pair<std::string, ObjectOperation*> >& ops,
+      AioCompletion *c, std::vector<int> *results);
+    /// Perform operations on many objects at once; see aio_operate_batch()
+    int operate_batch(
+      const std::vector<std::pair<std::string, ObjectOperation*> >& ops,
+      std::vector<int> *results);
+
     // watch/notify
     int watch(const std::string& o, uint64_t ver, uint64_t *handle,
 	      librados::WatchCtx *ctx);
+    int watch(const std::string& o, uint64_t ver, uint64_t *handle,
+	      librados::WatchReplyCtx *ctx);
     int unwatch(const std::string& o, uint64_t handle);
     int notify(const std::string& o, uint64_t ver, bufferlist& bl);
+    /**
+     * Notify watchers and collect their replies
+     *
+     * Replies are keyed by watcher instance id and watch handle.  Only
+     * watchers that sent a non-empty reply are included, and none are
+     * returned by OSDs that predate notify replies.
+     */
+    int notify(const std::string& o, uint64_t ver, bufferlist& bl,
+	       std::map<std::pair<uint64_t, uint64_t>, bufferlist> *replies);
     int list_watchers(const std::string& o, std::list<obj_watch_t> *out_watchers);
     int list_snaps(const std::string& o, snap_set_t *out_snaps);
     void set_notify_timeout(uint32_t timeout);
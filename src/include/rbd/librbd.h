@@ -26,6 +26,7 @@ extern "C" {
 #include <sys/types.h>
 #endif
 #include <string.h>
+#include <sys/uio.h>
 #include "../rados/librados.h"
 #include "features.h"
 
@@ -40,6 +41,9 @@ extern "C" {
 #define LIBRBD_SUPPORTS_WATCH 0
 #define LIBRBD_SUPPORTS_AIO_FLUSH 1
 #define LIBRBD_SUPPORTS_INVALIDATE 1
+#define LIBRBD_SUPPORTS_AIO_VECTORED 1
+#define LIBRBD_SUPPORTS_COMPARE_AND_WRITE 1
+#define LIBRBD_SUPPORTS_WRITESAME 1
 
 #if __GNUC__ >= 4
   #define CEPH_RBD_API    __attribute__ ((visibility ("default")))
@@ -390,6 +394,44 @@ CEPH_RBD_API int rbd_aio_read(rbd_image_t image, uint64_t off, size_t len,
                               char *buf, rbd_completion_t c);
 CEPH_RBD_API int rbd_aio_discard(rbd_image_t image, uint64_t off, uint64_t len,
                                  rbd_completion_t c);
+/**
+ * Atomically compare len bytes at off with cmp_buf and, if they
+ * match, write buf there.
+ *
+ * The extent must lie within a single object. The completion returns
+ * -EILSEQ if the data doesn't match, after storing the image offset
+ * of the first differing byte in mismatch_off, and nothing is written.
+ */
+CEPH_RBD_API int rbd_aio_compare_and_write(rbd_image_t image, uint64_t off,
+                                           size_t len, const char *cmp_buf,
+                                           const char *buf, rbd_completion_t c,
+                                           uint64_t *mismatch_off);
+/**
+ * Write len bytes at off by repeating the data_len bytes of buf.
+ *
+ * len must be a multiple of data_len. Only the pattern is sent to the
+ * OSDs, and an all-zero pattern becomes a discard.
+ */
+CEPH_RBD_API int rbd_aio_writesame(rbd_image_t image, uint64_t off, size_t len,
+                                   const char *buf, size_t data_len,
+                                   rbd_completion_t c);
+/**
+ * Write a scatter/gather list to the image at off, asynchronously.
+ *
+ * The buffers are written back to back as a single request. Without
+ * the cache they are sent as they are rather than copied, so they
+ * must not be modified or freed until the completion fires.
+ */
+CEPH_RBD_API int rbd_aio_writev(rbd_image_t image, const struct iovec *iov,
+                                int iovcnt, uint64_t off, rbd_completion_t c);
+/**
+ * Read from the image at off into a scatter/gather list, asynchronously.
+ *
+ * The completion's return value is the number of bytes read, which is
+ * less than the total size of the buffers at the end of the image.
+ */
+CEPH_RBD_API int rbd_aio_readv(rbd_image_t image, const struct iovec *iov,
+                               int iovcnt, uint64_t off, rbd_completion_t c);
 CEPH_RBD_API int rbd_aio_create_completion(void *cb_arg,
                                            rbd_callback_t complete_cb,
                                            rbd_completion_t *c);
@@ -207,6 +207,18 @@ public:
    */
   int aio_read(uint64_t off, size_t len, ceph::bufferlist& bl, RBD::AioCompletion *c);
   int aio_discard(uint64_t off, uint64_t len, RBD::AioCompletion *c);
+  /**
+   * Atomically compare len bytes at off with cmp_bl and, if they
+   * match, write bl there.  The extent must lie within one object.
+   * The completion returns -EILSEQ on a mismatch, with the image
+   * offset of the first differing byte stored in mismatch_off.
+   */
+  int aio_compare_and_write(uint64_t off, size_t len, ceph::bufferlist& cmp_bl,
+			    ceph::bufferlist& bl, RBD::AioCompletion *c,
+			    uint64_t *mismatch_off);
+  /// write len bytes at off by repeating bl, len a multiple of its length
+  int aio_writesame(uint64_t off, size_t len, ceph::bufferlist& bl,
+		    RBD::AioCompletion *c);
 
   int flush();
   /**
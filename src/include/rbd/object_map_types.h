@@ -0,0 +1,23 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_RBD_OBJECT_MAP_TYPES_H
+#define CEPH_RBD_OBJECT_MAP_TYPES_H
+
+#include "include/int_types.h"
+
+/*
+ * per-object states kept in an image's object map (two bits each)
+ *
+ * OBJECT_PENDING marks an object whose removal is in flight; it is
+ * treated like OBJECT_EXISTS until the removal completes.
+ *
+ * OBJECT_EXISTS_CLEAN marks an object that exists but hasn't been
+ * written since the last snapshot, so a snapshot's map also records
+ * which objects changed since the snapshot before it.
+ */
+static const uint8_t OBJECT_NONEXISTENT  = 0;
+static const uint8_t OBJECT_EXISTS       = 1;
+static const uint8_t OBJECT_PENDING      = 2;
+static const uint8_t OBJECT_EXISTS_CLEAN = 3;
+
+#endif
@@ -27,11 +27,14 @@
  *   rbd_data.<id>.00000000
  *   rbd_data.<id>.00000001
  *   ...                     - data
+ *   rbd_object_map.<id>     - which data objects exist (object map feature)
+ *   rbd_object_map.<id>.<snapid> - same, for a snapshot
  */
 
 #define RBD_HEADER_PREFIX      "rbd_header."
 #define RBD_DATA_PREFIX        "rbd_data."
 #define RBD_ID_PREFIX          "rbd_id."
+#define RBD_OBJECT_MAP_PREFIX  "rbd_object_map."
 
 /*
  * old-style rbd image 'foo' consists of objects
@@ -21,6 +21,7 @@
 #include <errno.h>
 
 #include "include/types.h"
+#include "include/denc.h"
 #include "common/strtol.h"
 
 
@@ -100,6 +101,17 @@ public:
     ::decode(tv.tv_sec, p);
     ::decode(tv.tv_nsec, p);
   }
+  void bound_encode(size_t& p) const {
+    p += sizeof(ceph_le32) * 2;
+  }
+  void encode(contiguous_appender& p) const {
+    ::encode(tv.tv_sec, p);
+    ::encode(tv.tv_nsec, p);
+  }
+  void decode(contiguous_decoder& p) {
+    ::decode(tv.tv_sec, p);
+    ::decode(tv.tv_nsec, p);
+  }
 
   void encode_timeval(struct ceph_timespec *t) const {
     t->tv_sec = tv.tv_sec;
@@ -296,6 +308,7 @@ public:
   }
 };
 WRITE_CLASS_ENCODER(utime_t)
+WRITE_CLASS_DENC(utime_t)
 
 
 // arithmetic operators
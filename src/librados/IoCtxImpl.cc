@@ -361,6 +361,40 @@ uint32_t librados::IoCtxImpl::nlist_seek(Objecter::NListContext *context,
   return objecter->list_nobjects_seek(context, pos);
 }
 
+int librados::IoCtxImpl::object_list(const Objecter::NListCursor& start,
+				     const Objecter::NListCursor& finish,
+				     size_t max, const bufferlist& filter,
+				     std::list<librados::ListObjectImpl> *result,
+				     std::list<pg_nls_object_info_t> *info,
+				     Objecter::NListCursor *next)
+{
+  Cond cond;
+  bool done;
+  int r = 0;
+  Mutex mylock("IoCtxImpl::object_list::mylock");
+
+  objecter->list_nobjects_range(poolid, oloc.nspace, start, finish, max,
+				filter, result, info, next,
+				new C_SafeCond(&mylock, &cond, &done, &r));
+
+  mylock.Lock();
+  while (!done)
+    cond.Wait(mylock);
+  mylock.Unlock();
+
+  return r;
+}
+
+int librados::IoCtxImpl::object_list_slice(const Objecter::NListCursor& start,
+					   const Objecter::NListCursor& finish,
+					   size_t n, size_t m,
+					   Objecter::NListCursor *split_start,
+					   Objecter::NListCursor *split_finish)
+{
+  return objecter->split_nlist_range(poolid, start, finish, n, m,
+				     split_start, split_finish);
+}
+
 int librados::IoCtxImpl::list(Objecter::ListContext *context, int max_entries)
 {
   Cond cond;
@@ -590,6 +624,87 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   return 0;
 }
 
+namespace {
+
+struct C_aio_BatchOp : public Context {
+  vector<int> *results;
+  size_t i;
+  Context *on_finish;
+  C_aio_BatchOp(vector<int> *results, size_t i, Context *on_finish)
+    : results(results), i(i), on_finish(on_finish) {}
+  void finish(int r) {
+    (*results)[i] = r;
+    on_finish->complete(0);
+  }
+};
+
+struct C_aio_BatchDone : public Context {
+  Context *onack;
+  Context *onsafe;
+  C_aio_BatchDone(Context *onack, Context *onsafe)
+    : onack(onack), onsafe(onsafe) {}
+  void finish(int r) {
+    onack->complete(r);
+    if (onsafe)
+      onsafe->complete(r);
+  }
+};
+
+bool is_write_op(const ::ObjectOperation *o)
+{
+  for (vector<OSDOp>::const_iterator p = o->ops.begin(); p != o->ops.end();
+       ++p) {
+    if (p->op.op & CEPH_OSD_OP_MODE_WR)
+      return true;
+  }
+  return false;
+}
+
+}
+
+int librados::IoCtxImpl::aio_operate_batch(
+  const vector<pair<object_t, ::ObjectOperation*> >& ops,
+  AioCompletionImpl *c, vector<int> *results)
+{
+  bool any_write = false;
+  for (vector<pair<object_t, ::ObjectOperation*> >::const_iterator p =
+	 ops.begin(); p != ops.end(); ++p) {
+    if (is_write_op(p->second))
+      any_write = true;
+  }
+  /* can't write to a snapshot */
+  if (any_write && snap_seq != CEPH_NOSNAP)
+    return -EROFS;
+
+  results->assign(ops.size(), 0);
+  c->io = this;
+  Context *onack = new C_aio_Ack(c);
+  Context *onsafe = NULL;
+  if (any_write) {
+    onsafe = new C_aio_Safe(c);
+    queue_aio_write(c);
+  } else {
+    c->is_read = true;
+  }
+
+  utime_t ut = ceph_clock_now(client->cct);
+  C_GatherBuilder gather(client->cct, new C_aio_BatchDone(onack, onsafe));
+  vector<Objecter::Op*> objecter_ops;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    Context *done = new C_aio_BatchOp(results, i, gather.new_sub());
+    if (is_write_op(ops[i].second)) {
+      objecter_ops.push_back(objecter->prepare_mutate_op(
+	ops[i].first, oloc, *ops[i].second, snapc, ut, 0, NULL, done, NULL));
+    } else {
+      objecter_ops.push_back(objecter->prepare_read_op(
+	ops[i].first, oloc, *ops[i].second, snap_seq, NULL, 0, done, NULL));
+    }
+  }
+  objecter->op_submit_batch(objecter_ops);
+  gather.activate();
+  return 0;
+}
+
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off,
 				  uint64_t snapid)
@@ -631,6 +746,39 @@ int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
   return 0;
 }
 
+int librados::IoCtxImpl::aio_readv(const object_t &oid, AioCompletionImpl *c,
+				   const struct iovec *iov, int iovcnt,
+				   uint64_t off, uint64_t snapid)
+{
+  if (iovcnt <= 0)
+    return -EINVAL;
+
+  // each segment becomes its own rx buffer, so the reply lands in the
+  // caller's memory without a bounce copy
+  c->bl.clear();
+  size_t len = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].iov_len == 0)
+      continue;
+    len += iov[i].iov_len;
+    if (len > (size_t) INT_MAX)
+      return -EDOM;
+    c->bl.push_back(buffer::create_static(iov[i].iov_len,
+					  (char *)iov[i].iov_base));
+  }
+
+  Context *onack = new C_aio_Ack(c);
+
+  c->is_read = true;
+  c->io = this;
+  c->blp = &c->bl;
+
+  c->tid = objecter->read(oid, oloc,
+		 off, len, snapid, &c->bl, 0,
+		 onack, &c->objver);
+  return 0;
+}
+
 class C_ObjectOperation : public Context {
 public:
   ::ObjectOperation m_ops;
@@ -1033,7 +1181,8 @@ void librados::IoCtxImpl::set_sync_op_version(version_t ver)
 }
 
 int librados::IoCtxImpl::watch(const object_t& oid, uint64_t ver,
-			       uint64_t *cookie, librados::WatchCtx *ctx)
+			       uint64_t *cookie, librados::WatchCtx *ctx,
+			       librados::WatchReplyCtx *reply_ctx)
 {
   ::ObjectOperation wr;
   Mutex mylock("IoCtxImpl::watch::mylock");
@@ -1047,6 +1196,7 @@ int librados::IoCtxImpl::watch(const object_t& oid, uint64_t ver,
 
   WatchNotifyInfo *wc = new WatchNotifyInfo(this, oid);
   wc->watch_ctx = ctx;
+  wc->watch_reply_ctx = reply_ctx;
   client->register_watch_notify_callback(wc, cookie);
   prepare_assert_ops(&wr);
   wr.watch(*cookie, ver, 1);
@@ -1078,11 +1228,14 @@ int librados::IoCtxImpl::watch(const object_t& oid, uint64_t ver,
 int librados::IoCtxImpl::_notify_ack(
   const object_t& oid,
   uint64_t notify_id, uint64_t ver,
-  uint64_t cookie)
+  const map<uint64_t, bufferlist>& acks)
 {
   ::ObjectOperation rd;
   prepare_assert_ops(&rd);
-  rd.notify_ack(notify_id, ver, cookie);
+  for (map<uint64_t, bufferlist>::const_iterator p = acks.begin();
+       p != acks.end();
+       ++p)
+    rd.notify_ack(notify_id, ver, p->first, p->second);
   objecter->read(oid, oloc, rd, snap_seq, (bufferlist*)NULL, 0, 0, 0);
   return 0;
 }
@@ -1117,7 +1270,8 @@ int librados::IoCtxImpl::unwatch(const object_t& oid, uint64_t cookie)
   return r;
 }
 
-int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& bl)
+int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& bl,
+				std::map<std::pair<uint64_t, uint64_t>, bufferlist> *replies)
 {
   bufferlist inbl, outbl;
 
@@ -1126,11 +1280,13 @@ int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& b
   Mutex mylock_all("IoCtxImpl::notify::mylock_all");
   bool done_all = false;
   int r_notify = 0;
+  bufferlist reply_bl;
   WatchNotifyInfo *wc = new WatchNotifyInfo(this, oid);
   wc->notify_done = &done_all;
   wc->notify_lock = &mylock_all;
   wc->notify_cond = &cond_all;
   wc->notify_rval = &r_notify;
+  wc->notify_reply_bl = &reply_bl;
 
   lock->Lock();
 
@@ -1174,6 +1330,21 @@ int librados::IoCtxImpl::notify(const object_t& oid, uint64_t ver, bufferlist& b
 
   set_sync_op_version(objver);
 
+  if (replies) {
+    replies->clear();
+    if (reply_bl.length()) {
+      try {
+	bufferlist::iterator p = reply_bl.begin();
+	::decode(*replies, p);
+      } catch (const buffer::error &err) {
+	ldout(client->cct, 1) << __func__ << " error decoding notify replies: "
+			      << err.what() << dendl;
+	if (r_issue == 0 && r_notify == 0)
+	  return -EIO;
+      }
+    }
+  }
+
   return r_issue == 0 ? r_notify : r_issue;
 }
 
@@ -112,6 +112,17 @@ struct librados::IoCtxImpl {
   // io
   int nlist(Objecter::NListContext *context, int max_entries);
   uint32_t nlist_seek(Objecter::NListContext *context, uint32_t pos);
+  int object_list(const Objecter::NListCursor& start,
+		  const Objecter::NListCursor& finish, size_t max,
+		  const bufferlist& filter,
+		  std::list<librados::ListObjectImpl> *result,
+		  std::list<pg_nls_object_info_t> *info,
+		  Objecter::NListCursor *next);
+  int object_list_slice(const Objecter::NListCursor& start,
+			const Objecter::NListCursor& finish,
+			size_t n, size_t m,
+			Objecter::NListCursor *split_start,
+			Objecter::NListCursor *split_finish);
   int list(Objecter::ListContext *context, int max_entries);
   uint32_t list_seek(Objecter::ListContext *context, uint32_t pos);
   int create(const object_t& oid, bool exclusive);
@@ -148,6 +159,9 @@ struct librados::IoCtxImpl {
 		  int flags);
   int aio_operate_read(const object_t& oid, ::ObjectOperation *o,
 		       AioCompletionImpl *c, int flags, bufferlist *pbl);
+  int aio_operate_batch(
+    const vector<pair<object_t, ::ObjectOperation*> >& ops,
+    AioCompletionImpl *c, vector<int> *results);
 
   struct C_aio_Ack : public Context {
     librados::AioCompletionImpl *c;
@@ -173,6 +187,9 @@ struct librados::IoCtxImpl {
 	       bufferlist *pbl, size_t len, uint64_t off, uint64_t snapid);
   int aio_read(object_t oid, AioCompletionImpl *c,
 	       char *buf, size_t len, uint64_t off, uint64_t snapid);
+  int aio_readv(const object_t &oid, AioCompletionImpl *c,
+		const struct iovec *iov, int iovcnt, uint64_t off,
+		uint64_t snapid);
   int aio_sparse_read(const object_t oid, AioCompletionImpl *c,
 		      std::map<uint64_t,uint64_t> *m, bufferlist *data_bl,
 		      size_t len, uint64_t off, uint64_t snapid);
@@ -197,12 +214,15 @@ struct librados::IoCtxImpl {
 		  bufferlist *pbl);
 
   void set_sync_op_version(version_t ver);
-  int watch(const object_t& oid, uint64_t ver, uint64_t *cookie, librados::WatchCtx *ctx);
+  int watch(const object_t& oid, uint64_t ver, uint64_t *cookie,
+	    librados::WatchCtx *ctx, librados::WatchReplyCtx *reply_ctx = NULL);
   int unwatch(const object_t& oid, uint64_t cookie);
-  int notify(const object_t& oid, uint64_t ver, bufferlist& bl);
+  int notify(const object_t& oid, uint64_t ver, bufferlist& bl,
+	     std::map<std::pair<uint64_t, uint64_t>, bufferlist> *replies = NULL);
+  /// ack a notify for each watch cookie in acks, with its reply
   int _notify_ack(
     const object_t& oid, uint64_t notify_id, uint64_t ver,
-    uint64_t cookie);
+    const map<uint64_t, bufferlist>& acks);
 
   int set_alloc_hint(const object_t& oid,
                      uint64_t expected_object_size,
@@ -230,12 +250,14 @@ struct WatchNotifyInfo : public RefCountedWaitObject {
 
   // watcher
   librados::WatchCtx *watch_ctx;
+  librados::WatchReplyCtx *watch_reply_ctx;
 
   // notify that we initiated
   Mutex *notify_lock;
   Cond *notify_cond;
   bool *notify_done;
   int *notify_rval;
+  bufferlist *notify_reply_bl;
 
   WatchNotifyInfo(IoCtxImpl *io_ctx_impl_,
 		  const object_t& _oc)
@@ -244,10 +266,12 @@ struct WatchNotifyInfo : public RefCountedWaitObject {
       linger_id(0),
       cookie(0),
       watch_ctx(NULL),
+      watch_reply_ctx(NULL),
       notify_lock(NULL),
       notify_cond(NULL),
       notify_done(NULL),
-      notify_rval(NULL) {
+      notify_rval(NULL),
+      notify_reply_bl(NULL) {
     io_ctx_impl->get();
   }
 
@@ -687,7 +687,13 @@ void librados::RadosClient::handle_watch_notify(MWatchNotify *m)
 {
   Mutex::Locker l(lock);
 
-  if (watch_notify_info.count(m->cookie)) {
+  bool known = watch_notify_info.count(m->cookie);
+  for (vector<uint64_t>::iterator p = m->cookies.begin();
+       !known && p != m->cookies.end();
+       ++p)
+    known = watch_notify_info.count(*p);
+
+  if (known) {
     ldout(cct,10) << __func__ << " queueing async " << *m << dendl;
     // deliver this async via a finisher thread
     finisher.queue(new C_DoWatchNotify(this, m));
@@ -703,36 +709,67 @@ void librados::RadosClient::do_watch_notify(MWatchNotify *m)
   Mutex::Locker l(lock);
   map<uint64_t, WatchNotifyInfo *>::iterator iter =
     watch_notify_info.find(m->cookie);
-  if (iter != watch_notify_info.end()) {
+  if (iter != watch_notify_info.end() && iter->second->notify_lock) {
+    // we sent a notify and it completed (or failed)
+    WatchNotifyInfo *wc = iter->second;
+    ldout(cct,10) << __func__ << " completed notify " << *m << dendl;
+    wc->notify_lock->Lock();
+    *wc->notify_done = true;
+    *wc->notify_rval = m->return_code;
+    if (wc->notify_reply_bl && m->opcode == WATCH_NOTIFY_COMPLETE)
+      *wc->notify_reply_bl = m->bl;
+    wc->notify_cond->Signal();
+    wc->notify_lock->Unlock();
+    m->put();
+    return;
+  }
+
+  // we are watcher and got a notify, possibly for several of our
+  // watches at once; run every callback and ack them together
+  vector<uint64_t> cookies;
+  if (m->cookies.empty())
+    cookies.push_back(m->cookie);
+  else
+    cookies = m->cookies;
+
+  list<WatchNotifyInfo *> wcs;
+  map<uint64_t, bufferlist> acks;
+  for (vector<uint64_t>::iterator p = cookies.begin();
+       p != cookies.end();
+       ++p) {
+    iter = watch_notify_info.find(*p);
+    if (iter == watch_notify_info.end()) {
+      ldout(cct, 4) << __func__ << " unknown cookie " << *p << dendl;
+      continue;
+    }
     WatchNotifyInfo *wc = iter->second;
     assert(wc);
-    if (wc->notify_lock) {
-      // we sent a notify and it completed (or failed)
-      ldout(cct,10) << __func__ << " completed notify " << *m << dendl;
-      wc->notify_lock->Lock();
-      *wc->notify_done = true;
-      *wc->notify_rval = m->return_code;
-      wc->notify_cond->Signal();
-      wc->notify_lock->Unlock();
-    } else {
-      // we are watcher and got a notify
-      ldout(cct,10) << __func__ << " got notify " << *m << dendl;
-      wc->get();
+    ldout(cct,10) << __func__ << " got notify " << *m << " for cookie "
+		  << *p << dendl;
+    wc->get();
+    wcs.push_back(wc);
 
-      // trigger the callback
-      lock.Unlock();
+    // trigger the callback
+    bufferlist reply;
+    lock.Unlock();
+    if (wc->watch_reply_ctx)
+      wc->watch_reply_ctx->notify(m->opcode, m->ver, m->bl, &reply);
+    else
       wc->watch_ctx->notify(m->opcode, m->ver, m->bl);
-      lock.Lock();
-
-      // send ACK back to the OSD
-      wc->io_ctx_impl->_notify_ack(wc->oid, m->notify_id, m->ver, m->cookie);
+    lock.Lock();
+    acks[*p].claim(reply);
+  }
 
-      ldout(cct,10) << __func__ << " notify done" << dendl;
-      wc->put();
-    }
-  } else {
-    ldout(cct, 4) << __func__ << " unknown cookie " << m->cookie << dendl;
+  if (!wcs.empty()) {
+    // send ACKs back to the OSD
+    WatchNotifyInfo *wc = wcs.front();
+    wc->io_ctx_impl->_notify_ack(wc->oid, m->notify_id, m->ver, acks);
+    ldout(cct,10) << __func__ << " notify done" << dendl;
   }
+  for (list<WatchNotifyInfo *>::iterator p = wcs.begin();
+       p != wcs.end();
+       ++p)
+    (*p)->put();
   m->put();
 }
 
@@ -111,6 +111,14 @@ void librados::ObjectOperation::cmpxattr(const char *name, uint8_t op, uint64_t
   o->cmpxattr(name, op, CEPH_OSD_CMPXATTR_MODE_U64, bl);
 }
 
+void librados::ObjectOperation::cmpext(uint64_t off, const bufferlist& cmp_bl,
+				       int *prval)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  bufferlist c = cmp_bl;
+  o->cmpext(off, c, prval);
+}
+
 void librados::ObjectOperation::src_cmpxattr(const std::string& src_oid,
 					 const char *name, int op, const bufferlist& v)
 {
@@ -360,6 +368,15 @@ void librados::ObjectWriteOperation::zero(uint64_t off, uint64_t len)
   o->zero(off, len);
 }
 
+void librados::ObjectWriteOperation::writesame(uint64_t off,
+						uint64_t write_len,
+						const bufferlist& bl)
+{
+  ::ObjectOperation *o = (::ObjectOperation *)impl;
+  bufferlist c = bl;
+  o->writesame(off, write_len, c);
+}
+
 void librados::ObjectWriteOperation::rmxattr(const char *name)
 {
   ::ObjectOperation *o = (::ObjectOperation *)impl;
@@ -480,6 +497,11 @@ librados::WatchCtx::
 {
 }
 
+librados::WatchReplyCtx::
+~WatchReplyCtx()
+{
+}
+
 
 struct librados::ObjListCtx {
   bool new_request;
@@ -1312,6 +1334,34 @@ int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
 				       0, pbl);
 }
 
+int librados::IoCtx::aio_operate_batch(
+  const std::vector<std::pair<std::string, ObjectOperation*> >& ops,
+  AioCompletion *c, std::vector<int> *results)
+{
+  vector<pair<object_t, ::ObjectOperation*> > batch;
+  batch.reserve(ops.size());
+  for (std::vector<std::pair<std::string, ObjectOperation*> >::const_iterator
+	 p = ops.begin(); p != ops.end(); ++p) {
+    batch.push_back(make_pair(object_t(p->first),
+			      (::ObjectOperation*)p->second->impl));
+  }
+  return io_ctx_impl->aio_operate_batch(batch, c->pc, results);
+}
+
+int librados::IoCtx::operate_batch(
+  const std::vector<std::pair<std::string, ObjectOperation*> >& ops,
+  std::vector<int> *results)
+{
+  AioCompletion *c = Rados::aio_create_completion();
+  int r = aio_operate_batch(ops, c, results);
+  if (r == 0) {
+    c->wait_for_safe();
+    r = c->get_return_value();
+  }
+  c->release();
+  return r;
+}
+
 // deprecated
 int librados::IoCtx::aio_operate(const std::string& oid, AioCompletion *c,
 				 librados::ObjectReadOperation *o, 
@@ -1547,6 +1597,206 @@ const librados::ObjectIterator& librados::IoCtx::objects_end() const
   return ObjectIterator::__EndObjectIterator;
 }
 
+///////////////////////////// ObjectCursor //////////////////////////////
+
+librados::ObjectCursor::ObjectCursor()
+  : c_cursor(new Objecter::NListCursor())
+{
+}
+
+librados::ObjectCursor::ObjectCursor(const ObjectCursor &rhs)
+  : c_cursor(new Objecter::NListCursor(
+	       *(Objecter::NListCursor *)rhs.c_cursor))
+{
+}
+
+librados::ObjectCursor& librados::ObjectCursor::operator=(
+  const ObjectCursor& rhs)
+{
+  *(Objecter::NListCursor *)c_cursor = *(Objecter::NListCursor *)rhs.c_cursor;
+  return *this;
+}
+
+librados::ObjectCursor::~ObjectCursor()
+{
+  delete (Objecter::NListCursor *)c_cursor;
+}
+
+bool librados::ObjectCursor::operator<(const ObjectCursor &rhs) const
+{
+  return *(Objecter::NListCursor *)c_cursor <
+    *(Objecter::NListCursor *)rhs.c_cursor;
+}
+
+bool librados::ObjectCursor::operator==(const ObjectCursor &rhs) const
+{
+  return *(Objecter::NListCursor *)c_cursor ==
+    *(Objecter::NListCursor *)rhs.c_cursor;
+}
+
+bool librados::ObjectCursor::operator!=(const ObjectCursor &rhs) const
+{
+  return !(*this == rhs);
+}
+
+std::string librados::ObjectCursor::to_str() const
+{
+  bufferlist bl, b64;
+  ::encode(*(Objecter::NListCursor *)c_cursor, bl);
+  bl.encode_base64(b64);
+  return std::string(b64.c_str(), b64.length());
+}
+
+bool librados::ObjectCursor::from_str(const std::string& s)
+{
+  Objecter::NListCursor c;
+  try {
+    bufferlist b64, bl;
+    b64.append(s);
+    bl.decode_base64(b64);
+    bufferlist::iterator p = bl.begin();
+    ::decode(c, p);
+  } catch (buffer::error& e) {
+    return false;
+  }
+  *(Objecter::NListCursor *)c_cursor = c;
+  return true;
+}
+
+namespace librados {
+std::ostream& operator<<(std::ostream& out, const librados::ObjectCursor& c)
+{
+  return out << *(Objecter::NListCursor *)c.c_cursor;
+}
+}
+
+librados::ObjectCursor librados::IoCtx::object_list_begin()
+{
+  return ObjectCursor();
+}
+
+librados::ObjectCursor librados::IoCtx::object_list_end()
+{
+  ObjectCursor oc;
+  *(Objecter::NListCursor *)oc.c_cursor = Objecter::NListCursor::end();
+  return oc;
+}
+
+bool librados::IoCtx::object_list_is_end(const ObjectCursor &oc)
+{
+  return ((Objecter::NListCursor *)oc.c_cursor)->is_end();
+}
+
+librados::ObjectListFilter::ObjectListFilter()
+  : min_size(0), max_size((uint64_t)-1), min_mtime(0), max_mtime(0),
+    check_omap_header(false), want_size(false), want_mtime(false)
+{
+}
+
+int librados::IoCtx::object_list(const ObjectCursor &start,
+				 const ObjectCursor &finish,
+				 const size_t result_count,
+				 std::vector<ObjectItem> *result,
+				 ObjectCursor *next)
+{
+  assert(result != NULL);
+  result->clear();
+
+  std::list<librados::ListObjectImpl> objects;
+  Objecter::NListCursor n;
+  bufferlist filter;
+  int r = io_ctx_impl->object_list(*(Objecter::NListCursor *)start.c_cursor,
+				   *(Objecter::NListCursor *)finish.c_cursor,
+				   result_count, filter, &objects, NULL, &n);
+  if (r < 0)
+    return r;
+
+  for (std::list<librados::ListObjectImpl>::iterator p = objects.begin();
+       p != objects.end(); ++p) {
+    ObjectItem item;
+    item.oid = p->oid;
+    item.nspace = p->nspace;
+    item.locator = p->locator;
+    result->push_back(item);
+  }
+  if (next)
+    *(Objecter::NListCursor *)next->c_cursor = n;
+  return 0;
+}
+
+int librados::IoCtx::object_list(const ObjectCursor &start,
+				 const ObjectCursor &finish,
+				 const size_t result_count,
+				 const ObjectListFilter &filter,
+				 std::vector<ObjectItem> *result,
+				 ObjectCursor *next)
+{
+  assert(result != NULL);
+  result->clear();
+
+  pg_nls_filter_t expr;
+  expr.name_prefix = filter.name_prefix;
+  expr.name_glob = filter.name_glob;
+  expr.min_size = filter.min_size;
+  expr.max_size = filter.max_size;
+  expr.min_mtime = utime_t(filter.min_mtime, 0);
+  expr.max_mtime = utime_t(filter.max_mtime, 0);
+  expr.xattrs_equal = filter.xattrs_equal;
+  expr.xattrs_present = filter.xattrs_present;
+  expr.check_omap_header = filter.check_omap_header;
+  expr.omap_header_prefix = filter.omap_header_prefix;
+  if (filter.want_size)
+    expr.want |= pg_nls_filter_t::WANT_SIZE;
+  if (filter.want_mtime)
+    expr.want |= pg_nls_filter_t::WANT_MTIME;
+  expr.want_xattrs = filter.want_xattrs;
+
+  bufferlist filter_bl;
+  ::encode(std::string("expr"), filter_bl);
+  ::encode(expr, filter_bl);
+
+  std::list<librados::ListObjectImpl> objects;
+  std::list<pg_nls_object_info_t> info;
+  Objecter::NListCursor n;
+  int r = io_ctx_impl->object_list(*(Objecter::NListCursor *)start.c_cursor,
+				   *(Objecter::NListCursor *)finish.c_cursor,
+				   result_count, filter_bl, &objects, &info,
+				   &n);
+  if (r < 0)
+    return r;
+
+  std::list<pg_nls_object_info_t>::iterator i = info.begin();
+  for (std::list<librados::ListObjectImpl>::iterator p = objects.begin();
+       p != objects.end(); ++p, ++i) {
+    ObjectItem item;
+    item.oid = p->oid;
+    item.nspace = p->nspace;
+    item.locator = p->locator;
+    item.size = i->size;
+    item.mtime = i->mtime.sec();
+    item.xattrs.swap(i->xattrs);
+    result->push_back(item);
+  }
+  if (next)
+    *(Objecter::NListCursor *)next->c_cursor = n;
+  return 0;
+}
+
+int librados::IoCtx::object_list_slice(const ObjectCursor &start,
+				       const ObjectCursor &finish,
+				       const size_t n, const size_t m,
+				       ObjectCursor *split_start,
+				       ObjectCursor *split_finish)
+{
+  assert(split_start != NULL);
+  assert(split_finish != NULL);
+  return io_ctx_impl->object_list_slice(
+    *(Objecter::NListCursor *)start.c_cursor,
+    *(Objecter::NListCursor *)finish.c_cursor, n, m,
+    (Objecter::NListCursor *)split_start->c_cursor,
+    (Objecter::NListCursor *)split_finish->c_cursor);
+}
+
 int librados::IoCtx::hit_set_list(uint32_t hash, AioCompletion *c,
 				  std::list< std::pair<time_t, time_t> > *pls)
 {
@@ -1661,6 +1911,13 @@ int librados::IoCtx::watch(const string& oid, uint64_t ver, uint64_t *cookie,
   return io_ctx_impl->watch(obj, ver, cookie, ctx);
 }
 
+int librados::IoCtx::watch(const string& oid, uint64_t ver, uint64_t *cookie,
+			   librados::WatchReplyCtx *ctx)
+{
+  object_t obj(oid);
+  return io_ctx_impl->watch(obj, ver, cookie, NULL, ctx);
+}
+
 int librados::IoCtx::unwatch(const string& oid, uint64_t handle)
 {
   uint64_t cookie = handle;
@@ -1674,6 +1931,13 @@ int librados::IoCtx::notify(const string& oid, uint64_t ver, bufferlist& bl)
   return io_ctx_impl->notify(obj, ver, bl);
 }
 
+int librados::IoCtx::notify(const string& oid, uint64_t ver, bufferlist& bl,
+			    std::map<std::pair<uint64_t, uint64_t>, bufferlist> *replies)
+{
+  object_t obj(oid);
+  return io_ctx_impl->notify(obj, ver, bl, replies);
+}
+
 int librados::IoCtx::list_watchers(const std::string& oid,
                                    std::list<obj_watch_t> *out_watchers)
 {
@@ -3364,6 +3628,152 @@ extern "C" uint32_t rados_nobjects_list_get_pg_hash_position(
   return retval;
 }
 
+extern "C" rados_object_list_cursor rados_object_list_begin(rados_ioctx_t io)
+{
+  return (rados_object_list_cursor)new Objecter::NListCursor();
+}
+
+extern "C" rados_object_list_cursor rados_object_list_end(rados_ioctx_t io)
+{
+  return (rados_object_list_cursor)new Objecter::NListCursor(
+    Objecter::NListCursor::end());
+}
+
+extern "C" int rados_object_list_is_end(rados_ioctx_t io,
+					rados_object_list_cursor cur)
+{
+  return ((Objecter::NListCursor *)cur)->is_end();
+}
+
+extern "C" void rados_object_list_cursor_free(rados_ioctx_t io,
+					      rados_object_list_cursor cur)
+{
+  delete (Objecter::NListCursor *)cur;
+}
+
+extern "C" int rados_object_list_cursor_cmp(rados_ioctx_t io,
+					    rados_object_list_cursor lhs,
+					    rados_object_list_cursor rhs)
+{
+  const Objecter::NListCursor &l = *(Objecter::NListCursor *)lhs;
+  const Objecter::NListCursor &r = *(Objecter::NListCursor *)rhs;
+  if (l < r)
+    return -1;
+  if (r < l)
+    return 1;
+  return 0;
+}
+
+extern "C" int rados_object_list_cursor_to_str(rados_ioctx_t io,
+					       rados_object_list_cursor cur,
+					       char *buf, size_t *len)
+{
+  bufferlist bl, b64;
+  ::encode(*(Objecter::NListCursor *)cur, bl);
+  bl.encode_base64(b64);
+  size_t needed = b64.length() + 1;
+  if (*len < needed) {
+    *len = needed;
+    return -ERANGE;
+  }
+  *len = needed;
+  b64.copy(0, b64.length(), buf);
+  buf[b64.length()] = '\0';
+  return 0;
+}
+
+extern "C" int rados_object_list_cursor_from_str(rados_ioctx_t io,
+						 const char *str,
+						 rados_object_list_cursor *cur)
+{
+  Objecter::NListCursor c;
+  try {
+    bufferlist b64, bl;
+    b64.append(str);
+    bl.decode_base64(b64);
+    bufferlist::iterator p = bl.begin();
+    ::decode(c, p);
+  } catch (buffer::error& e) {
+    return -EINVAL;
+  }
+  *cur = (rados_object_list_cursor)new Objecter::NListCursor(c);
+  return 0;
+}
+
+static void copy_list_item_str(const std::string& s, size_t *len, char **str)
+{
+  *len = s.size();
+  *str = (char *)malloc(s.size() + 1);
+  memcpy(*str, s.c_str(), s.size() + 1);
+}
+
+extern "C" int rados_object_list(rados_ioctx_t io,
+				 const rados_object_list_cursor start,
+				 const rados_object_list_cursor finish,
+				 const size_t result_size,
+				 rados_object_list_item *results,
+				 rados_object_list_cursor *next)
+{
+  tracepoint(librados, rados_object_list_enter, io, start, finish,
+	     result_size);
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+  std::list<librados::ListObjectImpl> objects;
+  Objecter::NListCursor n;
+  bufferlist filter;
+  int r = ctx->object_list(*(Objecter::NListCursor *)start,
+			   *(Objecter::NListCursor *)finish,
+			   result_size, filter, &objects, NULL, &n);
+  if (r < 0) {
+    tracepoint(librados, rados_object_list_exit, r, NULL);
+    return r;
+  }
+
+  int count = 0;
+  for (std::list<librados::ListObjectImpl>::iterator p = objects.begin();
+       p != objects.end(); ++p, ++count) {
+    rados_object_list_item *item = &results[count];
+    copy_list_item_str(p->oid, &item->oid_length, &item->oid);
+    copy_list_item_str(p->nspace, &item->nspace_length, &item->nspace);
+    copy_list_item_str(p->locator, &item->locator_length, &item->locator);
+  }
+  if (next)
+    *next = (rados_object_list_cursor)new Objecter::NListCursor(n);
+  tracepoint(librados, rados_object_list_exit, count, next ? *next : NULL);
+  return count;
+}
+
+extern "C" void rados_object_list_free(const size_t result_size,
+				       rados_object_list_item *results)
+{
+  for (size_t i = 0; i < result_size; ++i) {
+    free(results[i].oid);
+    free(results[i].nspace);
+    free(results[i].locator);
+  }
+}
+
+extern "C" int rados_object_list_slice(rados_ioctx_t io,
+				       const rados_object_list_cursor start,
+				       const rados_object_list_cursor finish,
+				       const size_t n,
+				       const size_t m,
+				       rados_object_list_cursor *split_start,
+				       rados_object_list_cursor *split_finish)
+{
+  tracepoint(librados, rados_object_list_slice_enter, io, start, finish, n, m);
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+  Objecter::NListCursor s, f;
+  int r = ctx->object_list_slice(*(Objecter::NListCursor *)start,
+				 *(Objecter::NListCursor *)finish,
+				 n, m, &s, &f);
+  if (r == 0) {
+    *split_start = (rados_object_list_cursor)new Objecter::NListCursor(s);
+    *split_finish = (rados_object_list_cursor)new Objecter::NListCursor(f);
+  }
+  tracepoint(librados, rados_object_list_slice_exit, r);
+  return r;
+}
+
 // Deprecated, but using it for compatibility with older OSDs
 extern "C" int rados_objects_list_open(rados_ioctx_t io, rados_list_ctx_t *listh)
 {
@@ -3619,6 +4029,20 @@ extern "C" int rados_aio_read(rados_ioctx_t io, const char *o,
   return retval;
 }
 
+extern "C" int rados_aio_readv(rados_ioctx_t io, const char *o,
+				rados_completion_t completion,
+				const struct iovec *iov, int iovcnt,
+				uint64_t off)
+{
+  tracepoint(librados, rados_aio_readv_enter, io, o, completion, iovcnt, off);
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+  object_t oid(o);
+  int retval = ctx->aio_readv(oid, (librados::AioCompletionImpl*)completion,
+			      iov, iovcnt, off, ctx->snap_seq);
+  tracepoint(librados, rados_aio_readv_exit, retval);
+  return retval;
+}
+
 extern "C" int rados_aio_write(rados_ioctx_t io, const char *o,
 				rados_completion_t completion,
 				const char *buf, size_t len, uint64_t off)
@@ -3636,6 +4060,31 @@ extern "C" int rados_aio_write(rados_ioctx_t io, const char *o,
   return retval;
 }
 
+extern "C" int rados_aio_writev(rados_ioctx_t io, const char *o,
+				 rados_completion_t completion,
+				 const struct iovec *iov, int iovcnt,
+				 uint64_t off)
+{
+  tracepoint(librados, rados_aio_writev_enter, io, o, completion, iovcnt, off);
+  if (iovcnt <= 0) {
+    tracepoint(librados, rados_aio_writev_exit, -EINVAL);
+    return -EINVAL;
+  }
+  librados::IoCtxImpl *ctx = (librados::IoCtxImpl *)io;
+  object_t oid(o);
+  bufferlist bl;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].iov_len == 0)
+      continue;
+    bl.push_back(buffer::create_static(iov[i].iov_len,
+				       (char *)iov[i].iov_base));
+  }
+  int retval = ctx->aio_write(oid, (librados::AioCompletionImpl*)completion,
+			      bl, bl.length(), off);
+  tracepoint(librados, rados_aio_writev_exit, retval);
+  return retval;
+}
+
 extern "C" int rados_aio_append(rados_ioctx_t io, const char *o,
 				rados_completion_t completion,
 				const char *buf, size_t len)
@@ -3945,6 +4394,19 @@ extern "C" void rados_write_op_cmpxattr(rados_write_op_t write_op,
   tracepoint(librados, rados_write_op_cmpxattr_exit);
 }
 
+extern "C" void rados_write_op_cmpext(rados_write_op_t write_op,
+				      const char *cmp_buf,
+				      size_t cmp_len,
+				      uint64_t off,
+				      int *prval)
+{
+  tracepoint(librados, rados_write_op_cmpext_enter, write_op, cmp_buf, cmp_len, off, prval);
+  bufferlist bl;
+  bl.append(cmp_buf, cmp_len);
+  ((::ObjectOperation *)write_op)->cmpext(off, bl, prval);
+  tracepoint(librados, rados_write_op_cmpext_exit);
+}
+
 static void rados_c_omap_cmp(ObjectOperation *op,
 			     const char *key,
 			     uint8_t comparison_operator,
@@ -4061,6 +4523,19 @@ extern "C" void rados_write_op_zero(rados_write_op_t write_op,
   tracepoint(librados, rados_write_op_zero_exit);
 }
 
+extern "C" void rados_write_op_writesame(rados_write_op_t write_op,
+					 const char *buffer,
+					 size_t data_len,
+					 size_t write_len,
+					 uint64_t offset)
+{
+  tracepoint(librados, rados_write_op_writesame_enter, write_op, buffer, data_len, write_len, offset);
+  bufferlist bl;
+  bl.append(buffer, data_len);
+  ((::ObjectOperation *)write_op)->writesame(offset, write_len, bl);
+  tracepoint(librados, rados_write_op_writesame_exit);
+}
+
 extern "C" void rados_write_op_exec(rados_write_op_t write_op,
 				    const char *cls,
 				    const char *method,
@@ -29,6 +29,7 @@
 #include "libradosstriper/MultiAioCompletionImpl.h"
 #include "librados/AioCompletionImpl.h"
 #include <cls/lock/cls_lock_client.h>
+#include "cls/striper/cls_striper_client.h"
 
 /*
  * This file contents the actual implementation of the rados striped objects interface.
@@ -105,6 +106,9 @@
 /// format of the extension of rados objects created for a given striped object
 #define RADOS_OBJECT_EXTENSION_FORMAT ".%016llx"
 
+/// number of striped objects whose readahead state is kept
+#define MAX_READ_STREAMS 16
+
 /// default object layout (external declaration)
 extern ceph_file_layout g_default_file_layout;
 
@@ -181,6 +185,83 @@ void libradosstriper::RadosStriperImpl::WriteCompletionData::safe(int r) {
   if (m_safe) m_safe->finish(r);
 }
 
+///////////////////////// ReadStream /////////////////////////////
+
+libradosstriper::RadosStriperImpl::ReadStream::ReadStream
+(CephContext *cct,
+ const ceph_file_layout& layout,
+ uint64_t size) :
+  RefCountedObject(cct, 1),
+  m_lock("RadosStriperImpl::ReadStream::m_lock"),
+  m_layout(layout), m_size(size), m_bytes(0)
+{
+  __u32 su = layout.fl_stripe_unit;
+  __u32 stripe_count = layout.fl_stripe_count;
+  m_readahead.set_trigger_requests(cct->_conf->rados_striper_readahead_trigger_requests);
+  m_readahead.set_min_readahead_size(su);
+  m_readahead.set_max_readahead_size(cct->_conf->rados_striper_readahead_max_bytes);
+  // prefer reading ahead whole stripes, so that all objects are read in parallel
+  std::vector<uint64_t> alignments;
+  alignments.push_back((uint64_t)su * stripe_count);
+  alignments.push_back(su);
+  m_readahead.set_alignments(alignments);
+}
+
+libradosstriper::RadosStriperImpl::ReadStream::~ReadStream() {
+  // readahead reads in flight hold a reference, so nothing is pending here
+  for (std::map<uint64_t, Unit*>::iterator it = m_units.begin();
+       it != m_units.end();
+       ++it) {
+    assert(!it->second->m_pending);
+    delete it->second;
+  }
+}
+
+void libradosstriper::RadosStriperImpl::ReadStream::gather
+(const std::vector<std::pair<uint64_t, uint64_t> >& extents,
+ bufferlist *bl) {
+  assert(m_lock.is_locked());
+  for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator p = extents.begin();
+       p != extents.end();
+       ++p) {
+    uint64_t off = p->first;
+    uint64_t len = p->second;
+    while (len > 0) {
+      std::map<uint64_t, Unit*>::iterator it = m_units.upper_bound(off);
+      assert(it != m_units.begin());
+      --it;
+      Unit *unit = it->second;
+      uint64_t unit_off = off - it->first;
+      uint64_t n = MIN(len, unit->m_length - unit_off);
+      // share the unit's buffers rather than copying them
+      bufferlist sub;
+      sub.substr_of(unit->m_bl, unit_off, n);
+      bl->claim_append(sub);
+      off += n;
+      len -= n;
+    }
+  }
+}
+
+void libradosstriper::RadosStriperImpl::ReadStream::trim(uint64_t off,
+							 uint64_t max_bytes) {
+  assert(m_lock.is_locked());
+  bool all = m_bytes > max_bytes;
+  std::map<uint64_t, Unit*>::iterator it = m_units.begin();
+  while (it != m_units.end()) {
+    Unit *unit = it->second;
+    if (!all && it->first + unit->m_length > off)
+      break;
+    if (unit->m_pending || !unit->m_waiters.empty()) {
+      ++it;
+      continue;
+    }
+    m_bytes -= unit->m_length;
+    delete unit;
+    m_units.erase(it++);
+  }
+}
+
 ///////////////////////// RadosExclusiveLock /////////////////////////////
 
 libradosstriper::RadosStriperImpl::RadosExclusiveLock::RadosExclusiveLock(librados::IoCtx* ioCtx,
@@ -204,7 +285,17 @@ libradosstriper::RadosStriperImpl::RadosExclusiveLock::~RadosExclusiveLock() {
 
 libradosstriper::RadosStriperImpl::RadosStriperImpl(librados::IoCtx& ioctx, librados::IoCtxImpl *ioctx_impl) :
   m_refCnt(0),lock("RadosStriper Refcont", false, false), m_radosCluster(ioctx), m_ioCtx(ioctx), m_ioCtxImpl(ioctx_impl),
-  m_layout(g_default_file_layout) {}
+  m_layout(g_default_file_layout),
+  m_readStreamsLock("RadosStriperImpl::m_readStreamsLock") {}
+
+libradosstriper::RadosStriperImpl::~RadosStriperImpl()
+{
+  for (std::map<std::string, ReadStream*>::iterator it = m_readStreams.begin();
+       it != m_readStreams.end();
+       ++it) {
+    it->second->put();
+  }
+}
 
 ///////////////////////// layout /////////////////////////////
 
@@ -289,11 +380,12 @@ int libradosstriper::RadosStriperImpl::write(const std::string& soid,
 					     size_t len,
 					     uint64_t off) 
 {
-  // open the object. This will create it if needed, retrieve its layout
-  // and size and take a shared lock on it
+  // open the object. This will create it if needed, retrieve its layout,
+  // take a shared lock on it and extend its size
   ceph_file_layout layout;
+  uint64_t size = len+off;
   std::string lockCookie;
-  int rc = createAndOpenStripedObject(soid, &layout, len+off, &lockCookie, true);
+  int rc = openStripedObjectForWrite(soid, &layout, &size, &lockCookie, true);
   if (rc) return rc;
   return write_in_open_object(soid, layout, lockCookie, bl, len, off);
 }
@@ -302,8 +394,8 @@ int libradosstriper::RadosStriperImpl::append(const std::string& soid,
 					      const bufferlist& bl,
 					      size_t len) 
 {
-  // open the object. This will create it if needed, retrieve its layout
-  // and size and take a shared lock on it
+  // open the object. This will create it if needed, retrieve its layout,
+  // take a shared lock on it and reserve the appended range by growing its size
   ceph_file_layout layout;
   uint64_t size = len;
   std::string lockCookie;
@@ -348,8 +440,9 @@ int libradosstriper::RadosStriperImpl::aio_write(const std::string& soid,
 						 uint64_t off)
 {
   ceph_file_layout layout;
+  uint64_t size = len+off;
   std::string lockCookie;
-  int rc = createAndOpenStripedObject(soid, &layout, len+off, &lockCookie, true);
+  int rc = openStripedObjectForWrite(soid, &layout, &size, &lockCookie, true);
   if (rc) return rc;
   return aio_write_in_open_object(soid, c, layout, lockCookie, bl, len, off);
 }
@@ -364,7 +457,6 @@ int libradosstriper::RadosStriperImpl::aio_append(const std::string& soid,
   std::string lockCookie;
   int rc = openStripedObjectForWrite(soid, &layout, &size, &lockCookie, false);
   if (rc) return rc;
-  // create a completion object
   return aio_write_in_open_object(soid, c, layout, lockCookie, bl, len, size);
 }
 
@@ -456,9 +548,11 @@ int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
   }
   // get list of extents to be read from
   vector<ObjectExtent> *extents = new vector<ObjectExtent>();
+  ReadStream *stream = 0;
   if (read_len > 0) {
     std::string format = soid + RADOS_OBJECT_EXTENSION_FORMAT;
     Striper::file_to_extents(cct(), format.c_str(), &layout, off, read_len, 0, *extents);
+    stream = get_read_stream(soid, layout, size);
   }
   
   // create a completion object and transfer ownership of extents and resultbl
@@ -474,6 +568,9 @@ int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
   for (vector<ObjectExtent>::iterator p = extents->begin(); p != extents->end(); ++p) {
     // create a buffer list describing where to place data read from current extend
     bufferlist *oid_bl = &((*resultbl)[i++]);
+    // use what was read ahead if it covers this extent
+    if (stream && read_from_stream(stream, *p, off, oid_bl, nc))
+      continue;
     for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
         q != p->buffer_extents.end();
         ++q) {
@@ -495,6 +592,10 @@ int libradosstriper::RadosStriperImpl::aio_read(const std::string& soid,
   }
   nc->finish_adding_requests();
   nc->put();
+  if (stream) {
+    readahead(stream, soid, off, read_len);
+    stream->put();
+  }
   return r;
 }
 
@@ -526,6 +627,240 @@ int libradosstriper::RadosStriperImpl::aio_flush()
   return ret;
 }
 
+///////////////////////// readahead /////////////////////////////
+
+libradosstriper::RadosStriperImpl::ReadStream*
+libradosstriper::RadosStriperImpl::get_read_stream(const std::string& soid,
+						   const ceph_file_layout& layout,
+						   uint64_t size)
+{
+  if (cct()->_conf->rados_striper_readahead_max_bytes <= 0)
+    return 0;
+  Mutex::Locker l(m_readStreamsLock);
+  m_readStreamsLru.remove(soid);
+  std::map<std::string, ReadStream*>::iterator it = m_readStreams.find(soid);
+  if (it != m_readStreams.end()) {
+    ReadStream *stream = it->second;
+    if (stream->m_size == size &&
+	memcmp(&stream->m_layout, &layout, sizeof(layout)) == 0) {
+      m_readStreamsLru.push_front(soid);
+      stream->get();
+      return stream;
+    }
+    // the object was changed, what was read ahead may be stale
+    stream->put();
+    m_readStreams.erase(it);
+  }
+  ReadStream *stream = new ReadStream(cct(), layout, size);
+  m_readStreams[soid] = stream;
+  m_readStreamsLru.push_front(soid);
+  while (m_readStreamsLru.size() > MAX_READ_STREAMS) {
+    it = m_readStreams.find(m_readStreamsLru.back());
+    it->second->put();
+    m_readStreams.erase(it);
+    m_readStreamsLru.pop_back();
+  }
+  stream->get();
+  return stream;
+}
+
+void libradosstriper::RadosStriperImpl::invalidate_read_stream(const std::string& soid)
+{
+  Mutex::Locker l(m_readStreamsLock);
+  std::map<std::string, ReadStream*>::iterator it = m_readStreams.find(soid);
+  if (it != m_readStreams.end()) {
+    it->second->put();
+    m_readStreams.erase(it);
+    m_readStreamsLru.remove(soid);
+  }
+}
+
+bool libradosstriper::RadosStriperImpl::read_from_stream(ReadStream *stream,
+							 const ObjectExtent& extent,
+							 uint64_t off,
+							 bufferlist *bl,
+							 libradosstriper::MultiAioCompletionImpl *c)
+{
+  // ranges of the striped object this extent is made of, in object order
+  std::vector<std::pair<uint64_t, uint64_t> > extents;
+  for (vector<pair<uint64_t,uint64_t> >::const_iterator q = extent.buffer_extents.begin();
+       q != extent.buffer_extents.end();
+       ++q) {
+    extents.push_back(std::make_pair(off + q->first, q->second));
+  }
+  uint64_t su = stream->m_layout.fl_stripe_unit;
+  std::list<ReadStream::Unit*> pending;
+  stream->m_lock.Lock();
+  for (std::vector<std::pair<uint64_t, uint64_t> >::iterator p = extents.begin();
+       p != extents.end();
+       ++p) {
+    for (uint64_t u = p->first / su * su; u < p->first + p->second; u += su) {
+      std::map<uint64_t, ReadStream::Unit*>::iterator it = stream->m_units.find(u);
+      if (it == stream->m_units.end() ||
+	  (!it->second->m_pending && it->second->m_rval < 0)) {
+	// not read ahead, or failed : do a regular read
+	stream->m_lock.Unlock();
+	return false;
+      }
+      if (it->second->m_pending)
+	pending.push_back(it->second);
+    }
+  }
+  ldout(cct(), 20) << "RadosStriperImpl::read_from_stream : " << extent.oid
+		   << " " << extent.offset << "~" << extent.length
+		   << " from readahead, " << pending.size()
+		   << " stripe units pending" << dendl;
+  c->add_request();
+  if (!pending.empty()) {
+    ReadStream::Waiter *waiter = new ReadStream::Waiter;
+    waiter->m_multiAioCompl = c;
+    waiter->m_bl = bl;
+    waiter->m_extents.swap(extents);
+    waiter->m_pending = pending.size();
+    waiter->m_rval = 0;
+    for (std::list<ReadStream::Unit*>::iterator it = pending.begin();
+	 it != pending.end();
+	 ++it) {
+      (*it)->m_waiters.push_back(waiter);
+    }
+    stream->m_lock.Unlock();
+    return true;
+  }
+  stream->gather(extents, bl);
+  stream->m_lock.Unlock();
+  c->complete_request(extent.length);
+  c->safe_request(0);
+  return true;
+}
+
+static void rados_req_readahead_complete(rados_completion_t c, void *arg)
+{
+  libradosstriper::RadosStriperImpl::ReadaheadCompletionData *data =
+    reinterpret_cast<libradosstriper::RadosStriperImpl::ReadaheadCompletionData*>(arg);
+  int rc = rados_aio_get_return_value(c);
+  data->m_striper->complete_readahead(data->m_stream, data->m_offset, data->m_bl, rc);
+  data->m_stream->put();
+  data->m_striper->put();
+  delete data;
+}
+
+void libradosstriper::RadosStriperImpl::readahead(ReadStream *stream,
+						  const std::string& soid,
+						  uint64_t off,
+						  uint64_t len)
+{
+  Readahead::extent_t ra = stream->m_readahead.update(off, len, stream->m_size);
+  uint64_t su = stream->m_layout.fl_stripe_unit;
+  std::list<ReadaheadCompletionData*> reads;
+  stream->m_lock.Lock();
+  // keep what's ahead of the reader, unless we've piled up too much
+  stream->trim(off, 2 * cct()->_conf->rados_striper_readahead_max_bytes);
+  for (uint64_t u = ra.first / su * su; u < ra.first + ra.second; u += su) {
+    if (stream->m_units.count(u))
+      continue;
+    ReadStream::Unit *unit = new ReadStream::Unit;
+    unit->m_length = MIN(su, stream->m_size - u);
+    unit->m_pending = true;
+    unit->m_rval = 0;
+    stream->m_units[u] = unit;
+    stream->m_bytes += unit->m_length;
+    ReadaheadCompletionData *data = new ReadaheadCompletionData;
+    data->m_striper = this;
+    data->m_stream = stream;
+    data->m_offset = u;
+    reads.push_back(data);
+  }
+  stream->m_lock.Unlock();
+  if (reads.empty())
+    return;
+
+  ldout(cct(), 20) << "RadosStriperImpl::readahead : " << soid << " "
+		   << ra.first << "~" << ra.second << ", reading "
+		   << reads.size() << " stripe units" << dendl;
+  std::string format = soid + RADOS_OBJECT_EXTENSION_FORMAT;
+  for (std::list<ReadaheadCompletionData*>::iterator it = reads.begin();
+       it != reads.end();
+       ++it) {
+    ReadaheadCompletionData *data = *it;
+    // both are released when the read completes
+    get();
+    stream->get();
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(cct(), format.c_str(), &stream->m_layout, data->m_offset,
+			     MIN(su, stream->m_size - data->m_offset), 0, extents);
+    assert(extents.size() == 1);
+    librados::AioCompletion *rados_completion =
+      m_radosCluster.aio_create_completion(data, rados_req_readahead_complete, 0);
+    int r = m_ioCtx.aio_read(extents[0].oid.name, rados_completion, &data->m_bl,
+			     extents[0].length, extents[0].offset);
+    rados_completion->release();
+    if (r < 0) {
+      complete_readahead(stream, data->m_offset, data->m_bl, r);
+      stream->put();
+      put();
+      delete data;
+    }
+  }
+}
+
+void libradosstriper::RadosStriperImpl::complete_readahead(ReadStream *stream,
+							   uint64_t offset,
+							   bufferlist& bl,
+							   int rc)
+{
+  // ENOENT means that we are dealing with a sparse file, the unit is all 0s
+  if (rc == -ENOENT)
+    rc = 0;
+  std::list<ReadStream::Waiter*> done;
+  stream->m_lock.Lock();
+  std::map<uint64_t, ReadStream::Unit*>::iterator it = stream->m_units.find(offset);
+  assert(it != stream->m_units.end());
+  ReadStream::Unit *unit = it->second;
+  unit->m_pending = false;
+  if (rc < 0) {
+    ldout(cct(), 10) << "RadosStriperImpl::complete_readahead : stripe unit at "
+		     << offset << " failed : rc = " << rc << dendl;
+    unit->m_rval = rc;
+  } else {
+    unit->m_bl.claim(bl);
+    if (unit->m_bl.length() < unit->m_length) {
+      // only partial data were present in the object, complete with 0s
+      ceph::bufferptr zeros(ceph::buffer::create(unit->m_length - unit->m_bl.length()));
+      zeros.zero();
+      unit->m_bl.push_back(zeros);
+    }
+  }
+  for (std::list<ReadStream::Waiter*>::iterator p = unit->m_waiters.begin();
+       p != unit->m_waiters.end();
+       ++p) {
+    ReadStream::Waiter *waiter = *p;
+    if (rc < 0)
+      waiter->m_rval = rc;
+    if (--waiter->m_pending == 0) {
+      if (!waiter->m_rval)
+	stream->gather(waiter->m_extents, waiter->m_bl);
+      done.push_back(waiter);
+    }
+  }
+  unit->m_waiters.clear();
+  stream->m_lock.Unlock();
+
+  for (std::list<ReadStream::Waiter*>::iterator p = done.begin();
+       p != done.end();
+       ++p) {
+    ReadStream::Waiter *waiter = *p;
+    uint64_t len = 0;
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator q = waiter->m_extents.begin();
+	 q != waiter->m_extents.end();
+	 ++q) {
+      len += q->second;
+    }
+    waiter->m_multiAioCompl->complete_request(waiter->m_rval ? waiter->m_rval : len);
+    waiter->m_multiAioCompl->safe_request(waiter->m_rval);
+    delete waiter;
+  }
+}
+
 ///////////////////////// stat and deletion /////////////////////////////
 
 int libradosstriper::RadosStriperImpl::stat(const std::string& soid, uint64_t *psize, time_t *pmtime)
@@ -552,6 +887,7 @@ int libradosstriper::RadosStriperImpl::stat(const std::string& soid, uint64_t *p
 
 int libradosstriper::RadosStriperImpl::remove(const std::string& soid)
 {
+  invalidate_read_stream(soid);
   std::string firstObjOid = getObjectId(soid, 0);
   try {
     // lock the object in exclusive mode. Will be released when leaving the scope
@@ -609,6 +945,7 @@ int libradosstriper::RadosStriperImpl::remove(const std::string& soid)
 
 int libradosstriper::RadosStriperImpl::trunc(const std::string& soid, uint64_t size)
 {
+  invalidate_read_stream(soid);
   // lock the object in exclusive mode. Will be released when leaving the scope
   std::string firstObjOid = getObjectId(soid, 0);
   try {
@@ -639,14 +976,6 @@ std::string libradosstriper::RadosStriperImpl::getObjectId(const object_t& soid,
   return s.str();
 }
 
-int libradosstriper::RadosStriperImpl::closeForWrite(const std::string& soid,
-						     const std::string& lockCookie)
-{
-  // unlock the shared lock on the first rados object
-  unlockObject(soid, lockCookie);
-  return 0;
-}
-
 void libradosstriper::RadosStriperImpl::unlockObject(const std::string& soid,
 						     const std::string& lockCookie)
 {
@@ -659,7 +988,9 @@ static void striper_write_req_complete(rados_striper_multi_completion_t c, void
 {
   libradosstriper::RadosStriperImpl::WriteCompletionData *cdata =
     reinterpret_cast<libradosstriper::RadosStriperImpl::WriteCompletionData*>(arg);
-  cdata->m_striper->closeForWrite(cdata->m_soid, cdata->m_lockCookie);
+  cdata->m_striper->unlockObject(cdata->m_soid, cdata->m_lockCookie);
+  // readahead started while the write was in flight may predate it
+  cdata->m_striper->invalidate_read_stream(cdata->m_soid);
   cdata->put();
 }
 
@@ -692,9 +1023,11 @@ static void striper_write_aio_req_complete(rados_striper_multi_completion_t c, v
 {
   libradosstriper::RadosStriperImpl::WriteCompletionData *cdata =
     reinterpret_cast<libradosstriper::RadosStriperImpl::WriteCompletionData*>(arg);
-  cdata->m_striper->closeForWrite(cdata->m_soid, cdata->m_lockCookie);
+  cdata->m_striper->unlockObject(cdata->m_soid, cdata->m_lockCookie);
   libradosstriper::MultiAioCompletionImpl *comp =
     reinterpret_cast<libradosstriper::MultiAioCompletionImpl*>(c);
+  // readahead started while the write was in flight may predate it
+  cdata->m_striper->invalidate_read_stream(cdata->m_soid);
   cdata->complete(comp->rval);
   cdata->put();
 }
@@ -882,66 +1215,92 @@ int libradosstriper::RadosStriperImpl::openStripedObjectForWrite(const std::stri
 								 std::string *lockCookie,
 								 bool isFileSizeAbsolute)
 {
-  // take a lock the first rados object, if it exists
-  // check and lock must be atomic and are thus done within a single operation
-  librados::ObjectWriteOperation op;
-  op.assert_exists();
-  *lockCookie = getUUID();
-  utime_t dur = utime_t();
-  rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
+  // what was read ahead is about to be stale. It is dropped again once
+  // the write completes, see striper_write_aio_req_complete
+  invalidate_read_stream(soid);
   std::string firstObjOid = getObjectId(soid, 0);
-  int rc = m_ioCtx.operate(firstObjOid, &op);
-  if (rc) {
-    if (rc == -ENOENT) {
-      // object does not exist, delegate to createEmptyStripedObject
-      int rc = createAndOpenStripedObject(soid, layout, *size, lockCookie, isFileSizeAbsolute);
-      // return original size
-      *size = 0;
-      return rc; 
-    } else {
-      return rc;
-    }
-  }
-  // all fine
   uint64_t curSize;
-  rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+  int rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+  if (-ENOENT == rc) {
+    // object does not exist, create it and retry
+    rc = createStripedObject(soid, isFileSizeAbsolute ? *size : 0);
+    if (rc) return rc;
+    rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+  }
   if (rc) {
-    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
     lderr(cct()) << "RadosStriperImpl::openStripedObjectForWrite : "
 		   << "could not load layout and size for "
 		   << soid << " : rc = " << rc << dendl;
     return rc;
   }
-  // atomically update object size, only if smaller than current one
-  if (!isFileSizeAbsolute)
-    *size += curSize;
-  librados::ObjectWriteOperation writeOp;
-  writeOp.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_GT, *size);
-  std::ostringstream oss;
-  oss << *size;
-  bufferlist bl;
-  bl.append(oss.str());
-  writeOp.setxattr(XATTR_SIZE, bl);
-  rc = m_ioCtx.operate(firstObjOid, &writeOp);
-  // return current size
-  *size = curSize;
-  // handle case where objectsize is already bigger than size
-  if (-ECANCELED == rc) 
-    rc = 0;
+  // take a shared lock on the first rados object and grow the size in
+  // the same operation. The lock is held until the write completes, so
+  // that trunc and remove, which take it in exclusive mode, cannot run
+  // while any of the data is being written.
+  // In append mode, the appended range is reserved by atomically moving
+  // the size from curSize to curSize + *size. Retry if someone else
+  // changed the size in the mean time
+  *lockCookie = getUUID();
+  utime_t dur = utime_t();
+  bool useStriperClass = true;
+  while (true) {
+    uint64_t newSize = isFileSizeAbsolute ? *size : curSize + *size;
+    librados::ObjectWriteOperation op;
+    op.assert_exists();
+    rados::cls::lock::lock(&op, RADOS_LOCK_NAME, LOCK_SHARED, *lockCookie, "Tag", "", dur, 0);
+    if (useStriperClass) {
+      if (isFileSizeAbsolute)
+	cls_striper_update_size(op, newSize);
+      else
+	cls_striper_update_size(op, curSize, newSize);
+      rc = m_ioCtx.operate(firstObjOid, &op);
+      if (-EOPNOTSUPP == rc) {
+	// OSDs without the striper class, take the lock and grow the
+	// size in separate operations
+	ldout(cct(), 10) << "RadosStriperImpl::openStripedObjectForWrite : "
+			 << "striper class not available, falling back to xattrs"
+			 << dendl;
+	useStriperClass = false;
+	continue;
+      }
+    } else {
+      rc = m_ioCtx.operate(firstObjOid, &op);
+      if (!rc) {
+	librados::ObjectWriteOperation writeOp;
+	if (isFileSizeAbsolute)
+	  writeOp.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_GT, newSize);
+	else
+	  writeOp.cmpxattr(XATTR_SIZE, LIBRADOS_CMPXATTR_OP_EQ, curSize);
+	std::ostringstream oss;
+	oss << newSize;
+	bufferlist bl;
+	bl.append(oss.str());
+	writeOp.setxattr(XATTR_SIZE, bl);
+	rc = m_ioCtx.operate(firstObjOid, &writeOp);
+	// the size is already bigger than what an absolute write needs
+	if (-ECANCELED == rc && isFileSizeAbsolute)
+	  rc = 0;
+	if (rc)
+	  m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
+      }
+    }
+    if (-ECANCELED != rc) break;
+    rc = internal_get_layout_and_size(firstObjOid, layout, &curSize);
+    if (rc) break;
+  }
   if (rc) {
-    m_ioCtx.unlock(firstObjOid, RADOS_LOCK_NAME, *lockCookie);
     lderr(cct()) << "RadosStriperImpl::openStripedObjectForWrite : "
-		   << "could not set new size for "
+		   << "could not lock and set new size for "
 		   << soid << " : rc = " << rc << dendl;
+    return rc;
   }
-  return rc;
+  // return original size
+  *size = curSize;
+  return 0;
 }
 
-int libradosstriper::RadosStriperImpl::createAndOpenStripedObject(const std::string& soid,
-								  ceph_file_layout *layout,
-								  uint64_t size,
-								  std::string *lockCookie,
-								  bool isFileSizeAbsolute)
+int libradosstriper::RadosStriperImpl::createStripedObject(const std::string& soid,
+							   uint64_t size)
 {
   // build atomic write operation
   librados::ObjectWriteOperation writeOp;
@@ -966,18 +1325,16 @@ int libradosstriper::RadosStriperImpl::createAndOpenStripedObject(const std::str
   writeOp.setxattr(XATTR_LAYOUT_STRIPE_COUNT, bl_stripe_count);
   // size
   std::ostringstream oss_size;
-  oss_size << (isFileSizeAbsolute?size:0);
+  oss_size << size;
   bufferlist bl_size;
   bl_size.append(oss_size.str());
   writeOp.setxattr(XATTR_SIZE, bl_size);
   // effectively change attributes
   std::string firstObjOid = getObjectId(soid, 0);
   int rc = m_ioCtx.operate(firstObjOid, &writeOp);
-  // in case of error (but no EEXIST which would mean the object existed), return
-  if (rc && -EEXIST != rc) return rc;
-  // Otherwise open the object
-  uint64_t fileSize = size;
-  return openStripedObjectForWrite(soid, layout, &fileSize, lockCookie, isFileSizeAbsolute);
+  // EEXIST means that someone else created it in the mean time, which is fine
+  if (-EEXIST == rc) return 0;
+  return rc;
 }
 
 int libradosstriper::RadosStriperImpl::truncate(const std::string& soid,
@@ -15,6 +15,8 @@
 #ifndef CEPH_LIBRADOSSTRIPER_RADOSSTRIPERIMPL_H
 #define CEPH_LIBRADOSSTRIPER_RADOSSTRIPERIMPL_H
 
+#include <list>
+#include <map>
 #include <string>
 
 #include "include/atomic.h"
@@ -26,6 +28,7 @@
 
 #include "librados/IoCtxImpl.h"
 #include "common/RefCountedObj.h"
+#include "common/Readahead.h"
 
 struct libradosstriper::RadosStriperImpl {
 
@@ -120,6 +123,69 @@ struct libradosstriper::RadosStriperImpl {
     bufferlist *m_bl;
   };
 
+  /**
+   * Readahead state of a striped object being read sequentially
+   *
+   * Once common/Readahead sees a sequential stream, whole stripe units
+   * ahead of the reader are read into units, keyed by their offset in
+   * the striped object.  Reads covered by units share their buffers
+   * instead of going to the OSDs, waiting for the ones still in flight.
+   * Units are dropped once the reader has moved past them.
+   */
+  struct ReadStream : RefCountedObject {
+    /// part of a read waiting for units in flight
+    struct Waiter {
+      /// the read's completion
+      MultiAioCompletionImpl *m_multiAioCompl;
+      /// where the data goes
+      bufferlist *m_bl;
+      /// ranges of the striped object to gather, in order
+      std::vector<std::pair<uint64_t, uint64_t> > m_extents;
+      /// units still in flight
+      int m_pending;
+      int m_rval;
+    };
+    /// one prefetched stripe unit
+    struct Unit {
+      /// bytes of the striped object covered
+      uint64_t m_length;
+      bool m_pending;
+      int m_rval;
+      /// data, zero padded to m_length once read
+      bufferlist m_bl;
+      std::list<Waiter*> m_waiters;
+    };
+    /// constructor
+    ReadStream(CephContext *cct, const ceph_file_layout& layout, uint64_t size);
+    /// destructor
+    virtual ~ReadStream();
+    /// copy ranges of the striped object held in units to bl
+    void gather(const std::vector<std::pair<uint64_t, uint64_t> >& extents,
+		bufferlist *bl);
+    /// drop idle units ending before off, or all idle units if too many
+    void trim(uint64_t off, uint64_t max_bytes);
+
+    /// protects m_units and m_bytes
+    Mutex m_lock;
+    Readahead m_readahead;
+    /// layout and size of the object when the units were read
+    ceph_file_layout m_layout;
+    uint64_t m_size;
+    std::map<uint64_t, Unit*> m_units;
+    uint64_t m_bytes;
+  };
+
+  /**
+   * struct handling the data needed to pass to the call back
+   * function in readahead reads of a stripe unit
+   */
+  struct ReadaheadCompletionData {
+    libradosstriper::RadosStriperImpl *m_striper;
+    ReadStream *m_stream;
+    uint64_t m_offset;
+    bufferlist m_bl;
+  };
+
   /**
    * exception wrapper around an error code
    */
@@ -153,7 +219,7 @@ struct libradosstriper::RadosStriperImpl {
    */
   RadosStriperImpl(librados::IoCtx& ioctx, librados::IoCtxImpl *ioctx_impl);
   /// Destructor
-  ~RadosStriperImpl() {};
+  ~RadosStriperImpl();
 
   // configuration
   int setObjectLayoutStripeUnit(unsigned int stripe_unit);
@@ -212,8 +278,6 @@ struct libradosstriper::RadosStriperImpl {
   std::string getObjectId(const object_t& soid, long long unsigned objectno);
 
   // opening and closing of striped objects
-  int closeForWrite(const std::string& soid,
-		    const std::string& lockCookie);
   void unlockObject(const std::string& soid,
 		    const std::string& lockCookie);
 
@@ -262,16 +326,18 @@ struct libradosstriper::RadosStriperImpl {
 			       std::string *lockCookie);
 
   /**
-   * opens an existing striped object, takes a shared lock on it
-   * and sets its size to the size it will have after the write.
-   * In case the striped object does not exists, it will create it by
-   * calling createOrOpenStripedObject.
+   * opens a striped object for writing, creating it if needed.
+   * A shared lock is taken on it, keeping trunc and remove out until the
+   * write completes, and its size is grown in the same operation.
+   * In append mode, the size is atomically moved forward, which reserves
+   * the appended range
    * @param layout this is filled with the layout of the file 
    * @param size new size of the file (together with isFileSizeAbsolute)
    * In case of success, this is filled with the size of the file before the opening
    * @param isFileSizeAbsolute if false, this means that the given size should
    * be added to the current file size (append mode)
    * @return 0 if everything is ok and the lock was taken. -errcode otherwise
+   * In particular, -EBUSY is returned if the object is being truncated or removed
    * In case the return code in not 0, no lock is taken
    */
   int openStripedObjectForWrite(const std::string& soid,
@@ -280,20 +346,12 @@ struct libradosstriper::RadosStriperImpl {
 				std::string *lockCookie,
 				bool isFileSizeAbsolute);
   /**
-   * creates an empty striped object with the given size and opens it calling
-   * openStripedObjectForWrite, which implies taking a shared lock on it
+   * creates an empty striped object with the given size
    * Also deals with the cases where the object was created in the mean time
-   * @param isFileSizeAbsolute if false, this means that the given size should
-   * be added to the current file size (append mode). This of course only makes
-   * sense in case the striped object already exists
-   * @return 0 if everything is ok and the lock was taken. -errcode otherwise
-   * In case the return code in not 0, no lock is taken
+   * @return 0 if everything is ok or the object already existed. -errcode otherwise
    */
-  int createAndOpenStripedObject(const std::string& soid,
-				 ceph_file_layout *layout,
-				 uint64_t size,
-				 std::string *lockCookie,
-				 bool isFileSizeAbsolute);
+  int createStripedObject(const std::string& soid,
+			  uint64_t size);
 
   /**
    * truncates an object. Should only be called with size < original_size
@@ -311,6 +369,49 @@ struct libradosstriper::RadosStriperImpl {
 	   uint64_t size,
 	   ceph_file_layout &layout);
   
+  /**
+   * returns a reference to the readahead state of a striped object,
+   * resetting it if the object's layout or size changed, or NULL if
+   * readahead is disabled
+   */
+  ReadStream *get_read_stream(const std::string& soid,
+			      const ceph_file_layout& layout,
+			      uint64_t size);
+
+  /**
+   * drops the readahead state of a striped object, called before it
+   * is modified and again when a write completes, as readers may have
+   * read ahead old data while it was in flight
+   */
+  void invalidate_read_stream(const std::string& soid);
+
+  /**
+   * serves the part of a read going to one rados object from units
+   * of the stream, if they cover it
+   * @param off offset of the read in the striped object
+   * @return true if a request was added to c for it
+   */
+  bool read_from_stream(ReadStream *stream,
+			const ObjectExtent& extent,
+			uint64_t off,
+			bufferlist *bl,
+			libradosstriper::MultiAioCompletionImpl *c);
+
+  /**
+   * records a read and starts reading the stripe units readahead
+   * asks for
+   */
+  void readahead(ReadStream *stream,
+		 const std::string& soid,
+		 uint64_t off,
+		 uint64_t len);
+
+  /**
+   * called when a readahead read of a stripe unit completes
+   */
+  void complete_readahead(ReadStream *stream, uint64_t offset,
+			  bufferlist& bl, int rc);
+
   /**
    * creates a unique identifier
    */
@@ -333,6 +434,11 @@ struct libradosstriper::RadosStriperImpl {
 
   // Default layout
   ceph_file_layout m_layout;
+
+  // Readahead state of recently read objects, most recent first in the lru
+  Mutex m_readStreamsLock;
+  std::map<std::string, ReadStream*> m_readStreams;
+  std::list<std::string> m_readStreamsLru;
 };
 
 #endif
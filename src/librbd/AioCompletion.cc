@@ -54,12 +54,44 @@ namespace librbd {
       bufferlist bl;
       destriper.assemble_result(cct, bl, true);
 
+      if (!read_overlay.empty()) {
+	// splice rather than copy over, the buffers may be the cache's
+	bufferlist merged;
+	uint64_t pos = 0;
+	for (std::map<uint64_t, bufferlist>::iterator p = read_overlay.begin();
+	     p != read_overlay.end() && p->first < bl.length(); ++p) {
+	  bufferlist sub;
+	  sub.substr_of(bl, pos, p->first - pos);
+	  merged.claim_append(sub);
+	  merged.append(p->second);
+	  pos = p->first + p->second.length();
+	}
+	if (pos < bl.length()) {
+	  bufferlist sub;
+	  sub.substr_of(bl, pos, bl.length() - pos);
+	  merged.claim_append(sub);
+	}
+	bl.swap(merged);
+      }
+
       if (read_buf) {
 	assert(bl.length() == read_buf_len);
 	bl.copy(0, read_buf_len, read_buf);
 	ldout(cct, 20) << "AioCompletion::finalize() copied resulting " << bl.length()
 		       << " bytes to " << (void*)read_buf << dendl;
       }
+      if (!read_iov.empty()) {
+	// a read clipped at the end of the image leaves the tail untouched
+	uint64_t off = 0;
+	for (std::vector<struct iovec>::iterator p = read_iov.begin();
+	     p != read_iov.end() && off < bl.length(); ++p) {
+	  uint64_t len = MIN(p->iov_len, bl.length() - off);
+	  bl.copy(off, len, (char *)p->iov_base);
+	  off += len;
+	}
+	ldout(cct, 20) << "AioCompletion::finalize() copied resulting " << off
+		       << " bytes to " << read_iov.size() << " buffers" << dendl;
+      }
       if (read_bl) {
 	ldout(cct, 20) << "AioCompletion::finalize() moving resulting " << bl.length()
 		       << " bytes to bl " << (void*)read_bl << dendl;
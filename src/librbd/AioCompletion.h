@@ -60,6 +60,9 @@ namespace librbd {
     bufferlist *read_bl;
     char *read_buf;
     size_t read_buf_len;
+    std::vector<struct iovec> read_iov;
+    /// newer data from the persistent cache, keyed by result offset
+    std::map<uint64_t, bufferlist> read_overlay;
 
     AioCompletion() : lock("AioCompletion::lock", true),
 		      done(false), rval(0), complete_cb(NULL),
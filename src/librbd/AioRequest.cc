@@ -7,8 +7,10 @@
 #include "common/RWLock.h"
 
 #include "librbd/AioCompletion.h"
+#include "librbd/CopyOnRead.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/internal.h"
+#include "librbd/ParentCache.h"
 
 #include "librbd/AioRequest.h"
 
@@ -82,17 +84,36 @@ namespace librbd {
       }
     }
 
+    // otherwise reads of this object keep going to the parent
+    if (m_tried_parent && r >= 0 && m_snap_id == CEPH_NOSNAP &&
+	m_ictx->copy_on_read != NULL)
+      m_ictx->copy_on_read->queue(m_object_no);
+
     return true;
   }
 
   int AioRead::send() {
     ldout(m_ictx->cct, 20) << "send " << this << " " << m_oid << " " << m_object_off << "~" << m_object_len << dendl;
 
+    // skip the OSD round trip if the object map knows there's no object
+    if (!m_ictx->object_map.object_may_exist(m_object_no)) {
+      complete(-ENOENT);
+      return 0;
+    }
+
+    int flags = m_ictx->get_read_flags(m_snap_id);
+    if (m_ictx->parent_cache != NULL) {
+      m_ictx->parent_cache->read(*m_ioctx, m_ictx->id, m_oid, m_object_no,
+				 m_snap_id, m_ictx->get_object_size(), flags,
+				 m_object_off, m_object_len, &m_read_data,
+				 new C_AioRequest(this));
+      return 0;
+    }
+
     librados::AioCompletion *rados_completion =
       librados::Rados::aio_create_completion(this, rados_req_cb, NULL);
     int r;
     librados::ObjectReadOperation op;
-    int flags = m_ictx->get_read_flags(m_snap_id);
     if (m_sparse) {
       op.sparse_read(m_object_off, m_object_len, &m_ext_map, &m_read_data,
 		     NULL);
@@ -108,7 +129,7 @@ namespace librbd {
   /** write **/
 
   AbstractWrite::AbstractWrite()
-    : m_state(LIBRBD_AIO_WRITE_FLAT),
+    : m_state(LIBRBD_AIO_WRITE_FLAT), m_guard(false), m_object_exist(true),
       m_parent_overlap(0),
       m_snap_seq(0) {}
   AbstractWrite::AbstractWrite(ImageCtx *ictx, const std::string &oid,
@@ -120,7 +141,8 @@ namespace librbd {
 			       bool hide_enoent)
     : AioRequest(ictx, oid, object_no, object_off, len, snap_id, completion,
 		 hide_enoent),
-      m_state(LIBRBD_AIO_WRITE_FLAT), m_snap_seq(snapc.seq.val)
+      m_state(LIBRBD_AIO_WRITE_FLAT), m_guard(false), m_object_exist(true),
+      m_snap_seq(snapc.seq.val)
   {
     m_object_image_extents = objectx;
     m_parent_overlap = object_overlap;
@@ -135,6 +157,7 @@ namespace librbd {
   void AbstractWrite::guard_write()
   {
     if (has_parent()) {
+      m_guard = true;
       m_state = LIBRBD_AIO_WRITE_GUARD;
       m_write.assert_exists();
       ldout(m_ictx->cct, 20) << __func__ << " guarding write" << dendl;
@@ -148,6 +171,15 @@ namespace librbd {
 
     bool finished = true;
     switch (m_state) {
+    case LIBRBD_AIO_WRITE_PRE:
+      ldout(m_ictx->cct, 20) << "WRITE_PRE" << dendl;
+      if (r < 0)
+	break;
+      r = send_write();
+      assert(r == 0);
+      finished = false;
+      break;
+
     case LIBRBD_AIO_WRITE_GUARD:
       ldout(m_ictx->cct, 20) << "WRITE_CHECK_GUARD" << dendl;
 
@@ -213,6 +245,20 @@ namespace librbd {
 
     case LIBRBD_AIO_WRITE_FLAT:
       ldout(m_ictx->cct, 20) << "WRITE_FLAT" << dendl;
+      if ((r == 0 || r == -ENOENT) && post_object_map_update()) {
+	m_state = LIBRBD_AIO_WRITE_POST;
+	Context *ctx = new C_AioRequest(this);
+	if (m_ictx->object_map.aio_update(m_object_no, OBJECT_NONEXISTENT,
+					  OBJECT_PENDING, ctx)) {
+	  finished = false;
+	} else {
+	  delete ctx;
+	}
+      }
+      break;
+
+    case LIBRBD_AIO_WRITE_POST:
+      ldout(m_ictx->cct, 20) << "WRITE_POST" << dendl;
       // nothing to do
       break;
 
@@ -226,6 +272,33 @@ namespace librbd {
 
   int AbstractWrite::send() {
     ldout(m_ictx->cct, 20) << "send " << this << " " << m_oid << " " << m_object_off << "~" << m_object_len << dendl;
+
+    m_object_exist = m_ictx->object_map.object_may_exist(m_object_no);
+    if (!m_object_exist && is_noop_if_nonexistent()) {
+      ldout(m_ictx->cct, 20) << "skipping nonexistent object" << dendl;
+      m_state = LIBRBD_AIO_WRITE_FLAT;
+      complete(0);
+      return 0;
+    }
+
+    m_state = LIBRBD_AIO_WRITE_PRE;
+    Context *ctx = new C_AioRequest(this);
+    if (m_ictx->object_map.aio_update(m_object_no, pre_object_map_update(),
+				      boost::optional<uint8_t>(), ctx))
+      return 0;
+    delete ctx;
+    return send_write();
+  }
+
+  int AbstractWrite::send_write() {
+    ldout(m_ictx->cct, 20) << "send_write " << this << " " << m_oid << " " << m_object_off << "~" << m_object_len << dendl;
+    m_state = m_guard ? LIBRBD_AIO_WRITE_GUARD : LIBRBD_AIO_WRITE_FLAT;
+    if (m_guard && !m_object_exist) {
+      // the object map says the guard would fail: go straight to copyup
+      complete(-ENOENT);
+      return 0;
+    }
+
     librados::AioCompletion *rados_completion =
       librados::Rados::aio_create_completion(this, NULL, rados_req_cb);
     int r;
@@ -250,7 +323,21 @@ namespace librbd {
   }
 
   void AioWrite::add_write_ops(librados::ObjectWriteOperation &wr) {
+    wr.set_alloc_hint(m_ictx->get_object_size(), m_ictx->get_object_size());
+    for (vector<pair<uint64_t, bufferlist> >::iterator it = m_extents.begin();
+	 it != m_extents.end(); ++it) {
+      wr.write(it->first, it->second);
+    }
+  }
+
+  void AioCompareAndWrite::add_write_ops(librados::ObjectWriteOperation &wr) {
+    wr.cmpext(m_object_off, m_cmp_data, NULL);
     wr.set_alloc_hint(m_ictx->get_object_size(), m_ictx->get_object_size());
     wr.write(m_object_off, m_write_data);
   }
+
+  void AioWriteSame::add_write_ops(librados::ObjectWriteOperation &wr) {
+    wr.set_alloc_hint(m_ictx->get_object_size(), m_ictx->get_object_size());
+    wr.writesame(m_object_off, m_object_len, m_write_data);
+  }
 }
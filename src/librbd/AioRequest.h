@@ -11,6 +11,7 @@
 #include "include/buffer.h"
 #include "include/Context.h"
 #include "include/rados/librados.hpp"
+#include "include/rbd/object_map_types.h"
 
 namespace librbd {
 
@@ -46,6 +47,16 @@ namespace librbd {
     virtual int send() = 0;
 
   protected:
+    class C_AioRequest : public Context {
+    public:
+      C_AioRequest(AioRequest *req) : m_req(req) {}
+      virtual void finish(int r) {
+	m_req->complete(r);
+      }
+    private:
+      AioRequest *m_req;
+    };
+
     void read_from_parent(vector<pair<uint64_t,uint64_t> >& image_extents);
 
     ImageCtx *m_ictx;
@@ -110,30 +121,54 @@ namespace librbd {
   private:
     /**
      * Writes go through the following state machine to deal with
-     * layering:
+     * layering and the object map:
      *
-     *                           need copyup
+     *                 need object map update
+     * <start> ---------------------------------> LIBRBD_AIO_WRITE_PRE
+     *    |                                                |
+     *    |    /-------------------------------------------/
+     *    |    |
+     *    v    v                 need copyup
      * LIBRBD_AIO_WRITE_GUARD ---------------> LIBRBD_AIO_WRITE_COPYUP
      *           |        ^                              |
      *           v        \------------------------------/
-     *         done
-     *           ^
-     *           |
-     * LIBRBD_AIO_WRITE_FLAT
+     *         done <------------------------------------\
+     *           ^                                       |
+     *           |          need object map update       |
+     * LIBRBD_AIO_WRITE_FLAT ------------------> LIBRBD_AIO_WRITE_POST
      *
      * Writes start in LIBRBD_AIO_WRITE_GUARD or _FLAT, depending on whether
-     * there is a parent or not.
+     * there is a parent or not, after first marking the object as
+     * existing (or pending removal) in the object map if needed.  A
+     * guarded write to an object the map knows does not exist skips
+     * straight to the copyup.
      */
     enum write_state_d {
+      LIBRBD_AIO_WRITE_PRE,
       LIBRBD_AIO_WRITE_GUARD,
       LIBRBD_AIO_WRITE_COPYUP,
-      LIBRBD_AIO_WRITE_FLAT
+      LIBRBD_AIO_WRITE_FLAT,
+      LIBRBD_AIO_WRITE_POST
     };
 
   protected:
     virtual void add_copyup_ops() = 0;
+    /// state to record in the object map before the write is sent
+    virtual uint8_t pre_object_map_update() {
+      return OBJECT_EXISTS;
+    }
+    /// whether the object map needs another update once the write is done
+    virtual bool post_object_map_update() {
+      return false;
+    }
+    /// whether the write does nothing to an object that doesn't exist
+    virtual bool is_noop_if_nonexistent() const {
+      return false;
+    }
 
     write_state_d m_state;
+    bool m_guard;
+    bool m_object_exist;
     vector<pair<uint64_t,uint64_t> > m_object_image_extents;
     uint64_t m_parent_overlap;
     librados::ObjectWriteOperation m_write;
@@ -142,6 +177,7 @@ namespace librbd {
     std::vector<librados::snap_t> m_snaps;
 
   private:
+    int send_write();
     void send_copyup();
   };
 
@@ -157,12 +193,92 @@ namespace librbd {
 		      object_no, object_off, data.length(),
 		      objectx, object_overlap,
 		      snapc, snap_id,
+		      completion, false) {
+      m_extents.push_back(std::make_pair(object_off, data));
+      guard_write();
+      add_write_ops(m_write);
+    }
+    /// write several non-overlapping extents, sorted by offset, at once
+    AioWrite(ImageCtx *ictx, const std::string &oid,
+	     uint64_t object_no,
+	     vector<pair<uint64_t, ceph::bufferlist> >& extents,
+	     vector<pair<uint64_t,uint64_t> >& objectx, uint64_t object_overlap,
+	     const ::SnapContext &snapc, librados::snap_t snap_id,
+	     Context *completion)
+      : AbstractWrite(ictx, oid,
+		      object_no, extents.front().first,
+		      extents.back().first + extents.back().second.length() -
+		        extents.front().first,
+		      objectx, object_overlap,
+		      snapc, snap_id,
+		      completion, false) {
+      m_extents.swap(extents);
+      guard_write();
+      add_write_ops(m_write);
+    }
+    virtual ~AioWrite() {}
+
+  protected:
+    virtual void add_copyup_ops() {
+      add_write_ops(m_copyup);
+    }
+
+  private:
+    void add_write_ops(librados::ObjectWriteOperation &wr);
+    vector<pair<uint64_t, ceph::bufferlist> > m_extents;
+  };
+
+  class AioCompareAndWrite : public AbstractWrite {
+  public:
+    AioCompareAndWrite(ImageCtx *ictx, const std::string &oid,
+		       uint64_t object_no, uint64_t object_off,
+		       vector<pair<uint64_t,uint64_t> >& objectx,
+		       uint64_t object_overlap,
+		       const ceph::bufferlist &cmp_data,
+		       const ceph::bufferlist &data,
+		       const ::SnapContext &snapc, librados::snap_t snap_id,
+		       Context *completion)
+      : AbstractWrite(ictx, oid,
+		      object_no, object_off, data.length(),
+		      objectx, object_overlap,
+		      snapc, snap_id,
+		      completion, false),
+	m_cmp_data(cmp_data), m_write_data(data) {
+      guard_write();
+      add_write_ops(m_write);
+    }
+    virtual ~AioCompareAndWrite() {}
+
+  protected:
+    virtual void add_copyup_ops() {
+      // compare against the parent data copied up in the same op
+      add_write_ops(m_copyup);
+    }
+
+  private:
+    void add_write_ops(librados::ObjectWriteOperation &wr);
+    ceph::bufferlist m_cmp_data;
+    ceph::bufferlist m_write_data;
+  };
+
+  class AioWriteSame : public AbstractWrite {
+  public:
+    AioWriteSame(ImageCtx *ictx, const std::string &oid,
+		 uint64_t object_no, uint64_t object_off, uint64_t object_len,
+		 vector<pair<uint64_t,uint64_t> >& objectx,
+		 uint64_t object_overlap,
+		 const ceph::bufferlist &data, const ::SnapContext &snapc,
+		 librados::snap_t snap_id, Context *completion)
+      : AbstractWrite(ictx, oid,
+		      object_no, object_off, object_len,
+		      objectx, object_overlap,
+		      snapc, snap_id,
 		      completion, false),
 	m_write_data(data) {
       guard_write();
       add_write_ops(m_write);
     }
-    virtual ~AioWrite() {}
+    virtual ~AioWriteSame() {}
 
   protected:
     virtual void add_copyup_ops() {
@@ -171,6 +287,7 @@ namespace librbd {
 
   private:
     void add_write_ops(librados::ObjectWriteOperation &wr);
+    /// the pattern, starting at m_object_off
     ceph::bufferlist m_write_data;
   };
 
@@ -198,6 +315,16 @@ namespace librbd {
       // removing an object never needs to copyup
       assert(0);
     }
+    virtual uint8_t pre_object_map_update() {
+      // a truncated clone object still exists
+      return has_parent() ? OBJECT_EXISTS : OBJECT_PENDING;
+    }
+    virtual bool post_object_map_update() {
+      return !has_parent();
+    }
+    virtual bool is_noop_if_nonexistent() const {
+      return !has_parent();
+    }
   };
 
   class AioTruncate : public AbstractWrite {
@@ -221,6 +348,9 @@ namespace librbd {
     virtual void add_copyup_ops() {
       m_copyup.truncate(m_object_off);
     }
+    virtual bool is_noop_if_nonexistent() const {
+      return !has_parent();
+    }
   };
 
   class AioZero : public AbstractWrite {
@@ -244,6 +374,9 @@ namespace librbd {
     virtual void add_copyup_ops() {
       m_copyup.zero(m_object_off, m_object_len);
     }
+    virtual bool is_noop_if_nonexistent() const {
+      return !has_parent();
+    }
   };
 
 }
@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <vector>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/rbd/object_map_types.h"
+
+#include "librbd/AioRequest.h"
+#include "librbd/ExclusiveLock.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/internal.h"
+
+#include "librbd/CopyOnRead.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::CopyOnRead: "
+
+namespace librbd {
+
+  CopyOnRead::CopyOnRead(ImageCtx &image_ctx)
+    : m_image_ctx(image_ctx), m_lock("librbd::CopyOnRead::m_lock"),
+      m_in_flight(0), m_send_queued(false), m_shutting_down(false),
+      m_finisher(image_ctx.cct)
+  {
+    m_finisher.start();
+  }
+
+  CopyOnRead::~CopyOnRead()
+  {
+    m_finisher.wait_for_empty();
+    m_finisher.stop();
+    assert(m_in_flight == 0);
+  }
+
+  void CopyOnRead::queue(uint64_t object_no)
+  {
+    const md_config_t *conf = m_image_ctx.cct->_conf;
+    Mutex::Locker l(m_lock);
+    if (m_shutting_down || m_pending.count(object_no) ||
+	m_queue.size() >= (size_t)conf->rbd_clone_copy_on_read_max_queued)
+      return;
+
+    ldout(m_image_ctx.cct, 20) << "queueing copyup of object " << object_no
+			       << dendl;
+    m_queue.push_back(object_no);
+    m_pending.insert(object_no);
+    if (!m_send_queued &&
+	m_in_flight < (uint32_t)conf->rbd_clone_copy_on_read_max_ops) {
+      m_send_queued = true;
+      m_finisher.queue(new C_Send(this));
+    }
+  }
+
+  void CopyOnRead::shut_down()
+  {
+    Mutex::Locker l(m_lock);
+    m_shutting_down = true;
+    m_queue.clear();
+    while (m_in_flight > 0 || m_send_queued)
+      m_cond.Wait(m_lock);
+    m_pending.clear();
+  }
+
+  void CopyOnRead::send_copyups()
+  {
+    const md_config_t *conf = m_image_ctx.cct->_conf;
+    Mutex::Locker l(m_lock);
+    m_send_queued = false;
+    while (!m_shutting_down && !m_queue.empty() &&
+	   m_in_flight < (uint32_t)conf->rbd_clone_copy_on_read_max_ops) {
+      uint64_t object_no = m_queue.front();
+      m_queue.pop_front();
+      ++m_in_flight;
+
+      m_lock.Unlock();
+      bool sent = send_copyup(object_no);
+      m_lock.Lock();
+      if (!sent) {
+	--m_in_flight;
+	m_pending.erase(object_no);
+      }
+    }
+    m_cond.Signal();
+  }
+
+  bool CopyOnRead::send_copyup(uint64_t object_no)
+  {
+    CephContext *cct = m_image_ctx.cct;
+    RWLock::RLocker owner_locker(m_image_ctx.owner_lock);
+    if (m_image_ctx.exclusive_lock != NULL &&
+	!m_image_ctx.exclusive_lock->is_lock_owner()) {
+      ldout(cct, 20) << "not the lock owner, skipping copyup of object "
+		     << object_no << dendl;
+      return false;
+    }
+
+    ::SnapContext snapc;
+    vector<pair<uint64_t,uint64_t> > objectx;
+    uint64_t object_overlap;
+    {
+      RWLock::RLocker l(m_image_ctx.md_lock);
+      RWLock::RLocker l2(m_image_ctx.snap_lock);
+      RWLock::RLocker l3(m_image_ctx.parent_lock);
+      if (m_image_ctx.parent == NULL || m_image_ctx.snap_id != CEPH_NOSNAP)
+	return false;
+
+      snapc = m_image_ctx.snapc;
+      Striper::extent_to_file(cct, &m_image_ctx.layout, object_no, 0,
+			      m_image_ctx.get_object_size(), objectx);
+      object_overlap = m_image_ctx.prune_parent_extents(
+	objectx, m_image_ctx.parent_md.overlap);
+    }
+    if (object_overlap == 0)
+      return false;
+
+    // a write may have copied it up since the read
+    uint8_t state = m_image_ctx.object_map.get_state(object_no);
+    if (m_image_ctx.object_map.enabled() &&
+	(state == OBJECT_EXISTS || state == OBJECT_EXISTS_CLEAN))
+      return false;
+
+    ldout(cct, 20) << "copying up object " << object_no << dendl;
+    bufferlist bl;
+    AioWrite *req = new AioWrite(&m_image_ctx,
+				 m_image_ctx.get_object_name(object_no),
+				 object_no, 0, objectx, object_overlap, bl,
+				 snapc, CEPH_NOSNAP,
+				 new C_CopyupDone(this, object_no));
+    int r = req->send();
+    assert(r == 0);
+    return true;
+  }
+
+  void CopyOnRead::complete_copyup(uint64_t object_no, int r)
+  {
+    if (r < 0) {
+      lderr(m_image_ctx.cct) << "error copying up object " << object_no
+			     << ": " << cpp_strerror(r) << dendl;
+    }
+
+    Mutex::Locker l(m_lock);
+    --m_in_flight;
+    m_pending.erase(object_no);
+    if (!m_shutting_down && !m_queue.empty() && !m_send_queued) {
+      m_send_queued = true;
+      m_finisher.queue(new C_Send(this));
+    }
+    m_cond.Signal();
+  }
+
+}
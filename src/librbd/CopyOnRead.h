@@ -0,0 +1,83 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_COPYONREAD_H
+#define CEPH_LIBRBD_COPYONREAD_H
+
+#include "include/int_types.h"
+
+#include <list>
+#include <set>
+
+#include "common/Cond.h"
+#include "common/Finisher.h"
+#include "common/Mutex.h"
+#include "include/Context.h"
+
+namespace librbd {
+
+  struct ImageCtx;
+
+  /**
+   * Copies up the objects of a clone that reads fall through to the
+   * parent for, so the parent stops serving them.
+   *
+   * The copyups are the ones a write or flatten would do, and run in
+   * the background with a few in flight at a time.  When too many are
+   * waiting, more are dropped; a later read of the same object queues
+   * it again.  A client without the exclusive lock leaves the image
+   * alone rather than take the lock for a read.
+   */
+  class CopyOnRead {
+  public:
+    CopyOnRead(ImageCtx &image_ctx);
+    ~CopyOnRead();
+
+    /// copy up an object whose data was just read from the parent
+    void queue(uint64_t object_no);
+    /// drop queued copyups and wait for the ones in flight
+    void shut_down();
+
+  private:
+    class C_Send : public Context {
+    public:
+      C_Send(CopyOnRead *copy_on_read) : m_copy_on_read(copy_on_read) {}
+      virtual void finish(int r) {
+	m_copy_on_read->send_copyups();
+      }
+    private:
+      CopyOnRead *m_copy_on_read;
+    };
+
+    class C_CopyupDone : public Context {
+    public:
+      C_CopyupDone(CopyOnRead *copy_on_read, uint64_t object_no)
+	: m_copy_on_read(copy_on_read), m_object_no(object_no) {}
+      virtual void finish(int r) {
+	m_copy_on_read->complete_copyup(m_object_no, r);
+      }
+    private:
+      CopyOnRead *m_copy_on_read;
+      uint64_t m_object_no;
+    };
+
+    ImageCtx &m_image_ctx;
+
+    Mutex m_lock; // protects everything below
+    Cond m_cond;
+    std::list<uint64_t> m_queue;
+    std::set<uint64_t> m_pending;  ///< queued or in flight
+    uint32_t m_in_flight;
+    bool m_send_queued;
+    bool m_shutting_down;
+
+    /// sends copyups outside the read completion's context
+    Finisher m_finisher;
+
+    void send_copyups();
+    bool send_copyup(uint64_t object_no);
+    void complete_copyup(uint64_t object_no, int r);
+  };
+
+}
+
+#endif
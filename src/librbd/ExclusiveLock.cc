@@ -0,0 +1,307 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <list>
+#include <map>
+
+#include "cls/lock/cls_lock_client.h"
+#include "cls/lock/cls_lock_types.h"
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/encoding.h"
+#include "include/rados/librados.hpp"
+#include "include/rbd_types.h"
+#include "include/stringify.h"
+
+#include "librbd/ImageCtx.h"
+#include "librbd/internal.h"
+#include "librbd/WatchCtx.h"
+
+#include "librbd/ExclusiveLock.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::ExclusiveLock: "
+
+using rados::cls::lock::locker_id_t;
+using rados::cls::lock::locker_info_t;
+
+namespace librbd {
+
+  // distinguishes the automatic lock from advisory locks taken
+  // through the lock API under the same name
+  static const std::string WATCHER_LOCK_TAG("internal");
+  static const std::string WATCHER_LOCK_COOKIE_PREFIX("auto");
+
+  ExclusiveLock::ExclusiveLock(ImageCtx &image_ctx)
+    : m_image_ctx(image_ctx), m_lock_owner(false), m_client_id(0),
+      m_lock("librbd::ExclusiveLock::m_lock"), m_released_seq(0),
+      m_finisher(image_ctx.cct)
+  {
+    librados::Rados rados(m_image_ctx.md_ctx);
+    m_client_id = rados.get_instance_id();
+    m_finisher.start();
+  }
+
+  ExclusiveLock::~ExclusiveLock()
+  {
+    m_finisher.wait_for_empty();
+    m_finisher.stop();
+    assert(!m_lock_owner);
+  }
+
+  bool ExclusiveLock::is_lock_owner() const
+  {
+    assert(m_image_ctx.owner_lock.is_locked());
+    return m_lock_owner;
+  }
+
+  uint64_t ExclusiveLock::get_watch_handle() const
+  {
+    return m_image_ctx.wctx != NULL ? m_image_ctx.wctx->cookie : 0;
+  }
+
+  std::string ExclusiveLock::encode_lock_cookie(uint64_t watch_handle) const
+  {
+    return WATCHER_LOCK_COOKIE_PREFIX + " " + stringify(watch_handle);
+  }
+
+  int ExclusiveLock::try_lock()
+  {
+    int r = rados::cls::lock::lock(&m_image_ctx.md_ctx,
+				   m_image_ctx.header_oid, RBD_LOCK_NAME,
+				   LOCK_EXCLUSIVE,
+				   encode_lock_cookie(get_watch_handle()),
+				   WATCHER_LOCK_TAG, "", utime_t(), 0);
+    if (r == -EEXIST) {
+      // already ours
+      r = 0;
+    }
+    if (r < 0)
+      return r;
+
+    ldout(m_image_ctx.cct, 10) << "acquired exclusive lock" << dendl;
+    m_lock_owner = true;
+
+    // whatever we cached may be stale after another owner's updates
+    Mutex::Locker l(m_image_ctx.refresh_lock);
+    ++m_image_ctx.refresh_seq;
+    return 0;
+  }
+
+  int ExclusiveLock::request_lock()
+  {
+    assert(m_image_ctx.owner_lock.is_wlocked());
+    CephContext *cct = m_image_ctx.cct;
+
+    while (!m_lock_owner) {
+      int r = try_lock();
+      if (r != -EBUSY)
+	return r;
+
+      uint64_t released_seq;
+      {
+	Mutex::Locker l(m_lock);
+	released_seq = m_released_seq;
+      }
+      ldout(cct, 10) << "requesting exclusive lock from its owner" << dendl;
+      notify(NOTIFY_OP_REQUEST_LOCK);
+
+      bool released;
+      {
+	utime_t timeout = ceph_clock_now(cct);
+	timeout += cct->_conf->rbd_lock_request_timeout;
+	Mutex::Locker l(m_lock);
+	while (m_released_seq == released_seq) {
+	  if (m_cond.WaitUntil(m_lock, timeout) != 0)
+	    break;
+	}
+	released = (m_released_seq != released_seq);
+      }
+      if (released)
+	continue;
+
+      ldout(cct, 10) << "timed out waiting for the exclusive lock" << dendl;
+      r = break_lock_if_dead();
+      if (r < 0)
+	return r;
+    }
+    return 0;
+  }
+
+  int ExclusiveLock::break_lock_if_dead()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    std::map<locker_id_t, locker_info_t> lockers;
+    ClsLockType lock_type;
+    std::string lock_tag;
+    int r = rados::cls::lock::get_lock_info(&m_image_ctx.md_ctx,
+					    m_image_ctx.header_oid,
+					    RBD_LOCK_NAME, &lockers, &lock_type,
+					    &lock_tag);
+    if (r < 0) {
+      lderr(cct) << "error reading lock info: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    if (lockers.empty())
+      return 0;
+    if (lock_tag != WATCHER_LOCK_TAG || lock_type != LOCK_EXCLUSIVE) {
+      lderr(cct) << "image is locked through the lock API" << dendl;
+      return -EBUSY;
+    }
+
+    const locker_id_t &locker = lockers.begin()->first;
+    const locker_info_t &locker_info = lockers.begin()->second;
+
+    std::list<obj_watch_t> watchers;
+    r = m_image_ctx.md_ctx.list_watchers(m_image_ctx.header_oid, &watchers);
+    if (r < 0) {
+      lderr(cct) << "error listing watchers: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    for (std::list<obj_watch_t>::iterator it = watchers.begin();
+	 it != watchers.end(); ++it) {
+      if (it->watcher_id == locker.locker.num() &&
+	  encode_lock_cookie(it->cookie) == locker.cookie) {
+	ldout(cct, 10) << "lock owner " << locker.locker << " is still alive"
+		       << dendl;
+	return 0;
+      }
+    }
+
+    ldout(cct, 1) << "breaking exclusive lock of dead owner "
+		  << locker.locker << " at " << locker_info.addr << dendl;
+    if (cct->_conf->rbd_blacklist_on_break_lock) {
+      std::string cmd = "{\"prefix\": \"osd blacklist\", "
+			"\"blacklistop\": \"add\", "
+			"\"addr\": \"" + stringify(locker_info.addr) + "\"";
+      if (cct->_conf->rbd_blacklist_expire_seconds > 0) {
+	cmd += ", \"expire\": " +
+	  stringify(cct->_conf->rbd_blacklist_expire_seconds) + ".0";
+      }
+      cmd += "}";
+
+      librados::Rados rados(m_image_ctx.md_ctx);
+      bufferlist inbl;
+      r = rados.mon_command(cmd, inbl, NULL, NULL);
+      if (r < 0) {
+	lderr(cct) << "error blacklisting lock owner: " << cpp_strerror(r)
+		   << dendl;
+	return r;
+      }
+    }
+
+    r = rados::cls::lock::break_lock(&m_image_ctx.md_ctx,
+				     m_image_ctx.header_oid, RBD_LOCK_NAME,
+				     locker.cookie, locker.locker);
+    if (r < 0 && r != -ENOENT) {
+      lderr(cct) << "error breaking lock: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    return 0;
+  }
+
+  int ExclusiveLock::release_lock()
+  {
+    assert(m_image_ctx.owner_lock.is_wlocked());
+    if (!m_lock_owner)
+      return 0;
+
+    CephContext *cct = m_image_ctx.cct;
+    ldout(cct, 10) << "releasing exclusive lock" << dendl;
+
+    // nothing may reach the OSDs once another client owns the image,
+    // including what's only in the persistent cache
+    int r = writeback_persistent_cache(&m_image_ctx);
+    if (r < 0) {
+      lderr(cct) << "error writing back before releasing lock: "
+		 << cpp_strerror(r) << dendl;
+    }
+    r = _flush(&m_image_ctx);
+    if (r < 0) {
+      lderr(cct) << "error flushing before releasing lock: "
+		 << cpp_strerror(r) << dendl;
+    }
+
+    m_lock_owner = false;
+    r = rados::cls::lock::unlock(&m_image_ctx.md_ctx, m_image_ctx.header_oid,
+				 RBD_LOCK_NAME,
+				 encode_lock_cookie(get_watch_handle()));
+    if (r < 0 && r != -ENOENT) {
+      lderr(cct) << "error releasing lock: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    notify(NOTIFY_OP_RELEASED_LOCK);
+    return 0;
+  }
+
+  void ExclusiveLock::C_ReleaseLock::finish(int r)
+  {
+    RWLock::WLocker l(m_exclusive_lock->m_image_ctx.owner_lock);
+    m_exclusive_lock->release_lock();
+  }
+
+  void ExclusiveLock::encode_notify(uint8_t op, uint64_t client_id,
+				    uint64_t watch_handle, bufferlist &bl)
+  {
+    ENCODE_START(1, 1, bl);
+    ::encode(op, bl);
+    ::encode(client_id, bl);
+    ::encode(watch_handle, bl);
+    ENCODE_FINISH(bl);
+  }
+
+  void ExclusiveLock::handle_notify(bufferlist::iterator &iter)
+  {
+    uint8_t op;
+    uint64_t client_id;
+    uint64_t watch_handle;
+    try {
+      DECODE_START(1, iter);
+      ::decode(op, iter);
+      ::decode(client_id, iter);
+      ::decode(watch_handle, iter);
+      DECODE_FINISH(iter);
+    } catch (const buffer::error &err) {
+      lderr(m_image_ctx.cct) << "error decoding notification: " << err.what()
+			     << dendl;
+      return;
+    }
+
+    switch (op) {
+    case NOTIFY_OP_REQUEST_LOCK:
+      if (client_id == m_client_id && watch_handle == get_watch_handle())
+	break;
+      ldout(m_image_ctx.cct, 10) << "exclusive lock requested by client."
+				 << client_id << dendl;
+      // releasing flushes I/O, which can't wait on the notify callback
+      m_finisher.queue(new C_ReleaseLock(this));
+      break;
+    case NOTIFY_OP_RELEASED_LOCK:
+      {
+	Mutex::Locker l(m_lock);
+	++m_released_seq;
+	m_cond.Signal();
+      }
+      break;
+    default:
+      ldout(m_image_ctx.cct, 10) << "ignoring unknown lock notification "
+				 << (int)op << dendl;
+      break;
+    }
+  }
+
+  void ExclusiveLock::notify(uint8_t op)
+  {
+    bufferlist bl;
+    encode_notify(op, m_client_id, get_watch_handle(), bl);
+    int r = m_image_ctx.md_ctx.notify(m_image_ctx.header_oid, 0, bl);
+    if (r < 0) {
+      lderr(m_image_ctx.cct) << "error sending lock notification: "
+			     << cpp_strerror(r) << dendl;
+    }
+  }
+
+}
@@ -0,0 +1,89 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_EXCLUSIVELOCK_H
+#define CEPH_LIBRBD_EXCLUSIVELOCK_H
+
+#include "include/int_types.h"
+
+#include <string>
+
+#include "common/Cond.h"
+#include "common/Finisher.h"
+#include "common/Mutex.h"
+#include "include/buffer.h"
+#include "include/Context.h"
+
+namespace librbd {
+
+  struct ImageCtx;
+
+  /**
+   * Automatic ownership of an image with the exclusive lock feature.
+   *
+   * The first update a client makes takes the exclusive lock on the
+   * image header.  A client that needs the lock while another one
+   * holds it asks the owner to release it over watch/notify; the
+   * owner flushes its in-flight writes, unlocks and announces the
+   * release.  An owner that doesn't answer and whose watch on the
+   * header has gone away is assumed dead: it's blacklisted, so it
+   * can't write again if it was only partitioned, and its lock is
+   * broken.
+   *
+   * Ownership is protected by ImageCtx::owner_lock.
+   */
+  class ExclusiveLock {
+  public:
+    enum {
+      NOTIFY_OP_REQUEST_LOCK  = 1,
+      NOTIFY_OP_RELEASED_LOCK = 2
+    };
+
+    ExclusiveLock(ImageCtx &image_ctx);
+    ~ExclusiveLock();
+
+    /// owner_lock must be held
+    bool is_lock_owner() const;
+    /**
+     * Take the lock, asking the owner to release it (owner_lock
+     * write-held).  A fresh acquisition marks the image for a refresh.
+     */
+    int request_lock();
+    /// flush in-flight writes and release the lock (owner_lock write-held)
+    int release_lock();
+
+    /// handle a lock notification sent to the image header
+    void handle_notify(ceph::bufferlist::iterator &iter);
+    static void encode_notify(uint8_t op, uint64_t client_id,
+			      uint64_t watch_handle, ceph::bufferlist &bl);
+
+  private:
+    class C_ReleaseLock : public Context {
+    public:
+      C_ReleaseLock(ExclusiveLock *exclusive_lock)
+	: m_exclusive_lock(exclusive_lock) {}
+      virtual void finish(int r);
+    private:
+      ExclusiveLock *m_exclusive_lock;
+    };
+
+    ImageCtx &m_image_ctx;
+    bool m_lock_owner;
+    uint64_t m_client_id;
+
+    Mutex m_lock; // protects m_released_seq
+    Cond m_cond;
+    uint64_t m_released_seq;
+
+    /// runs releases requested by peers outside the notify callback
+    Finisher m_finisher;
+
+    uint64_t get_watch_handle() const;
+    std::string encode_lock_cookie(uint64_t watch_handle) const;
+    int try_lock();
+    int break_lock_if_dead();
+    void notify(uint8_t op);
+  };
+
+}
+
+#endif
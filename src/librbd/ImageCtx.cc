@@ -40,10 +40,12 @@ namespace librbd {
       wctx(NULL),
       refresh_seq(0),
       last_refresh(0),
+      owner_lock("librbd::ImageCtx::owner_lock"),
       md_lock("librbd::ImageCtx::md_lock"),
       cache_lock("librbd::ImageCtx::cache_lock"),
       snap_lock("librbd::ImageCtx::snap_lock"),
       parent_lock("librbd::ImageCtx::parent_lock"),
+      object_map_lock("librbd::ImageCtx::object_map_lock"),
       refresh_lock("librbd::ImageCtx::refresh_lock"),
       extra_read_flags(0),
       old_format(true),
@@ -53,7 +55,9 @@ namespace librbd {
       stripe_unit(0), stripe_count(0),
       object_cacher(NULL), writeback_handler(NULL), object_set(NULL),
       readahead(),
-      total_bytes_read(0)
+      total_bytes_read(0),
+      object_map(*this), exclusive_lock(NULL),
+      persistent_cache(NULL), parent_cache(NULL), copy_on_read(NULL)
   {
     md_ctx.dup(p);
     data_ctx.dup(p);
@@ -94,6 +98,9 @@ namespace librbd {
 				       cct->_conf->rbd_cache_target_dirty,
 				       cct->_conf->rbd_cache_max_dirty_age,
 				       cct->_conf->rbd_cache_block_writes_upfront);
+      // librbd read callbacks never need cache_lock
+      object_cacher->set_unlocked_read_completions(true);
+      object_cacher->set_policy(cct->_conf->rbd_cache_policy);
       object_set = new ObjectCacher::ObjectSet(NULL, data_ctx.get_id(), 0);
       object_set->return_enoent = true;
       object_cacher->start();
@@ -480,9 +487,13 @@ namespace librbd {
     extent.oloc.pool = data_ctx.get_id();
     extent.buffer_extents.push_back(make_pair(0, len));
     rd->extents.push_back(extent);
-    cache_lock.Lock();
-    int r = object_cacher->readx(rd, object_set, onfinish);
-    cache_lock.Unlock();
+    // hits don't need cache_lock, so they don't wait on each other
+    int r = object_cacher->readx_hit(rd, object_set);
+    if (r == -EAGAIN) {
+      cache_lock.Lock();
+      r = object_cacher->readx(rd, object_set, onfinish);
+      cache_lock.Unlock();
+    }
     if (r != 0)
       onfinish->complete(r);
   }
@@ -521,7 +532,9 @@ namespace librbd {
   }
 
   void ImageCtx::user_flushed() {
-    if (object_cacher && cct->_conf->rbd_cache_writethrough_until_flush) {
+    // with a persistent cache, the ObjectCacher stays writethrough
+    if (object_cacher && !persistent_cache &&
+	cct->_conf->rbd_cache_writethrough_until_flush) {
       md_lock.get_read();
       bool flushed_before = flush_encountered;
       md_lock.put_read();
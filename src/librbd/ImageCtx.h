@@ -22,6 +22,7 @@
 
 #include "cls/rbd/cls_rbd_client.h"
 #include "librbd/LibrbdWriteback.h"
+#include "librbd/ObjectMap.h"
 #include "librbd/SnapInfo.h"
 #include "librbd/parent_types.h"
 
@@ -30,6 +31,10 @@ class PerfCounters;
 
 namespace librbd {
 
+  class CopyOnRead;
+  class ExclusiveLock;
+  class ParentCache;
+  class PersistentCache;
   class WatchCtx;
 
   struct ImageCtx {
@@ -61,14 +66,17 @@ namespace librbd {
 
     /**
      * Lock ordering:
-     * md_lock, cache_lock, snap_lock, parent_lock, refresh_lock
+     * owner_lock, md_lock, cache_lock, snap_lock, parent_lock,
+     * object_map_lock, refresh_lock
      */
+    RWLock owner_lock; // protects exclusive lock ownership
     RWLock md_lock; // protects access to the mutable image metadata that
                    // isn't guarded by other locks below
                    // (size, features, image locks, etc)
     Mutex cache_lock; // used as client_lock for the ObjectCacher
     RWLock snap_lock; // protects snapshot-related member variables:
     RWLock parent_lock; // protects parent_md and parent
+    RWLock object_map_lock; // protects the in-memory object map
     Mutex refresh_lock; // protects refresh_seq and last_refresh
 
     unsigned extra_read_flags;
@@ -94,6 +102,12 @@ namespace librbd {
     Readahead readahead;
     uint64_t total_bytes_read;
 
+    ObjectMap object_map;
+    ExclusiveLock *exclusive_lock; // NULL without the exclusive lock feature
+    PersistentCache *persistent_cache; // NULL unless configured
+    ParentCache *parent_cache; // shared; NULL unless a parent and configured
+    CopyOnRead *copy_on_read; // NULL unless a writable clone and configured
+
     /**
      * Either image_name or image_id must be set.
      * If id is not known, pass the empty std::string,
@@ -138,6 +138,19 @@ namespace librbd {
 			       const bufferlist &bl, utime_t mtime,
 			       uint64_t trunc_size, __u32 trunc_seq,
 			       Context *oncommit)
+  {
+    vector<pair<uint64_t, bufferlist> > io_vec;
+    io_vec.push_back(make_pair(off, bl));
+    return write(oid, oloc, io_vec, snapc, mtime, trunc_size, trunc_seq,
+		 oncommit);
+  }
+
+  ceph_tid_t LibrbdWriteback::write(const object_t& oid,
+			       const object_locator_t& oloc,
+			       vector<pair<uint64_t, bufferlist> >& io_vec,
+			       const SnapContext& snapc, utime_t mtime,
+			       uint64_t trunc_size, __u32 trunc_seq,
+			       Context *oncommit)
   {
     m_ictx->snap_lock.get_read();
     librados::snap_t snap_id = m_ictx->snap_id;
@@ -160,9 +173,8 @@ namespace librbd {
     ldout(m_ictx->cct, 20) << "write will wait for result " << result << dendl;
     C_OrderedWrite *req_comp = new C_OrderedWrite(m_ictx->cct, result, this);
     AioWrite *req = new AioWrite(m_ictx, oid.name,
-				 object_no, off, objectx, object_overlap,
-				 bl, snapc, snap_id,
-				 req_comp);
+				 object_no, io_vec, objectx, object_overlap,
+				 snapc, snap_id, req_comp);
     req->send();
     return ++m_tid;
   }
@@ -22,6 +22,8 @@ namespace librbd {
     LibrbdWriteback(ImageCtx *ictx, Mutex& lock);
     virtual ~LibrbdWriteback() {}
 
+    using WritebackHandler::write;
+
     // Note that oloc, trunc_size, and trunc_seq are ignored
     virtual void read(const object_t& oid, const object_locator_t& oloc,
 		      uint64_t off, uint64_t len, snapid_t snapid,
@@ -37,6 +39,13 @@ namespace librbd {
 			const bufferlist &bl, utime_t mtime, uint64_t trunc_size,
 			__u32 trunc_seq, Context *oncommit);
 
+    virtual bool can_scattered_write() { return true; }
+    virtual ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+			vector<pair<uint64_t, bufferlist> >& io_vec,
+			const SnapContext& snapc, utime_t mtime,
+			uint64_t trunc_size, __u32 trunc_seq,
+			Context *oncommit);
+
     struct write_result_d {
       bool done;
       int ret;
@@ -0,0 +1,563 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <algorithm>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "include/rbd/object_map_types.h"
+#include "include/stringify.h"
+#include "osdc/Striper.h"
+
+#include "cls/rbd/cls_rbd_client.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/internal.h"
+
+#include "librbd/ObjectMap.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::ObjectMap: "
+
+using ceph::BitVector;
+
+namespace librbd {
+
+  ObjectMap::ObjectMap(ImageCtx &image_ctx)
+    : m_image_ctx(image_ctx), m_enabled(false)
+  {
+  }
+
+  std::string ObjectMap::object_map_name(const std::string &image_id,
+					 uint64_t snap_id)
+  {
+    std::string oid(RBD_OBJECT_MAP_PREFIX + image_id);
+    if (snap_id != CEPH_NOSNAP) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), ".%016llx", (unsigned long long)snap_id);
+      oid += buf;
+    }
+    return oid;
+  }
+
+  bool ObjectMap::enabled() const
+  {
+    RWLock::RLocker l(m_image_ctx.object_map_lock);
+    return m_enabled;
+  }
+
+  uint8_t ObjectMap::get_state(uint64_t object_no) const
+  {
+    RWLock::RLocker l(m_image_ctx.object_map_lock);
+    if (!m_enabled || object_no >= m_object_map.size())
+      return OBJECT_EXISTS;
+    return m_object_map[object_no];
+  }
+
+  bool ObjectMap::object_may_exist(uint64_t object_no) const
+  {
+    RWLock::RLocker l(m_image_ctx.object_map_lock);
+    if (!m_enabled || object_no >= m_object_map.size() ||
+	m_in_flight.count(object_no))
+      return true;
+    bool exists = m_object_map[object_no] != OBJECT_NONEXISTENT;
+    ldout(m_image_ctx.cct, 20) << "object_may_exist " << object_no << " = "
+			       << exists << dendl;
+    return exists;
+  }
+
+  bool ObjectMap::head_enabled() const
+  {
+    return (m_image_ctx.features & RBD_FEATURE_OBJECT_MAP) != 0;
+  }
+
+  int ObjectMap::refresh()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    while (true) {
+      uint64_t snap_id;
+      uint64_t features;
+      uint64_t size;
+      {
+	RWLock::RLocker l(m_image_ctx.snap_lock);
+	snap_id = m_image_ctx.snap_id;
+	if (m_image_ctx.get_features(snap_id, &features) < 0)
+	  features = 0;
+	size = m_image_ctx.size;
+      }
+
+      // load without holding any image locks, then swap it in
+      BitVector<2> object_map;
+      int r = 0;
+      if ((features & RBD_FEATURE_OBJECT_MAP) != 0) {
+	std::string oid(object_map_name(m_image_ctx.id, snap_id));
+	ldout(cct, 10) << "refreshing object map " << oid << dendl;
+	r = cls_client::object_map_load(&m_image_ctx.md_ctx, oid, &object_map);
+	if (r == -ENOENT && snap_id == CEPH_NOSNAP && !m_image_ctx.read_only) {
+	  // rebuild a lost head map conservatively: every object may exist
+	  uint64_t object_count = Striper::get_num_objects(m_image_ctx.layout,
+							   size);
+	  lderr(cct) << "object map " << oid << " missing, recreating it with "
+		     << object_count << " objects" << dendl;
+	  librados::ObjectWriteOperation op;
+	  cls_client::object_map_resize(&op, object_count, OBJECT_EXISTS);
+	  r = m_image_ctx.md_ctx.operate(oid, &op);
+	  if (r == 0)
+	    r = cls_client::object_map_load(&m_image_ctx.md_ctx, oid,
+					    &object_map);
+	}
+	if (r < 0) {
+	  lderr(cct) << "error loading object map " << oid << ": "
+		     << cpp_strerror(r) << dendl;
+	  object_map.clear();
+	}
+      }
+
+      RWLock::RLocker l(m_image_ctx.snap_lock);
+      if (m_image_ctx.snap_id != snap_id) {
+	ldout(cct, 10) << "snapshot changed while loading object map, retrying"
+		       << dendl;
+	continue;
+      }
+      RWLock::WLocker l2(m_image_ctx.object_map_lock);
+      m_enabled = (features & RBD_FEATURE_OBJECT_MAP) != 0 && r == 0;
+      m_object_map.swap(object_map);
+      // a head map we can't keep in sync must not be trusted later;
+      // snapshots and read-only opens just fall back to reading
+      // every object
+      if (r < 0 && snap_id == CEPH_NOSNAP && !m_image_ctx.read_only)
+	return r;
+      return 0;
+    }
+  }
+
+  int ObjectMap::create(librados::IoCtx &io_ctx, const std::string &image_id,
+			uint64_t object_count)
+  {
+    librados::ObjectWriteOperation op;
+    op.create(true);
+    cls_client::object_map_resize(&op, object_count, OBJECT_NONEXISTENT);
+    return io_ctx.operate(object_map_name(image_id, CEPH_NOSNAP), &op);
+  }
+
+  int ObjectMap::load(uint64_t snap_id, BitVector<2> *object_map) const
+  {
+    uint64_t features;
+    {
+      RWLock::RLocker l(m_image_ctx.snap_lock);
+      int r = m_image_ctx.get_features(snap_id, &features);
+      if (r < 0)
+	return r;
+    }
+    if ((features & RBD_FEATURE_OBJECT_MAP) == 0)
+      return -EINVAL;
+    return cls_client::object_map_load(&m_image_ctx.md_ctx,
+				       object_map_name(m_image_ctx.id, snap_id),
+				       object_map);
+  }
+
+  int ObjectMap::resize(uint64_t size, uint8_t default_state)
+  {
+    if (!head_enabled())
+      return 0;
+
+    CephContext *cct = m_image_ctx.cct;
+    uint64_t object_count = Striper::get_num_objects(m_image_ctx.layout, size);
+    ldout(cct, 10) << "resizing object map to " << object_count
+		   << " objects" << dendl;
+
+    librados::ObjectWriteOperation op;
+    cls_client::object_map_resize(&op, object_count, default_state);
+    int r = m_image_ctx.md_ctx.operate(
+      object_map_name(m_image_ctx.id, CEPH_NOSNAP), &op);
+    if (r < 0) {
+      lderr(cct) << "error resizing object map: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    if (m_enabled) {
+      uint64_t orig_object_count = m_object_map.size();
+      m_object_map.resize(object_count);
+      for (uint64_t i = orig_object_count; i < object_count; ++i)
+	m_object_map[i] = default_state;
+    }
+    return 0;
+  }
+
+  void ObjectMap::apply_update(uint64_t start_object_no,
+			       uint64_t end_object_no, uint8_t new_state,
+			       const boost::optional<uint8_t> &current_state)
+  {
+    assert(m_image_ctx.object_map_lock.is_wlocked());
+    if (!m_enabled)
+      return;
+    end_object_no = MIN(end_object_no, m_object_map.size());
+    for (uint64_t i = start_object_no; i < end_object_no; ++i) {
+      if (!current_state || m_object_map[i] == *current_state)
+	m_object_map[i] = new_state;
+    }
+  }
+
+  int ObjectMap::update(uint64_t start_object_no, uint64_t end_object_no,
+			uint8_t new_state,
+			const boost::optional<uint8_t> &current_state)
+  {
+    if (!head_enabled() || start_object_no >= end_object_no)
+      return 0;
+
+    CephContext *cct = m_image_ctx.cct;
+    ldout(cct, 20) << "update " << start_object_no << "~"
+		   << (end_object_no - start_object_no) << " -> "
+		   << (int)new_state << dendl;
+
+    librados::ObjectWriteOperation op;
+    cls_client::object_map_update(&op, start_object_no, end_object_no,
+				  new_state, current_state);
+    int r = m_image_ctx.md_ctx.operate(
+      object_map_name(m_image_ctx.id, CEPH_NOSNAP), &op);
+    if (r < 0) {
+      lderr(cct) << "error updating object map: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    apply_update(start_object_no, end_object_no, new_state, current_state);
+    return 0;
+  }
+
+  bool ObjectMap::aio_update(uint64_t object_no, uint8_t new_state,
+			     const boost::optional<uint8_t> &current_state,
+			     Context *on_finish)
+  {
+    if (!head_enabled())
+      return false;
+
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    // objects past the end of the map are always treated as existing
+    if (!m_enabled || object_no >= m_object_map.size())
+      return false;
+    if (m_in_flight.count(object_no) == 0) {
+      uint8_t state = m_object_map[object_no];
+      if (state == new_state || (current_state && state != *current_state))
+	return false;
+    }
+
+    ldout(m_image_ctx.cct, 20) << "aio_update " << object_no << " -> "
+			       << (int)new_state << dendl;
+    ++m_in_flight[object_no];
+
+    librados::ObjectWriteOperation op;
+    cls_client::object_map_update(&op, object_no, object_no + 1, new_state,
+				  current_state);
+    Context *ctx = new C_Update(this, object_no, new_state, current_state,
+				on_finish);
+    librados::AioCompletion *rados_completion =
+      librados::Rados::aio_create_completion(ctx, NULL, rados_ctx_cb);
+    int r = m_image_ctx.md_ctx.aio_operate(
+      object_map_name(m_image_ctx.id, CEPH_NOSNAP), rados_completion, &op);
+    assert(r == 0);
+    rados_completion->release();
+    return true;
+  }
+
+  void ObjectMap::C_Update::finish(int r)
+  {
+    {
+      RWLock::WLocker l(m_object_map->m_image_ctx.object_map_lock);
+      if (r == 0)
+	m_object_map->apply_update(m_object_no, m_object_no + 1, m_new_state,
+				   m_current_state);
+      std::map<uint64_t, uint32_t>::iterator it =
+	m_object_map->m_in_flight.find(m_object_no);
+      assert(it != m_object_map->m_in_flight.end());
+      if (--it->second == 0)
+	m_object_map->m_in_flight.erase(it);
+    }
+    if (r < 0) {
+      lderr(m_object_map->m_image_ctx.cct) << "error updating object map: "
+					   << cpp_strerror(r) << dendl;
+    }
+    m_on_finish->complete(r);
+  }
+
+  int ObjectMap::snapshot(uint64_t snap_id)
+  {
+    if (!head_enabled())
+      return 0;
+
+    // block local writes from marking objects dirty between the copy
+    // and the cleaning below, or their changes would be lost to diffs
+    // against the new snapshot
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    CephContext *cct = m_image_ctx.cct;
+    std::string oid(object_map_name(m_image_ctx.id, CEPH_NOSNAP));
+    BitVector<2> object_map;
+    int r = cls_client::object_map_load(&m_image_ctx.md_ctx, oid, &object_map);
+    if (r < 0) {
+      lderr(cct) << "error reading object map: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    bufferlist bl;
+    ::encode(object_map, bl);
+    r = m_image_ctx.md_ctx.write_full(object_map_name(m_image_ctx.id, snap_id),
+				      bl);
+    if (r < 0) {
+      lderr(cct) << "error writing snapshot object map: " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    // the head starts a new interval with every object clean
+    if (object_map.size() > 0) {
+      librados::ObjectWriteOperation op;
+      cls_client::object_map_update(&op, 0, object_map.size(),
+				    OBJECT_EXISTS_CLEAN, OBJECT_EXISTS);
+      r = m_image_ctx.md_ctx.operate(oid, &op);
+      if (r < 0) {
+	// harmless: the objects just stay flagged as changed
+	lderr(cct) << "error cleaning object map: " << cpp_strerror(r)
+		   << dendl;
+	return 0;
+      }
+      apply_update(0, object_map.size(), OBJECT_EXISTS_CLEAN, OBJECT_EXISTS);
+    }
+    return 0;
+  }
+
+  int ObjectMap::diff(uint64_t from_snap_id, uint64_t end_snap_id,
+		      std::vector<bool> *changed) const
+  {
+    std::vector<uint64_t> snap_ids;
+    if (from_snap_id != 0) {
+      RWLock::RLocker l(m_image_ctx.snap_lock);
+      for (std::vector<librados::snap_t>::const_iterator it =
+	     m_image_ctx.snaps.begin();
+	   it != m_image_ctx.snaps.end(); ++it) {
+	if (*it > from_snap_id && *it < end_snap_id)
+	  snap_ids.push_back(*it);
+      }
+      std::sort(snap_ids.begin(), snap_ids.end());
+    }
+    snap_ids.push_back(end_snap_id);
+
+    // from the beginning of time only existence at the end matters
+    BitVector<2> prev;
+    int r;
+    if (from_snap_id != 0) {
+      r = load(from_snap_id, &prev);
+      if (r < 0)
+	return r;
+    }
+
+    changed->clear();
+    for (std::vector<uint64_t>::iterator it = snap_ids.begin();
+	 it != snap_ids.end(); ++it) {
+      BitVector<2> cur;
+      r = load(*it, &cur);
+      if (r < 0)
+	return r;
+
+      // objects past the end of a map are past the end of the image
+      uint64_t object_count = MAX(prev.size(), cur.size());
+      if (changed->size() < object_count)
+	changed->resize(object_count, false);
+      for (uint64_t i = 0; i < object_count; ++i) {
+	uint8_t cur_state = i < cur.size() ? cur[i] : OBJECT_NONEXISTENT;
+	uint8_t prev_state = i < prev.size() ? prev[i] : OBJECT_NONEXISTENT;
+	if (cur_state == OBJECT_EXISTS || cur_state == OBJECT_PENDING ||
+	    ((cur_state == OBJECT_NONEXISTENT) !=
+	     (prev_state == OBJECT_NONEXISTENT)))
+	  (*changed)[i] = true;
+      }
+      prev = cur;
+    }
+    ldout(m_image_ctx.cct, 10) << "diff " << from_snap_id << ".."
+			       << end_snap_id << " walked "
+			       << snap_ids.size() << " object maps" << dendl;
+    return 0;
+  }
+
+  int ObjectMap::rollback(uint64_t snap_id)
+  {
+    if (!head_enabled())
+      return 0;
+
+    CephContext *cct = m_image_ctx.cct;
+    std::string oid(object_map_name(m_image_ctx.id, CEPH_NOSNAP));
+    BitVector<2> object_map;
+    int r = cls_client::object_map_load(
+      &m_image_ctx.md_ctx, object_map_name(m_image_ctx.id, snap_id),
+      &object_map);
+    if (r == 0) {
+      bufferlist bl;
+      ::encode(object_map, bl);
+      r = m_image_ctx.md_ctx.write_full(oid, bl);
+      if (r == 0 && object_map.size() > 0) {
+	// everything since the newest snapshot may have changed, so
+	// no object can stay clean
+	librados::ObjectWriteOperation op;
+	cls_client::object_map_update(&op, 0, object_map.size(),
+				      OBJECT_EXISTS, OBJECT_EXISTS_CLEAN);
+	r = m_image_ctx.md_ctx.operate(oid, &op);
+      }
+    } else {
+      lderr(cct) << "error reading snapshot object map: " << cpp_strerror(r)
+		 << dendl;
+      // rolled back objects are unknown: assume they all exist
+      librados::ObjectWriteOperation op;
+      uint64_t object_count = Striper::get_num_objects(m_image_ctx.layout,
+						       m_image_ctx.size);
+      cls_client::object_map_resize(&op, object_count, OBJECT_EXISTS);
+      if (object_count > 0)
+	cls_client::object_map_update(&op, 0, object_count, OBJECT_EXISTS,
+				      boost::optional<uint8_t>());
+      r = m_image_ctx.md_ctx.operate(oid, &op);
+    }
+    if (r < 0) {
+      lderr(cct) << "error rolling back object map: " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    if (m_enabled) {
+      r = cls_client::object_map_load(&m_image_ctx.md_ctx, oid, &m_object_map);
+      if (r < 0) {
+	lderr(cct) << "error reloading object map: " << cpp_strerror(r)
+		   << dendl;
+	m_enabled = false;
+	m_object_map.clear();
+      }
+    }
+    return r;
+  }
+
+  int ObjectMap::snapshot_remove(uint64_t snap_id)
+  {
+    if (!head_enabled())
+      return 0;
+
+    CephContext *cct = m_image_ctx.cct;
+    uint64_t next_snap_id = CEPH_NOSNAP;
+    {
+      RWLock::RLocker l(m_image_ctx.snap_lock);
+      for (std::vector<librados::snap_t>::const_iterator it =
+	     m_image_ctx.snaps.begin();
+	   it != m_image_ctx.snaps.end(); ++it) {
+	if (*it > snap_id && *it < next_snap_id)
+	  next_snap_id = *it;
+      }
+    }
+
+    // the next newer snapshot (or the head) now covers the removed
+    // snapshot's interval too, so it inherits its changed objects
+    BitVector<2> removed;
+    int r = load(snap_id, &removed);
+    bool all_changed = false;
+    if (r < 0) {
+      lderr(cct) << "error reading snapshot object map, treating every "
+		 << "object as changed: " << cpp_strerror(r) << dendl;
+      all_changed = true;
+    }
+    r = merge_changed(next_snap_id, removed, all_changed);
+    if (r < 0) {
+      lderr(cct) << "error merging snapshot object map: " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    r = m_image_ctx.md_ctx.remove(object_map_name(m_image_ctx.id,
+						  snap_id));
+    if (r < 0 && r != -ENOENT) {
+      lderr(m_image_ctx.cct) << "error removing snapshot object map: "
+			     << cpp_strerror(r) << dendl;
+      return r;
+    }
+    return 0;
+  }
+
+  int ObjectMap::merge_changed(uint64_t snap_id,
+			       const BitVector<2> &changed, bool all_changed)
+  {
+    CephContext *cct = m_image_ctx.cct;
+    std::string oid(object_map_name(m_image_ctx.id, snap_id));
+    ldout(cct, 10) << "merging changed objects into " << oid << dendl;
+
+    if (snap_id != CEPH_NOSNAP) {
+      // nothing writes snapshot maps, so rewrite the whole map
+      BitVector<2> object_map;
+      int r = load(snap_id, &object_map);
+      if (r == -EINVAL)
+	return 0;	// predates the object map: diffs scan the objects
+      if (r < 0)
+	return r;
+      for (uint64_t i = 0; i < object_map.size(); ++i) {
+	if (object_map[i] == OBJECT_EXISTS_CLEAN &&
+	    (all_changed ||
+	     (i < changed.size() && changed[i] != OBJECT_EXISTS_CLEAN &&
+	      changed[i] != OBJECT_NONEXISTENT)))
+	  object_map[i] = OBJECT_EXISTS;
+      }
+      bufferlist bl;
+      ::encode(object_map, bl);
+      return m_image_ctx.md_ctx.write_full(oid, bl);
+    }
+
+    // keep the head's size stable while its clean objects are dirtied
+    RWLock::WLocker l(m_image_ctx.object_map_lock);
+    BitVector<2> object_map;
+    int r = cls_client::object_map_load(&m_image_ctx.md_ctx, oid, &object_map);
+    if (r < 0)
+      return r;
+
+    std::vector<std::pair<uint64_t, uint64_t> > runs;
+    for (uint64_t i = 0; i < object_map.size(); ++i) {
+      if (!all_changed &&
+	  (i >= changed.size() || changed[i] == OBJECT_EXISTS_CLEAN ||
+	   changed[i] == OBJECT_NONEXISTENT))
+	continue;
+      if (!runs.empty() && runs.back().second == i)
+	++runs.back().second;
+      else
+	runs.push_back(std::make_pair(i, i + 1));
+    }
+    if (runs.empty())
+      return 0;
+
+    librados::ObjectWriteOperation op;
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator it =
+	   runs.begin(); it != runs.end(); ++it)
+      cls_client::object_map_update(&op, it->first, it->second, OBJECT_EXISTS,
+				    OBJECT_EXISTS_CLEAN);
+    r = m_image_ctx.md_ctx.operate(oid, &op);
+    if (r < 0)
+      return r;
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator it =
+	   runs.begin(); it != runs.end(); ++it)
+      apply_update(it->first, it->second, OBJECT_EXISTS, OBJECT_EXISTS_CLEAN);
+    return 0;
+  }
+
+  int ObjectMap::remove()
+  {
+    if (!head_enabled())
+      return 0;
+
+    {
+      RWLock::WLocker l(m_image_ctx.object_map_lock);
+      m_enabled = false;
+      m_object_map.clear();
+    }
+    int r = m_image_ctx.md_ctx.remove(object_map_name(m_image_ctx.id,
+						      CEPH_NOSNAP));
+    if (r < 0 && r != -ENOENT) {
+      lderr(m_image_ctx.cct) << "error removing object map: "
+			     << cpp_strerror(r) << dendl;
+      return r;
+    }
+    return 0;
+  }
+}
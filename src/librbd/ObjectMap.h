@@ -0,0 +1,126 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_OBJECTMAP_H
+#define CEPH_LIBRBD_OBJECTMAP_H
+
+#include "include/int_types.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "common/bit_vector.hpp"
+#include "include/Context.h"
+#include "include/rados/librados.hpp"
+
+namespace librbd {
+
+  struct ImageCtx;
+
+  /**
+   * In-memory copy of the object map of the image (or snapshot) an
+   * ImageCtx has open.  The map records which data objects exist, so
+   * reads, diffs and management operations can skip objects that
+   * were never written.  Updates are applied by the rbd class on the
+   * OSD and mirrored here once they commit.
+   *
+   * All methods take ImageCtx::object_map_lock themselves.
+   */
+  class ObjectMap {
+  public:
+    ObjectMap(ImageCtx &image_ctx);
+
+    static std::string object_map_name(const std::string &image_id,
+				       uint64_t snap_id);
+
+    bool enabled() const;
+    uint8_t get_state(uint64_t object_no) const;
+    /// false only if the object is known not to exist
+    bool object_may_exist(uint64_t object_no) const;
+
+    /// reload the map for the current snapshot (snap_lock not held)
+    int refresh();
+
+    /// create the head object map of a new image
+    static int create(librados::IoCtx &io_ctx, const std::string &image_id,
+		      uint64_t object_count);
+    /// load the map of a snapshot (or the head) of this image
+    int load(uint64_t snap_id, ceph::BitVector<2> *object_map) const;
+
+    /// resize the head map to cover an image of the given size
+    int resize(uint64_t size, uint8_t default_state);
+    /// update objects [start_object_no, end_object_no) of the head map
+    int update(uint64_t start_object_no, uint64_t end_object_no,
+	       uint8_t new_state,
+	       const boost::optional<uint8_t> &current_state);
+    /**
+     * Asynchronously update one object of the head map.
+     *
+     * @returns false (and leaves on_finish untouched) if the map
+     * already reflects the update and no other update of the object
+     * is in flight
+     */
+    bool aio_update(uint64_t object_no, uint8_t new_state,
+		    const boost::optional<uint8_t> &current_state,
+		    Context *on_finish);
+
+    /// copy the head map for a new snapshot and mark the head clean
+    int snapshot(uint64_t snap_id);
+    /**
+     * Find the objects that may differ between two snapshots (0 for
+     * the beginning of time, CEPH_NOSNAP for the head) from the object
+     * maps of every snapshot in between, without touching the objects.
+     *
+     * @param changed set for each object that may have changed
+     */
+    int diff(uint64_t from_snap_id, uint64_t end_snap_id,
+	     std::vector<bool> *changed) const;
+    /// replace the head map with a snapshot's after a rollback
+    int rollback(uint64_t snap_id);
+    /**
+     * Remove a snapshot's map, first marking the objects it recorded
+     * as changed in the map of the next newer snapshot (or the head),
+     * whose interval now starts where the removed snapshot's did.
+     */
+    int snapshot_remove(uint64_t snap_id);
+    /// remove the head map of an image being deleted
+    int remove();
+
+  private:
+    class C_Update : public Context {
+    public:
+      C_Update(ObjectMap *object_map, uint64_t object_no, uint8_t new_state,
+	       const boost::optional<uint8_t> &current_state,
+	       Context *on_finish)
+	: m_object_map(object_map), m_object_no(object_no),
+	  m_new_state(new_state), m_current_state(current_state),
+	  m_on_finish(on_finish) {}
+      virtual void finish(int r);
+    private:
+      ObjectMap *m_object_map;
+      uint64_t m_object_no;
+      uint8_t m_new_state;
+      boost::optional<uint8_t> m_current_state;
+      Context *m_on_finish;
+    };
+
+    ImageCtx &m_image_ctx;
+    bool m_enabled;
+    ceph::BitVector<2> m_object_map;
+    /// objects with updates sent but not yet committed
+    std::map<uint64_t, uint32_t> m_in_flight;
+
+    bool head_enabled() const;
+    /// mark the clean objects of a map as changed where changed says so
+    int merge_changed(uint64_t snap_id, const ceph::BitVector<2> &changed,
+		      bool all_changed);
+    void apply_update(uint64_t start_object_no, uint64_t end_object_no,
+		      uint8_t new_state,
+		      const boost::optional<uint8_t> &current_state);
+  };
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <vector>
+
+#include "common/dout.h"
+#include "common/errno.h"
+
+#include "librbd/internal.h"
+
+#include "librbd/ParentCache.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::ParentCache: "
+
+namespace librbd {
+
+  const std::string ParentCache::name = "librbd::ParentCache";
+
+  bool ParentCache::Key::operator<(const Key &rhs) const
+  {
+    if (pool_id != rhs.pool_id)
+      return pool_id < rhs.pool_id;
+    if (image_id != rhs.image_id)
+      return image_id < rhs.image_id;
+    if (snap_id != rhs.snap_id)
+      return snap_id < rhs.snap_id;
+    return object_no < rhs.object_no;
+  }
+
+  ParentCache::ParentCache(CephContext *cct)
+    : m_cct(cct), m_max_bytes(cct->_conf->rbd_parent_cache_size),
+      m_lock("librbd::ParentCache::m_lock"), m_bytes(0)
+  {
+  }
+
+  ParentCache::~ParentCache()
+  {
+    for (std::map<Key, Entry*>::iterator it = m_entries.begin();
+	 it != m_entries.end(); ++it) {
+      assert(!it->second->fetching);
+      delete it->second;
+    }
+  }
+
+  void ParentCache::read(librados::IoCtx &ioctx, const std::string &image_id,
+			 const std::string &oid, uint64_t object_no,
+			 librados::snap_t snap_id, uint64_t object_size,
+			 int flags, uint64_t off, uint64_t len,
+			 bufferlist *pbl, Context *on_finish)
+  {
+    Key key;
+    key.pool_id = ioctx.get_id();
+    key.image_id = image_id;
+    key.snap_id = snap_id;
+    key.object_no = object_no;
+
+    Waiter waiter;
+    waiter.off = off;
+    waiter.len = len;
+    waiter.pbl = pbl;
+    waiter.on_finish = on_finish;
+
+    m_lock.Lock();
+    std::map<Key, Entry*>::iterator it = m_entries.find(key);
+    if (it != m_entries.end()) {
+      Entry *entry = it->second;
+      if (entry->fetching) {
+	ldout(m_cct, 20) << "waiting for fetch of " << oid << dendl;
+	entry->waiters.push_back(waiter);
+	m_lock.Unlock();
+	return;
+      }
+
+      ldout(m_cct, 20) << "hit " << oid << " " << off << "~" << len << dendl;
+      m_lru.splice(m_lru.begin(), m_lru, entry->lru_it);
+      int r = finish_read(entry, waiter);
+      m_lock.Unlock();
+      on_finish->complete(r);
+      return;
+    }
+
+    ldout(m_cct, 20) << "fetching " << oid << dendl;
+    Entry *entry = new Entry;
+    entry->key = key;
+    entry->fetching = true;
+    entry->r = 0;
+    entry->waiters.push_back(waiter);
+    entry->lru_it = m_lru.end();
+    m_entries[key] = entry;
+    m_lock.Unlock();
+
+    C_Fetch *ctx = new C_Fetch(this, entry);
+    librados::AioCompletion *rados_completion =
+      librados::Rados::aio_create_completion(ctx, rados_ctx_cb, NULL);
+    librados::ObjectReadOperation op;
+    op.read(0, object_size, &ctx->m_bl, NULL);
+    int r = ioctx.aio_operate(oid, rados_completion, &op, flags, NULL);
+    rados_completion->release();
+    assert(r == 0);
+  }
+
+  void ParentCache::complete_fetch(Entry *entry, int r, bufferlist &bl)
+  {
+    ldout(m_cct, 20) << "fetched object " << entry->key.object_no << " r = "
+		     << r << dendl;
+    if (r < 0 && r != -ENOENT) {
+      lderr(m_cct) << "error reading parent object "
+		   << entry->key.object_no << ": " << cpp_strerror(r) << dendl;
+    }
+
+    std::list<Waiter> waiters;
+    std::vector<int> results;
+    {
+      Mutex::Locker l(m_lock);
+      waiters.swap(entry->waiters);
+      entry->fetching = false;
+      entry->r = r < 0 ? r : 0;
+      entry->data.claim(bl);
+      for (std::list<Waiter>::iterator it = waiters.begin();
+	   it != waiters.end(); ++it) {
+	results.push_back(finish_read(entry, *it));
+      }
+
+      if (r < 0 && r != -ENOENT) {
+	// let the next reader try again
+	m_entries.erase(entry->key);
+	delete entry;
+      } else {
+	m_lru.push_front(entry);
+	entry->lru_it = m_lru.begin();
+	m_bytes += entry_bytes(entry);
+	trim();
+      }
+    }
+
+    std::vector<int>::iterator result = results.begin();
+    for (std::list<Waiter>::iterator it = waiters.begin();
+	 it != waiters.end(); ++it, ++result) {
+      it->on_finish->complete(*result);
+    }
+  }
+
+  void ParentCache::trim()
+  {
+    assert(m_lock.is_locked());
+    while (m_bytes > m_max_bytes && !m_lru.empty()) {
+      Entry *entry = m_lru.back();
+      m_lru.pop_back();
+      m_bytes -= entry_bytes(entry);
+      m_entries.erase(entry->key);
+      delete entry;
+    }
+  }
+
+  uint64_t ParentCache::entry_bytes(const Entry *entry)
+  {
+    // objects that don't exist take up room too
+    return sizeof(Entry) + entry->key.image_id.size() + entry->data.length();
+  }
+
+  int ParentCache::finish_read(const Entry *entry, const Waiter &waiter)
+  {
+    if (entry->r < 0)
+      return entry->r;
+    if (waiter.off >= entry->data.length())
+      return 0;
+
+    uint64_t len = MIN(waiter.len, entry->data.length() - waiter.off);
+    bufferlist bl;
+    bl.substr_of(entry->data, waiter.off, len);
+    waiter.pbl->claim_append(bl);
+    return len;
+  }
+
+}
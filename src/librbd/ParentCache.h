@@ -0,0 +1,105 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_PARENTCACHE_H
+#define CEPH_LIBRBD_PARENTCACHE_H
+
+#include "include/int_types.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "common/ceph_context.h"
+#include "common/Mutex.h"
+#include "include/buffer.h"
+#include "include/Context.h"
+#include "include/rados/librados.hpp"
+
+namespace librbd {
+
+  /**
+   * Read-only cache of parent snapshot objects, shared by every image
+   * opened through the same client.
+   *
+   * Clones of one base snapshot each open their own parent ImageCtx,
+   * so without this each of them reads the same parent objects from
+   * the OSDs.  Snapshot data never changes, so whole objects are
+   * cached by pool, image, snapshot and object number, and a miss
+   * that's already being fetched waits for that fetch instead of
+   * sending another read.  Objects that don't exist are cached too.
+   */
+  class ParentCache : public CephContext::AssociatedSingletonObject {
+  public:
+    static const std::string name;
+
+    ParentCache(CephContext *cct);
+    virtual ~ParentCache();
+
+    /**
+     * Read part of an object of a snapshot.
+     *
+     * on_finish gets the number of bytes read, which may be short at
+     * the end of the object, or -ENOENT if the object doesn't exist.
+     */
+    void read(librados::IoCtx &ioctx, const std::string &image_id,
+	      const std::string &oid, uint64_t object_no,
+	      librados::snap_t snap_id, uint64_t object_size, int flags,
+	      uint64_t off, uint64_t len, ceph::bufferlist *pbl,
+	      Context *on_finish);
+
+  private:
+    struct Key {
+      int64_t pool_id;
+      std::string image_id;
+      librados::snap_t snap_id;
+      uint64_t object_no;
+
+      bool operator<(const Key &rhs) const;
+    };
+
+    struct Waiter {
+      uint64_t off;
+      uint64_t len;
+      ceph::bufferlist *pbl;
+      Context *on_finish;
+    };
+
+    struct Entry {
+      Key key;
+      bool fetching;
+      int r;
+      ceph::bufferlist data;
+      std::list<Waiter> waiters;
+      std::list<Entry*>::iterator lru_it;
+    };
+
+    class C_Fetch : public Context {
+    public:
+      C_Fetch(ParentCache *cache, Entry *entry)
+	: m_cache(cache), m_entry(entry) {}
+      virtual void finish(int r) {
+	m_cache->complete_fetch(m_entry, r, m_bl);
+      }
+      ceph::bufferlist m_bl;
+    private:
+      ParentCache *m_cache;
+      Entry *m_entry;
+    };
+
+    CephContext *m_cct;
+    uint64_t m_max_bytes;
+
+    Mutex m_lock; // protects everything below
+    std::map<Key, Entry*> m_entries;
+    std::list<Entry*> m_lru;  ///< cached entries, most recently used first
+    uint64_t m_bytes;
+
+    void complete_fetch(Entry *entry, int r, ceph::bufferlist &bl);
+    void trim();
+    static uint64_t entry_bytes(const Entry *entry);
+    static int finish_read(const Entry *entry, const Waiter &waiter);
+  };
+
+}
+
+#endif
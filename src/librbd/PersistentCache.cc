@@ -0,0 +1,779 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "common/ceph_context.h"
+#include "common/dout.h"
+#include "common/errno.h"
+#include "common/safe_io.h"
+#include "include/compat.h"
+#include "include/encoding.h"
+#include "include/intarith.h"
+#include "include/stringify.h"
+
+#include "librbd/AioCompletion.h"
+#include "librbd/ImageCtx.h"
+#include "librbd/internal.h"
+
+#include "librbd/PersistentCache.h"
+
+#define dout_subsys ceph_subsys_rbd
+#undef dout_prefix
+#define dout_prefix *_dout << "librbd::PersistentCache: "
+
+namespace librbd {
+
+  static const std::string SUPERBLOCK_MAGIC("rbd persistent cache");
+
+  PersistentCache::PersistentCache(ImageCtx &image_ctx)
+    : m_image_ctx(image_ctx), m_fd(-1), m_ring_size(0),
+      m_lock("librbd::PersistentCache::m_lock"), m_generation(0),
+      m_head(0), m_head_seq(0), m_tail(0), m_tail_seq(0), m_used(0),
+      m_unsynced(0), m_error(0), m_in_flight(0), m_writeback_queued(false),
+      m_finisher(image_ctx.cct)
+  {
+    m_finisher.start();
+  }
+
+  PersistentCache::~PersistentCache()
+  {
+    m_finisher.wait_for_empty();
+    m_finisher.stop();
+    assert(m_fd < 0);
+    assert(m_in_flight == 0);
+    for (std::list<Entry*>::iterator it = m_entries.begin();
+	 it != m_entries.end(); ++it) {
+      delete *it;
+    }
+  }
+
+  std::string PersistentCache::get_path() const
+  {
+    return m_image_ctx.cct->_conf->rbd_persistent_cache_path + "/rbd-" +
+      stringify(m_image_ctx.md_ctx.get_id()) + "-" +
+      m_image_ctx.header_oid + ".log";
+  }
+
+  int PersistentCache::init()
+  {
+    Mutex::Locker l(m_lock);
+    int r = open_log();
+    if (r < 0 && m_fd >= 0) {
+      // leave whatever is there alone
+      VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+      m_fd = -1;
+    }
+    return r;
+  }
+
+  int PersistentCache::open_log()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    m_path = get_path();
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (m_fd < 0) {
+      int r = -errno;
+      lderr(cct) << "error opening " << m_path << ": " << cpp_strerror(r)
+		 << dendl;
+      return r;
+    }
+
+    struct stat st;
+    if (::fstat(m_fd, &st) < 0) {
+      int r = -errno;
+      lderr(cct) << "error reading size of " << m_path << ": "
+		 << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    if (st.st_size == 0) {
+      m_ring_size = cct->_conf->rbd_persistent_cache_size;
+      m_ring_size -= m_ring_size % LOG_ALIGN;
+      if (m_ring_size < 4 * (ENTRY_HEADER_SIZE + LOG_ALIGN)) {
+	lderr(cct) << "rbd_persistent_cache_size is too small" << dendl;
+	return -EINVAL;
+      }
+      if (::ftruncate(m_fd, SUPERBLOCK_SIZE + m_ring_size) < 0) {
+	int r = -errno;
+	lderr(cct) << "error sizing " << m_path << ": " << cpp_strerror(r)
+		   << dendl;
+	return r;
+      }
+      ldout(cct, 5) << "created " << m_path << " with " << m_ring_size
+		    << " bytes of log" << dendl;
+      m_generation = 1;
+      return write_superblock();
+    }
+
+    int r = read_superblock();
+    if (r < 0)
+      return r;
+    r = load_entries();
+    if (r < 0)
+      return r;
+    ldout(cct, 5) << "loaded " << m_entries.size() << " entries from "
+		  << m_path << dendl;
+    return 0;
+  }
+
+  int PersistentCache::replay()
+  {
+    int r = writeback();
+    if (r < 0) {
+      lderr(m_image_ctx.cct) << "error replaying " << m_path << ": "
+			     << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    // anything past the end of the log, e.g. behind a torn entry, is
+    // from an older generation and can't be mistaken for new entries
+    Mutex::Locker l(m_lock);
+    assert(m_entries.empty());
+    ++m_generation;
+    m_head = m_tail = 0;
+    m_tail_seq = m_head_seq;
+    m_used = 0;
+    m_unsynced = 0;
+    return write_superblock();
+  }
+
+  void PersistentCache::shut_down()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    {
+      Mutex::Locker l(m_lock);
+      if (m_error == 0)
+	m_error = -ESHUTDOWN;
+      while (m_in_flight > 0)
+	m_cond.Wait(m_lock);
+    }
+    m_finisher.wait_for_empty();
+
+    Mutex::Locker l(m_lock);
+    if (m_fd < 0)
+      return;
+    if (m_entries.empty()) {
+      write_superblock();
+    } else {
+      lderr(cct) << "leaving " << m_entries.size() << " entries in " << m_path
+		 << " to write back on the next open" << dendl;
+    }
+    VOID_TEMP_FAILURE_RETRY(::close(m_fd));
+    m_fd = -1;
+  }
+
+  bool PersistentCache::is_dirty() const
+  {
+    Mutex::Locker l(m_lock);
+    return !m_entries.empty();
+  }
+
+  bool PersistentCache::is_loggable(uint64_t len) const
+  {
+    // a few large writes shouldn't stall everything behind them
+    return ENTRY_HEADER_SIZE + ROUND_UP_TO(len, LOG_ALIGN) <= m_ring_size / 4;
+  }
+
+  void PersistentCache::append(uint64_t off, const bufferlist &bl,
+			       Context *on_finish)
+  {
+    CephContext *cct = m_image_ctx.cct;
+    uint64_t len = bl.length();
+    uint64_t log_len = ENTRY_HEADER_SIZE + ROUND_UP_TO(len, LOG_ALIGN);
+
+    Mutex::Locker l(m_lock);
+    int r = reserve(log_len);
+    if (r == 0) {
+      bufferptr bp = buffer::create_page_aligned(log_len);
+      bp.zero();
+      encode_entry_header(ENTRY_TYPE_WRITE, m_head_seq, off, len,
+			  bl.crc32c(0), bp.c_str());
+      bl.copy(0, len, bp.c_str() + ENTRY_HEADER_SIZE);
+      r = safe_pwrite(m_fd, bp.c_str(), log_len, SUPERBLOCK_SIZE + m_head);
+      if (r < 0) {
+	lderr(cct) << "error appending to " << m_path << ": "
+		   << cpp_strerror(r) << dendl;
+	m_error = r;
+      }
+    }
+    if (r < 0) {
+      m_finisher.queue(on_finish, r);
+      return;
+    }
+
+    ldout(cct, 20) << "logged " << off << "~" << len << " as entry "
+		   << m_head_seq << " at " << m_head << dendl;
+    Entry *entry = new Entry();
+    entry->seq = m_head_seq++;
+    entry->log_off = m_head;
+    entry->log_len = log_len;
+    entry->image_off = off;
+    entry->length = len;
+    entry->in_flight = false;
+    entry->written = false;
+    m_head += log_len;
+    if (m_head == m_ring_size)
+      m_head = 0;
+    m_used += log_len;
+    add_entry(entry);
+
+    kick_writeback();
+    m_finisher.queue(on_finish);
+  }
+
+  void PersistentCache::aio_flush(Context *on_finish)
+  {
+    // appends are already in the file, so syncing it covers them
+    m_finisher.queue(new C_Flush(this, on_finish));
+  }
+
+  int PersistentCache::flush()
+  {
+    if (::fdatasync(m_fd) < 0) {
+      int r = -errno;
+      lderr(m_image_ctx.cct) << "error syncing " << m_path << ": "
+			     << cpp_strerror(r) << dendl;
+      return r;
+    }
+    return 0;
+  }
+
+  void PersistentCache::read(uint64_t off, uint64_t len, uint64_t buffer_off,
+			     std::map<uint64_t, bufferlist> *overlay)
+  {
+    Mutex::Locker l(m_lock);
+    if (!has_chunks(m_dirty_chunks, off, len))
+      return;
+
+    // newer entries hide older ones.  Overlapping entries are written
+    // back in order, so a written entry's data is already the cluster's,
+    // or was overwritten there since by a write that bypassed the log.
+    interval_set<uint64_t> covered;
+    for (std::list<Entry*>::reverse_iterator it = m_entries.rbegin();
+	 it != m_entries.rend(); ++it) {
+      Entry *entry = *it;
+      if (entry->written)
+	continue;
+      uint64_t start = MAX(off, entry->image_off);
+      uint64_t end = MIN(off + len, entry->image_off + entry->length);
+      if (start >= end)
+	continue;
+
+      interval_set<uint64_t> pieces;
+      pieces.insert(start, end - start);
+      interval_set<uint64_t> hidden;
+      hidden.intersection_of(pieces, covered);
+      pieces.subtract(hidden);
+      for (interval_set<uint64_t>::iterator p = pieces.begin();
+	   p != pieces.end(); ++p) {
+	bufferlist bl;
+	int r = read_data(entry, p.get_start() - entry->image_off,
+			  p.get_len(), &bl);
+	if (r < 0) {
+	  // leave it to the cluster's copy, which may be stale
+	  continue;
+	}
+	(*overlay)[buffer_off + p.get_start() - off].claim(bl);
+      }
+      covered.union_of(pieces);
+    }
+  }
+
+  int PersistentCache::writeback()
+  {
+    return wait_for_writeback(0, 0);
+  }
+
+  int PersistentCache::writeback(uint64_t off, uint64_t len)
+  {
+    if (len == 0)
+      return 0;
+    return wait_for_writeback(off, len);
+  }
+
+  int PersistentCache::wait_for_writeback(uint64_t off, uint64_t len)
+  {
+    Mutex::Locker l(m_lock);
+    if (len > 0 && !has_chunks(m_logged_chunks, off, len))
+      return 0;
+
+    // later appends don't hold this up.  The tail only moves past a
+    // prefix of the log, so an extent needs everything up to the last
+    // entry that touches it.
+    uint64_t seq = m_head_seq;
+    if (len > 0) {
+      seq = 0;
+      for (std::list<Entry*>::iterator it = m_entries.begin();
+	   it != m_entries.end(); ++it) {
+	Entry *entry = *it;
+	if (entry->image_off < off + len &&
+	    off < entry->image_off + entry->length)
+	  seq = entry->seq + 1;
+      }
+    }
+
+    while (m_error == 0) {
+      bool pending = false;
+      for (std::list<Entry*>::iterator it = m_entries.begin();
+	   it != m_entries.end() && (*it)->seq < seq; ++it) {
+	if (!(*it)->written) {
+	  pending = true;
+	  break;
+	}
+      }
+      if (!pending)
+	break;
+
+      kick_writeback();
+      m_cond.Wait(m_lock);
+    }
+    if (m_error != 0)
+      return m_error;
+
+    // the caller is about to write around the log
+    if (m_unsynced > 0) {
+      int r = write_superblock();
+      if (r < 0) {
+	m_error = r;
+	return r;
+      }
+    }
+    return 0;
+  }
+
+  int PersistentCache::read_superblock()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    bufferptr bp = buffer::create(SUPERBLOCK_SIZE);
+    int r = safe_pread_exact(m_fd, bp.c_str(), SUPERBLOCK_SIZE, 0);
+    if (r < 0) {
+      lderr(cct) << "error reading superblock of " << m_path << ": "
+		 << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    bufferlist bl;
+    bl.push_back(bp);
+    std::string magic;
+    int64_t pool_id;
+    std::string header_oid;
+    try {
+      bufferlist::iterator it = bl.begin();
+      DECODE_START(1, it);
+      ::decode(magic, it);
+      ::decode(pool_id, it);
+      ::decode(header_oid, it);
+      ::decode(m_ring_size, it);
+      ::decode(m_generation, it);
+      ::decode(m_tail, it);
+      ::decode(m_tail_seq, it);
+      DECODE_FINISH(it);
+
+      bufferlist encoded;
+      encoded.substr_of(bl, 0, it.get_off());
+      uint32_t crc;
+      ::decode(crc, it);
+      if (crc != encoded.crc32c(0))
+	throw buffer::malformed_input("bad superblock crc");
+    } catch (const buffer::error &err) {
+      lderr(cct) << "corrupt superblock in " << m_path << ": " << err.what()
+		 << dendl;
+      return -EINVAL;
+    }
+
+    if (magic != SUPERBLOCK_MAGIC || pool_id != m_image_ctx.md_ctx.get_id() ||
+	header_oid != m_image_ctx.header_oid) {
+      lderr(cct) << m_path << " isn't a log for this image" << dendl;
+      return -EINVAL;
+    }
+    if (m_ring_size % LOG_ALIGN != 0 || m_tail >= m_ring_size ||
+	m_tail % LOG_ALIGN != 0) {
+      lderr(cct) << "corrupt superblock in " << m_path << dendl;
+      return -EINVAL;
+    }
+    m_head = m_tail;
+    m_head_seq = m_tail_seq;
+    return 0;
+  }
+
+  int PersistentCache::write_superblock()
+  {
+    assert(m_lock.is_locked());
+    bufferlist bl;
+    ENCODE_START(1, 1, bl);
+    ::encode(SUPERBLOCK_MAGIC, bl);
+    ::encode((int64_t)m_image_ctx.md_ctx.get_id(), bl);
+    ::encode(m_image_ctx.header_oid, bl);
+    ::encode(m_ring_size, bl);
+    ::encode(m_generation, bl);
+    ::encode(m_tail, bl);
+    ::encode(m_tail_seq, bl);
+    ENCODE_FINISH(bl);
+    ::encode(bl.crc32c(0), bl);
+    assert(bl.length() <= SUPERBLOCK_SIZE);
+    bl.append_zero(SUPERBLOCK_SIZE - bl.length());
+
+    int r = safe_pwrite(m_fd, bl.c_str(), SUPERBLOCK_SIZE, 0);
+    if (r == 0)
+      r = flush();
+    if (r < 0) {
+      lderr(m_image_ctx.cct) << "error writing superblock of " << m_path
+			     << ": " << cpp_strerror(r) << dendl;
+      return r;
+    }
+
+    // the space behind the new tail can be reused
+    m_used -= m_unsynced;
+    m_unsynced = 0;
+    for (std::vector<std::pair<uint64_t, uint64_t> >::iterator it =
+	   m_unsynced_extents.begin();
+	 it != m_unsynced_extents.end(); ++it)
+      update_chunks(m_logged_chunks, it->first, it->second, -1);
+    m_unsynced_extents.clear();
+    return 0;
+  }
+
+  void PersistentCache::encode_entry_header(uint8_t type, uint64_t seq,
+					    uint64_t image_off, uint64_t length,
+					    uint32_t data_crc, char *buf)
+  {
+    bufferlist bl;
+    ENCODE_START(1, 1, bl);
+    ::encode(type, bl);
+    ::encode(m_generation, bl);
+    ::encode(seq, bl);
+    ::encode(image_off, bl);
+    ::encode(length, bl);
+    ::encode(data_crc, bl);
+    ENCODE_FINISH(bl);
+    ::encode(bl.crc32c(0), bl);
+    assert(bl.length() <= ENTRY_HEADER_SIZE);
+    bl.copy(0, bl.length(), buf);
+  }
+
+  int PersistentCache::read_entry_header(uint64_t log_off, uint8_t *type,
+					 uint64_t *seq, uint64_t *image_off,
+					 uint64_t *length, uint32_t *data_crc)
+  {
+    bufferptr bp = buffer::create(ENTRY_HEADER_SIZE);
+    int r = safe_pread_exact(m_fd, bp.c_str(), ENTRY_HEADER_SIZE,
+			     SUPERBLOCK_SIZE + log_off);
+    if (r < 0)
+      return r;
+
+    bufferlist bl;
+    bl.push_back(bp);
+    uint64_t generation;
+    try {
+      bufferlist::iterator it = bl.begin();
+      DECODE_START(1, it);
+      ::decode(*type, it);
+      ::decode(generation, it);
+      ::decode(*seq, it);
+      ::decode(*image_off, it);
+      ::decode(*length, it);
+      ::decode(*data_crc, it);
+      DECODE_FINISH(it);
+
+      bufferlist encoded;
+      encoded.substr_of(bl, 0, it.get_off());
+      uint32_t crc;
+      ::decode(crc, it);
+      if (crc != encoded.crc32c(0))
+	return -EINVAL;
+    } catch (const buffer::error &err) {
+      return -EINVAL;
+    }
+    if (generation != m_generation)
+      return -EINVAL;
+    return 0;
+  }
+
+  int PersistentCache::load_entries()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    uint64_t pos = m_tail;
+    uint64_t seq = m_tail_seq;
+    uint64_t used = 0;
+    while (used < m_ring_size) {
+      if (pos == m_ring_size)
+	pos = 0;
+
+      uint8_t type;
+      uint64_t entry_seq, image_off, length;
+      uint32_t data_crc;
+      int r = read_entry_header(pos, &type, &entry_seq, &image_off, &length,
+				&data_crc);
+      if (r == -EINVAL || (r == 0 && entry_seq != seq))
+	break;
+      if (r < 0) {
+	lderr(cct) << "error reading " << m_path << ": " << cpp_strerror(r)
+		   << dendl;
+	return r;
+      }
+
+      Entry *entry = new Entry();
+      entry->seq = seq;
+      entry->log_off = pos;
+      entry->in_flight = false;
+      if (type == ENTRY_TYPE_PAD) {
+	entry->log_len = m_ring_size - pos;
+	entry->image_off = 0;
+	entry->length = 0;
+	entry->written = true;
+      } else {
+	entry->log_len = ENTRY_HEADER_SIZE + ROUND_UP_TO(length, LOG_ALIGN);
+	entry->image_off = image_off;
+	entry->length = length;
+	entry->written = false;
+      }
+      if (type != ENTRY_TYPE_PAD && type != ENTRY_TYPE_WRITE) {
+	delete entry;
+	break;
+      }
+      if (pos + entry->log_len > m_ring_size ||
+	  used + entry->log_len > m_ring_size) {
+	delete entry;
+	break;
+      }
+      if (type == ENTRY_TYPE_WRITE) {
+	// a torn entry ends the log
+	bufferlist bl;
+	r = read_data(entry, 0, length, &bl);
+	if (r < 0 || bl.crc32c(0) != data_crc) {
+	  delete entry;
+	  break;
+	}
+      }
+
+      ldout(cct, 20) << "loaded entry " << seq << " for " << image_off << "~"
+		     << length << dendl;
+      add_entry(entry);
+      used += entry->log_len;
+      pos += entry->log_len;
+      ++seq;
+    }
+
+    m_head = pos == m_ring_size ? 0 : pos;
+    m_head_seq = seq;
+    m_used = used;
+    retire_entries();
+    return 0;
+  }
+
+  int PersistentCache::read_data(const Entry *entry, uint64_t off,
+				 uint64_t len, bufferlist *bl)
+  {
+    bufferptr bp = buffer::create(len);
+    int r = safe_pread_exact(m_fd, bp.c_str(), len,
+			     SUPERBLOCK_SIZE + entry->log_off +
+			     ENTRY_HEADER_SIZE + off);
+    if (r < 0) {
+      lderr(m_image_ctx.cct) << "error reading " << m_path << ": "
+			     << cpp_strerror(r) << dendl;
+      return r;
+    }
+    bl->push_back(bp);
+    return 0;
+  }
+
+  int PersistentCache::reserve(uint64_t len)
+  {
+    assert(m_lock.is_locked());
+    CephContext *cct = m_image_ctx.cct;
+    while (true) {
+      if (m_error != 0)
+	return m_error;
+
+      // entries don't wrap, so the end of the ring may be skipped
+      uint64_t pad = m_head + len > m_ring_size ? m_ring_size - m_head : 0;
+      if (m_used + pad + len <= m_ring_size) {
+	if (pad == 0)
+	  return 0;
+
+	char buf[ENTRY_HEADER_SIZE];
+	memset(buf, 0, sizeof(buf));
+	encode_entry_header(ENTRY_TYPE_PAD, m_head_seq, 0, 0, 0, buf);
+	int r = safe_pwrite(m_fd, buf, sizeof(buf), SUPERBLOCK_SIZE + m_head);
+	if (r < 0) {
+	  lderr(cct) << "error appending to " << m_path << ": "
+		     << cpp_strerror(r) << dendl;
+	  m_error = r;
+	  return r;
+	}
+
+	Entry *entry = new Entry();
+	entry->seq = m_head_seq++;
+	entry->log_off = m_head;
+	entry->log_len = pad;
+	entry->image_off = 0;
+	entry->length = 0;
+	entry->in_flight = false;
+	entry->written = true;
+	m_head = 0;
+	m_used += pad;
+	add_entry(entry);
+	retire_entries();
+	return 0;
+      }
+
+      if (m_unsynced > 0) {
+	int r = write_superblock();
+	if (r < 0) {
+	  m_error = r;
+	  return r;
+	}
+	continue;
+      }
+
+      ldout(cct, 20) << "waiting for space in the log" << dendl;
+      kick_writeback();
+      m_cond.Wait(m_lock);
+    }
+  }
+
+  void PersistentCache::add_entry(Entry *entry)
+  {
+    assert(m_lock.is_locked());
+    m_entries.push_back(entry);
+    update_chunks(m_logged_chunks, entry->image_off, entry->length, 1);
+    if (!entry->written) {
+      m_writeback_queue.push_back(entry);
+      update_chunks(m_dirty_chunks, entry->image_off, entry->length, 1);
+    }
+  }
+
+  void PersistentCache::retire_entries()
+  {
+    assert(m_lock.is_locked());
+    while (!m_entries.empty() && m_entries.front()->written) {
+      Entry *entry = m_entries.front();
+      m_entries.pop_front();
+      m_unsynced += entry->log_len;
+      if (entry->length > 0)
+	m_unsynced_extents.push_back(std::make_pair(entry->image_off,
+						    entry->length));
+      delete entry;
+    }
+
+    // the superblock only catches up when the space is needed
+    if (m_entries.empty()) {
+      m_tail = m_head;
+      m_tail_seq = m_head_seq;
+    } else {
+      m_tail = m_entries.front()->log_off;
+      m_tail_seq = m_entries.front()->seq;
+    }
+  }
+
+  void PersistentCache::update_chunks(std::map<uint64_t, uint32_t> &chunks,
+				      uint64_t off, uint64_t len, int delta)
+  {
+    if (len == 0)
+      return;
+    uint64_t start = off >> DIRTY_CHUNK_SHIFT;
+    uint64_t end = (off + len - 1) >> DIRTY_CHUNK_SHIFT;
+    for (uint64_t chunk = start; chunk <= end; ++chunk) {
+      uint32_t &count = chunks[chunk];
+      count += delta;
+      if (count == 0)
+	chunks.erase(chunk);
+    }
+  }
+
+  bool PersistentCache::has_chunks(const std::map<uint64_t, uint32_t> &chunks,
+				   uint64_t off, uint64_t len)
+  {
+    if (len == 0 || chunks.empty())
+      return false;
+    std::map<uint64_t, uint32_t>::const_iterator it =
+      chunks.lower_bound(off >> DIRTY_CHUNK_SHIFT);
+    return it != chunks.end() &&
+      it->first <= ((off + len - 1) >> DIRTY_CHUNK_SHIFT);
+  }
+
+  void PersistentCache::kick_writeback()
+  {
+    assert(m_lock.is_locked());
+    if (m_error == 0 && !m_writeback_queued && !m_writeback_queue.empty()) {
+      m_writeback_queued = true;
+      m_finisher.queue(new C_Writeback(this));
+    }
+  }
+
+  void PersistentCache::send_writeback()
+  {
+    CephContext *cct = m_image_ctx.cct;
+    std::list<Entry*> entries;
+    {
+      Mutex::Locker l(m_lock);
+      m_writeback_queued = false;
+      uint32_t max_ops =
+	MAX(1, cct->_conf->rbd_persistent_cache_max_writeback_ops);
+      while (m_error == 0 && !m_writeback_queue.empty() &&
+	     m_in_flight < max_ops) {
+	Entry *entry = m_writeback_queue.front();
+	// overlapping writes must reach the cluster in log order
+	if (m_in_flight_extents.intersects(entry->image_off, entry->length))
+	  break;
+	m_writeback_queue.pop_front();
+	m_in_flight_extents.insert(entry->image_off, entry->length);
+	entry->in_flight = true;
+	++m_in_flight;
+	entries.push_back(entry);
+      }
+    }
+
+    for (std::list<Entry*>::iterator it = entries.begin();
+	 it != entries.end(); ++it) {
+      Entry *entry = *it;
+      ldout(cct, 20) << "writing back entry " << entry->seq << " for "
+		     << entry->image_off << "~" << entry->length << dendl;
+      bufferlist bl;
+      int r = read_data(entry, 0, entry->length, &bl);
+      if (r < 0) {
+	complete_writeback(entry, r);
+	continue;
+      }
+
+      Context *ctx = new C_WritebackDone(this, entry);
+      AioCompletion *c = aio_create_completion_internal(ctx, rbd_ctx_cb);
+      r = _aio_write(&m_image_ctx, entry->image_off, bl, false, c);
+      if (r < 0) {
+	c->release();
+	delete ctx;
+	complete_writeback(entry, r);
+      }
+    }
+  }
+
+  void PersistentCache::complete_writeback(Entry *entry, int r)
+  {
+    CephContext *cct = m_image_ctx.cct;
+    Mutex::Locker l(m_lock);
+    assert(entry->in_flight);
+    entry->in_flight = false;
+    m_in_flight_extents.erase(entry->image_off, entry->length);
+    --m_in_flight;
+
+    if (r < 0) {
+      // the entry stays in the log for the next open to retry
+      lderr(cct) << "error writing back " << entry->image_off << "~"
+		 << entry->length << ": " << cpp_strerror(r) << dendl;
+      if (m_error == 0)
+	m_error = r;
+    } else {
+      entry->written = true;
+      update_chunks(m_dirty_chunks, entry->image_off, entry->length, -1);
+      retire_entries();
+      kick_writeback();
+    }
+    m_cond.Signal();
+  }
+
+}
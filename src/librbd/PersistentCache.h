@@ -0,0 +1,207 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#ifndef CEPH_LIBRBD_PERSISTENTCACHE_H
+#define CEPH_LIBRBD_PERSISTENTCACHE_H
+
+#include "include/int_types.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/Cond.h"
+#include "common/Finisher.h"
+#include "common/Mutex.h"
+#include "include/buffer.h"
+#include "include/Context.h"
+#include "include/interval_set.h"
+
+namespace librbd {
+
+  struct ImageCtx;
+
+  /**
+   * Write-back cache kept in a log on local storage.
+   *
+   * Writes complete once they're appended to the log, and are written
+   * back to the cluster in order in the background.  A flush only has
+   * to make the log durable, so after a crash the log holds every
+   * write completed before the last flush followed by some prefix of
+   * the later ones.  Whatever is left in the log is written back when
+   * the image is next opened.
+   *
+   * Only the exclusive lock owner may write the image back, so the
+   * cache requires the exclusive lock feature, and releasing the lock
+   * writes the whole log back first.
+   *
+   * The log file starts with a superblock recording the oldest entry
+   * that may not be written back yet, followed by a ring of entries
+   * aligned to LOG_ALIGN.  Each entry has a sequence number and
+   * checksums, which is how replay finds the end of the log; entries
+   * left over from earlier opens carry an older generation.
+   */
+  class PersistentCache {
+  public:
+    PersistentCache(ImageCtx &image_ctx);
+    ~PersistentCache();
+
+    /// open (or create) the log and load the entries left in it
+    int init();
+    /// write back what init() found (lock owner only) and reset the log
+    int replay();
+    /// record that the log is clean and close it
+    void shut_down();
+
+    bool is_dirty() const;
+    /// whether a write of the given length can go through the log
+    bool is_loggable(uint64_t len) const;
+
+    /// log a write; on_finish completes once it's in the log
+    void append(uint64_t off, const ceph::bufferlist &bl, Context *on_finish);
+    /// make everything logged so far durable
+    void aio_flush(Context *on_finish);
+    int flush();
+
+    /**
+     * Collect the logged data that's newer than what the cluster has
+     * for part of a read.
+     *
+     * @param buffer_off offset of the extent within the read's result
+     * @param overlay non-overlapping pieces keyed by result offset
+     */
+    void read(uint64_t off, uint64_t len, uint64_t buffer_off,
+	      std::map<uint64_t, ceph::bufferlist> *overlay);
+
+    /**
+     * Write back everything logged so far (lock owner only), and move
+     * the superblock's tail past it so a replay after a crash can't
+     * write it again over later updates from elsewhere.
+     */
+    int writeback();
+    /// the same, for everything logged so far that overlaps an extent
+    int writeback(uint64_t off, uint64_t len);
+
+  private:
+    static const uint64_t SUPERBLOCK_SIZE = 4096;
+    static const uint64_t LOG_ALIGN = 512;
+    static const uint64_t ENTRY_HEADER_SIZE = LOG_ALIGN;
+    static const unsigned DIRTY_CHUNK_SHIFT = 22;
+
+    enum {
+      ENTRY_TYPE_WRITE = 1,
+      ENTRY_TYPE_PAD   = 2  ///< rest of the ring is unused, wrap around
+    };
+
+    struct Entry {
+      uint64_t seq;
+      uint64_t log_off;  ///< of the header, within the ring
+      uint64_t log_len;  ///< including header and padding
+      uint64_t image_off;
+      uint64_t length;   ///< 0 for padding
+      bool in_flight;
+      bool written;
+    };
+
+    class C_Writeback : public Context {
+    public:
+      C_Writeback(PersistentCache *cache) : m_cache(cache) {}
+      virtual void finish(int r) {
+	m_cache->send_writeback();
+      }
+    private:
+      PersistentCache *m_cache;
+    };
+
+    class C_WritebackDone : public Context {
+    public:
+      C_WritebackDone(PersistentCache *cache, Entry *entry)
+	: m_cache(cache), m_entry(entry) {}
+      virtual void finish(int r) {
+	m_cache->complete_writeback(m_entry, r);
+      }
+    private:
+      PersistentCache *m_cache;
+      Entry *m_entry;
+    };
+
+    class C_Flush : public Context {
+    public:
+      C_Flush(PersistentCache *cache, Context *on_finish)
+	: m_cache(cache), m_on_finish(on_finish) {}
+      virtual void finish(int r) {
+	m_on_finish->complete(m_cache->flush());
+      }
+    private:
+      PersistentCache *m_cache;
+      Context *m_on_finish;
+    };
+
+    ImageCtx &m_image_ctx;
+    std::string m_path;
+    int m_fd;
+    uint64_t m_ring_size;
+
+    /**
+     * Protects everything below, and is held across appends so entries
+     * land in the log in sequence order.  An entry's space is only
+     * reused after it's written back and the superblock no longer
+     * points at it, so its data can be read without the lock.
+     */
+    mutable Mutex m_lock;
+    Cond m_cond;
+    uint64_t m_generation;
+    uint64_t m_head;        ///< where the next entry goes
+    uint64_t m_head_seq;
+    uint64_t m_tail;        ///< oldest entry not yet written back
+    uint64_t m_tail_seq;
+    uint64_t m_used;        ///< bytes from the superblock's tail to m_head
+    uint64_t m_unsynced;    ///< written back but still behind that tail
+    int m_error;            ///< stops writeback and appends once set
+
+    std::list<Entry*> m_entries;          ///< in log order
+    std::list<Entry*> m_writeback_queue;  ///< not yet sent
+    interval_set<uint64_t> m_in_flight_extents;
+    uint32_t m_in_flight;
+    bool m_writeback_queued;
+    /// entries per 4MB chunk of the image, to skip reads of clean data
+    std::map<uint64_t, uint32_t> m_dirty_chunks;
+    /// entries per 4MB chunk that a replay would still write back
+    std::map<uint64_t, uint32_t> m_logged_chunks;
+    /// extents of entries retired since the superblock was written
+    std::vector<std::pair<uint64_t, uint64_t> > m_unsynced_extents;
+
+    /// completes appends and sends writeback outside the caller's locks
+    Finisher m_finisher;
+
+    std::string get_path() const;
+    int open_log();
+    int read_superblock();
+    int write_superblock();
+    int load_entries();
+    int read_entry_header(uint64_t log_off, uint8_t *type, uint64_t *seq,
+			  uint64_t *image_off, uint64_t *length,
+			  uint32_t *data_crc);
+    void encode_entry_header(uint8_t type, uint64_t seq, uint64_t image_off,
+			     uint64_t length, uint32_t data_crc, char *buf);
+    int read_data(const Entry *entry, uint64_t off, uint64_t len,
+		  ceph::bufferlist *bl);
+
+    int reserve(uint64_t len);
+    void add_entry(Entry *entry);
+    void retire_entries();
+    static void update_chunks(std::map<uint64_t, uint32_t> &chunks,
+			      uint64_t off, uint64_t len, int delta);
+    static bool has_chunks(const std::map<uint64_t, uint32_t> &chunks,
+			   uint64_t off, uint64_t len);
+
+    void kick_writeback();
+    void send_writeback();
+    void complete_writeback(Entry *entry, int r);
+    int wait_for_writeback(uint64_t off, uint64_t len);
+  };
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "common/dout.h"
 #include "common/perf_counters.h"
 
+#include "librbd/ExclusiveLock.h"
 #include "librbd/ImageCtx.h"
 #include "librbd/internal.h"
 
@@ -27,10 +28,18 @@ namespace librbd {
     Mutex::Locker l(lock);
     ldout(ictx->cct, 1) <<  " got notification opcode=" << (int)opcode
 			<< " ver=" << ver << " cookie=" << cookie << dendl;
-    if (valid) {
-      Mutex::Locker lictx(ictx->refresh_lock);
-      ++ictx->refresh_seq;
-      ictx->perfcounter->inc(l_librbd_notify);
+    if (!valid)
+      return;
+
+    // a lock handoff means the previous owner may have updated the
+    // header and object map, so it forces a refresh too
+    if (bl.length() > 0 && ictx->exclusive_lock) {
+      bufferlist::iterator it = bl.begin();
+      ictx->exclusive_lock->handle_notify(it);
     }
+
+    Mutex::Locker lictx(ictx->refresh_lock);
+    ++ictx->refresh_seq;
+    ictx->perfcounter->inc(l_librbd_notify);
   }
 }
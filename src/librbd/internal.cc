@@ -10,13 +10,20 @@
 #include "common/errno.h"
 #include "common/Throttle.h"
 #include "cls/lock/cls_lock_client.h"
+#include "include/err.h"
+#include "include/rbd/object_map_types.h"
 #include "include/stringify.h"
 
 #include "cls/rbd/cls_rbd.h"
 
 #include "librbd/AioCompletion.h"
 #include "librbd/AioRequest.h"
+#include "librbd/CopyOnRead.h"
+#include "librbd/ExclusiveLock.h"
 #include "librbd/ImageCtx.h"
+#include "librbd/ObjectMap.h"
+#include "librbd/ParentCache.h"
+#include "librbd/PersistentCache.h"
 
 #include "librbd/internal.h"
 #include "librbd/parent_types.h"
@@ -165,11 +172,29 @@ namespace librbd {
 		   << " to " << (num_objects-1)
 		   << dendl;
 
+    // objects past the new end are flagged as pending removal until
+    // they're gone, so an interrupted trim never leaves one marked as
+    // nonexistent while it still holds data
+    uint64_t new_num_objects = Striper::get_num_objects(ictx->layout, newsize);
+    if (new_num_objects < num_objects) {
+      int r = ictx->object_map.update(new_num_objects, num_objects,
+				      OBJECT_PENDING, OBJECT_EXISTS);
+      if (r == 0)
+	r = ictx->object_map.update(new_num_objects, num_objects,
+				    OBJECT_PENDING, OBJECT_EXISTS_CLEAN);
+      if (r < 0) {
+	lderr(cct) << "warning: failed to update object map: "
+		   << cpp_strerror(r) << dendl;
+      }
+    }
+
     SimpleThrottle throttle(cct->_conf->rbd_concurrent_management_ops, true);
     if (delete_start < num_objects) {
       ldout(cct, 2) << "trim_image objects " << delete_start << " to "
 		    << (num_objects - 1) << dendl;
       for (uint64_t i = delete_start; i < num_objects; ++i) {
+	if (!ictx->object_map.object_may_exist(i))
+	  continue;
 	string oid = ictx->get_object_name(i);
 	Context *req_comp = new C_SimpleThrottle(&throttle);
 	librados::AioCompletion *rados_completion =
@@ -190,6 +215,8 @@ namespace librbd {
       for (vector<ObjectExtent>::iterator p = extents.begin();
 	   p != extents.end(); ++p) {
 	ldout(ictx->cct, 20) << " ex " << *p << dendl;
+	if (!ictx->object_map.object_may_exist(p->objectno))
+	  continue;
 	Context *req_comp = new C_SimpleThrottle(&throttle);
 	librados::AioCompletion *rados_completion =
 	  librados::Rados::aio_create_completion(req_comp, NULL, rados_ctx_cb);
@@ -207,6 +234,13 @@ namespace librbd {
     if (r < 0) {
       lderr(cct) << "warning: failed to remove some object(s): "
 		 << cpp_strerror(r) << dendl;
+    } else if (new_num_objects < num_objects) {
+      r = ictx->object_map.update(new_num_objects, num_objects,
+				  OBJECT_NONEXISTENT, OBJECT_PENDING);
+      if (r < 0) {
+	lderr(cct) << "warning: failed to update object map: "
+		   << cpp_strerror(r) << dendl;
+      }
     }
   }
 
@@ -468,7 +502,17 @@ namespace librbd {
     if (ictx->read_only)
       return -EROFS;
 
-    int r = ictx_check(ictx);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0)
+      return r;
+
+    r = ictx_check(ictx);
+    if (r < 0)
+      return r;
+
+    // the snapshot must include what was logged before it
+    r = writeback_persistent_cache(ictx);
     if (r < 0)
       return r;
 
@@ -512,7 +556,12 @@ namespace librbd {
     if (ictx->read_only)
       return -EROFS;
 
-    int r = ictx_check(ictx);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0)
+      return r;
+
+    r = ictx_check(ictx);
     if (r < 0)
       return r;
 
@@ -552,6 +601,8 @@ namespace librbd {
     if (r < 0)
       return r;
 
+    ictx->object_map.snapshot_remove(snap_id);
+
     notify_change(ictx->md_ctx, ictx->header_oid, NULL, ictx);
 
     ictx->perfcounter->inc(l_librbd_snap_remove);
@@ -825,6 +876,21 @@ reprotect_and_return_err:
       }
     }
 
+    if ((features & RBD_FEATURE_OBJECT_MAP) != 0) {
+      ceph_file_layout layout;
+      memset(&layout, 0, sizeof(layout));
+      layout.fl_object_size = 1ull << order;
+      layout.fl_stripe_unit = stripe_unit ? stripe_unit : layout.fl_object_size;
+      layout.fl_stripe_count = stripe_count ? stripe_count : 1;
+      r = ObjectMap::create(io_ctx, id,
+			    Striper::get_num_objects(layout, size));
+      if (r < 0) {
+	lderr(cct) << "error creating object map: " << cpp_strerror(r)
+		   << dendl;
+	goto err_remove_header;
+      }
+    }
+
     ldout(cct, 2) << "done." << dendl;
     return 0;
 
@@ -881,6 +947,12 @@ reprotect_and_return_err:
       lderr(cct) << "librbd does not support requested features." << dendl;
       return -ENOSYS;
     }
+    // only the lock owner can keep the object map in sync
+    if ((features & RBD_FEATURE_OBJECT_MAP) != 0 &&
+	(features & RBD_FEATURE_EXCLUSIVE_LOCK) == 0) {
+      lderr(cct) << "the object map requires the exclusive lock" << dendl;
+      return -EINVAL;
+    }
 
     // make sure it doesn't already exist, in either format
     int r = detect_format(io_ctx, imgname, NULL, NULL);
@@ -961,6 +1033,11 @@ reprotect_and_return_err:
       lderr(cct) << "librbd does not support requested features" << dendl;
       return -ENOSYS;
     }
+    if ((features & RBD_FEATURE_OBJECT_MAP) != 0 &&
+	(features & RBD_FEATURE_EXCLUSIVE_LOCK) == 0) {
+      lderr(cct) << "the object map requires the exclusive lock" << dendl;
+      return -EINVAL;
+    }
 
     // make sure child doesn't already exist, in either format
     int r = detect_format(c_ioctx, c_name, NULL, NULL);
@@ -1289,6 +1366,13 @@ reprotect_and_return_err:
     else if (ictx->cct->_conf->rbd_localize_parent_reads)
       ictx->parent->set_read_flag(librados::OPERATION_LOCALIZE_READS);
 
+    // clones of the same snapshot share its objects instead of each
+    // reading them through their own parent's cache
+    if (ictx->cct->_conf->rbd_parent_cache_size > 0) {
+      ictx->cct->lookup_or_create_singleton_object<ParentCache>(
+	ictx->parent->parent_cache, ParentCache::name);
+    }
+
     r = open_image(ictx->parent);
     if (r < 0) {
       lderr(ictx->cct) << "error opening parent image: " << cpp_strerror(r)
@@ -1427,6 +1511,8 @@ reprotect_and_return_err:
       trim_image(ictx, 0, prog_ctx);
       ictx->md_lock.put_read();
 
+      ictx->object_map.remove();
+
       ictx->parent_lock.get_read();
       // struct assignment
       parent_info parent_info = ictx->parent_md;
@@ -1496,10 +1582,14 @@ reprotect_and_return_err:
       return 0;
     }
 
+    uint64_t original_size = ictx->size;
     if (size > ictx->size) {
       ldout(cct, 2) << "expanding image " << ictx->size << " -> " << size
 		    << dendl;
       // TODO: make ictx->set_size
+      int r = ictx->object_map.resize(size, OBJECT_NONEXISTENT);
+      if (r < 0)
+	return r;
     } else {
       ldout(cct, 2) << "shrinking image " << ictx->size << " -> " << size
 		    << dendl;
@@ -1529,6 +1619,11 @@ reprotect_and_return_err:
       notify_change(ictx->md_ctx, ictx->header_oid, NULL, ictx);
     }
 
+    if (size < original_size) {
+      // the trimmed objects are already marked nonexistent; errors
+      // only leave the map longer than the image, which is harmless
+      ictx->object_map.resize(size, OBJECT_NONEXISTENT);
+    }
     return 0;
   }
 
@@ -1542,7 +1637,18 @@ reprotect_and_return_err:
       return -EROFS;
     }
 
-    int r = ictx_check(ictx);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    r = ictx_check(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    r = writeback_persistent_cache(ictx);
     if (r < 0) {
       return r;
     }
@@ -1624,6 +1730,10 @@ reprotect_and_return_err:
       return r;
     }
 
+    // copied after the snapshot exists, so the copy can only overstate
+    // which objects the snapshot holds
+    ictx->object_map.snapshot(snap_id);
+
     return 0;
   }
 
@@ -1670,6 +1780,52 @@ reprotect_and_return_err:
     return 0;
   }
 
+  int prepare_image_update(ImageCtx *ictx)
+  {
+    assert(ictx->owner_lock.is_locked() && !ictx->owner_lock.is_wlocked());
+    if (ictx->exclusive_lock == NULL)
+      return 0;
+
+    // the lock may be handed off again before we get owner_lock back
+    bool acquired = false;
+    while (!ictx->exclusive_lock->is_lock_owner()) {
+      ictx->owner_lock.put_read();
+      int r;
+      {
+	RWLock::WLocker l(ictx->owner_lock);
+	r = ictx->exclusive_lock->request_lock();
+      }
+      ictx->owner_lock.get_read();
+      if (r < 0) {
+	lderr(ictx->cct) << "failed to acquire exclusive lock: "
+			 << cpp_strerror(r) << dendl;
+	return r;
+      }
+      acquired = true;
+    }
+
+    // the previous owner may have changed the header and object map
+    // without us seeing a notification, so reload both before using them
+    if (acquired) {
+      int r = ictx_check(ictx);
+      if (r < 0)
+	return r;
+    }
+    return 0;
+  }
+
+  int writeback_persistent_cache(ImageCtx *ictx)
+  {
+    if (ictx->persistent_cache == NULL)
+      return 0;
+    int r = ictx->persistent_cache->writeback();
+    if (r < 0) {
+      lderr(ictx->cct) << "error writing back persistent cache: "
+		       << cpp_strerror(r) << dendl;
+    }
+    return r;
+  }
+
   int refresh_parent(ImageCtx *ictx) {
     // close the parent if it changed or this image no longer needs
     // to read from it
@@ -1853,6 +2009,10 @@ reprotect_and_return_err:
       ictx->data_ctx.selfmanaged_snap_set_write_ctx(ictx->snapc.seq, ictx->snaps);
     } // release snap_lock
 
+    int r = ictx->object_map.refresh();
+    if (r < 0)
+      return r;
+
     if (new_snap) {
       _flush(ictx);
     }
@@ -1871,7 +2031,16 @@ reprotect_and_return_err:
     ldout(cct, 20) << "snap_rollback " << ictx << " snap = " << snap_name
 		   << dendl;
 
-    int r = ictx_check(ictx);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0)
+      return r;
+
+    r = ictx_check(ictx);
+    if (r < 0)
+      return r;
+
+    r = writeback_persistent_cache(ictx);
     if (r < 0)
       return r;
 
@@ -1917,6 +2086,13 @@ reprotect_and_return_err:
       return r;
     }
 
+    r = ictx->object_map.rollback(snap_id);
+    if (r < 0) {
+      lderr(cct) << "Error rolling back object map: " << cpp_strerror(-r)
+		 << dendl;
+      return r;
+    }
+
     notify_change(ictx->md_ctx, ictx->header_oid, NULL, ictx);
 
     ictx->perfcounter->inc(l_librbd_snap_rollback);
@@ -1981,41 +2157,39 @@ reprotect_and_return_err:
 
   class C_CopyWrite : public Context {
   public:
-    C_CopyWrite(SimpleThrottle *throttle, bufferlist *bl)
-      : m_throttle(throttle), m_bl(bl) {}
+    C_CopyWrite(Context *on_finish, bufferlist *bl)
+      : m_on_finish(on_finish), m_bl(bl) {}
     virtual void finish(int r) {
       delete m_bl;
-      m_throttle->end_op(r);
+      m_on_finish->complete(r);
     }
   private:
-    SimpleThrottle *m_throttle;
+    Context *m_on_finish;
     bufferlist *m_bl;
   };
 
   class C_CopyRead : public Context {
   public:
-    C_CopyRead(SimpleThrottle *throttle, ImageCtx *dest, uint64_t offset,
+    C_CopyRead(Context *on_finish, ImageCtx *dest, uint64_t offset,
 	       bufferlist *bl)
-      : m_throttle(throttle), m_dest(dest), m_offset(offset), m_bl(bl) {
-      m_throttle->start_op();
-    }
+      : m_on_finish(on_finish), m_dest(dest), m_offset(offset), m_bl(bl) {}
     virtual void finish(int r) {
       if (r < 0) {
 	lderr(m_dest->cct) << "error reading from source image at offset "
 			   << m_offset << ": " << cpp_strerror(r) << dendl;
 	delete m_bl;
-	m_throttle->end_op(r);
+	m_on_finish->complete(r);
 	return;
       }
       assert(m_bl->length() == (size_t)r);
 
       if (m_bl->is_zero()) {
 	delete m_bl;
-	m_throttle->end_op(r);
+	m_on_finish->complete(r);
 	return;
       }
 
-      Context *ctx = new C_CopyWrite(m_throttle, m_bl);
+      Context *ctx = new C_CopyWrite(m_on_finish, m_bl);
       AioCompletion *comp = aio_create_completion_internal(ctx, rbd_ctx_cb);
       r = aio_write(m_dest, m_offset, m_bl->length(), m_bl->c_str(), comp);
       if (r < 0) {
@@ -2026,17 +2200,43 @@ reprotect_and_return_err:
       }
     }
   private:
-    SimpleThrottle *m_throttle;
+    Context *m_on_finish;
     ImageCtx *m_dest;
     uint64_t m_offset;
     bufferlist *m_bl;
   };
 
+  /**
+   * Whether an extent of the image is known to be a hole, because it's
+   * beyond the parent overlap and the object map says none of the
+   * objects backing it exist.
+   */
+  static bool is_hole(ImageCtx *ictx, uint64_t off, uint64_t len,
+		      uint64_t parent_overlap)
+  {
+    if (off < parent_overlap)
+      return false;
+
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(ictx->cct, ictx->format_string, &ictx->layout,
+			     off, len, 0, extents);
+    for (vector<ObjectExtent>::iterator p = extents.begin();
+	 p != extents.end(); ++p) {
+      if (ictx->object_map.object_may_exist(p->objectno))
+	return false;
+    }
+    return true;
+  }
+
   int copy(ImageCtx *src, ImageCtx *dest, ProgressContext &prog_ctx)
   {
     src->md_lock.get_read();
     src->snap_lock.get_read();
+    src->parent_lock.get_read();
     uint64_t src_size = src->get_image_size(src->snap_id);
+    uint64_t parent_overlap = 0;
+    src->get_parent_overlap(src->snap_id, &parent_overlap);
+    src->parent_lock.put_read();
     src->snap_lock.put_read();
     src->md_lock.put_read();
 
@@ -2053,12 +2253,21 @@ reprotect_and_return_err:
       return -EINVAL;
     }
     int r;
-    SimpleThrottle throttle(cct->_conf->rbd_concurrent_management_ops, false);
+    OrderedThrottle throttle(cct->_conf->rbd_concurrent_management_ops,
+			     cct->_conf->rbd_concurrent_management_bytes,
+			     false);
     uint64_t period = src->get_stripe_period();
     for (uint64_t offset = 0; offset < src_size; offset += period) {
+      if (throttle.pending_error())
+	break;
+
       uint64_t len = min(period, src_size - offset);
+      if (is_hole(src, offset, len, parent_overlap))
+	continue;
+
       bufferlist *bl = new bufferlist();
-      Context *ctx = new C_CopyRead(&throttle, dest, offset, bl);
+      Context *ctx = new C_CopyRead(throttle.start_op(NULL, len), dest,
+				    offset, bl);
       AioCompletion *comp = aio_create_completion_internal(ctx, rbd_ctx_cb);
       r = aio_read(src, offset, len, NULL, bl, comp);
       if (r < 0) {
@@ -2083,20 +2292,22 @@ reprotect_and_return_err:
 
   int _snap_set(ImageCtx *ictx, const char *snap_name)
   {
-    RWLock::WLocker l1(ictx->snap_lock);
-    RWLock::WLocker l2(ictx->parent_lock);
-    int r;
-    if ((snap_name != NULL) && (strlen(snap_name) != 0)) {
-      r = ictx->snap_set(snap_name);
-    } else {
-      ictx->snap_unset();
-      r = 0;
-    }
-    if (r < 0) {
-      return r;
+    {
+      RWLock::WLocker l1(ictx->snap_lock);
+      RWLock::WLocker l2(ictx->parent_lock);
+      int r;
+      if ((snap_name != NULL) && (strlen(snap_name) != 0)) {
+	r = ictx->snap_set(snap_name);
+      } else {
+	ictx->snap_unset();
+	r = 0;
+      }
+      if (r < 0) {
+	return r;
+      }
+      refresh_parent(ictx);
     }
-    refresh_parent(ictx);
-    return 0;
+    return ictx->object_map.refresh();
   }
 
   int snap_set(ImageCtx *ictx, const char *snap_name)
@@ -2106,6 +2317,7 @@ reprotect_and_return_err:
     // ignore return value, since we may be set to a non-existent
     // snapshot and the user is trying to fix that
     ictx_check(ictx);
+    writeback_persistent_cache(ictx);
     if (ictx->object_cacher) {
       // complete pending writes before we're set to a snapshot and
       // get -EROFS for writes
@@ -2144,6 +2356,50 @@ reprotect_and_return_err:
     if ((r = _snap_set(ictx, ictx->snap_name.c_str())) < 0)
       goto err_close;
 
+    if (!ictx->read_only &&
+	(ictx->features & RBD_FEATURE_EXCLUSIVE_LOCK) != 0) {
+      // taken on the first update
+      ictx->exclusive_lock = new ExclusiveLock(*ictx);
+    }
+
+    if (!ictx->cct->_conf->rbd_persistent_cache_path.empty() &&
+	!ictx->read_only && ictx->snap_id == CEPH_NOSNAP) {
+      if (ictx->exclusive_lock == NULL) {
+	// another client could write the image behind the log's back
+	lderr(ictx->cct) << "persistent cache requires the exclusive lock "
+			 << "feature, not using it" << dendl;
+      } else {
+	ictx->persistent_cache = new PersistentCache(*ictx);
+	r = ictx->persistent_cache->init();
+	if (r < 0)
+	  goto err_close;
+
+	RWLock::RLocker owner_locker(ictx->owner_lock);
+	if (ictx->persistent_cache->is_dirty()) {
+	  // writing the log back needs the lock
+	  r = prepare_image_update(ictx);
+	  if (r < 0)
+	    goto err_close;
+	}
+	r = ictx->persistent_cache->replay();
+	if (r < 0)
+	  goto err_close;
+
+	if (ictx->object_cacher) {
+	  // the log absorbs writes; the ObjectCacher only caches reads
+	  Mutex::Locker l(ictx->cache_lock);
+	  ictx->object_cacher->set_max_dirty(0);
+	}
+      }
+    }
+
+    if (ictx->cct->_conf->rbd_clone_copy_on_read && !ictx->read_only &&
+	ictx->snap_id == CEPH_NOSNAP) {
+      RWLock::RLocker l(ictx->parent_lock);
+      if (ictx->parent != NULL)
+	ictx->copy_on_read = new CopyOnRead(*ictx);
+    }
+
     return 0;
 
   err_close:
@@ -2157,6 +2413,25 @@ reprotect_and_return_err:
 
     ictx->readahead.wait_for_pending();
 
+    if (ictx->copy_on_read) {
+      // copyups need the lock and the parent
+      ictx->copy_on_read->shut_down();
+      delete ictx->copy_on_read;
+      ictx->copy_on_read = NULL;
+    }
+
+    if (ictx->exclusive_lock) {
+      RWLock::WLocker l(ictx->owner_lock);
+      ictx->exclusive_lock->release_lock();
+    }
+
+    if (ictx->persistent_cache) {
+      // releasing the lock wrote it back, unless we never had it
+      ictx->persistent_cache->shut_down();
+      delete ictx->persistent_cache;
+      ictx->persistent_cache = NULL;
+    }
+
     if (ictx->object_cacher)
       ictx->shutdown_cache(); // implicitly flushes
     else
@@ -2170,6 +2445,10 @@ reprotect_and_return_err:
     if (ictx->wctx)
       ictx->unregister_watch();
 
+    // no more lock notifications can arrive
+    delete ictx->exclusive_lock;
+    ictx->exclusive_lock = NULL;
+
     delete ictx;
   }
 
@@ -2182,7 +2461,11 @@ reprotect_and_return_err:
     if (ictx->read_only)
       return -EROFS;
 
-    int r;
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0)
+      return r;
+
     // ictx_check also updates parent data
     if ((r = ictx_check(ictx)) < 0) {
       lderr(cct) << "ictx_check failed" << dendl;
@@ -2231,6 +2514,14 @@ reprotect_and_return_err:
 	}
       }
 
+      // an object the child already has never needs a copyup
+      uint8_t state = ictx->object_map.get_state(ono);
+      if (ictx->object_map.enabled() &&
+	  (state == OBJECT_EXISTS || state == OBJECT_EXISTS_CLEAN)) {
+	prog_ctx.update_progress(ono, overlap_objects);
+	continue;
+      }
+
       // map child object onto the parent
       vector<pair<uint64_t,uint64_t> > objectx;
       Striper::extent_to_file(cct, &ictx->layout,
@@ -2493,6 +2784,7 @@ reprotect_and_return_err:
 			 << " len = " << len << dendl;
 
     // ensure previous writes are visible to listsnaps
+    writeback_persistent_cache(ictx);
     _flush(ictx);
 
     int r = ictx_check(ictx);
@@ -2554,6 +2846,15 @@ reprotect_and_return_err:
 	return r;
     }
 
+    // the object maps tell which objects changed in each snapshot
+    // interval, so only those need a list_snaps
+    vector<bool> changed_objects;
+    bool use_object_map =
+      ictx->object_map.diff(from_snap_id, end_snap_id, &changed_objects) == 0;
+    if (use_object_map)
+      ldout(ictx->cct, 10) << "diff_iterate using object maps for "
+			   << changed_objects.size() << " objects" << dendl;
+
     uint64_t period = ictx->get_stripe_period();
     uint64_t left = len;
 
@@ -2573,7 +2874,12 @@ reprotect_and_return_err:
 	ldout(ictx->cct, 20) << "diff_iterate object " << p->first << dendl;
 
 	librados::snap_set_t snap_set;
-	int r = head_ctx.list_snaps(p->first.name, &snap_set);
+	int r = -ENOENT;
+	uint64_t object_no = p->second.front().objectno;
+	if (!use_object_map ||
+	    (object_no < changed_objects.size() &&
+	     changed_objects[object_no]))
+	  r = head_ctx.list_snaps(p->first.name, &snap_set);
 	if (r == -ENOENT) {
 	  if (from_snap_id == 0 && !parent_diff.empty()) {
 	    // report parent diff instead
@@ -2886,7 +3192,10 @@ reprotect_and_return_err:
     c->add_request();
     c->init_time(ictx, AIO_TYPE_FLUSH);
     C_AioWrite *req_comp = new C_AioWrite(cct, c);
-    if (ictx->object_cacher) {
+    if (ictx->persistent_cache) {
+      // the log is durable; writeback to the cluster carries on
+      ictx->persistent_cache->aio_flush(req_comp);
+    } else if (ictx->object_cacher) {
       ictx->flush_cache_aio(req_comp);
     } else {
       librados::AioCompletion *rados_completion =
@@ -2912,7 +3221,11 @@ reprotect_and_return_err:
     }
 
     ictx->user_flushed();
-    r = _flush(ictx);
+    if (ictx->persistent_cache) {
+      r = ictx->persistent_cache->flush();
+    } else {
+      r = _flush(ictx);
+    }
     ictx->perfcounter->inc(l_librbd_flush);
     return r;
   }
@@ -2951,10 +3264,58 @@ reprotect_and_return_err:
 
   int aio_write(ImageCtx *ictx, uint64_t off, size_t len, const char *buf,
 		AioCompletion *c)
+  {
+    ldout(ictx->cct, 20) << "aio_write " << ictx << " off = " << off
+			 << " len = " << len << " buf = " << (void*)buf << dendl;
+
+    bufferlist bl;
+    bl.append(buf, len);
+    return aio_write(ictx, off, bl, c);
+  }
+
+  int aio_writev(ImageCtx *ictx, uint64_t off, const struct iovec *iov,
+		 int iovcnt, AioCompletion *c)
+  {
+    ldout(ictx->cct, 20) << "aio_writev " << ictx << " off = " << off
+			 << " iovcnt = " << iovcnt << dendl;
+    if (iovcnt <= 0)
+      return -EINVAL;
+
+    // the cache keeps what it's given past completion, so it needs a
+    // copy; otherwise the segments go out as they are
+    bufferlist bl;
+    for (int i = 0; i < iovcnt; ++i) {
+      if (iov[i].iov_len == 0)
+	continue;
+      if (ictx->object_cacher) {
+	bl.append((const char *)iov[i].iov_base, iov[i].iov_len);
+      } else {
+	bl.push_back(buffer::create_static(iov[i].iov_len,
+					   (char *)iov[i].iov_base));
+      }
+    }
+    return aio_write(ictx, off, bl, c);
+  }
+
+  int aio_write(ImageCtx *ictx, uint64_t off, const bufferlist &data,
+		AioCompletion *c)
+  {
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    return _aio_write(ictx, off, data, ictx->persistent_cache != NULL, c);
+  }
+
+  // writes back from the persistent cache don't take owner_lock, which
+  // releasing the exclusive lock holds while waiting for them
+  int _aio_write(ImageCtx *ictx, uint64_t off, const bufferlist &data,
+		 bool persistent, AioCompletion *c)
   {
     CephContext *cct = ictx->cct;
-    ldout(cct, 20) << "aio_write " << ictx << " off = " << off << " len = "
-		   << len << " buf = " << (void*)buf << dendl;
+    size_t len = data.length();
 
     int r = ictx_check(ictx);
     if (r < 0) {
@@ -2982,24 +3343,41 @@ reprotect_and_return_err:
 
     ldout(cct, 20) << "  parent overlap " << overlap << dendl;
 
+    if (persistent && !ictx->persistent_cache->is_loggable(mylen)) {
+      // too big for the log, so it can only follow what's logged
+      r = ictx->persistent_cache->writeback(off, mylen);
+      if (r < 0) {
+	return r;
+      }
+      persistent = false;
+    }
+
     // map
     vector<ObjectExtent> extents;
-    if (len > 0) {
+    if (len > 0 && !persistent) {
       Striper::file_to_extents(ictx->cct, ictx->format_string,
 			       &ictx->layout, off, mylen, 0, extents);
     }
 
     c->get();
     c->init_time(ictx, AIO_TYPE_WRITE);
+    if (persistent && mylen > 0) {
+      bufferlist bl;
+      bl.substr_of(data, 0, mylen);
+      c->add_request();
+      ictx->persistent_cache->append(off, bl, new C_AioWrite(cct, c));
+    }
     for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
       ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
 		     << " from " << p->buffer_extents << dendl;
-      // assemble extent
+      // assemble extent; segments adjacent in the object share one op
       bufferlist bl;
       for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
 	   q != p->buffer_extents.end();
 	   ++q) {
-	bl.append(buf + q->first, q->second);
+	bufferlist sub;
+	sub.substr_of(data, q->first, q->second);
+	bl.claim_append(sub);
       }
 
       C_AioWrite *req_comp = new C_AioWrite(cct, c);
@@ -3040,7 +3418,13 @@ reprotect_and_return_err:
     ldout(cct, 20) << "aio_discard " << ictx << " off = " << off << " len = "
 		   << len << dendl;
 
-    int r = ictx_check(ictx);
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    r = ictx_check(ictx);
     if (r < 0) {
       return r;
     }
@@ -3050,6 +3434,14 @@ reprotect_and_return_err:
       return r;
     }
 
+    if (ictx->persistent_cache) {
+      // logged writes to the extent must not land after the discard
+      r = ictx->persistent_cache->writeback(off, len);
+      if (r < 0) {
+	return r;
+      }
+    }
+
     // TODO: check for snap
     ictx->snap_lock.get_read();
     snapid_t snap_id = ictx->snap_id;
@@ -3123,6 +3515,239 @@ reprotect_and_return_err:
     return r;
   }
 
+  // turns the OSD's encoded mismatch offset into -EILSEQ plus an
+  // image offset
+  class C_CompareAndWrite : public Context {
+  public:
+    C_CompareAndWrite(Context *on_finish, uint64_t image_off,
+		      uint64_t *mismatch_off)
+      : m_on_finish(on_finish), m_image_off(image_off),
+	m_mismatch_off(mismatch_off) {}
+    virtual void finish(int r) {
+      if (r <= -MAX_ERRNO) {
+	if (m_mismatch_off != NULL)
+	  *m_mismatch_off = m_image_off + (-MAX_ERRNO - r);
+	r = -EILSEQ;
+      }
+      m_on_finish->complete(r);
+    }
+  private:
+    Context *m_on_finish;
+    uint64_t m_image_off;
+    uint64_t *m_mismatch_off;
+  };
+
+  int aio_compare_and_write(ImageCtx *ictx, uint64_t off, size_t len,
+			    const char *cmp_buf, const char *buf,
+			    uint64_t *mismatch_off, AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    ldout(cct, 20) << "aio_compare_and_write " << ictx << " off = " << off
+		   << " len = " << len << dendl;
+
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    r = ictx_check(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    uint64_t mylen = len;
+    r = clip_io(ictx, off, &mylen);
+    if (r < 0) {
+      return r;
+    }
+    if (len == 0 || mylen != len) {
+      return -EINVAL;
+    }
+
+    ictx->snap_lock.get_read();
+    snapid_t snap_id = ictx->snap_id;
+    ::SnapContext snapc = ictx->snapc;
+    ictx->parent_lock.get_read();
+    uint64_t overlap = 0;
+    ictx->get_parent_overlap(ictx->snap_id, &overlap);
+    ictx->parent_lock.put_read();
+    ictx->snap_lock.put_read();
+
+    if (snap_id != CEPH_NOSNAP || ictx->read_only) {
+      return -EROFS;
+    }
+
+    // the compare is only atomic within one object
+    vector<ObjectExtent> extents;
+    Striper::file_to_extents(ictx->cct, ictx->format_string,
+			     &ictx->layout, off, len, 0, extents);
+    if (extents.size() != 1 || extents[0].buffer_extents.size() != 1) {
+      ldout(cct, 20) << "compare and write spans objects" << dendl;
+      return -EINVAL;
+    }
+    ObjectExtent &extent = extents[0];
+
+    if (ictx->persistent_cache) {
+      r = ictx->persistent_cache->writeback(off, len);
+      if (r < 0) {
+	return r;
+      }
+    }
+    if (ictx->object_cacher) {
+      // the OSD must see any dirty data for the extent, and the cache
+      // must not return what it held before the write
+      r = _flush(ictx);
+      if (r < 0) {
+	return r;
+      }
+      Mutex::Locker l(ictx->cache_lock);
+      ictx->object_cacher->discard_set(ictx->object_set, extents);
+    }
+
+    vector<pair<uint64_t,uint64_t> > objectx;
+    Striper::extent_to_file(ictx->cct, &ictx->layout,
+			    extent.objectno, 0, ictx->layout.fl_object_size,
+			    objectx);
+    uint64_t object_overlap = ictx->prune_parent_extents(objectx, overlap);
+
+    bufferlist cmp_bl;
+    cmp_bl.append(cmp_buf, len);
+    bufferlist bl;
+    bl.append(buf, len);
+
+    c->get();
+    c->init_time(ictx, AIO_TYPE_WRITE);
+    Context *req_comp = new C_CompareAndWrite(new C_AioWrite(cct, c), off,
+					      mismatch_off);
+    AioCompareAndWrite *req = new AioCompareAndWrite(
+      ictx, extent.oid.name, extent.objectno, extent.offset, objectx,
+      object_overlap, cmp_bl, bl, snapc, snap_id, req_comp);
+    c->add_request();
+    r = req->send();
+
+    c->finish_adding_requests(ictx->cct);
+    c->put();
+
+    ictx->perfcounter->inc(l_librbd_aio_wr);
+    ictx->perfcounter->inc(l_librbd_aio_wr_bytes, len);
+    return r;
+  }
+
+  int aio_writesame(ImageCtx *ictx, uint64_t off, size_t len,
+		    const char *buf, size_t data_len, AioCompletion *c)
+  {
+    CephContext *cct = ictx->cct;
+    ldout(cct, 20) << "aio_writesame " << ictx << " off = " << off
+		   << " len = " << len << " data_len = " << data_len << dendl;
+
+    if (data_len == 0 || len % data_len != 0) {
+      return -EINVAL;
+    }
+
+    bufferlist pattern;
+    pattern.append(buf, data_len);
+    if (pattern.is_zero()) {
+      // reads of discarded extents return zeros
+      return aio_discard(ictx, off, len, c);
+    }
+
+    if (ictx->object_cacher || ictx->persistent_cache) {
+      // the caches only deal in plain writes
+      bufferlist bl;
+      for (uint64_t i = 0; i < len; i += data_len)
+	bl.append(buf, data_len);
+      return aio_write(ictx, off, bl, c);
+    }
+
+    RWLock::RLocker owner_locker(ictx->owner_lock);
+    int r = prepare_image_update(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    r = ictx_check(ictx);
+    if (r < 0) {
+      return r;
+    }
+
+    uint64_t mylen = len;
+    r = clip_io(ictx, off, &mylen);
+    if (r < 0) {
+      return r;
+    }
+
+    ictx->snap_lock.get_read();
+    snapid_t snap_id = ictx->snap_id;
+    ::SnapContext snapc = ictx->snapc;
+    ictx->parent_lock.get_read();
+    uint64_t overlap = 0;
+    ictx->get_parent_overlap(ictx->snap_id, &overlap);
+    ictx->parent_lock.put_read();
+    ictx->snap_lock.put_read();
+
+    if (snap_id != CEPH_NOSNAP || ictx->read_only) {
+      return -EROFS;
+    }
+
+    vector<ObjectExtent> extents;
+    if (mylen > 0) {
+      Striper::file_to_extents(ictx->cct, ictx->format_string,
+			       &ictx->layout, off, mylen, 0, extents);
+    }
+
+    c->get();
+    c->init_time(ictx, AIO_TYPE_WRITE);
+    for (vector<ObjectExtent>::iterator p = extents.begin(); p != extents.end(); ++p) {
+      ldout(cct, 20) << " oid " << p->oid << " " << p->offset << "~" << p->length
+		     << " from " << p->buffer_extents << dendl;
+      vector<pair<uint64_t,uint64_t> > objectx;
+      Striper::extent_to_file(ictx->cct, &ictx->layout,
+			      p->objectno, 0, ictx->layout.fl_object_size,
+			      objectx);
+      uint64_t object_overlap = ictx->prune_parent_extents(objectx, overlap);
+
+      C_AioWrite *req_comp = new C_AioWrite(cct, c);
+      AbstractWrite *req;
+      if (p->buffer_extents.size() == 1) {
+	// rotate the pattern so it lines up with the start of the extent
+	uint64_t phase = p->buffer_extents[0].first % data_len;
+	bufferlist head, tail;
+	tail.substr_of(pattern, phase, data_len - phase);
+	head.substr_of(pattern, 0, phase);
+	tail.claim_append(head);
+	req = new AioWriteSame(ictx, p->oid.name, p->objectno, p->offset,
+			       p->length, objectx, object_overlap, tail, snapc,
+			       snap_id, req_comp);
+      } else {
+	// striped pieces of the request interleave within the object
+	bufferlist bl;
+	for (vector<pair<uint64_t,uint64_t> >::iterator q = p->buffer_extents.begin();
+	     q != p->buffer_extents.end(); ++q) {
+	  for (uint64_t i = 0; i < q->second; ) {
+	    uint64_t phase = (q->first + i) % data_len;
+	    uint64_t n = MIN(data_len - phase, q->second - i);
+	    bl.append(buf + phase, n);
+	    i += n;
+	  }
+	}
+	req = new AioWrite(ictx, p->oid.name, p->objectno, p->offset,
+			   objectx, object_overlap, bl, snapc, snap_id,
+			   req_comp);
+      }
+      c->add_request();
+      r = req->send();
+      if (r < 0)
+	break;
+    }
+    c->finish_adding_requests(ictx->cct);
+    c->put();
+
+    ictx->perfcounter->inc(l_librbd_aio_wr);
+    ictx->perfcounter->inc(l_librbd_aio_wr_bytes, mylen);
+    return r;
+  }
+
   void rbd_req_cb(completion_t cb, void *arg)
   {
     AioRequest *req = reinterpret_cast<AioRequest *>(arg);
@@ -3139,6 +3764,22 @@ reprotect_and_return_err:
     return aio_read(ictx, image_extents, buf, bl, c);
   }
 
+  int aio_readv(ImageCtx *ictx, uint64_t off, const struct iovec *iov,
+		int iovcnt, AioCompletion *c)
+  {
+    if (iovcnt <= 0)
+      return -EINVAL;
+
+    uint64_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+      len += iov[i].iov_len;
+
+    c->read_iov.assign(iov, iov + iovcnt);
+    vector<pair<uint64_t,uint64_t> > image_extents(1);
+    image_extents[0] = make_pair(off, len);
+    return aio_read(ictx, image_extents, NULL, NULL, c);
+  }
+
   struct C_RBD_Readahead : public Context {
     ImageCtx *ictx;
     object_t oid;
@@ -3214,7 +3855,8 @@ reprotect_and_return_err:
 
     // readahead
     const md_config_t *conf = ictx->cct->_conf;
-    if (ictx->object_cacher && conf->rbd_readahead_max_bytes > 0) {
+    if (ictx->object_cacher && !ictx->parent_cache &&
+	conf->rbd_readahead_max_bytes > 0) {
       readahead(ictx, image_extents, conf);
     }
 
@@ -3235,6 +3877,10 @@ reprotect_and_return_err:
 
       Striper::file_to_extents(ictx->cct, ictx->format_string, &ictx->layout,
 			       p->first, len, 0, object_extents, buffer_ofs);
+      if (ictx->persistent_cache && snap_id == CEPH_NOSNAP) {
+	ictx->persistent_cache->read(p->first, len, buffer_ofs,
+				     &c->read_overlay);
+      }
       buffer_ofs += len;
     }
 
@@ -3259,7 +3905,7 @@ reprotect_and_return_err:
 	req_comp->set_req(req);
 	c->add_request();
 
-	if (ictx->object_cacher) {
+	if (ictx->object_cacher && !ictx->parent_cache) {
 	  C_CacheRead *cache_comp = new C_CacheRead(req);
 	  ictx->aio_read_from_cache(q->oid, &req->data(),
 				    q->length, q->offset,
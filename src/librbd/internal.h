@@ -119,6 +119,10 @@ namespace librbd {
   int rm_snap(ImageCtx *ictx, const char *snap_name);
   int refresh_parent(ImageCtx *ictx);
   int ictx_check(ImageCtx *ictx);
+  /// take the exclusive lock, if the image uses one (owner_lock held)
+  int prepare_image_update(ImageCtx *ictx);
+  /// write back the persistent cache, if any (md_lock must not be held)
+  int writeback_persistent_cache(ImageCtx *ictx);
   int ictx_refresh(ImageCtx *ictx);
   int copy(ImageCtx *ictx, IoCtx& dest_md_ctx, const char *destname,
 	   ProgressContext &prog_ctx);
@@ -184,11 +188,24 @@ namespace librbd {
   int discard(ImageCtx *ictx, uint64_t off, uint64_t len);
   int aio_write(ImageCtx *ictx, uint64_t off, size_t len, const char *buf,
 		AioCompletion *c);
+  int aio_write(ImageCtx *ictx, uint64_t off, const bufferlist &bl,
+		AioCompletion *c);
+  int _aio_write(ImageCtx *ictx, uint64_t off, const bufferlist &bl,
+		 bool persistent, AioCompletion *c);
+  int aio_writev(ImageCtx *ictx, uint64_t off, const struct iovec *iov,
+		 int iovcnt, AioCompletion *c);
   int aio_discard(ImageCtx *ictx, uint64_t off, uint64_t len, AioCompletion *c);
+  int aio_compare_and_write(ImageCtx *ictx, uint64_t off, size_t len,
+			    const char *cmp_buf, const char *buf,
+			    uint64_t *mismatch_off, AioCompletion *c);
+  int aio_writesame(ImageCtx *ictx, uint64_t off, size_t len,
+		    const char *buf, size_t data_len, AioCompletion *c);
   int aio_read(ImageCtx *ictx, uint64_t off, size_t len,
 	       char *buf, bufferlist *pbl, AioCompletion *c);
   int aio_read(ImageCtx *ictx, const vector<pair<uint64_t,uint64_t> >& image_extents,
 	       char *buf, bufferlist *pbl, AioCompletion *c);
+  int aio_readv(ImageCtx *ictx, uint64_t off, const struct iovec *iov,
+		int iovcnt, AioCompletion *c);
   int aio_flush(ImageCtx *ictx, AioCompletion *c);
   int flush(ImageCtx *ictx);
   int _flush(ImageCtx *ictx);
@@ -678,6 +678,35 @@ namespace librbd {
     return r;
   }
 
+  int Image::aio_compare_and_write(uint64_t off, size_t len,
+				   bufferlist& cmp_bl, bufferlist& bl,
+				   RBD::AioCompletion *c,
+				   uint64_t *mismatch_off)
+  {
+    ImageCtx *ictx = (ImageCtx *)ctx;
+    tracepoint(librbd, aio_compare_and_write_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, off, len, c->pc);
+    if (cmp_bl.length() < len || bl.length() < len) {
+      tracepoint(librbd, aio_compare_and_write_exit, -EINVAL);
+      return -EINVAL;
+    }
+    int r = librbd::aio_compare_and_write(ictx, off, len, cmp_bl.c_str(),
+					  bl.c_str(), mismatch_off,
+					  (librbd::AioCompletion *)c->pc);
+    tracepoint(librbd, aio_compare_and_write_exit, r);
+    return r;
+  }
+
+  int Image::aio_writesame(uint64_t off, size_t len, bufferlist& bl,
+			   RBD::AioCompletion *c)
+  {
+    ImageCtx *ictx = (ImageCtx *)ctx;
+    tracepoint(librbd, aio_writesame_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, off, len, bl.length(), c->pc);
+    int r = librbd::aio_writesame(ictx, off, len, bl.c_str(), bl.length(),
+				  (librbd::AioCompletion *)c->pc);
+    tracepoint(librbd, aio_writesame_exit, r);
+    return r;
+  }
+
   int Image::aio_read(uint64_t off, size_t len, bufferlist& bl,
 		      RBD::AioCompletion *c)
   {
@@ -1510,6 +1539,34 @@ extern "C" int rbd_aio_discard(rbd_image_t image, uint64_t off, uint64_t len,
   return r;
 }
 
+extern "C" int rbd_aio_compare_and_write(rbd_image_t image, uint64_t off,
+					 size_t len, const char *cmp_buf,
+					 const char *buf, rbd_completion_t c,
+					 uint64_t *mismatch_off)
+{
+  librbd::ImageCtx *ictx = (librbd::ImageCtx *)image;
+  librbd::RBD::AioCompletion *comp = (librbd::RBD::AioCompletion *)c;
+  tracepoint(librbd, aio_compare_and_write_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, off, len, comp->pc);
+  int r = librbd::aio_compare_and_write(ictx, off, len, cmp_buf, buf,
+					mismatch_off,
+					(librbd::AioCompletion *)comp->pc);
+  tracepoint(librbd, aio_compare_and_write_exit, r);
+  return r;
+}
+
+extern "C" int rbd_aio_writesame(rbd_image_t image, uint64_t off, size_t len,
+				 const char *buf, size_t data_len,
+				 rbd_completion_t c)
+{
+  librbd::ImageCtx *ictx = (librbd::ImageCtx *)image;
+  librbd::RBD::AioCompletion *comp = (librbd::RBD::AioCompletion *)c;
+  tracepoint(librbd, aio_writesame_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, off, len, data_len, comp->pc);
+  int r = librbd::aio_writesame(ictx, off, len, buf, data_len,
+				(librbd::AioCompletion *)comp->pc);
+  tracepoint(librbd, aio_writesame_exit, r);
+  return r;
+}
+
 extern "C" int rbd_aio_read(rbd_image_t image, uint64_t off, size_t len,
 			    char *buf, rbd_completion_t c)
 {
@@ -1522,6 +1579,30 @@ extern "C" int rbd_aio_read(rbd_image_t image, uint64_t off, size_t len,
   return r;
 }
 
+extern "C" int rbd_aio_writev(rbd_image_t image, const struct iovec *iov,
+			      int iovcnt, uint64_t off, rbd_completion_t c)
+{
+  librbd::ImageCtx *ictx = (librbd::ImageCtx *)image;
+  librbd::RBD::AioCompletion *comp = (librbd::RBD::AioCompletion *)c;
+  tracepoint(librbd, aio_writev_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, iovcnt, off, comp->pc);
+  int r = librbd::aio_writev(ictx, off, iov, iovcnt,
+			     (librbd::AioCompletion *)comp->pc);
+  tracepoint(librbd, aio_writev_exit, r);
+  return r;
+}
+
+extern "C" int rbd_aio_readv(rbd_image_t image, const struct iovec *iov,
+			     int iovcnt, uint64_t off, rbd_completion_t c)
+{
+  librbd::ImageCtx *ictx = (librbd::ImageCtx *)image;
+  librbd::RBD::AioCompletion *comp = (librbd::RBD::AioCompletion *)c;
+  tracepoint(librbd, aio_readv_enter, ictx, ictx->name.c_str(), ictx->snap_name.c_str(), ictx->read_only, iovcnt, off, comp->pc);
+  int r = librbd::aio_readv(ictx, off, iov, iovcnt,
+			    (librbd::AioCompletion *)comp->pc);
+  tracepoint(librbd, aio_readv_exit, r);
+  return r;
+}
+
 extern "C" int rbd_flush(rbd_image_t image)
 {
   librbd::ImageCtx *ictx = (librbd::ImageCtx *)image;
@@ -225,8 +225,7 @@ struct ceph_osd_request_head {
       //::encode(ops, payload);
       __u16 num_ops = ops.size();
       ::encode(num_ops, payload);
-      for (unsigned i = 0; i < ops.size(); i++)
-	::encode(ops[i].op, payload);
+      OSDOp::encode_osd_op_vector_nohead(ops, payload);
 
       ::encode_nohead(oid.name, payload);
       ::encode_nohead(snaps, payload);
@@ -243,8 +242,7 @@ struct ceph_osd_request_head {
 
       __u16 num_ops = ops.size();
       ::encode(num_ops, payload);
-      for (unsigned i = 0; i < ops.size(); i++)
-	::encode(ops[i].op, payload);
+      OSDOp::encode_osd_op_vector_nohead(ops, payload);
 
       ::encode(snapid, payload);
       ::encode(snap_seq, payload);
@@ -0,0 +1,70 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MOSDOPBATCH_H
+#define CEPH_MOSDOPBATCH_H
+
+#include "msg/Message.h"
+#include "messages/MOSDOp.h"
+
+/*
+ * Several independent ops sent to one OSD in one message.
+ *
+ * Each op is encoded as a complete MOSDOp, and the OSD dispatches it
+ * as if it had arrived on its own, so ops in a batch may be for
+ * different PGs and each gets its own MOSDOpReply.
+ */
+class MOSDOpBatch : public Message {
+  static const int HEAD_VERSION = 1;
+  static const int COMPAT_VERSION = 1;
+
+public:
+  list<MOSDOp*> ops;
+
+  MOSDOpBatch()
+    : Message(CEPH_MSG_OSD_OP_BATCH, HEAD_VERSION, COMPAT_VERSION) {}
+private:
+  ~MOSDOpBatch() {
+    for (list<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  void encode_payload(uint64_t features) {
+    __u32 n = ops.size();
+    ::encode(n, payload);
+    for (list<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p)
+      encode_message(*p, features, payload);
+  }
+  void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    __u32 n;
+    ::decode(n, p);
+    while (n--) {
+      Message *m = decode_message(get_cct(), p);
+      if (!m)
+	throw buffer::malformed_input("undecodable op in osd_op_batch");
+      if (m->get_type() != CEPH_MSG_OSD_OP) {
+	m->put();
+	throw buffer::malformed_input("unexpected message in osd_op_batch");
+      }
+      ops.push_back(static_cast<MOSDOp*>(m));
+    }
+  }
+
+  const char *get_type_name() const { return "osd_op_batch"; }
+  void print(ostream& out) const {
+    out << "osd_op_batch(" << ops.size() << " ops)";
+  }
+};
+
+#endif
@@ -178,8 +178,7 @@ public:
 
       __u32 num_ops = ops.size();
       ::encode(num_ops, payload);
-      for (unsigned i = 0; i < num_ops; i++)
-	::encode(ops[i].op, payload);
+      OSDOp::encode_osd_op_vector_nohead(ops, payload);
 
       ::encode(retry_attempt, payload);
 
@@ -20,16 +20,19 @@
 
 
 class MWatchNotify : public Message {
-  static const int HEAD_VERSION = 2;
+  static const int HEAD_VERSION = 3;
   static const int COMPAT_VERSION = 1;
 
  public:
   uint64_t cookie;     ///< client unique id for this watch or notify
   uint64_t ver;        ///< unused
   uint64_t notify_id;  ///< osd unique id for a notify notification
-  uint8_t opcode;      ///< always WATCH_NOTIFY
-  bufferlist bl;       ///< notify payload (osd->client)
+  uint8_t opcode;      ///< WATCH_NOTIFY or WATCH_NOTIFY_COMPLETE
+  bufferlist bl;       ///< notify payload, or watcher replies on completion
   int32_t return_code; ///< notify result (osd->client)
+  /// all watches this notification is for, when one connection has
+  /// several on the object (cookie is the first); empty otherwise
+  vector<uint64_t> cookies;
 
   MWatchNotify()
     : Message(CEPH_MSG_WATCH_NOTIFY, HEAD_VERSION, COMPAT_VERSION) { }
@@ -59,6 +62,8 @@ public:
       ::decode(return_code, p);
     else
       return_code = 0;
+    if (header.version >= 3)
+      ::decode(cookies, p);
   }
   void encode_payload(uint64_t features) {
     uint8_t msg_ver = 1;
@@ -69,11 +74,15 @@ public:
     ::encode(notify_id, payload);
     ::encode(bl, payload);
     ::encode(return_code, payload);
+    ::encode(cookies, payload);
   }
 
   const char *get_type_name() const { return "watch-notify"; }
   void print(ostream& out) const {
-    out << "watch-notify(c=" << cookie << " v=" << ver << " i=" << notify_id << " opcode=" << (int)opcode << " r = " << return_code << ")";
+    out << "watch-notify(c=" << cookie;
+    if (!cookies.empty())
+      out << " cookies=" << cookies;
+    out << " v=" << ver << " i=" << notify_id << " opcode=" << (int)opcode << " r = " << return_code << ")";
   }
 };
 
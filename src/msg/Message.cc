@@ -62,6 +62,7 @@ using namespace std;
 #include "messages/MOSDMarkMeDown.h"
 #include "messages/MOSDPing.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
@@ -407,6 +408,9 @@ Message *decode_message(CephContext *cct, ceph_msg_header& header, ceph_msg_foot
   case CEPH_MSG_OSD_OPREPLY:
     m = new MOSDOpReply();
     break;
+  case CEPH_MSG_OSD_OP_BATCH:
+    m = new MOSDOpBatch();
+    break;
   case MSG_OSD_SUBOP:
     m = new MOSDSubOp();
     break;
@@ -109,11 +109,23 @@ public:
     ::decode(_type, bl);
     ::decode(_num, bl);
   }
+  void bound_encode(size_t& p) const {
+    p += sizeof(_type) + sizeof(ceph_le64);
+  }
+  void encode(contiguous_appender& p) const {
+    ::encode(_type, p);
+    ::encode(_num, p);
+  }
+  void decode(contiguous_decoder& p) {
+    ::decode(_type, p);
+    ::decode(_num, p);
+  }
   void dump(Formatter *f) const;
 
   static void generate_test_instances(list<entity_name_t*>& o);
 };
 WRITE_CLASS_ENCODER(entity_name_t)
+WRITE_CLASS_DENC(entity_name_t)
 
 inline bool operator== (const entity_name_t& l, const entity_name_t& r) { 
   return (l.type() == r.type()) && (l.num() == r.num()); }
@@ -168,6 +180,22 @@ static inline void decode(sockaddr_storage& a, bufferlist::iterator& bl) {
   a.ss_family = ntohs(a.ss_family);
 #endif
 }
+static inline void bound_encode(const sockaddr_storage& a, size_t& p) {
+  p += sizeof(a);
+}
+static inline void encode(const sockaddr_storage& a, contiguous_appender& p) {
+  struct sockaddr_storage ss = a;
+#if !defined(__FreeBSD__)
+  ss.ss_family = htons(ss.ss_family);
+#endif
+  memcpy(p.get_pos_add(sizeof(ss)), &ss, sizeof(ss));
+}
+static inline void decode(sockaddr_storage& a, contiguous_decoder& p) {
+  memcpy(&a, p.get_pos_add(sizeof(a)), sizeof(a));
+#if !defined(__FreeBSD__)
+  a.ss_family = ntohs(a.ss_family);
+#endif
+}
 
 struct entity_addr_t {
   __u32 type;
@@ -334,12 +362,27 @@ struct entity_addr_t {
     ::decode(nonce, bl);
     ::decode(addr, bl);
   }
+  void bound_encode(size_t& p) const {
+    p += sizeof(ceph_le32) * 2;
+    ::bound_encode(addr, p);
+  }
+  void encode(contiguous_appender& p) const {
+    ::encode(type, p);
+    ::encode(nonce, p);
+    ::encode(addr, p);
+  }
+  void decode(contiguous_decoder& p) {
+    ::decode(type, p);
+    ::decode(nonce, p);
+    ::decode(addr, p);
+  }
 
   void dump(Formatter *f) const;
 
   static void generate_test_instances(list<entity_addr_t*>& o);
 };
 WRITE_CLASS_ENCODER(entity_addr_t)
+WRITE_CLASS_DENC(entity_addr_t)
 
 inline ostream& operator<<(ostream& out, const entity_addr_t &addr)
 {
@@ -16,6 +16,7 @@
 
 #include "include/Context.h"
 #include "include/buffer.h"
+#include "include/ceph_features.h"
 #include "include/types.h"
 #include "osd/osd_types.h"
 #include "common/TrackedOp.h"
@@ -383,12 +384,48 @@ public:
       COLL_HINT_EXPECTED_NUM_OBJECTS = 1,
     };
 
+    /**
+     * Op
+     *
+     * Fixed-size, little-endian description of one operation.  The
+     * collections and objects an op refers to are indexes into the
+     * per-transaction coll_index and object_index tables; names, attrs,
+     * keys and data follow in data_bl in the order the op consumes
+     * them.  Fields an op does not use are left zero (NO_INDEX for the
+     * table references).
+     */
+    struct Op {
+      __le32 op;
+      __le32 cid;
+      __le32 oid;
+      __le32 dest_cid;       ///< OP_COLL_ADD, OP_COLL_MOVE_RENAME, splits
+      __le32 dest_oid;       ///< OP_CLONE*, OP_COLL_MOVE_RENAME
+      __le32 hint_type;      ///< OP_COLL_HINT
+      __le32 split_bits;     ///< OP_SPLIT_COLLECTION*
+      __le32 split_rem;
+      __le64 off;
+      __le64 len;
+      __le64 dest_off;       ///< OP_CLONERANGE2
+      __le64 expected_object_size;  ///< OP_SETALLOCHINT
+      __le64 expected_write_size;
+    } __attribute__ ((packed));
+
+    static const __u32 NO_INDEX = (__u32)-1;
+
   private:
-    uint64_t ops;
-    uint64_t pad_unused_bytes;
-    uint32_t largest_data_len, largest_data_off, largest_data_off_in_tbl;
-    bufferlist tbl;
-    bool sobject_encoding;
+    struct TransactionData {
+      __le64 ops;
+      __le32 largest_data_len;
+      __le32 largest_data_off;
+      __le32 largest_data_off_in_data_bl;
+    } __attribute__ ((packed));
+
+    TransactionData data;
+    map<coll_t, __u32> coll_index;
+    map<ghobject_t, __u32> object_index;
+    bufferlist data_bl;  ///< names, attrs, keys and write payloads
+    bufferlist op_bl;    ///< packed Op structs, data.ops of them
+
     int64_t pool_override;
     bool use_pool_override;
     bool replica;
@@ -398,6 +435,58 @@ public:
     list<Context *> on_commit;
     list<Context *> on_applied_sync;
 
+    Op *_get_next_op() {
+      char *p = op_bl.obtain_contiguous_space(sizeof(Op));
+      memset(p, 0, sizeof(Op));
+      op_bl.commit_contiguous_space(sizeof(Op));
+      Op *op = reinterpret_cast<Op*>(p);
+      op->cid = NO_INDEX;
+      op->oid = NO_INDEX;
+      op->dest_cid = NO_INDEX;
+      op->dest_oid = NO_INDEX;
+      data.ops = data.ops + 1;
+      return op;
+    }
+    Op *_get_next_op(__u32 code) {
+      Op *op = _get_next_op();
+      op->op = code;
+      return op;
+    }
+    __u32 _get_coll_id(const coll_t& cid) {
+      map<coll_t, __u32>::iterator p = coll_index.lower_bound(cid);
+      if (p != coll_index.end() && p->first == cid)
+	return p->second;
+      __u32 id = coll_index.size();
+      coll_index.insert(p, make_pair(cid, id));
+      return id;
+    }
+    __u32 _get_object_id(const ghobject_t& oid) {
+      map<ghobject_t, __u32>::iterator p = object_index.lower_bound(oid);
+      if (p != object_index.end() && p->first == oid)
+	return p->second;
+      __u32 id = object_index.size();
+      object_index.insert(p, make_pair(oid, id));
+      return id;
+    }
+    /// append a write payload to data_bl, tracking the largest one
+    void _encode_write_data(uint64_t off, const bufferlist& bl) {
+      if (bl.length() > data.largest_data_len) {
+	data.largest_data_len = bl.length();
+	data.largest_data_off = off;
+	data.largest_data_off_in_data_bl = data_bl.length() +
+	  sizeof(__u32);  // we are about to
+      }
+      ::encode(bl, data_bl);
+    }
+    /// legacy (struct_v < 6) transactions may carry oids without a pool
+    bool _needs_pool_override(const ghobject_t& oid) const {
+      return use_pool_override && pool_override != -1 &&
+	!oid.hobj.is_max() && oid.hobj.pool == -1;
+    }
+
+    void _encode_legacy(bufferlist& bl) const;
+    void _build_actions_from_tbl(bufferlist& tbl, bool sobject_encoding);
+
   public:
     /* Operations on callback contexts */
     void register_on_applied(Context *c) {
@@ -460,37 +549,35 @@ public:
     bool get_replica() { return replica; }
 
     void swap(Transaction& other) {
-      std::swap(ops, other.ops);
-      std::swap(largest_data_len, other.largest_data_len);
-      std::swap(largest_data_off, other.largest_data_off);
-      std::swap(largest_data_off_in_tbl, other.largest_data_off_in_tbl);
+      std::swap(data, other.data);
       std::swap(on_applied, other.on_applied);
       std::swap(on_commit, other.on_commit);
       std::swap(on_applied_sync, other.on_applied_sync);
-      tbl.swap(other.tbl);
+      coll_index.swap(other.coll_index);
+      object_index.swap(other.object_index);
+      data_bl.swap(other.data_bl);
+      op_bl.swap(other.op_bl);
     }
 
     /// Append the operations of the parameter to this Transaction. Those operations are removed from the parameter Transaction
-    void append(Transaction& other) {
-      ops += other.ops;
-      assert(pad_unused_bytes == 0);
-      assert(other.pad_unused_bytes == 0);
-      if (other.largest_data_len > largest_data_len) {
-	largest_data_len = other.largest_data_len;
-	largest_data_off = other.largest_data_off;
-	largest_data_off_in_tbl = tbl.length() + other.largest_data_off_in_tbl;
-      }
-      tbl.append(other.tbl);
-      on_applied.splice(on_applied.end(), other.on_applied);
-      on_commit.splice(on_commit.end(), other.on_commit);
-      on_applied_sync.splice(on_applied_sync.end(), other.on_applied_sync);
-    }
+    void append(Transaction& other);
 
     /** Inquires about the Transaction as a whole. */
 
     /// How big is the encoded Transaction buffer?
     uint64_t get_encoded_bytes() {
-      return 1 + 8 + 8 + 4 + 4 + 4 + 4 + tbl.length();
+      uint64_t tables = 0;
+      for (map<coll_t, __u32>::iterator p = coll_index.begin();
+	   p != coll_index.end();
+	   ++p)
+	tables += 13 + p->first.to_str().length();
+      for (map<ghobject_t, __u32>::iterator p = object_index.begin();
+	   p != object_index.end();
+	   ++p)
+	tables += 56 + p->first.hobj.oid.name.length() +
+	  p->first.hobj.get_key().length() + p->first.hobj.nspace.length();
+      return 1 + 1 + 4 + sizeof(data) + 4 + data_bl.length() +
+	4 + op_bl.length() + 4 + 4 + tables;
     }
 
     uint64_t get_num_bytes() {
@@ -498,37 +585,33 @@ public:
     }
     /// Size of largest data buffer to the "write" operation encountered so far
     uint32_t get_data_length() {
-      return largest_data_len;
+      return data.largest_data_len;
     }
     /// offset within the encoded buffer to the start of the largest data buffer that's encoded
     uint32_t get_data_offset() {
-      if (largest_data_off_in_tbl) {
-	return largest_data_off_in_tbl +
+      if (data.largest_data_off_in_data_bl) {
+	return data.largest_data_off_in_data_bl +
 	  sizeof(__u8) +  // encode struct_v
 	  sizeof(__u8) +  // encode compat_v
 	  sizeof(__u32) + // encode len
-	  sizeof(ops) +
-	  sizeof(pad_unused_bytes) +
-	  sizeof(largest_data_len) +
-	  sizeof(largest_data_off) +
-	  sizeof(largest_data_off_in_tbl) +
-	  sizeof(__u32);  // tbl length
+	  sizeof(data) +
+	  sizeof(__u32);  // data_bl length
       }
       return 0;  // none
     }
     /// offset of buffer as aligned to destination within object.
     int get_data_alignment() {
-      if (!largest_data_len)
+      if (!data.largest_data_len)
 	return -1;
       return (0 - get_data_offset()) & ~CEPH_PAGE_MASK;
     }
     /// Is the Transaction empty (no operations)
     bool empty() {
-      return !ops;
+      return !data.ops;
     }
     /// Number of operations in the transation
     int get_num_ops() {
-      return ops;
+      return data.ops;
     }
 
     void set_osr(void *s) {
@@ -544,98 +627,75 @@ public:
      *
      * Helper object to parse Transactions.
      *
-     * ObjectStore instances use this object to step down the encoded
-     * buffer decoding operation codes and parameters as we go.
-     *
+     * ObjectStore instances use this object to step through the
+     * operations.  decode_op() returns the next fixed-size Op; the
+     * collections and objects it names are looked up with get_cid()
+     * and get_oid(), and any variable-length arguments are decoded,
+     * in order, with the decode_* helpers.
      */
     class iterator {
-      bufferlist::iterator p;
-      bool sobject_encoding;
-      int64_t pool_override;
-      bool use_pool_override;
-      bool replica;
-
-      iterator(Transaction *t)
-	: p(t->tbl.begin()),
-	  sobject_encoding(t->sobject_encoding),
-	  pool_override(t->pool_override),
-	  use_pool_override(t->use_pool_override),
-	  replica(t->replica) {}
+      Transaction *t;
+      uint64_t ops;
+      char *op_buffer_p;
+      bufferlist::iterator data_bl_p;
+      vector<const coll_t*> colls;
+      vector<const ghobject_t*> objects;
+      vector<ghobject_t> overridden;  ///< legacy oids with the pool filled in
+
+      iterator(Transaction *t);
 
       friend class Transaction;
 
     public:
       /// true if there are more operations left to be enumerated
       bool have_op() {
-	return !p.end();
+	return ops > 0;
       }
 
-      /* Decode the specified type of object from the input
-       * stream. There is no checking that the encoded data is of the
-       * correct type.
-       */
-      int decode_op() {
-	__u32 op;
-	::decode(op, p);
+      /// Get the next op.  Points into the transaction, so it stays valid.
+      Op *decode_op() {
+	assert(ops > 0);
+	Op *op = reinterpret_cast<Op*>(op_buffer_p);
+	op_buffer_p += sizeof(Op);
+	--ops;
 	return op;
       }
-      void decode_bl(bufferlist& bl) {
-	::decode(bl, p);
-      }
-      /// Get an oid, recognize various legacy forms and update them.
-      ghobject_t decode_oid() {
-	ghobject_t oid;
-	if (sobject_encoding) {
-	  sobject_t soid;
-	  ::decode(soid, p);
-	  oid.hobj.snap = soid.snap;
-	  oid.hobj.oid = soid.oid;
-	  oid.generation = ghobject_t::NO_GEN;
-	  oid.shard_id = shard_id_t::NO_SHARD;
-	} else {
-	  ::decode(oid, p);
-	  if (use_pool_override && pool_override != -1 &&
-	      !oid.hobj.is_max() && oid.hobj.pool == -1) {
-	    oid.hobj.pool = pool_override;
-	  }
-	}
-	return oid;
+      const coll_t &get_cid(__u32 cid_id) {
+	assert(cid_id < colls.size() && colls[cid_id]);
+	return *colls[cid_id];
       }
-      coll_t decode_cid() {
-	coll_t c;
-	::decode(c, p);
-	return c;
+      const ghobject_t &get_oid(__u32 oid_id) {
+	assert(oid_id < objects.size() && objects[oid_id]);
+	return *objects[oid_id];
       }
-      uint64_t decode_length() {
-	uint64_t len;
-	::decode(len, p);
-	return len;
+
+      /* Decode the variable-length arguments of the current op from
+       * data_bl.  There is no checking that the encoded data is of the
+       * correct type.
+       */
+      void decode_bl(bufferlist& bl) {
+	::decode(bl, data_bl_p);
       }
       string decode_attrname() {
 	string s;
-	::decode(s, p);
+	::decode(s, data_bl_p);
 	return s;
       }
       string decode_key() {
 	string s;
-	::decode(s, p);
+	::decode(s, data_bl_p);
 	return s;
       }
       void decode_attrset(map<string,bufferptr>& aset) {
-	::decode(aset, p);
+	::decode(aset, data_bl_p);
       }
       void decode_attrset(map<string,bufferlist>& aset) {
-	::decode(aset, p);
+	::decode(aset, data_bl_p);
       }
       void decode_keyset(set<string> &keys) {
-	::decode(keys, p);
+	::decode(keys, data_bl_p);
       }
-      uint32_t decode_u32() {
-	uint32_t bits;
-	::decode(bits, p);
-	return bits;
-      }
-      bool get_replica() { return replica; }
+      bool get_replica() { return t->replica; }
     };
 
     iterator begin() {
@@ -653,15 +713,11 @@ public:
 
     /// Commence a global file system sync operation.
     void start_sync() {
-      __u32 op = OP_STARTSYNC;
-      ::encode(op, tbl);
-      ops++;
+      _get_next_op(OP_STARTSYNC);
     }
     /// noop. 'nuf said
     void nop() {
-      __u32 op = OP_NOP;
-      ::encode(op, tbl);
-      ops++;
+      _get_next_op(OP_NOP);
     }
     /**
      * touch
@@ -670,11 +726,9 @@ public:
      * empty object if necessary
      */
     void touch(coll_t cid, const ghobject_t& oid) {
-      __u32 op = OP_TOUCH;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_TOUCH);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
     }
     /**
      * Write data to an offset within an object. If the object is too
@@ -688,20 +742,13 @@ public:
      */
     void write(coll_t cid, const ghobject_t& oid, uint64_t off, uint64_t len,
 	       const bufferlist& data) {
-      __u32 op = OP_WRITE;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(off, tbl);
-      ::encode(len, tbl);
       assert(len == data.length());
-      if (data.length() > largest_data_len) {
-	largest_data_len = data.length();
-	largest_data_off = off;
-	largest_data_off_in_tbl = tbl.length() + sizeof(__u32);  // we are about to
-      }
-      ::encode(data, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_WRITE);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->off = off;
+      op->len = len;
+      _encode_write_data(off, data);
     }
     /**
      * zero out the indicated byte range within an object. Some
@@ -709,30 +756,24 @@ public:
      * underlying storage space.
      */
     void zero(coll_t cid, const ghobject_t& oid, uint64_t off, uint64_t len) {
-      __u32 op = OP_ZERO;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(off, tbl);
-      ::encode(len, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_ZERO);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->off = off;
+      op->len = len;
     }
     /// Discard all data in the object beyond the specified size.
     void truncate(coll_t cid, const ghobject_t& oid, uint64_t off) {
-      __u32 op = OP_TRUNCATE;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(off, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_TRUNCATE);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->off = off;
     }
     /// Remove an object. All four parts of the object are removed.
     void remove(coll_t cid, const ghobject_t& oid) {
-      __u32 op = OP_REMOVE;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_REMOVE);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
     }
     /// Set an xattr of an object
     void setattr(coll_t cid, const ghobject_t& oid, const char* name, bufferlist& val) {
@@ -741,31 +782,25 @@ public:
     }
     /// Set an xattr of an object
     void setattr(coll_t cid, const ghobject_t& oid, const string& s, bufferlist& val) {
-      __u32 op = OP_SETATTR;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(s, tbl);
-      ::encode(val, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_SETATTR);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(s, data_bl);
+      ::encode(val, data_bl);
     }
     /// Set multiple xattrs of an object
     void setattrs(coll_t cid, const ghobject_t& oid, map<string,bufferptr>& attrset) {
-      __u32 op = OP_SETATTRS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(attrset, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_SETATTRS);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(attrset, data_bl);
     }
     /// Set multiple xattrs of an object
     void setattrs(coll_t cid, const ghobject_t& oid, map<string,bufferlist>& attrset) {
-      __u32 op = OP_SETATTRS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(attrset, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_SETATTRS);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(attrset, data_bl);
     }
     /// remove an xattr from an object
     void rmattr(coll_t cid, const ghobject_t& oid, const char *name) {
@@ -774,20 +809,16 @@ public:
     }
     /// remove an xattr from an object
     void rmattr(coll_t cid, const ghobject_t& oid, const string& s) {
-      __u32 op = OP_RMATTR;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(s, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_RMATTR);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(s, data_bl);
     }
     /// remove all xattrs from an object
     void rmattrs(coll_t cid, const ghobject_t& oid) {
-      __u32 op = OP_RMATTRS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_RMATTRS);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
     }
     /**
      * Clone an object into another object.
@@ -801,12 +832,10 @@ public:
      * which case its previous contents are discarded.
      */
     void clone(coll_t cid, const ghobject_t& oid, ghobject_t noid) {
-      __u32 op = OP_CLONE;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(noid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_CLONE);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->dest_oid = _get_object_id(noid);
     }
     /**
      * Clone a byte range from one object to another.
@@ -817,22 +846,18 @@ public:
      */
     void clone_range(coll_t cid, const ghobject_t& oid, ghobject_t noid,
 		     uint64_t srcoff, uint64_t srclen, uint64_t dstoff) {
-      __u32 op = OP_CLONERANGE2;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(noid, tbl);
-      ::encode(srcoff, tbl);
-      ::encode(srclen, tbl);
-      ::encode(dstoff, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_CLONERANGE2);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->dest_oid = _get_object_id(noid);
+      op->off = srcoff;
+      op->len = srclen;
+      op->dest_off = dstoff;
     }
     /// Create the collection
     void create_collection(coll_t cid) {
-      __u32 op = OP_MKCOLL;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_MKCOLL);
+      op->cid = _get_coll_id(cid);
     }
 
     /**
@@ -844,46 +869,36 @@ public:
      *               data along with the hint type.
      */
      void collection_hint(coll_t cid, uint32_t type, const bufferlist& hint) {
-       __u32 op = OP_COLL_HINT;
-       ::encode(op, tbl);
-       ::encode(cid, tbl);
-       ::encode(type, tbl);
-       ::encode(hint, tbl);
-       ops++;
+       Op *op = _get_next_op(OP_COLL_HINT);
+       op->cid = _get_coll_id(cid);
+       op->hint_type = type;
+       ::encode(hint, data_bl);
      }
 
     /// remove the collection, the collection must be empty
     void remove_collection(coll_t cid) {
-      __u32 op = OP_RMCOLL;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_RMCOLL);
+      op->cid = _get_coll_id(cid);
     }
     void collection_move(coll_t cid, coll_t oldcid, const ghobject_t& oid) {
       // NOTE: we encode this as a fixed combo of ADD + REMOVE.  they
       // always appear together, so this is effectively a single MOVE.
-      __u32 op = OP_COLL_ADD;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oldcid, tbl);
-      ::encode(oid, tbl);
-      ops++;
-      op = OP_COLL_REMOVE;
-      ::encode(op, tbl);
-      ::encode(oldcid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_ADD);
+      op->cid = _get_coll_id(oldcid);
+      op->oid = _get_object_id(oid);
+      op->dest_cid = _get_coll_id(cid);
+      op = _get_next_op(OP_COLL_REMOVE);
+      op->cid = _get_coll_id(oldcid);
+      op->oid = _get_object_id(oid);
       return;
     }
     void collection_move_rename(coll_t oldcid, const ghobject_t& oldoid,
 				coll_t cid, const ghobject_t& oid) {
-      __u32 op = OP_COLL_MOVE_RENAME;
-      ::encode(op, tbl);
-      ::encode(oldcid, tbl);
-      ::encode(oldoid, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_MOVE_RENAME);
+      op->cid = _get_coll_id(oldcid);
+      op->oid = _get_object_id(oldoid);
+      op->dest_cid = _get_coll_id(cid);
+      op->dest_oid = _get_object_id(oid);
     }
 
     /// Set an xattr on a collection
@@ -893,12 +908,10 @@ public:
     }
     /// Set an xattr on a collection
     void collection_setattr(coll_t cid, const string& name, bufferlist& val) {
-      __u32 op = OP_COLL_SETATTR;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(name, tbl);
-      ::encode(val, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_SETATTR);
+      op->cid = _get_coll_id(cid);
+      ::encode(name, data_bl);
+      ::encode(val, data_bl);
     }
 
     /// Remove an xattr from a collection
@@ -908,27 +921,21 @@ public:
     }
     /// Remove an xattr from a collection
     void collection_rmattr(coll_t cid, const string& name) {
-      __u32 op = OP_COLL_RMATTR;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(name, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_RMATTR);
+      op->cid = _get_coll_id(cid);
+      ::encode(name, data_bl);
     }
     /// Set multiple xattrs on a collection
     void collection_setattrs(coll_t cid, map<string,bufferptr>& aset) {
-      __u32 op = OP_COLL_SETATTRS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(aset, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_SETATTRS);
+      op->cid = _get_coll_id(cid);
+      ::encode(aset, data_bl);
     }
     /// Set multiple xattrs on a collection
     void collection_setattrs(coll_t cid, map<string,bufferlist>& aset) {
-      __u32 op = OP_COLL_SETATTRS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(aset, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_COLL_SETATTRS);
+      op->cid = _get_coll_id(cid);
+      ::encode(aset, data_bl);
     }
 
     /// Remove omap from oid
@@ -936,11 +943,9 @@ public:
       coll_t cid,           ///< [in] Collection containing oid
       const ghobject_t &oid  ///< [in] Object from which to remove omap
       ) {
-      __u32 op = OP_OMAP_CLEAR;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_OMAP_CLEAR);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
     }
     /// Set keys on oid omap.  Replaces duplicate keys.
     void omap_setkeys(
@@ -948,12 +953,10 @@ public:
       const ghobject_t &oid,                ///< [in] Object to update
       const map<string, bufferlist> &attrset ///< [in] Replacement keys and values
       ) {
-      __u32 op = OP_OMAP_SETKEYS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(attrset, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_OMAP_SETKEYS);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(attrset, data_bl);
     }
     /// Remove keys from oid omap
     void omap_rmkeys(
@@ -961,12 +964,10 @@ public:
       const ghobject_t &oid,  ///< [in] Object from which to remove the omap
       const set<string> &keys ///< [in] Keys to clear
       ) {
-      __u32 op = OP_OMAP_RMKEYS;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(keys, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_OMAP_RMKEYS);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(keys, data_bl);
     }
 
     /// Remove key range from oid omap
@@ -976,13 +977,11 @@ public:
       const string& first,    ///< [in] first key in range
       const string& last      ///< [in] first key past range, range is [first,last)
       ) {
-      __u32 op = OP_OMAP_RMKEYRANGE;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(first, tbl);
-      ::encode(last, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_OMAP_RMKEYRANGE);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(first, data_bl);
+      ::encode(last, data_bl);
     }
 
     /// Set omap header
@@ -991,12 +990,10 @@ public:
       const ghobject_t &oid,  ///< [in] Object
       const bufferlist &bl    ///< [in] Header value
       ) {
-      __u32 op = OP_OMAP_SETHEADER;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(bl, tbl);
-      ops++;
+      Op *op = _get_next_op(OP_OMAP_SETHEADER);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      ::encode(bl, data_bl);
     }
 
     /// Split collection based on given prefixes, objects matching the specified bits/rem are
@@ -1006,13 +1003,11 @@ public:
       uint32_t bits,
       uint32_t rem,
       coll_t destination) {
-      __u32 op = OP_SPLIT_COLLECTION2;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(bits, tbl);
-      ::encode(rem, tbl);
-      ::encode(destination, tbl);
-      ++ops;
+      Op *op = _get_next_op(OP_SPLIT_COLLECTION2);
+      op->cid = _get_coll_id(cid);
+      op->dest_cid = _get_coll_id(destination);
+      op->split_bits = bits;
+      op->split_rem = rem;
     }
 
     void set_alloc_hint(
@@ -1021,77 +1016,56 @@ public:
       uint64_t expected_object_size,
       uint64_t expected_write_size
     ) {
-      __u32 op = OP_SETALLOCHINT;
-      ::encode(op, tbl);
-      ::encode(cid, tbl);
-      ::encode(oid, tbl);
-      ::encode(expected_object_size, tbl);
-      ::encode(expected_write_size, tbl);
-      ++ops;
+      Op *op = _get_next_op(OP_SETALLOCHINT);
+      op->cid = _get_coll_id(cid);
+      op->oid = _get_object_id(oid);
+      op->expected_object_size = expected_object_size;
+      op->expected_write_size = expected_write_size;
     }
 
     // etc.
     Transaction() :
-      ops(0), pad_unused_bytes(0), largest_data_len(0), largest_data_off(0), largest_data_off_in_tbl(0),
-      sobject_encoding(false), pool_override(-1), use_pool_override(false),
+      pool_override(-1), use_pool_override(false),
       replica(false),
-      osr(NULL) {}
+      osr(NULL) {
+      memset(&data, 0, sizeof(data));
+    }
 
     Transaction(bufferlist::iterator &dp) :
-      ops(0), pad_unused_bytes(0), largest_data_len(0), largest_data_off(0), largest_data_off_in_tbl(0),
-      sobject_encoding(false), pool_override(-1), use_pool_override(false),
+      pool_override(-1), use_pool_override(false),
       replica(false),
       osr(NULL) {
+      memset(&data, 0, sizeof(data));
       decode(dp);
     }
 
     Transaction(bufferlist &nbl) :
-      ops(0), pad_unused_bytes(0), largest_data_len(0), largest_data_off(0), largest_data_off_in_tbl(0),
-      sobject_encoding(false), pool_override(-1), use_pool_override(false),
+      pool_override(-1), use_pool_override(false),
       replica(false),
       osr(NULL) {
+      memset(&data, 0, sizeof(data));
       bufferlist::iterator dp = nbl.begin();
       decode(dp);
     }
 
     void encode(bufferlist& bl) const {
-      ENCODE_START(7, 5, bl);
-      ::encode(ops, bl);
-      ::encode(pad_unused_bytes, bl);
-      ::encode(largest_data_len, bl);
-      ::encode(largest_data_off, bl);
-      ::encode(largest_data_off_in_tbl, bl);
-      ::encode(tbl, bl);
-      {
-	bool tolerate_collection_add_enoent = 0;
-	::encode(tolerate_collection_add_enoent, bl);
-      }
-      ENCODE_FINISH(bl);
+      encode(bl, CEPH_FEATURES_ALL);
     }
-    void decode(bufferlist::iterator &bl) {
-      DECODE_START_LEGACY_COMPAT_LEN(7, 5, 5, bl);
-      DECODE_OLDEST(2);
-      if (struct_v < 4)
-	sobject_encoding = true;
-      else
-	sobject_encoding = false;
-      ::decode(ops, bl);
-      ::decode(pad_unused_bytes, bl);
-      if (struct_v >= 3) {
-	::decode(largest_data_len, bl);
-	::decode(largest_data_off, bl);
-	::decode(largest_data_off_in_tbl, bl);
+    /// peers without CEPH_FEATURE_OSD_TRANSACTION_INDEX get the v7 tbl encoding
+    void encode(bufferlist& bl, uint64_t features) const {
+      if (!(features & CEPH_FEATURE_OSD_TRANSACTION_INDEX)) {
+	_encode_legacy(bl);
+	return;
       }
-      ::decode(tbl, bl);
-      if (struct_v < 6) {
-	use_pool_override = true;
-      }
-      if (struct_v >= 7) {
-	bool tolerate_collection_add_enoent;
-	::decode(tolerate_collection_add_enoent, bl);
-      }
-      DECODE_FINISH(bl);
+      ENCODE_START(8, 8, bl);
+      bl.append(reinterpret_cast<const char*>(&data), sizeof(data));
+      ::encode(data_bl, bl);
+      ::encode(op_bl, bl);
+      ::encode(coll_index, bl);
+      ::encode(object_index, bl);
+      ENCODE_FINISH(bl);
     }
+    void decode(bufferlist::iterator &bl);
 
     void dump(ceph::Formatter *f);
     static void generate_test_instances(list<Transaction*>& o);
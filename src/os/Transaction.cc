@@ -1,9 +1,588 @@
-// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*- 
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
 #include "ObjectStore.h"
 #include "common/Formatter.h"
 
+ObjectStore::Transaction::iterator::iterator(Transaction *t)
+  : t(t),
+    ops(t->data.ops),
+    op_buffer_p(t->op_bl.c_str()),  // one copy if op_bl is fragmented
+    data_bl_p(t->data_bl.begin()),
+    colls(t->coll_index.size()),
+    objects(t->object_index.size())
+{
+  for (map<coll_t, __u32>::iterator p = t->coll_index.begin();
+       p != t->coll_index.end();
+       ++p)
+    colls[p->second] = &p->first;
+
+  unsigned need_override = 0;
+  for (map<ghobject_t, __u32>::iterator p = t->object_index.begin();
+       p != t->object_index.end();
+       ++p) {
+    if (t->_needs_pool_override(p->first))
+      ++need_override;
+    else
+      objects[p->second] = &p->first;
+  }
+  if (need_override) {
+    overridden.reserve(need_override);
+    for (map<ghobject_t, __u32>::iterator p = t->object_index.begin();
+	 p != t->object_index.end();
+	 ++p) {
+      if (!t->_needs_pool_override(p->first))
+	continue;
+      overridden.push_back(p->first);
+      overridden.back().hobj.pool = t->pool_override;
+      objects[p->second] = &overridden.back();
+    }
+  }
+}
+
+void ObjectStore::Transaction::append(Transaction& other)
+{
+  // the other transaction's table indexes mean nothing here; remap them
+  vector<__u32> cids(other.coll_index.size());
+  for (map<coll_t, __u32>::iterator p = other.coll_index.begin();
+       p != other.coll_index.end();
+       ++p)
+    cids[p->second] = _get_coll_id(p->first);
+  vector<__u32> oids(other.object_index.size());
+  for (map<ghobject_t, __u32>::iterator p = other.object_index.begin();
+       p != other.object_index.end();
+       ++p) {
+    if (other._needs_pool_override(p->first)) {
+      ghobject_t oid(p->first);
+      oid.hobj.pool = other.pool_override;
+      oids[p->second] = _get_object_id(oid);
+    } else {
+      oids[p->second] = _get_object_id(p->first);
+    }
+  }
+
+  bufferlist::iterator p = other.op_bl.begin();
+  for (uint64_t n = 0; n < other.data.ops; ++n) {
+    Op *op = _get_next_op();
+    p.copy(sizeof(Op), reinterpret_cast<char*>(op));
+    if ((__u32)op->cid != NO_INDEX)
+      op->cid = cids[op->cid];
+    if ((__u32)op->dest_cid != NO_INDEX)
+      op->dest_cid = cids[op->dest_cid];
+    if ((__u32)op->oid != NO_INDEX)
+      op->oid = oids[op->oid];
+    if ((__u32)op->dest_oid != NO_INDEX)
+      op->dest_oid = oids[op->dest_oid];
+  }
+
+  if (other.data.largest_data_len > data.largest_data_len) {
+    data.largest_data_len = other.data.largest_data_len;
+    data.largest_data_off = other.data.largest_data_off;
+    data.largest_data_off_in_data_bl =
+      data_bl.length() + other.data.largest_data_off_in_data_bl;
+  }
+  data_bl.append(other.data_bl);
+  on_applied.splice(on_applied.end(), other.on_applied);
+  on_commit.splice(on_commit.end(), other.on_commit);
+  on_applied_sync.splice(on_applied_sync.end(), other.on_applied_sync);
+}
+
+void ObjectStore::Transaction::decode(bufferlist::iterator &bl)
+{
+  memset(&data, 0, sizeof(data));
+  coll_index.clear();
+  object_index.clear();
+  data_bl.clear();
+  op_bl.clear();
+  use_pool_override = false;
+
+  DECODE_START_LEGACY_COMPAT_LEN(8, 5, 5, bl);
+  DECODE_OLDEST(2);
+  if (struct_v < 8) {
+    uint64_t ops, pad_unused_bytes;
+    ::decode(ops, bl);
+    ::decode(pad_unused_bytes, bl);
+    if (struct_v >= 3) {
+      // recomputed as the ops are rebuilt
+      uint32_t largest_data_len, largest_data_off, largest_data_off_in_tbl;
+      ::decode(largest_data_len, bl);
+      ::decode(largest_data_off, bl);
+      ::decode(largest_data_off_in_tbl, bl);
+    }
+    bufferlist tbl;
+    ::decode(tbl, bl);
+    if (struct_v < 6) {
+      use_pool_override = true;
+    }
+    if (struct_v >= 7) {
+      bool tolerate_collection_add_enoent;
+      ::decode(tolerate_collection_add_enoent, bl);
+    }
+    _build_actions_from_tbl(tbl, struct_v < 4);
+  } else {
+    bl.copy(sizeof(data), reinterpret_cast<char*>(&data));
+    ::decode(data_bl, bl);
+    ::decode(op_bl, bl);
+    ::decode(coll_index, bl);
+    ::decode(object_index, bl);
+    if (op_bl.length() != data.ops * sizeof(Op))
+      throw buffer::malformed_input("transaction op count does not match op_bl");
+    for (map<coll_t, __u32>::iterator p = coll_index.begin();
+	 p != coll_index.end();
+	 ++p)
+      if (p->second >= coll_index.size())
+	throw buffer::malformed_input("transaction coll_index out of range");
+    for (map<ghobject_t, __u32>::iterator p = object_index.begin();
+	 p != object_index.end();
+	 ++p)
+      if (p->second >= object_index.size())
+	throw buffer::malformed_input("transaction object_index out of range");
+  }
+  DECODE_FINISH(bl);
+}
+
+/*
+ * Legacy (struct_v <= 7) encoding: every op is serialized into tbl
+ * with its collections and objects inline.  We still write it for
+ * peers that lack CEPH_FEATURE_OSD_TRANSACTION_INDEX and read it when
+ * replaying old journals or talking to old peers.
+ */
+
+static coll_t decode_legacy_cid(bufferlist::iterator& p)
+{
+  coll_t c;
+  ::decode(c, p);
+  return c;
+}
+
+static ghobject_t decode_legacy_oid(bufferlist::iterator& p,
+				    bool sobject_encoding)
+{
+  ghobject_t oid;
+  if (sobject_encoding) {
+    sobject_t soid;
+    ::decode(soid, p);
+    oid.hobj.snap = soid.snap;
+    oid.hobj.oid = soid.oid;
+    oid.generation = ghobject_t::NO_GEN;
+    oid.shard_id = shard_id_t::NO_SHARD;
+  } else {
+    ::decode(oid, p);
+  }
+  return oid;
+}
+
+template<typename T>
+static void copy_legacy_arg(bufferlist::iterator& p, bufferlist& out)
+{
+  T v;
+  ::decode(v, p);
+  ::encode(v, out);
+}
+
+void ObjectStore::Transaction::_build_actions_from_tbl(bufferlist& tbl,
+						       bool sobject_encoding)
+{
+  bufferlist::iterator p = tbl.begin();
+  while (!p.end()) {
+    __u32 code;
+    ::decode(code, p);
+    Op *op = _get_next_op(code);
+
+    switch (code) {
+    case OP_NOP:
+    case OP_STARTSYNC:
+      break;
+
+    case OP_TOUCH:
+    case OP_REMOVE:
+    case OP_RMATTRS:
+    case OP_OMAP_CLEAR:
+    case OP_COLL_REMOVE:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      break;
+
+    case OP_WRITE:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+	uint64_t off, len;
+	::decode(off, p);
+	::decode(len, p);
+	op->off = off;
+	op->len = len;
+	bufferlist bl;
+	::decode(bl, p);
+	_encode_write_data(off, bl);
+      }
+      break;
+
+    case OP_ZERO:
+    case OP_TRIMCACHE:
+    case OP_CLONERANGE:
+    case OP_CLONERANGE2:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+	if (code == OP_CLONERANGE || code == OP_CLONERANGE2)
+	  op->dest_oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+	uint64_t off, len;
+	::decode(off, p);
+	::decode(len, p);
+	op->off = off;
+	op->len = len;
+	if (code == OP_CLONERANGE2) {
+	  uint64_t dest_off;
+	  ::decode(dest_off, p);
+	  op->dest_off = dest_off;
+	}
+      }
+      break;
+
+    case OP_TRUNCATE:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+	uint64_t off;
+	::decode(off, p);
+	op->off = off;
+      }
+      break;
+
+    case OP_SETATTR:
+    case OP_OMAP_RMKEYRANGE:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      copy_legacy_arg<string>(p, data_bl);
+      if (code == OP_SETATTR)
+	copy_legacy_arg<bufferlist>(p, data_bl);
+      else
+	copy_legacy_arg<string>(p, data_bl);
+      break;
+
+    case OP_SETATTRS:
+    case OP_OMAP_SETKEYS:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      copy_legacy_arg<map<string, bufferlist> >(p, data_bl);
+      break;
+
+    case OP_RMATTR:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      copy_legacy_arg<string>(p, data_bl);
+      break;
+
+    case OP_CLONE:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      op->dest_oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      break;
+
+    case OP_MKCOLL:
+    case OP_RMCOLL:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      break;
+
+    case OP_COLL_HINT:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	uint32_t type;
+	::decode(type, p);
+	op->hint_type = type;
+	copy_legacy_arg<bufferlist>(p, data_bl);
+      }
+      break;
+
+    case OP_COLL_ADD:
+      // legacy order is destination, source, oid
+      op->dest_cid = _get_coll_id(decode_legacy_cid(p));
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      break;
+
+    case OP_COLL_MOVE:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->dest_cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      break;
+
+    case OP_COLL_MOVE_RENAME:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      op->dest_cid = _get_coll_id(decode_legacy_cid(p));
+      op->dest_oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      break;
+
+    case OP_COLL_SETATTR:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      copy_legacy_arg<string>(p, data_bl);
+      copy_legacy_arg<bufferlist>(p, data_bl);
+      break;
+
+    case OP_COLL_RMATTR:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      copy_legacy_arg<string>(p, data_bl);
+      break;
+
+    case OP_COLL_SETATTRS:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      copy_legacy_arg<map<string, bufferlist> >(p, data_bl);
+      break;
+
+    case OP_COLL_RENAME:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->dest_cid = _get_coll_id(decode_legacy_cid(p));
+      break;
+
+    case OP_OMAP_RMKEYS:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      copy_legacy_arg<set<string> >(p, data_bl);
+      break;
+
+    case OP_OMAP_SETHEADER:
+      op->cid = _get_coll_id(decode_legacy_cid(p));
+      op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+      copy_legacy_arg<bufferlist>(p, data_bl);
+      break;
+
+    case OP_SPLIT_COLLECTION:
+    case OP_SPLIT_COLLECTION2:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	uint32_t bits, rem;
+	::decode(bits, p);
+	::decode(rem, p);
+	op->split_bits = bits;
+	op->split_rem = rem;
+	op->dest_cid = _get_coll_id(decode_legacy_cid(p));
+      }
+      break;
+
+    case OP_SETALLOCHINT:
+      {
+	op->cid = _get_coll_id(decode_legacy_cid(p));
+	op->oid = _get_object_id(decode_legacy_oid(p, sobject_encoding));
+	uint64_t expected_object_size, expected_write_size;
+	::decode(expected_object_size, p);
+	::decode(expected_write_size, p);
+	op->expected_object_size = expected_object_size;
+	op->expected_write_size = expected_write_size;
+      }
+      break;
+
+    default:
+      throw buffer::malformed_input("unknown op in legacy transaction");
+    }
+  }
+}
+
+void ObjectStore::Transaction::_encode_legacy(bufferlist& bl) const
+{
+  bufferlist tbl;
+  uint32_t largest_data_len = 0, largest_data_off = 0;
+  uint32_t largest_data_off_in_tbl = 0;
+  iterator i(const_cast<Transaction*>(this));
+  while (i.have_op()) {
+    Op *op = i.decode_op();
+    __u32 code = op->op;
+    ::encode(code, tbl);
+
+    switch (code) {
+    case OP_NOP:
+    case OP_STARTSYNC:
+      break;
+
+    case OP_TOUCH:
+    case OP_REMOVE:
+    case OP_RMATTRS:
+    case OP_OMAP_CLEAR:
+    case OP_COLL_REMOVE:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      break;
+
+    case OP_WRITE:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	::encode(i.get_oid(op->oid), tbl);
+	::encode((uint64_t)op->off, tbl);
+	::encode((uint64_t)op->len, tbl);
+	bufferlist data;
+	i.decode_bl(data);
+	if (data.length() > largest_data_len) {
+	  largest_data_len = data.length();
+	  largest_data_off = op->off;
+	  largest_data_off_in_tbl = tbl.length() + sizeof(__u32);
+	}
+	::encode(data, tbl);
+      }
+      break;
+
+    case OP_ZERO:
+    case OP_TRIMCACHE:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode((uint64_t)op->off, tbl);
+      ::encode((uint64_t)op->len, tbl);
+      break;
+
+    case OP_TRUNCATE:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode((uint64_t)op->off, tbl);
+      break;
+
+    case OP_SETATTR:
+    case OP_COLL_SETATTR:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	if (code == OP_SETATTR)
+	  ::encode(i.get_oid(op->oid), tbl);
+	::encode(i.decode_attrname(), tbl);
+	bufferlist bl;
+	i.decode_bl(bl);
+	::encode(bl, tbl);
+      }
+      break;
+
+    case OP_SETATTRS:
+    case OP_OMAP_SETKEYS:
+    case OP_COLL_SETATTRS:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	if (code != OP_COLL_SETATTRS)
+	  ::encode(i.get_oid(op->oid), tbl);
+	map<string, bufferlist> aset;
+	i.decode_attrset(aset);
+	::encode(aset, tbl);
+      }
+      break;
+
+    case OP_RMATTR:
+    case OP_COLL_RMATTR:
+      ::encode(i.get_cid(op->cid), tbl);
+      if (code == OP_RMATTR)
+	::encode(i.get_oid(op->oid), tbl);
+      ::encode(i.decode_attrname(), tbl);
+      break;
+
+    case OP_CLONE:
+    case OP_CLONERANGE:
+    case OP_CLONERANGE2:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode(i.get_oid(op->dest_oid), tbl);
+      if (code != OP_CLONE) {
+	::encode((uint64_t)op->off, tbl);
+	::encode((uint64_t)op->len, tbl);
+      }
+      if (code == OP_CLONERANGE2)
+	::encode((uint64_t)op->dest_off, tbl);
+      break;
+
+    case OP_MKCOLL:
+    case OP_RMCOLL:
+      ::encode(i.get_cid(op->cid), tbl);
+      break;
+
+    case OP_COLL_HINT:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	::encode((uint32_t)op->hint_type, tbl);
+	bufferlist hint;
+	i.decode_bl(hint);
+	::encode(hint, tbl);
+      }
+      break;
+
+    case OP_COLL_ADD:
+      ::encode(i.get_cid(op->dest_cid), tbl);
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      break;
+
+    case OP_COLL_MOVE:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_cid(op->dest_cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      break;
+
+    case OP_COLL_MOVE_RENAME:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode(i.get_cid(op->dest_cid), tbl);
+      ::encode(i.get_oid(op->dest_oid), tbl);
+      break;
+
+    case OP_COLL_RENAME:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_cid(op->dest_cid), tbl);
+      break;
+
+    case OP_OMAP_RMKEYS:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	::encode(i.get_oid(op->oid), tbl);
+	set<string> keys;
+	i.decode_keyset(keys);
+	::encode(keys, tbl);
+      }
+      break;
+
+    case OP_OMAP_RMKEYRANGE:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode(i.decode_key(), tbl);
+      ::encode(i.decode_key(), tbl);
+      break;
+
+    case OP_OMAP_SETHEADER:
+      {
+	::encode(i.get_cid(op->cid), tbl);
+	::encode(i.get_oid(op->oid), tbl);
+	bufferlist bl;
+	i.decode_bl(bl);
+	::encode(bl, tbl);
+      }
+      break;
+
+    case OP_SPLIT_COLLECTION:
+    case OP_SPLIT_COLLECTION2:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode((uint32_t)op->split_bits, tbl);
+      ::encode((uint32_t)op->split_rem, tbl);
+      ::encode(i.get_cid(op->dest_cid), tbl);
+      break;
+
+    case OP_SETALLOCHINT:
+      ::encode(i.get_cid(op->cid), tbl);
+      ::encode(i.get_oid(op->oid), tbl);
+      ::encode((uint64_t)op->expected_object_size, tbl);
+      ::encode((uint64_t)op->expected_write_size, tbl);
+      break;
+
+    default:
+      assert(0 == "unknown transaction op");
+    }
+  }
+
+  ENCODE_START(7, 5, bl);
+  ::encode((uint64_t)data.ops, bl);
+  ::encode((uint64_t)0, bl);  // pad_unused_bytes
+  ::encode(largest_data_len, bl);
+  ::encode(largest_data_off, bl);
+  ::encode(largest_data_off_in_tbl, bl);
+  ::encode(tbl, bl);
+  {
+    bool tolerate_collection_add_enoent = 0;
+    ::encode(tolerate_collection_add_enoent, bl);
+  }
+  ENCODE_FINISH(bl);
+}
+
 void ObjectStore::Transaction::dump(ceph::Formatter *f)
 {
   f->open_array_section("ops");
@@ -11,115 +590,92 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
   int op_num = 0;
   bool stop_looping = false;
   while (i.have_op() && !stop_looping) {
-    int op = i.decode_op();
+    Transaction::Op *op = i.decode_op();
     f->open_object_section("op");
     f->dump_int("op_num", op_num);
 
-    switch (op) {
+    switch (op->op) {
     case Transaction::OP_NOP:
       f->dump_string("op_name", "nop");
       break;
     case Transaction::OP_TOUCH:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "touch");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
-      
+
     case Transaction::OP_WRITE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	uint64_t off = i.decode_length();
-	uint64_t len = i.decode_length();
 	bufferlist bl;
 	i.decode_bl(bl);
 	f->dump_string("op_name", "write");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
-        f->dump_unsigned("length", len);
-        f->dump_unsigned("offset", off);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
+        f->dump_unsigned("length", op->len);
+        f->dump_unsigned("offset", op->off);
         f->dump_unsigned("bufferlist length", bl.length());
       }
       break;
-      
+
     case Transaction::OP_ZERO:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	uint64_t off = i.decode_length();
-	uint64_t len = i.decode_length();
 	f->dump_string("op_name", "zero");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
-        f->dump_unsigned("offset", off);
-	f->dump_unsigned("length", len);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
+        f->dump_unsigned("offset", op->off);
+	f->dump_unsigned("length", op->len);
       }
       break;
-      
+
     case Transaction::OP_TRIMCACHE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	uint64_t off = i.decode_length();
-	uint64_t len = i.decode_length();
 	f->dump_string("op_name", "trim_cache");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
-	f->dump_unsigned("offset", off);
-	f->dump_unsigned("length", len);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
+	f->dump_unsigned("offset", op->off);
+	f->dump_unsigned("length", op->len);
       }
       break;
-      
+
     case Transaction::OP_TRUNCATE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	uint64_t off = i.decode_length();
 	f->dump_string("op_name", "truncate");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
-	f->dump_unsigned("offset", off);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
+	f->dump_unsigned("offset", op->off);
       }
       break;
-      
+
     case Transaction::OP_REMOVE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "remove");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
-      
+
     case Transaction::OP_SETATTR:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	string name = i.decode_attrname();
 	bufferlist bl;
 	i.decode_bl(bl);
 	f->dump_string("op_name", "setattr");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->dump_string("name", name);
 	f->dump_unsigned("length", bl.length());
       }
       break;
-      
+
     case Transaction::OP_SETATTRS:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	map<string, bufferptr> aset;
 	i.decode_attrset(aset);
 	f->dump_string("op_name", "setattrs");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->open_object_section("attr_lens");
 	for (map<string,bufferptr>::iterator p = aset.begin();
 	    p != aset.end(); ++p) {
@@ -131,86 +687,66 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_RMATTR:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	string name = i.decode_attrname();
 	f->dump_string("op_name", "rmattr");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->dump_string("name", name);
       }
       break;
 
     case Transaction::OP_RMATTRS:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "rmattrs");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
-      
+
     case Transaction::OP_CLONE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	ghobject_t noid = i.decode_oid();
 	f->dump_string("op_name", "clone");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("src_oid") << oid;
-	f->dump_stream("dst_oid") << noid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("src_oid") << i.get_oid(op->oid);
+	f->dump_stream("dst_oid") << i.get_oid(op->dest_oid);
       }
       break;
 
     case Transaction::OP_CLONERANGE:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	ghobject_t noid = i.decode_oid();
-	uint64_t off = i.decode_length();
-	uint64_t len = i.decode_length();
 	f->dump_string("op_name", "clonerange");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("src_oid") << oid;
-	f->dump_stream("dst_oid") << noid;
-	f->dump_unsigned("offset", off);
-	f->dump_unsigned("len", len);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("src_oid") << i.get_oid(op->oid);
+	f->dump_stream("dst_oid") << i.get_oid(op->dest_oid);
+	f->dump_unsigned("offset", op->off);
+	f->dump_unsigned("len", op->len);
       }
       break;
 
     case Transaction::OP_CLONERANGE2:
       {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
-	ghobject_t noid = i.decode_oid();
-	uint64_t srcoff = i.decode_length();
-	uint64_t len = i.decode_length();
-	uint64_t dstoff = i.decode_length();
 	f->dump_string("op_name", "clonerange2");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("src_oid") << oid;
-	f->dump_stream("dst_oid") << noid;
-	f->dump_unsigned("src_offset", srcoff);
-	f->dump_unsigned("len", len);
-	f->dump_unsigned("dst_offset", dstoff);
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("src_oid") << i.get_oid(op->oid);
+	f->dump_stream("dst_oid") << i.get_oid(op->dest_oid);
+	f->dump_unsigned("src_offset", op->off);
+	f->dump_unsigned("len", op->len);
+	f->dump_unsigned("dst_offset", op->dest_off);
       }
       break;
 
     case Transaction::OP_MKCOLL:
       {
-	coll_t cid = i.decode_cid();
 	f->dump_string("op_name", "mkcoll");
-	f->dump_stream("collection") << cid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
       }
       break;
 
     case Transaction::OP_COLL_HINT:
       {
-        coll_t cid = i.decode_cid();
-        uint32_t type = i.decode_u32();
+        uint32_t type = op->hint_type;
         f->dump_string("op_name", "coll_hint");
-        f->dump_stream("collection") << cid;
+        f->dump_stream("collection") << i.get_cid(op->cid);
         f->dump_unsigned("type", type);
         bufferlist hint;
         i.decode_bl(hint);
@@ -228,43 +764,34 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_RMCOLL:
       {
-	coll_t cid = i.decode_cid();
 	f->dump_string("op_name", "rmcoll");
-	f->dump_stream("collection") << cid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
       }
       break;
 
     case Transaction::OP_COLL_ADD:
       {
-	coll_t ncid = i.decode_cid();
-	coll_t ocid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "collection_add");
-	f->dump_stream("src_collection") << ocid;
-	f->dump_stream("dst_collection") << ncid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("src_collection") << i.get_cid(op->cid);
+	f->dump_stream("dst_collection") << i.get_cid(op->dest_cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
 
     case Transaction::OP_COLL_REMOVE:
        {
-	coll_t cid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "collection_remove");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
        }
       break;
 
     case Transaction::OP_COLL_MOVE:
        {
-	coll_t ocid = i.decode_cid();
-	coll_t ncid = i.decode_cid();
-	ghobject_t oid = i.decode_oid();
 	f->open_object_section("collection_move");
-	f->dump_stream("src_collection") << ocid;
-	f->dump_stream("dst_collection") << ncid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("src_collection") << i.get_cid(op->cid);
+	f->dump_stream("dst_collection") << i.get_cid(op->dest_cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->close_section();
        }
       break;
@@ -272,12 +799,11 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_COLL_SETATTR:
       {
-	coll_t cid = i.decode_cid();
 	string name = i.decode_attrname();
 	bufferlist bl;
 	i.decode_bl(bl);
 	f->dump_string("op_name", "collection_setattr");
-	f->dump_stream("collection") << cid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
 	f->dump_string("name", name);
 	f->dump_unsigned("length", bl.length());
       }
@@ -285,10 +811,9 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_COLL_RMATTR:
       {
-	coll_t cid = i.decode_cid();
 	string name = i.decode_attrname();
 	f->dump_string("op_name", "collection_rmattr");
-	f->dump_stream("collection") << cid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
 	f->dump_string("name", name);
       }
       break;
@@ -299,33 +824,27 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_COLL_RENAME:
       {
-	coll_t cid(i.decode_cid());
-	coll_t ncid(i.decode_cid());
 	f->dump_string("op_name", "collection_rename");
-	f->dump_stream("src_collection") << cid;
-	f->dump_stream("dst_collection") << ncid;
+	f->dump_stream("src_collection") << i.get_cid(op->cid);
+	f->dump_stream("dst_collection") << i.get_cid(op->dest_cid);
       }
       break;
 
     case Transaction::OP_OMAP_CLEAR:
       {
-	coll_t cid(i.decode_cid());
-	ghobject_t oid = i.decode_oid();
 	f->dump_string("op_name", "omap_clear");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
 
     case Transaction::OP_OMAP_SETKEYS:
       {
-	coll_t cid(i.decode_cid());
-	ghobject_t oid = i.decode_oid();
 	map<string, bufferlist> aset;
 	i.decode_attrset(aset);
 	f->dump_string("op_name", "omap_setkeys");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->open_object_section("attr_lens");
 	for (map<string, bufferlist>::iterator p = aset.begin();
 	    p != aset.end(); ++p) {
@@ -337,67 +856,53 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_OMAP_RMKEYS:
       {
-	coll_t cid(i.decode_cid());
-	ghobject_t oid = i.decode_oid();
 	set<string> keys;
 	i.decode_keyset(keys);
 	f->dump_string("op_name", "omap_rmkeys");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
       }
       break;
 
     case Transaction::OP_OMAP_SETHEADER:
       {
-	coll_t cid(i.decode_cid());
-	ghobject_t oid = i.decode_oid();
 	bufferlist bl;
 	i.decode_bl(bl);
 	f->dump_string("op_name", "omap_setheader");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->dump_stream("header_length") << bl.length();
       }
       break;
 
     case Transaction::OP_SPLIT_COLLECTION:
       {
-	coll_t cid(i.decode_cid());
-	uint32_t bits(i.decode_u32());
-	uint32_t rem(i.decode_u32());
-	coll_t dest(i.decode_cid());
 	f->dump_string("op_name", "op_split_collection_create");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("bits") << bits;
-	f->dump_stream("rem") << rem;
-	f->dump_stream("dest") << dest;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("bits") << op->split_bits;
+	f->dump_stream("rem") << op->split_rem;
+	f->dump_stream("dest") << i.get_cid(op->dest_cid);
       }
       break;
 
     case Transaction::OP_SPLIT_COLLECTION2:
       {
-	coll_t cid(i.decode_cid());
-	uint32_t bits(i.decode_u32());
-	uint32_t rem(i.decode_u32());
-	coll_t dest(i.decode_cid());
 	f->dump_string("op_name", "op_split_collection");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("bits") << bits;
-	f->dump_stream("rem") << rem;
-	f->dump_stream("dest") << dest;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("bits") << op->split_bits;
+	f->dump_stream("rem") << op->split_rem;
+	f->dump_stream("dest") << i.get_cid(op->dest_cid);
       }
       break;
 
     case Transaction::OP_OMAP_RMKEYRANGE:
       {
-	coll_t cid(i.decode_cid());
-	ghobject_t oid = i.decode_oid();
 	string first, last;
 	first = i.decode_key();
 	last = i.decode_key();
 	f->dump_string("op_name", "op_omap_rmkeyrange");
-	f->dump_stream("collection") << cid;
-	f->dump_stream("oid") << oid;
+	f->dump_stream("collection") << i.get_cid(op->cid);
+	f->dump_stream("oid") << i.get_oid(op->oid);
 	f->dump_string("first", first);
 	f->dump_string("last", last);
       }
@@ -405,35 +910,27 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
 
     case Transaction::OP_COLL_MOVE_RENAME:
       {
-	coll_t old_cid(i.decode_cid());
-	ghobject_t old_oid = i.decode_oid();
-	coll_t new_cid(i.decode_cid());
-	ghobject_t new_oid = i.decode_oid();
 	f->dump_string("op_name", "op_coll_move_rename");
-	f->dump_stream("old_collection") << old_cid;
-	f->dump_stream("old_oid") << old_oid;
-	f->dump_stream("new_collection") << new_cid;
-	f->dump_stream("new_oid") << new_oid;
+	f->dump_stream("old_collection") << i.get_cid(op->cid);
+	f->dump_stream("old_oid") << i.get_oid(op->oid);
+	f->dump_stream("new_collection") << i.get_cid(op->dest_cid);
+	f->dump_stream("new_oid") << i.get_oid(op->dest_oid);
       }
       break;
 
     case Transaction::OP_SETALLOCHINT:
       {
-        coll_t cid = i.decode_cid();
-        ghobject_t oid = i.decode_oid();
-        uint64_t expected_object_size = i.decode_length();
-        uint64_t expected_write_size = i.decode_length();
         f->dump_string("op_name", "op_setallochint");
-        f->dump_stream("collection") << cid;
-        f->dump_stream("oid") << oid;
-        f->dump_stream("expected_object_size") << expected_object_size;
-        f->dump_stream("expected_write_size") << expected_write_size;
+        f->dump_stream("collection") << i.get_cid(op->cid);
+        f->dump_stream("oid") << i.get_oid(op->oid);
+        f->dump_stream("expected_object_size") << op->expected_object_size;
+        f->dump_stream("expected_write_size") << op->expected_write_size;
       }
       break;
 
     default:
       f->dump_string("op_name", "unknown");
-      f->dump_unsigned("op_code", op);
+      f->dump_unsigned("op_code", op->op);
       stop_looping = true;
       break;
     }
@@ -56,7 +56,10 @@ struct ECSubWrite {
       temp_added(temp_added),
       temp_removed(temp_removed),
       updated_hit_set_history(updated_hit_set_history) {}
-  void encode(bufferlist &bl) const;
+  void encode(bufferlist &bl) const {
+    encode(bl, CEPH_FEATURES_ALL);
+  }
+  void encode(bufferlist &bl, uint64_t features) const;
   void decode(bufferlist::iterator &bl);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<ECSubWrite*>& o);
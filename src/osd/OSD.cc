@@ -64,6 +64,7 @@
 #include "messages/MOSDFailure.h"
 #include "messages/MOSDMarkMeDown.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
@@ -117,6 +118,8 @@
 #include "include/color.h"
 #include "perfglue/cpu_profiler.h"
 #include "perfglue/heap_profiler.h"
+#include "perfglue/sampling_profiler.h"
+#include "common/profile_tag.h"
 
 #include "osd/ClassHandler.h"
 #include "osd/OpRequest.h"
@@ -1568,6 +1571,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
                                          cct->_conf->osd_op_log_threshold);
   op_tracker.set_history_size_and_duration(cct->_conf->osd_op_history_size,
                                            cct->_conf->osd_op_history_duration);
+  op_tracker.set_stages(OpRequest::stage_names, OpRequest::STAGE_MAX + 1);
 }
 
 OSD::~OSD()
@@ -1648,6 +1652,19 @@ bool OSD::asok_command(string command, cmdmap_t& cmdmap, string format,
     op_tracker.dump_ops_in_flight(f);
   } else if (command == "dump_historic_ops") {
     op_tracker.dump_historic_ops(f);
+  } else if (command == "dump_op_stage_latency") {
+    op_tracker.dump_stage_latency(f);
+  } else if (command == "sampling_profiler") {
+    vector<string> argvec;
+    argvec.push_back(command);
+    string action, arg;
+    cmd_getval(cct, cmdmap, "action", action);
+    argvec.push_back(action);
+    if (cmd_getval(cct, cmdmap, "arg", arg))
+      argvec.push_back(arg);
+    sampling_profiler_handle_command(argvec,
+				     cct->_conf->sampling_profiler_max_samples,
+				     ss);
   } else if (command == "dump_op_pq_state") {
     f->open_object_section("pq");
     op_shardedwq.dump(f);
@@ -1964,6 +1981,22 @@ void OSD::final_init()
 				     asok_hook,
 				     "show slowest recent ops");
   assert(r == 0);
+  r = admin_socket->register_command("dump_op_stage_latency",
+				     "dump_op_stage_latency",
+				     asok_hook,
+				     "show per-stage latency histograms of "
+				     "completed ops");
+  assert(r == 0);
+  r = admin_socket->register_command("sampling_profiler",
+				     "sampling_profiler " \
+				     "name=action,type=CephChoices,"
+				     "strings=start|stop|status|reset|dump " \
+				     "name=arg,type=CephString,req=false",
+				     asok_hook,
+				     "sampled on-CPU profile tagged by work "
+				     "queue and op: start [hz], stop, status, "
+				     "reset, dump <folded stack output path>");
+  assert(r == 0);
   r = admin_socket->register_command("dump_op_pq_state", "dump_op_pq_state",
 				     asok_hook,
 				     "dump op priority queue state");
@@ -2263,6 +2296,8 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("flush_journal");
   cct->get_admin_socket()->unregister_command("dump_ops_in_flight");
   cct->get_admin_socket()->unregister_command("dump_historic_ops");
+  cct->get_admin_socket()->unregister_command("dump_op_stage_latency");
+  cct->get_admin_socket()->unregister_command("sampling_profiler");
   cct->get_admin_socket()->unregister_command("dump_op_pq_state");
   cct->get_admin_socket()->unregister_command("dump_blacklist");
   cct->get_admin_socket()->unregister_command("dump_watchers");
@@ -5398,6 +5433,10 @@ void OSD::ms_fast_dispatch(Message *m)
     m->put();
     return;
   }
+  if (m->get_type() == CEPH_MSG_OSD_OP_BATCH) {
+    dispatch_op_batch(static_cast<MOSDOpBatch*>(m));
+    return;
+  }
   OpRequestRef op = op_tracker.create_request<OpRequest>(m);
   {
 #ifdef WITH_LTTNG
@@ -5420,6 +5459,43 @@ void OSD::ms_fast_dispatch(Message *m)
   service.release_map(nextmap);
 }
 
+/*
+ * The messenger charged the whole batch to the connection's policy
+ * throttler, and gives that back when the batch is freed, so each op
+ * holds a ref to the batch until it is put itself.
+ */
+struct C_PutOpBatch : public Message::CompletionHook {
+  MOSDOpBatch *batch;
+  C_PutOpBatch(Message *op, MOSDOpBatch *b)
+    : Message::CompletionHook(op), batch(b) {
+    batch->get();
+  }
+  void finish(int r) {
+    batch->put();
+  }
+};
+
+void OSD::dispatch_op_batch(MOSDOpBatch *m)
+{
+  dout(20) << __func__ << " " << *m << dendl;
+  list<MOSDOp*> ops;
+  ops.swap(m->ops);
+  for (list<MOSDOp*>::iterator p = ops.begin(); p != ops.end(); ++p) {
+    // as if each op had arrived on its own
+    MOSDOp *op = *p;
+    assert(!op->get_completion_hook());
+    op->set_completion_hook(new C_PutOpBatch(op, m));
+    op->set_connection(m->get_connection());
+    op->get_header().src = m->get_header().src;
+    op->set_recv_stamp(m->get_recv_stamp());
+    op->set_throttle_stamp(m->get_throttle_stamp());
+    op->set_recv_complete_stamp(m->get_recv_complete_stamp());
+    op->set_dispatch_stamp(m->get_dispatch_stamp());
+    ms_fast_dispatch(op);
+  }
+  m->put();
+}
+
 void OSD::ms_fast_preprocess(Message *m)
 {
   if (m->get_connection()->get_peer_type() == CEPH_ENTITY_TYPE_OSD) {
@@ -8131,6 +8207,7 @@ void OSD::enqueue_op(PG *pg, OpRequestRef& op)
 	   << " cost " << op->get_req()->get_cost()
 	   << " latency " << latency
 	   << " " << *(op->get_req()) << dendl;
+  op->mark_queued_for_pg();
   pg->queue_op(op);
 }
 
@@ -8300,7 +8377,14 @@ void OSD::dequeue_op(
 
   op->mark_reached_pg();
 
+  if (g_profile_tag)
+    profile_tag_set_op("%s pool %llu pg %llu.%x",
+		       op->get_req()->get_type_name(),
+		       (unsigned long long)pg->info.pgid.pool(),
+		       (unsigned long long)pg->info.pgid.pool(),
+		       pg->info.pgid.ps());
   pg->do_request(op, handle);
+  profile_tag_clear_op();
 
   // finish
   dout(10) << "dequeue_op " << op << " finish" << dendl;
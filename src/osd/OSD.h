@@ -186,6 +186,7 @@ class PerfCounters;
 class ObjectStore;
 class OSDMap;
 class MLog;
+class MOSDOpBatch;
 class MClass;
 class MOSDPGMissing;
 class Objecter;
@@ -2277,6 +2278,7 @@ protected:
   bool ms_can_fast_dispatch(Message *m) const {
     switch (m->get_type()) {
     case CEPH_MSG_OSD_OP:
+    case CEPH_MSG_OSD_OP_BATCH:
     case MSG_OSD_SUBOP:
     case MSG_OSD_SUBOPREPLY:
     case MSG_OSD_PG_PUSH:
@@ -2294,6 +2296,7 @@ protected:
     }
   }
   void ms_fast_dispatch(Message *m);
+  void dispatch_op_batch(MOSDOpBatch *m);
   void ms_fast_preprocess(Message *m);
   bool ms_dispatch(Message *m);
   bool ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new);
@@ -17,6 +17,18 @@
 #endif
 
 
+const char *OpRequest::stage_names[OpRequest::STAGE_MAX + 1] = {
+  "received",
+  "queued",
+  "dequeued",
+  "started",
+  "sub_op_sent",
+  "committed",
+  "applied",
+  "replied",
+  "total"
+};
+
 OpRequest::OpRequest(Message *req, OpTracker *tracker) :
   TrackedOp(tracker, req->get_recv_stamp()),
   rmw_flags(0), request(req),
@@ -31,6 +43,7 @@ OpRequest::OpRequest(Message *req, OpTracker *tracker) :
   } else if (req->get_type() == MSG_OSD_SUBOP) {
     reqid = static_cast<MOSDSubOp*>(req)->reqid;
   }
+  mark_stage(STAGE_RECEIVED, req->get_recv_stamp());
   tracker->mark_event(this, "header_read", request->get_recv_stamp());
   tracker->mark_event(this, "throttled", request->get_throttle_stamp());
   tracker->mark_event(this, "all_read", request->get_recv_complete_stamp());
@@ -62,6 +75,12 @@ void OpRequest::_dump(utime_t now, Formatter *f) const
     }
     f->close_section();
   }
+  f->open_object_section("stages");
+  for (unsigned s = STAGE_RECEIVED; s < STAGE_MAX; ++s) {
+    if (!stage_stamp[s].is_zero())
+      f->dump_stream(stage_names[s]) << stage_stamp[s];
+  }
+  f->close_section();
 }
 
 void OpRequest::_dump_op_descriptor_unlocked(ostream& stream) const
@@ -72,6 +91,19 @@ void OpRequest::_dump_op_descriptor_unlocked(ostream& stream) const
 void OpRequest::_unregistered() {
   request->clear_data();
   request->clear_payload();
+
+  // account the time spent reaching each stage from the previous one.
+  // stages reached out of order (e.g. applied before committed) are
+  // skipped rather than charged a negative interval.
+  utime_t prev = stage_stamp[STAGE_RECEIVED];
+  for (unsigned s = STAGE_RECEIVED + 1; s < STAGE_MAX; ++s) {
+    if (stage_stamp[s].is_zero() || stage_stamp[s] < prev)
+      continue;
+    tracker->add_stage_latency(s, stage_stamp[s] - prev);
+    prev = stage_stamp[s];
+  }
+  if (prev > stage_stamp[STAGE_RECEIVED])
+    tracker->add_stage_latency(STAGE_TOTAL, prev - stage_stamp[STAGE_RECEIVED]);
 }
 
 bool OpRequest::check_rmw(int flag) {
@@ -111,12 +143,14 @@ void OpRequest::set_class_write() { set_rmw_flags(CEPH_OSD_RMW_FLAG_CLASS_WRITE)
 void OpRequest::set_pg_op() { set_rmw_flags(CEPH_OSD_RMW_FLAG_PGOP); }
 void OpRequest::set_cache() { set_rmw_flags(CEPH_OSD_RMW_FLAG_CACHE); }
 
-void OpRequest::mark_flag_point(uint8_t flag, string s) {
+void OpRequest::mark_flag_point(uint8_t flag, const string& s) {
 #ifdef WITH_LTTNG
   uint8_t old_flags = hit_flag_points;
 #endif
-  mark_event(s);
-  current = s;
+  if (tracker->tracking_enabled) {
+    mark_event(s);
+    current = s;
+  }
   hit_flag_points |= flag;
   latest_flag_point = flag;
   tracepoint(oprequest, mark_flag_point, reqid.name._type,
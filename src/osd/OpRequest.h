@@ -41,10 +41,14 @@ struct osd_reqid_t {
 
   void encode(bufferlist &bl) const;
   void decode(bufferlist::iterator &bl);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<osd_reqid_t*>& o);
 };
 WRITE_CLASS_ENCODER(osd_reqid_t)
+WRITE_CLASS_DENC(osd_reqid_t)
 
 /**
  * The OpRequest takes in a Message* and takes over a single reference
@@ -74,6 +78,38 @@ struct OpRequest : public TrackedOp {
 
   void _dump(utime_t now, Formatter *f) const;
 
+  /**
+   * Stages every op may pass through.  The first time each is reached
+   * is recorded in a fixed array regardless of whether op tracking is
+   * enabled; when the op completes, the time taken to reach each stage
+   * from the previous one is fed to the tracker's stage histograms.
+   */
+  enum stage_t {
+    STAGE_RECEIVED = 0,
+    STAGE_QUEUED,
+    STAGE_DEQUEUED,
+    STAGE_STARTED,
+    STAGE_SUB_OP_SENT,
+    STAGE_COMMITTED,
+    STAGE_APPLIED,
+    STAGE_REPLIED,
+    STAGE_MAX,
+    STAGE_TOTAL = STAGE_MAX  ///< histogram slot for received -> last stage
+  };
+  static const char *stage_names[STAGE_MAX + 1];
+
+  void mark_stage(stage_t s, utime_t t) {
+    if (stage_stamp[s].is_zero())
+      stage_stamp[s] = t;
+  }
+  void mark_stage(stage_t s) {
+    if (stage_stamp[s].is_zero())
+      stage_stamp[s] = ceph_clock_now(tracker->cct);
+  }
+  utime_t get_stage_stamp(stage_t s) const {
+    return stage_stamp[s];
+  }
+
   bool has_feature(uint64_t f) const {
     return request->get_connection()->has_feature(f);
   }
@@ -84,6 +120,7 @@ private:
   uint8_t hit_flag_points;
   uint8_t latest_flag_point;
   utime_t dequeued_time;
+  utime_t stage_stamp[STAGE_MAX];
   static const uint8_t flag_queued_for_pg=1 << 0;
   static const uint8_t flag_reached_pg =  1 << 1;
   static const uint8_t flag_delayed =     1 << 2;
@@ -131,21 +168,25 @@ public:
   }
 
   void mark_queued_for_pg() {
+    mark_stage(STAGE_QUEUED);
     mark_flag_point(flag_queued_for_pg, "queued_for_pg");
   }
   void mark_reached_pg() {
     mark_flag_point(flag_reached_pg, "reached_pg");
   }
-  void mark_delayed(string s) {
+  void mark_delayed(const string& s) {
     mark_flag_point(flag_delayed, s);
   }
   void mark_started() {
+    mark_stage(STAGE_STARTED);
     mark_flag_point(flag_started, "started");
   }
-  void mark_sub_op_sent(string s) {
+  void mark_sub_op_sent(const string& s) {
+    mark_stage(STAGE_SUB_OP_SENT);
     mark_flag_point(flag_sub_op_sent, s);
   }
   void mark_commit_sent() {
+    mark_stage(STAGE_REPLIED);
     mark_flag_point(flag_commit_sent, "commit_sent");
   }
 
@@ -154,6 +195,7 @@ public:
   }
   void set_dequeued_time(utime_t deq_time) {
     dequeued_time = deq_time;
+    mark_stage(STAGE_DEQUEUED, deq_time);
   }
 
   osd_reqid_t get_reqid() const {
@@ -164,7 +206,7 @@ public:
 
 private:
   void set_rmw_flags(int flags);
-  void mark_flag_point(uint8_t flag, string s);
+  void mark_flag_point(uint8_t flag, const string& s);
 };
 
 typedef OpRequest::Ref OpRequestRef;
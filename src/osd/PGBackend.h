@@ -212,6 +212,8 @@
        Message *m, const ConnectionRef& con) = 0;
      virtual ConnectionRef get_con_osd_cluster(int peer, epoch_t from_epoch) = 0;
      virtual entity_name_t get_cluster_msgr_name() = 0;
+     /// features common to every peer in the acting set
+     virtual uint64_t min_peer_features() = 0;
 
      virtual PerfCounters *get_logger() = 0;
 
@@ -588,8 +588,10 @@ void ReplicatedBackend::op_applied(
   InProgressOp *op)
 {
   dout(10) << __func__ << ": " << op->tid << dendl;
-  if (op->op)
+  if (op->op) {
+    op->op->mark_stage(OpRequest::STAGE_APPLIED);
     op->op->mark_event("op_applied");
+  }
 
   op->waiting_for_applied.erase(get_parent()->whoami_shard());
   parent->op_applied(op->v);
@@ -608,8 +610,10 @@ void ReplicatedBackend::op_commit(
   InProgressOp *op)
 {
   dout(10) << __func__ << ": " << op->tid << dendl;
-  if (op->op)
+  if (op->op) {
+    op->op->mark_stage(OpRequest::STAGE_COMMITTED);
     op->op->mark_event("op_commit");
+  }
 
   op->waiting_for_commit.erase(get_parent()->whoami_shard());
 
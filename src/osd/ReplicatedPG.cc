@@ -49,6 +49,7 @@
 
 #include "common/config.h"
 #include "include/compat.h"
+#include "include/err.h"
 #include "common/cmdparse.h"
 
 #include "mon/MonClient.h"
@@ -553,6 +554,9 @@ bool PGLSPlainFilter::filter(bufferlist& xattr_data, bufferlist& outdata)
 
 bool ReplicatedPG::pgls_filter(PGLSFilter *filter, hobject_t& sobj, bufferlist& outdata)
 {
+  if (filter->get_expr())
+    return pgls_expr_filter(*filter->get_expr(), sobj, outdata);
+
   bufferlist bl;
   int ret = pgbackend->objects_get_attr(
     sobj,
@@ -565,6 +569,66 @@ bool ReplicatedPG::pgls_filter(PGLSFilter *filter, hobject_t& sobj, bufferlist&
   return filter->filter(bl, outdata);
 }
 
+bool ReplicatedPG::pgls_expr_filter(const pg_nls_filter_t& expr,
+				    hobject_t& sobj, bufferlist& outdata)
+{
+  // cheapest checks first
+  if (!expr.match_name(sobj.oid.name))
+    return false;
+
+  pg_nls_object_info_t info;
+  if (expr.needs_stat()) {
+    bufferlist bl;
+    int r = pgbackend->objects_get_attr(sobj, OI_ATTR, &bl);
+    if (r < 0)
+      return false;
+    object_info_t oi(bl);
+    if (!expr.match_stat(oi.size, oi.mtime))
+      return false;
+    if (expr.want & pg_nls_filter_t::WANT_SIZE)
+      info.size = oi.size;
+    if (expr.want & pg_nls_filter_t::WANT_MTIME)
+      info.mtime = oi.mtime;
+  }
+
+  // user xattrs are stored with a leading _
+  for (map<string, bufferlist>::const_iterator p = expr.xattrs_equal.begin();
+       p != expr.xattrs_equal.end(); ++p) {
+    bufferlist bl, want = p->second;
+    int r = pgbackend->objects_get_attr(sobj, "_" + p->first, &bl);
+    if (r < 0 || !bl.contents_equal(want))
+      return false;
+  }
+  for (set<string>::const_iterator p = expr.xattrs_present.begin();
+       p != expr.xattrs_present.end(); ++p) {
+    bufferlist bl;
+    if (pgbackend->objects_get_attr(sobj, "_" + *p, &bl) < 0)
+      return false;
+  }
+
+  if (expr.check_omap_header) {
+    bufferlist header;
+    if (!pool.info.require_rollback())
+      osd->store->omap_get_header(coll, sobj, &header);
+    unsigned len = expr.omap_header_prefix.length();
+    if (header.length() < len)
+      return false;
+    bufferlist prefix, want = expr.omap_header_prefix;
+    prefix.substr_of(header, 0, len);
+    if (!prefix.contents_equal(want))
+      return false;
+  }
+
+  for (set<string>::const_iterator p = expr.want_xattrs.begin();
+       p != expr.want_xattrs.end(); ++p) {
+    bufferlist bl;
+    if (pgbackend->objects_get_attr(sobj, "_" + *p, &bl) >= 0)
+      info.xattrs[*p].claim(bl);
+  }
+  ::encode(info, outdata);
+  return true;
+}
+
 int ReplicatedPG::get_pgls_filter(bufferlist::iterator& iter, PGLSFilter **pfilter)
 {
   string type;
@@ -581,6 +645,12 @@ int ReplicatedPG::get_pgls_filter(bufferlist::iterator& iter, PGLSFilter **pfilt
     filter = new PGLSParentFilter(iter);
   } else if (type.compare("plain") == 0) {
     filter = new PGLSPlainFilter(iter);
+  } else if (type.compare("expr") == 0) {
+    try {
+      filter = new PGLSExprFilter(iter);
+    } catch (buffer::error& e) {
+      return -EINVAL;
+    }
   } else {
     return -EINVAL;
   }
@@ -3770,6 +3840,57 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       }
       break;
 
+    case CEPH_OSD_OP_CMPEXT:
+      ++ctx->num_read;
+      tracepoint(osd, do_osd_op_pre_cmpext, soid.oid.name.c_str(), soid.snap.val, op.extent.offset, op.extent.length);
+      if (pool.info.require_rollback()) {
+	result = -EOPNOTSUPP;
+	break;
+      }
+      {
+	// the mismatch offset is returned in the result
+	if (op.extent.length != osd_op.indata.length() ||
+	    op.extent.length > (uint64_t)(INT_MAX - MAX_ERRNO)) {
+	  result = -EINVAL;
+	  break;
+	}
+
+	bufferlist read_bl;
+	if (obs.exists && !oi.is_whiteout() && op.extent.offset < oi.size &&
+	    op.extent.length > 0) {
+	  uint64_t len = MIN(op.extent.length, oi.size - op.extent.offset);
+	  int r = pgbackend->objects_read_sync(
+	    soid, op.extent.offset, len, &read_bl);
+	  if (r < 0) {
+	    result = r;
+	    break;
+	  }
+	}
+	ctx->delta_stats.num_rd++;
+	ctx->delta_stats.num_rd_kb += SHIFT_ROUND_UP(read_bl.length(), 10);
+
+	// anything past the end of the object reads as zeros
+	uint64_t read_len = read_bl.length();
+	const char *cmp = op.extent.length ? osd_op.indata.c_str() : NULL;
+	const char *data = read_len ? read_bl.c_str() : NULL;
+	uint64_t idx = 0;
+	if (read_len == op.extent.length &&
+	    (read_len == 0 || memcmp(cmp, data, read_len) == 0)) {
+	  idx = op.extent.length;
+	} else {
+	  for (; idx < op.extent.length; ++idx) {
+	    char c = idx < read_len ? data[idx] : 0;
+	    if (cmp[idx] != c)
+	      break;
+	  }
+	}
+	if (idx < op.extent.length) {
+	  dout(10) << " cmpext mismatch at " << op.extent.offset + idx << dendl;
+	  result = -MAX_ERRNO - (int)idx;
+	}
+      }
+      break;
+
     case CEPH_OSD_OP_ASSERT_VER:
       ++ctx->num_read;
       {
@@ -3936,10 +4057,13 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	try {
 	  uint64_t notify_id = 0;
 	  uint64_t watch_cookie = 0;
+	  bufferlist reply_bl;
 	  ::decode(notify_id, bp);
 	  ::decode(watch_cookie, bp);
+	  if (!bp.end())
+	    ::decode(reply_bl, bp);
 	  tracepoint(osd, do_osd_op_pre_notify_ack, soid.oid.name.c_str(), soid.snap.val, notify_id, watch_cookie, "Y");
-	  OpContext::NotifyAck ack(notify_id, watch_cookie);
+	  OpContext::NotifyAck ack(notify_id, watch_cookie, reply_bl);
 	  ctx->notify_acks.push_back(ack);
 	} catch (const buffer::error &e) {
 	  tracepoint(osd, do_osd_op_pre_notify_ack, soid.oid.name.c_str(), soid.snap.val, op.watch.cookie, 0, "N");
@@ -4415,6 +4539,45 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
       }
       break;
 
+    case CEPH_OSD_OP_WRITESAME:
+      {
+	tracepoint(osd, do_osd_op_pre_writesame, soid.oid.name.c_str(), soid.snap.val, oi.size, op.writesame.offset, op.writesame.length, op.writesame.data_length);
+	uint64_t data_length = op.writesame.data_length;
+	uint64_t length = op.writesame.length;
+	if (data_length == 0 || data_length != osd_op.indata.length()) {
+	  result = -EINVAL;
+	  break;
+	}
+	result = check_offset_and_length(op.writesame.offset, length,
+					 cct->_conf->osd_max_object_size);
+	if (result < 0)
+	  break;
+	// the expanded write must fit in the journal like any other
+	if (cct->_conf->osd_max_write_size &&
+	    length > (uint64_t)cct->_conf->osd_max_write_size << 20) {
+	  result = -EFBIG;
+	  break;
+	}
+
+	// only the pattern came over the wire; expand it into a plain
+	// write, truncating the last copy
+	bufferptr bp(length);
+	const char *pattern = osd_op.indata.c_str();
+	for (uint64_t off = 0; off < length; off += data_length)
+	  memcpy(bp.c_str() + off, pattern, MIN(data_length, length - off));
+
+	vector<OSDOp> nops(1);
+	OSDOp& newop = nops[0];
+	newop.op.op = CEPH_OSD_OP_WRITE;
+	newop.op.extent.offset = op.writesame.offset;
+	newop.op.extent.length = length;
+	newop.op.extent.truncate_seq = oi.truncate_seq;
+	newop.indata.push_back(bp);
+	result = do_osd_ops(ctx, nops);
+	osd_op.outdata.claim(newop.outdata);
+      }
+      break;
+
     case CEPH_OSD_OP_STARTSYNC:
       tracepoint(osd, do_osd_op_pre_startsync, soid.oid.name.c_str(), soid.snap.val);
       t->nop();
@@ -5406,12 +5569,26 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx)
 	osd->get_next_id(get_osdmap()->get_epoch()),
 	ctx->obc->obs.oi.user_version,
 	osd));
+    // watches on connections that take batched notifications get one
+    // message per connection
+    map<ConnectionRef, vector<uint64_t> > batches;
     for (map<pair<uint64_t, entity_name_t>, WatchRef>::iterator i =
 	   ctx->obc->watchers.begin();
 	 i != ctx->obc->watchers.end();
 	 ++i) {
       dout(10) << "starting notify on watch " << i->first << dendl;
-      i->second->start_notify(notif);
+      ConnectionRef con = i->second->get_con();
+      if (con && con->has_feature(CEPH_FEATURE_WATCH_NOTIFY_BATCH)) {
+	i->second->start_notify(notif, false);
+	batches[con].push_back(i->second->get_cookie());
+      } else {
+	i->second->start_notify(notif);
+      }
+    }
+    for (map<ConnectionRef, vector<uint64_t> >::iterator i = batches.begin();
+	 i != batches.end();
+	 ++i) {
+      notif->send_batch(i->first, i->second);
     }
     notif->init();
   }
@@ -5431,7 +5608,7 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx)
       if (p->watch_cookie &&
 	  p->watch_cookie.get() != i->first.first) continue;
       dout(10) << "acking notify on watch " << i->first << dendl;
-      i->second->notify_ack(p->notify_id);
+      i->second->notify_ack(p->notify_id, p->reply_bl);
     }
   }
 }
@@ -5721,6 +5898,7 @@ void ReplicatedPG::complete_read_ctx(int result, OpContext *ctx)
   reply->set_result(result);
   reply->add_flags(CEPH_OSD_FLAG_ACK | CEPH_OSD_FLAG_ONDISK);
   osd->send_message_osd_client(reply, m->get_connection());
+  ctx->op->mark_stage(OpRequest::STAGE_REPLIED);
   close_op_ctx(ctx, 0);
 }
 
@@ -7199,9 +7377,9 @@ void ReplicatedBackend::issue_op(
 	       << ", pinfo.last_backfill "
 	       << pinfo.last_backfill << ")" << dendl;
       ObjectStore::Transaction t;
-      ::encode(t, wr->get_data());
+      t.encode(wr->get_data(), parent->min_peer_features());
     } else {
-      ::encode(*op_t, wr->get_data());
+      op_t->encode(wr->get_data(), parent->min_peer_features());
     }
 
     ::encode(log_entries, wr->logbl);
@@ -8032,6 +8210,7 @@ void ReplicatedBackend::sub_op_modify(OpRequestRef op)
 
 void ReplicatedBackend::sub_op_modify_applied(RepModifyRef rm)
 {
+  rm->op->mark_stage(OpRequest::STAGE_APPLIED);
   rm->op->mark_event("sub_op_applied");
   rm->applied = true;
 
@@ -8055,6 +8234,7 @@ void ReplicatedBackend::sub_op_modify_applied(RepModifyRef rm)
 
 void ReplicatedBackend::sub_op_modify_commit(RepModifyRef rm)
 {
+  rm->op->mark_stage(OpRequest::STAGE_COMMITTED);
   rm->op->mark_commit_sent();
   rm->committed = true;
 
@@ -65,6 +65,8 @@ public:
   virtual ~PGLSFilter();
   virtual bool filter(bufferlist& xattr_data, bufferlist& outdata) = 0;
   virtual string& get_xattr() { return xattr; }
+  /// filters the PG evaluates itself instead of looking at one xattr
+  virtual const pg_nls_filter_t *get_expr() const { return NULL; }
 };
 
 class PGLSPlainFilter : public PGLSFilter {
@@ -90,6 +92,19 @@ public:
   virtual bool filter(bufferlist& xattr_data, bufferlist& outdata);
 };
 
+class PGLSExprFilter : public PGLSFilter {
+  pg_nls_filter_t expr;
+public:
+  PGLSExprFilter(bufferlist::iterator& params) {
+    ::decode(expr, params);
+  }
+  virtual ~PGLSExprFilter() {}
+  virtual bool filter(bufferlist& xattr_data, bufferlist& outdata) {
+    return false;
+  }
+  virtual const pg_nls_filter_t *get_expr() const { return &expr; }
+};
+
 class ReplicatedPG : public PG, public PGBackend::Listener {
   friend class OSD;
   friend class Watch;
@@ -411,6 +426,9 @@ public:
   entity_name_t get_cluster_msgr_name() {
     return osd->get_cluster_msgr_name();
   }
+  uint64_t min_peer_features() {
+    return get_min_peer_features();
+  }
 
   PerfCounters *get_logger();
 
@@ -447,9 +465,10 @@ public:
     struct NotifyAck {
       boost::optional<uint64_t> watch_cookie;
       uint64_t notify_id;
+      bufferlist reply_bl;
       NotifyAck(uint64_t notify_id) : notify_id(notify_id) {}
-      NotifyAck(uint64_t notify_id, uint64_t cookie)
-	: watch_cookie(cookie), notify_id(notify_id) {}
+      NotifyAck(uint64_t notify_id, uint64_t cookie, const bufferlist& rbl)
+	: watch_cookie(cookie), notify_id(notify_id), reply_bl(rbl) {}
     };
     list<NotifyAck> notify_acks;
     
@@ -1265,6 +1284,8 @@ protected:
   int do_xattr_cmp_str(int op, string& v1s, bufferlist& xattr);
 
   bool pgls_filter(PGLSFilter *filter, hobject_t& sobj, bufferlist& outdata);
+  bool pgls_expr_filter(const pg_nls_filter_t& expr, hobject_t& sobj,
+			bufferlist& outdata);
   int get_pgls_filter(bufferlist::iterator& iter, PGLSFilter **pfilter);
 
 public:
@@ -102,20 +102,7 @@ void Notify::do_timeout()
   timed_out = true;         // we will send the client and error code
   maybe_complete_notify();
   assert(complete);
-  set<WatchRef> _watchers;
-  _watchers.swap(watchers);
   lock.Unlock();
-
-  for (set<WatchRef>::iterator i = _watchers.begin();
-       i != _watchers.end();
-       ++i) {
-    boost::intrusive_ptr<ReplicatedPG> pg((*i)->get_pg());
-    pg->lock();
-    if (!(*i)->is_discarded()) {
-      (*i)->cancel_notify(self.lock());
-    }
-    pg->unlock();
-  }
 }
 
 void Notify::register_cb()
@@ -145,21 +132,27 @@ void Notify::unregister_cb()
   }
 }
 
-void Notify::start_watcher(WatchRef watch)
+void Notify::send_batch(ConnectionRef con, const vector<uint64_t> &cookies)
 {
-  Mutex::Locker l(lock);
-  dout(10) << "start_watcher" << dendl;
-  watchers.insert(watch);
+  dout(10) << "send_batch " << cookies << dendl;
+  assert(!cookies.empty());
+  MWatchNotify *notify_msg = new MWatchNotify(
+    cookies.front(), version, notify_id, WATCH_NOTIFY, payload);
+  if (cookies.size() > 1)
+    notify_msg->cookies = cookies;
+  osd->send_message_osd_client(notify_msg, con.get());
 }
 
-void Notify::complete_watcher(WatchRef watch)
+void Notify::complete_watcher(WatchRef watch, const bufferlist &reply_bl)
 {
   Mutex::Locker l(lock);
   dout(10) << "complete_watcher" << dendl;
   if (is_discarded())
     return;
   assert(in_progress_watchers > 0);
-  watchers.erase(watch);
+  if (reply_bl.length())
+    notify_replies[make_pair(watch->get_entity().num(),
+			     watch->get_cookie())] = reply_bl;
   --in_progress_watchers;
   maybe_complete_notify();
 }
@@ -170,8 +163,16 @@ void Notify::maybe_complete_notify()
 	   << in_progress_watchers
 	   << " in progress watchers " << dendl;
   if (!in_progress_watchers) {
-    MWatchNotify *reply(new MWatchNotify(cookie, version, notify_id,
-					 WATCH_NOTIFY, payload));
+    MWatchNotify *reply;
+    if (client->has_feature(CEPH_FEATURE_WATCH_NOTIFY_BATCH)) {
+      bufferlist bl;
+      ::encode(notify_replies, bl);
+      reply = new MWatchNotify(cookie, version, notify_id,
+			       WATCH_NOTIFY_COMPLETE, bl);
+    } else {
+      reply = new MWatchNotify(cookie, version, notify_id,
+			       WATCH_NOTIFY, payload);
+    }
     if (timed_out)
       reply->return_code = -ETIMEDOUT;
     osd->send_message_osd_client(reply, client.get());
@@ -185,7 +186,6 @@ void Notify::discard()
   Mutex::Locker l(lock);
   discarded = true;
   unregister_cb();
-  watchers.clear();
 }
 
 void Notify::init()
@@ -193,7 +193,6 @@ void Notify::init()
   Mutex::Locker l(lock);
   register_cb();
   maybe_complete_notify();
-  assert(in_progress_watchers == watchers.size());
 }
 
 #define dout_subsys ceph_subsys_osd
@@ -326,6 +325,7 @@ void Watch::connect(ConnectionRef con)
   if (sessionref) {
     sessionref->wstate.addWatch(self.lock());
     sessionref->put();
+    trim_notifies();
     for (map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
 	 i != in_progress_notifies.end();
 	 ++i) {
@@ -383,28 +383,35 @@ void Watch::remove()
   for (map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
        i != in_progress_notifies.end();
        ++i) {
-    i->second->complete_watcher(self.lock());
+    i->second->complete_watcher(self.lock(), bufferlist());
   }
   discard_state();
 }
 
-void Watch::start_notify(NotifyRef notif)
+void Watch::trim_notifies()
+{
+  map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.begin();
+  while (i != in_progress_notifies.end()) {
+    if (i->second->is_done()) {
+      dout(20) << "trimming notify " << i->first << dendl;
+      in_progress_notifies.erase(i++);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void Watch::start_notify(NotifyRef notif, bool send)
 {
   dout(10) << "start_notify " << notif->notify_id << dendl;
+  trim_notifies();
   assert(in_progress_notifies.find(notif->notify_id) ==
 	 in_progress_notifies.end());
   in_progress_notifies[notif->notify_id] = notif;
-  notif->start_watcher(self.lock());
-  if (connected())
+  if (send && connected())
     send_notify(notif);
 }
 
-void Watch::cancel_notify(NotifyRef notif)
-{
-  dout(10) << "cancel_notify " << notif->notify_id << dendl;
-  in_progress_notifies.erase(notif->notify_id);
-}
-
 void Watch::send_notify(NotifyRef notif)
 {
   dout(10) << "send_notify" << dendl;
@@ -414,12 +421,12 @@ void Watch::send_notify(NotifyRef notif)
   osd->send_message_osd_client(notify_msg, conn.get());
 }
 
-void Watch::notify_ack(uint64_t notify_id)
+void Watch::notify_ack(uint64_t notify_id, const bufferlist &reply_bl)
 {
   dout(10) << "notify_ack" << dendl;
   map<uint64_t, NotifyRef>::iterator i = in_progress_notifies.find(notify_id);
   if (i != in_progress_notifies.end()) {
-    i->second->complete_watcher(self.lock());
+    i->second->complete_watcher(self.lock(), reply_bl);
     in_progress_notifies.erase(i);
   }
 }
@@ -47,7 +47,10 @@ struct CancelableContext;
 /**
  * Notify tracks the progress of a particular notify
  *
- * References are held by Watch and the timeout callback.
+ * References are held by Watch and the timeout callback.  Only a count
+ * of the watchers still to ack is kept here, plus any replies they
+ * sent; watches drop their references to completed notifies the next
+ * time they look at them.
  */
 class NotifyTimeoutCB;
 class Notify {
@@ -59,7 +62,8 @@ class Notify {
   bool complete;
   bool discarded;
   bool timed_out;  ///< true if the notify timed out
-  set<WatchRef> watchers;
+  /// non-empty notify_ack payloads by (watcher entity num, watch cookie)
+  map<pair<uint64_t, uint64_t>, bufferlist> notify_replies;
 
   bufferlist payload;
   uint32_t timeout;
@@ -123,16 +127,24 @@ public:
   /// Call after creation to initialize
   void init();
 
-  /// Called once per watcher prior to init()
-  void start_watcher(
-    WatchRef watcher ///< [in] watcher to complete
+  /// Sends one notification for several watches on con
+  void send_batch(
+    ConnectionRef con,             ///< [in] connection of the watches
+    const vector<uint64_t> &cookies ///< [in] cookies of the watches
     );
 
   /// Called once per NotifyAck
   void complete_watcher(
-    WatchRef watcher ///< [in] watcher to complete
+    WatchRef watcher,     ///< [in] watcher to complete
+    const bufferlist &reply_bl  ///< [in] reply payload from the watcher
     );
 
+  /// True once completed, timed out or discarded
+  bool is_done() {
+    Mutex::Locker l(lock);
+    return is_discarded();
+  }
+
   /// Called when the notify is canceled due to a new peering interval
   void discard();
 };
@@ -177,6 +189,9 @@ class Watch {
   /// send a Notify message when connected for notif
   void send_notify(NotifyRef notif);
 
+  /// Drops references to notifies that are already done
+  void trim_notifies();
+
   /// Cleans up state on discard or remove (including Connection state, obc)
   void discard_state();
 public:
@@ -203,6 +218,7 @@ public:
   entity_name_t get_entity() const { return entity; }
   entity_addr_t get_peer_addr() const { return addr; }
   uint32_t get_timeout() const { return timeout; }
+  ConnectionRef get_con() { return conn; }
 
   /// Generates context for use if watch timeout is delayed by scrub or recovery
   Context *get_delayed_cb();
@@ -227,19 +243,17 @@ public:
   /// Called on unwatch
   void remove();
 
-  /// Adds notif as in-progress notify
+  /// Adds notif as in-progress notify, sending it unless the caller
+  /// batches it with other watches on the connection
   void start_notify(
-    NotifyRef notif ///< [in] Reference to new in-progress notify
-    );
-
-  /// Removes timed out notify
-  void cancel_notify(
-    NotifyRef notif ///< [in] notify which timed out
+    NotifyRef notif,  ///< [in] Reference to new in-progress notify
+    bool send = true  ///< [in] send the notification if connected
     );
 
   /// Call when notify_ack received on notify_id
   void notify_ack(
-    uint64_t notify_id ///< [in] id of acked notify
+    uint64_t notify_id,  ///< [in] id of acked notify
+    const bufferlist &reply_bl ///< [in] reply payload from the watcher
     );
 };
 
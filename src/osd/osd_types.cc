@@ -15,6 +15,8 @@
  *
  */
 
+#include <fnmatch.h>
+
 #include "osd_types.h"
 #include "include/ceph_features.h"
 extern "C" {
@@ -96,15 +98,13 @@ ostream &operator<<(ostream &lhs, const pg_shard_t &rhs)
 // -- osd_reqid_t --
 void osd_reqid_t::encode(bufferlist &bl) const
 {
-  ENCODE_START(2, 2, bl);
-  ::encode(name, bl);
-  ::encode(tid, bl);
-  ::encode(inc, bl);
-  ENCODE_FINISH(bl);
+  denc_encode(*this, bl);
 }
 
 void osd_reqid_t::decode(bufferlist::iterator &bl)
 {
+  if (denc_decode(*this, bl, 2))
+    return;
   DECODE_START_LEGACY_COMPAT_LEN(2, 2, 2, bl);
   ::decode(name, bl);
   ::decode(tid, bl);
@@ -112,6 +112,32 @@ void osd_reqid_t::decode(bufferlist::iterator &bl)
   DECODE_FINISH(bl);
 }
 
+void osd_reqid_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(name, p);
+  ::bound_encode(tid, p);
+  ::bound_encode(inc, p);
+}
+
+void osd_reqid_t::encode(contiguous_appender& p) const
+{
+  DENC_START(2, 2, p);
+  ::encode(name, p);
+  ::encode(tid, p);
+  ::encode(inc, p);
+  DENC_FINISH(p);
+}
+
+void osd_reqid_t::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(2, 2, p);
+  ::decode(name, p);
+  ::decode(tid, p);
+  ::decode(inc, p);
+  DENC_DECODE_FINISH(p);
+}
+
 void osd_reqid_t::dump(Formatter *f) const
 {
   f->dump_stream("name") << name;
@@ -170,6 +196,47 @@ void object_locator_t::decode(bufferlist::iterator& p)
   assert(hash == -1 || key.empty());
 }
 
+void object_locator_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(pool, p);
+  p += sizeof(ceph_le32);  // preferred
+  ::bound_encode(key, p);
+  ::bound_encode(nspace, p);
+  ::bound_encode(hash, p);
+}
+
+void object_locator_t::encode(contiguous_appender& p) const
+{
+  // verify that nobody's corrupted the locator
+  assert(hash == -1 || key.empty());
+  __u8 encode_compat = 3;
+  DENC_START(6, encode_compat, p);
+  ::encode(pool, p);
+  int32_t preferred = -1;  // tell old code there is no preferred osd (-1).
+  ::encode(preferred, p);
+  ::encode(key, p);
+  ::encode(nspace, p);
+  ::encode(hash, p);
+  if (hash != -1)
+    encode_compat = MAX(encode_compat, 6); // need to interpret the hash
+  DENC_FINISH_NEW_COMPAT(p, encode_compat);
+}
+
+void object_locator_t::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(6, 6, p);
+  ::decode(pool, p);
+  int32_t preferred;
+  ::decode(preferred, p);
+  ::decode(key, p);
+  ::decode(nspace, p);
+  ::decode(hash, p);
+  DENC_DECODE_FINISH(p);
+  // verify that nobody's corrupted the locator
+  assert(hash == -1 || key.empty());
+}
+
 void object_locator_t::dump(Formatter *f) const
 {
   f->dump_int("pool", pool);
@@ -2684,11 +2751,7 @@ void ObjectModDesc::generate_test_instances(list<ObjectModDesc*>& o)
 
 void ObjectModDesc::encode(bufferlist &_bl) const
 {
-  ENCODE_START(1, 1, _bl);
-  ::encode(can_local_rollback, _bl);
-  ::encode(rollback_info_completed, _bl);
-  ::encode(bl, _bl);
-  ENCODE_FINISH(_bl);
+  denc_encode(*this, _bl);
 }
 void ObjectModDesc::decode(bufferlist::iterator &_bl)
 {
@@ -2698,6 +2761,29 @@ void ObjectModDesc::decode(bufferlist::iterator &_bl)
   ::decode(bl, _bl);
   DECODE_FINISH(_bl);
 }
+void ObjectModDesc::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(can_local_rollback, p);
+  ::bound_encode(rollback_info_completed, p);
+  ::bound_encode(bl, p);
+}
+void ObjectModDesc::encode(contiguous_appender& p) const
+{
+  DENC_START(1, 1, p);
+  ::encode(can_local_rollback, p);
+  ::encode(rollback_info_completed, p);
+  ::encode(bl, p);
+  DENC_FINISH(p);
+}
+void ObjectModDesc::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(1, 1, p);
+  ::decode(can_local_rollback, p);
+  ::decode(rollback_info_completed, p);
+  ::decode(bl, p);
+  DENC_DECODE_FINISH(p);
+}
 
 // -- pg_log_entry_t --
 
@@ -2729,10 +2815,31 @@ void pg_log_entry_t::decode_with_checksum(bufferlist::iterator& p)
 
 void pg_log_entry_t::encode(bufferlist &bl) const
 {
-  ENCODE_START(9, 4, bl);
-  ::encode(op, bl);
-  ::encode(soid, bl);
-  ::encode(version, bl);
+  denc_encode(*this, bl);
+}
+
+void pg_log_entry_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(op, p);
+  ::bound_encode(soid, p);
+  ::bound_encode(version, p);
+  ::bound_encode(prior_version, p);
+  ::bound_encode(reqid, p);
+  ::bound_encode(mtime, p);
+  if (op == LOST_REVERT)
+    ::bound_encode(prior_version, p);
+  ::bound_encode(snaps, p);
+  ::bound_encode(user_version, p);
+  ::bound_encode(mod_desc, p);
+}
+
+void pg_log_entry_t::encode(contiguous_appender& p) const
+{
+  DENC_START(9, 4, p);
+  ::encode(op, p);
+  ::encode(soid, p);
+  ::encode(version, p);
 
   /**
    * Added with reverting_to:
@@ -2742,22 +2849,44 @@ void pg_log_entry_t::encode(bufferlist &bl) const
    * into prior_version as expected.
    */
   if (op == LOST_REVERT)
-    ::encode(reverting_to, bl);
+    ::encode(reverting_to, p);
   else
-    ::encode(prior_version, bl);
+    ::encode(prior_version, p);
 
-  ::encode(reqid, bl);
-  ::encode(mtime, bl);
+  ::encode(reqid, p);
+  ::encode(mtime, p);
   if (op == LOST_REVERT)
-    ::encode(prior_version, bl);
-  ::encode(snaps, bl);
-  ::encode(user_version, bl);
-  ::encode(mod_desc, bl);
-  ENCODE_FINISH(bl);
+    ::encode(prior_version, p);
+  ::encode(snaps, p);
+  ::encode(user_version, p);
+  ::encode(mod_desc, p);
+  DENC_FINISH(p);
+}
+
+void pg_log_entry_t::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(9, 9, p);
+  ::decode(op, p);
+  ::decode(soid, p);
+  ::decode(version, p);
+  if (op == LOST_REVERT)
+    ::decode(reverting_to, p);
+  else
+    ::decode(prior_version, p);
+  ::decode(reqid, p);
+  ::decode(mtime, p);
+  if (op == LOST_REVERT)
+    ::decode(prior_version, p);
+  ::decode(snaps, p);
+  ::decode(user_version, p);
+  ::decode(mod_desc, p);
+  DENC_DECODE_FINISH(p);
 }
 
 void pg_log_entry_t::decode(bufferlist::iterator &bl)
 {
+  if (denc_decode(*this, bl, 9))
+    return;
   DECODE_START_LEGACY_COMPAT_LEN(8, 4, 4, bl);
   ::decode(op, bl);
   if (struct_v < 2) {
@@ -3216,6 +3345,166 @@ void pg_missing_t::split_into(
   }
 }
 
+// -- pg_nls_filter_t --
+
+bool pg_nls_filter_t::match_name(const string& name) const
+{
+  if (name.compare(0, name_prefix.size(), name_prefix) != 0)
+    return false;
+  if (!name_glob.empty() &&
+      fnmatch(name_glob.c_str(), name.c_str(), 0) != 0)
+    return false;
+  return true;
+}
+
+bool pg_nls_filter_t::needs_stat() const
+{
+  return min_size > 0 || max_size != (uint64_t)-1 ||
+    !min_mtime.is_zero() || !max_mtime.is_zero() ||
+    (want & (WANT_SIZE | WANT_MTIME));
+}
+
+bool pg_nls_filter_t::match_stat(uint64_t size, utime_t mtime) const
+{
+  if (size < min_size || size > max_size)
+    return false;
+  if (mtime < min_mtime)
+    return false;
+  if (!max_mtime.is_zero() && mtime > max_mtime)
+    return false;
+  return true;
+}
+
+void pg_nls_filter_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(name_prefix, bl);
+  ::encode(name_glob, bl);
+  ::encode(min_size, bl);
+  ::encode(max_size, bl);
+  ::encode(min_mtime, bl);
+  ::encode(max_mtime, bl);
+  ::encode(xattrs_equal, bl);
+  ::encode(xattrs_present, bl);
+  ::encode(check_omap_header, bl);
+  ::encode(omap_header_prefix, bl);
+  ::encode(want, bl);
+  ::encode(want_xattrs, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_nls_filter_t::decode(bufferlist::iterator& bl)
+{
+  DECODE_START(1, bl);
+  ::decode(name_prefix, bl);
+  ::decode(name_glob, bl);
+  ::decode(min_size, bl);
+  ::decode(max_size, bl);
+  ::decode(min_mtime, bl);
+  ::decode(max_mtime, bl);
+  ::decode(xattrs_equal, bl);
+  ::decode(xattrs_present, bl);
+  ::decode(check_omap_header, bl);
+  ::decode(omap_header_prefix, bl);
+  ::decode(want, bl);
+  ::decode(want_xattrs, bl);
+  DECODE_FINISH(bl);
+}
+
+void pg_nls_filter_t::dump(Formatter *f) const
+{
+  f->dump_string("name_prefix", name_prefix);
+  f->dump_string("name_glob", name_glob);
+  f->dump_unsigned("min_size", min_size);
+  f->dump_unsigned("max_size", max_size);
+  f->dump_stream("min_mtime") << min_mtime;
+  f->dump_stream("max_mtime") << max_mtime;
+  f->open_array_section("xattrs_equal");
+  for (map<string, bufferlist>::const_iterator p = xattrs_equal.begin();
+       p != xattrs_equal.end(); ++p) {
+    f->open_object_section("xattr");
+    f->dump_string("name", p->first);
+    f->dump_unsigned("length", p->second.length());
+    f->close_section();
+  }
+  f->close_section();
+  f->open_array_section("xattrs_present");
+  for (set<string>::const_iterator p = xattrs_present.begin();
+       p != xattrs_present.end(); ++p)
+    f->dump_string("name", *p);
+  f->close_section();
+  f->dump_int("check_omap_header", check_omap_header);
+  f->dump_unsigned("omap_header_prefix_length", omap_header_prefix.length());
+  f->dump_unsigned("want", want);
+  f->open_array_section("want_xattrs");
+  for (set<string>::const_iterator p = want_xattrs.begin();
+       p != want_xattrs.end(); ++p)
+    f->dump_string("name", *p);
+  f->close_section();
+}
+
+void pg_nls_filter_t::generate_test_instances(list<pg_nls_filter_t*>& o)
+{
+  o.push_back(new pg_nls_filter_t);
+  o.push_back(new pg_nls_filter_t);
+  o.back()->name_prefix = "rbd_data.";
+  o.back()->name_glob = "*.0000*";
+  o.back()->min_size = 1;
+  o.back()->max_size = 4096;
+  o.back()->max_mtime = utime_t(12345, 0);
+  o.back()->xattrs_equal["foo"].append("bar");
+  o.back()->xattrs_present.insert("baz");
+  o.back()->check_omap_header = true;
+  o.back()->omap_header_prefix.append("head");
+  o.back()->want = WANT_SIZE | WANT_MTIME;
+  o.back()->want_xattrs.insert("foo");
+}
+
+// -- pg_nls_object_info_t --
+
+void pg_nls_object_info_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(size, bl);
+  ::encode(mtime, bl);
+  ::encode(xattrs, bl);
+  ENCODE_FINISH(bl);
+}
+
+void pg_nls_object_info_t::decode(bufferlist::iterator& bl)
+{
+  DECODE_START(1, bl);
+  ::decode(size, bl);
+  ::decode(mtime, bl);
+  ::decode(xattrs, bl);
+  DECODE_FINISH(bl);
+}
+
+void pg_nls_object_info_t::dump(Formatter *f) const
+{
+  f->dump_unsigned("size", size);
+  f->dump_stream("mtime") << mtime;
+  f->open_array_section("xattrs");
+  for (map<string, bufferlist>::const_iterator p = xattrs.begin();
+       p != xattrs.end(); ++p) {
+    f->open_object_section("xattr");
+    f->dump_string("name", p->first);
+    f->dump_unsigned("length", p->second.length());
+    f->close_section();
+  }
+  f->close_section();
+}
+
+void pg_nls_object_info_t::generate_test_instances(
+  list<pg_nls_object_info_t*>& o)
+{
+  o.push_back(new pg_nls_object_info_t);
+  o.push_back(new pg_nls_object_info_t);
+  o.back()->size = 4096;
+  o.back()->mtime = utime_t(12345, 6789);
+  o.back()->xattrs["foo"].append("bar");
+}
+
 // -- object_copy_cursor_t --
 
 void object_copy_cursor_t::encode(bufferlist& bl) const
@@ -3743,11 +4032,7 @@ uint64_t SnapSet::get_clone_bytes(snapid_t clone) const
 
 void watch_info_t::encode(bufferlist& bl) const
 {
-  ENCODE_START(4, 3, bl);
-  ::encode(cookie, bl);
-  ::encode(timeout_seconds, bl);
-  ::encode(addr, bl);
-  ENCODE_FINISH(bl);
+  denc_encode(*this, bl);
 }
 
 void watch_info_t::decode(bufferlist::iterator& bl)
@@ -3765,6 +4050,32 @@ void watch_info_t::decode(bufferlist::iterator& bl)
   DECODE_FINISH(bl);
 }
 
+void watch_info_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(cookie, p);
+  ::bound_encode(timeout_seconds, p);
+  ::bound_encode(addr, p);
+}
+
+void watch_info_t::encode(contiguous_appender& p) const
+{
+  DENC_START(4, 3, p);
+  ::encode(cookie, p);
+  ::encode(timeout_seconds, p);
+  ::encode(addr, p);
+  DENC_FINISH(p);
+}
+
+void watch_info_t::decode(contiguous_decoder& p)
+{
+  DENC_DECODE_START(4, 4, p);
+  ::decode(cookie, p);
+  ::decode(timeout_seconds, p);
+  ::decode(addr, p);
+  DENC_DECODE_FINISH(p);
+}
+
 void watch_info_t::dump(Formatter *f) const
 {
   f->dump_unsigned("cookie", cookie);
@@ -3821,6 +4132,45 @@ ps_t object_info_t::legacy_object_locator_to_ps(const object_t &oid,
 }
 
 void object_info_t::encode(bufferlist& bl) const
+{
+  denc_encode(*this, bl);
+}
+
+void object_info_t::bound_encode(size_t& p) const
+{
+  p += DENC_HEADER_LEN;
+  ::bound_encode(soid, p);
+  ::bound_encode(object_locator_t(soid), p);
+  p += sizeof(ceph_le32);  // category
+  ::bound_encode(version, p);
+  ::bound_encode(prior_version, p);
+  ::bound_encode(last_reqid, p);
+  ::bound_encode(size, p);
+  ::bound_encode(mtime, p);
+  if (soid.snap == CEPH_NOSNAP)
+    ::bound_encode(wrlock_by, p);
+  else
+    ::bound_encode(snaps, p);
+  ::bound_encode(truncate_seq, p);
+  ::bound_encode(truncate_size, p);
+  ::bound_encode(is_lost(), p);
+  // old_watchers has at most one entry per watcher
+  p += sizeof(ceph_le32);
+  for (map<pair<uint64_t, entity_name_t>, watch_info_t>::const_iterator i =
+	 watchers.begin();
+       i != watchers.end();
+       ++i) {
+    ::bound_encode(i->first.second, p);
+    ::bound_encode(i->second, p);
+  }
+  ::bound_encode(eversion_t(), p);
+  ::bound_encode(test_flag(FLAG_USES_TMAP), p);
+  ::bound_encode(watchers, p);
+  p += sizeof(ceph_le32);  // flags
+  ::bound_encode(local_mtime, p);
+}
+
+void object_info_t::encode(contiguous_appender& p) const
 {
   object_locator_t myoloc(soid);
   map<entity_name_t, watch_info_t> old_watchers;
@@ -3830,37 +4180,77 @@ void object_info_t::encode(bufferlist& bl) const
        ++i) {
     old_watchers.insert(make_pair(i->first.second, i->second));
   }
-  ENCODE_START(14, 8, bl);
-  ::encode(soid, bl);
-  ::encode(myoloc, bl);	//Retained for compatibility
-  ::encode((__u32)0, bl); // was category, no longer used
-  ::encode(version, bl);
-  ::encode(prior_version, bl);
-  ::encode(last_reqid, bl);
-  ::encode(size, bl);
-  ::encode(mtime, bl);
+  DENC_START(14, 8, p);
+  ::encode(soid, p);
+  ::encode(myoloc, p);	//Retained for compatibility
+  ::encode((__u32)0, p); // was category, no longer used
+  ::encode(version, p);
+  ::encode(prior_version, p);
+  ::encode(last_reqid, p);
+  ::encode(size, p);
+  ::encode(mtime, p);
   if (soid.snap == CEPH_NOSNAP)
-    ::encode(wrlock_by, bl);
+    ::encode(wrlock_by, p);
   else
-    ::encode(snaps, bl);
-  ::encode(truncate_seq, bl);
-  ::encode(truncate_size, bl);
-  ::encode(is_lost(), bl);
-  ::encode(old_watchers, bl);
+    ::encode(snaps, p);
+  ::encode(truncate_seq, p);
+  ::encode(truncate_size, p);
+  ::encode(is_lost(), p);
+  ::encode(old_watchers, p);
   /* shenanigans to avoid breaking backwards compatibility in the disk format.
    * When we can, switch this out for simply putting the version_t on disk. */
   eversion_t user_eversion(0, user_version);
-  ::encode(user_eversion, bl);
-  ::encode(test_flag(FLAG_USES_TMAP), bl);
-  ::encode(watchers, bl);
+  ::encode(user_eversion, p);
+  ::encode(test_flag(FLAG_USES_TMAP), p);
+  ::encode(watchers, p);
   __u32 _flags = flags;
-  ::encode(_flags, bl);
-  ::encode(local_mtime, bl);
-  ENCODE_FINISH(bl);
+  ::encode(_flags, p);
+  ::encode(local_mtime, p);
+  DENC_FINISH(p);
+}
+
+void object_info_t::decode(contiguous_decoder& p)
+{
+  object_locator_t myoloc;
+  DENC_DECODE_START(14, 14, p);
+  map<entity_name_t, watch_info_t> old_watchers;
+  ::decode(soid, p);
+  ::decode(myoloc, p);
+  {
+    string category;
+    ::decode(category, p);  // no longer used
+  }
+  ::decode(version, p);
+  ::decode(prior_version, p);
+  ::decode(last_reqid, p);
+  ::decode(size, p);
+  ::decode(mtime, p);
+  if (soid.snap == CEPH_NOSNAP)
+    ::decode(wrlock_by, p);
+  else
+    ::decode(snaps, p);
+  ::decode(truncate_seq, p);
+  ::decode(truncate_size, p);
+  __u8 lo;
+  ::decode(lo, p);  // superseded by flags below
+  ::decode(old_watchers, p);
+  eversion_t user_eversion;
+  ::decode(user_eversion, p);
+  user_version = user_eversion.version;
+  bool uses_tmap;
+  ::decode(uses_tmap, p);  // also carried in flags
+  ::decode(watchers, p);
+  __u32 _flags;
+  ::decode(_flags, p);
+  flags = (flag_t)_flags;
+  ::decode(local_mtime, p);
+  DENC_DECODE_FINISH(p);
 }
 
 void object_info_t::decode(bufferlist::iterator& bl)
 {
+  if (denc_decode(*this, bl, 14))
+    return;
   object_locator_t myoloc;
   DECODE_START_LEGACY_COMPAT_LEN(13, 8, 8, bl);
   map<entity_name_t, watch_info_t> old_watchers;
@@ -4568,6 +4958,10 @@ ostream& operator<<(ostream& out, const OSDOp& op)
       out << " object_size " << op.op.alloc_hint.expected_object_size
           << " write_size " << op.op.alloc_hint.expected_write_size;
       break;
+    case CEPH_OSD_OP_WRITESAME:
+      out << " " << op.op.writesame.offset << "~" << op.op.writesame.length
+	  << " data_length " << op.op.writesame.data_length;
+      break;
     default:
       out << " " << op.op.extent.offset << "~" << op.op.extent.length;
       if (op.op.extent.truncate_seq)
@@ -4678,3 +5072,13 @@ void OSDOp::merge_osd_op_vector_out_data(vector<OSDOp>& ops, bufferlist& out)
     }
   }
 }
+
+void OSDOp::encode_osd_op_vector_nohead(const vector<OSDOp>& ops,
+					bufferlist& bl)
+{
+  if (ops.empty())
+    return;
+  contiguous_appender p(bl, ops.size() * sizeof(ceph_osd_op));
+  for (unsigned i = 0; i < ops.size(); i++)
+    p.append((const char *)&ops[i].op, sizeof(ceph_osd_op));
+}
@@ -164,10 +164,14 @@ struct object_locator_t {
 
   void encode(bufferlist& bl) const;
   void decode(bufferlist::iterator& p);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<object_locator_t*>& o);
 };
 WRITE_CLASS_ENCODER(object_locator_t)
+WRITE_CLASS_DENC(object_locator_t)
 
 inline bool operator==(const object_locator_t& l, const object_locator_t& r) {
   return l.pool == r.pool && l.key == r.key && l.nspace == r.nspace && l.hash == r.hash;
@@ -613,8 +617,20 @@ public:
     bufferlist::iterator p = bl.begin();
     decode(p);
   }
+  void bound_encode(size_t& p) const {
+    p += sizeof(ceph_le64) + sizeof(ceph_le32);
+  }
+  void encode(contiguous_appender& p) const {
+    ::encode(version, p);
+    ::encode(epoch, p);
+  }
+  void decode(contiguous_decoder& p) {
+    ::decode(version, p);
+    ::decode(epoch, p);
+  }
 };
 WRITE_CLASS_ENCODER(eversion_t)
+WRITE_CLASS_DENC(eversion_t)
 
 inline bool operator==(const eversion_t& l, const eversion_t& r) {
   return (l.epoch == r.epoch) && (l.version == r.version);
@@ -2018,10 +2034,14 @@ public:
   }
   void encode(bufferlist &bl) const;
   void decode(bufferlist::iterator &bl);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<ObjectModDesc*>& o);
 };
 WRITE_CLASS_ENCODER(ObjectModDesc)
+WRITE_CLASS_DENC(ObjectModDesc)
 
 
 /**
@@ -2123,11 +2143,15 @@ struct pg_log_entry_t {
 
   void encode(bufferlist &bl) const;
   void decode(bufferlist::iterator &bl);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<pg_log_entry_t*>& o);
 
 };
 WRITE_CLASS_ENCODER(pg_log_entry_t)
+WRITE_CLASS_DENC(pg_log_entry_t)
 
 ostream& operator<<(ostream& out, const pg_log_entry_t& e);
 
@@ -2396,6 +2420,64 @@ struct pg_nls_response_t {
 
 WRITE_CLASS_ENCODER(pg_nls_response_t)
 
+/**
+ * pg_nls_filter_t
+ *
+ * A filter for PGNLS_FILTER that the OSD evaluates itself, passed as
+ * the "expr" filter type.  An object is listed only if it matches
+ * every predicate that is set.  Each listed object also gets a
+ * pg_nls_object_info_t in the filter output, holding what want and
+ * want_xattrs ask for.
+ */
+struct pg_nls_filter_t {
+  enum {
+    WANT_SIZE = 1,
+    WANT_MTIME = 2,
+  };
+
+  string name_prefix;
+  string name_glob;          ///< fnmatch(3) pattern, empty for any
+  uint64_t min_size, max_size;
+  utime_t min_mtime, max_mtime;  ///< zero max_mtime for no bound
+  map<string, bufferlist> xattrs_equal;
+  set<string> xattrs_present;
+  bool check_omap_header;
+  bufferlist omap_header_prefix;
+
+  uint32_t want;             ///< WANT_*
+  set<string> want_xattrs;
+
+  pg_nls_filter_t()
+    : min_size(0), max_size((uint64_t)-1),
+      check_omap_header(false), want(0) {}
+
+  bool match_name(const string& name) const;
+  /// whether the object's size and mtime are needed
+  bool needs_stat() const;
+  bool match_stat(uint64_t size, utime_t mtime) const;
+
+  static void generate_test_instances(list<pg_nls_filter_t*>& o);
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::iterator& bl);
+  void dump(Formatter *f) const;
+};
+WRITE_CLASS_ENCODER(pg_nls_filter_t)
+
+/// what a pg_nls_filter_t asked for about a listed object
+struct pg_nls_object_info_t {
+  uint64_t size;
+  utime_t mtime;
+  map<string, bufferlist> xattrs;
+
+  pg_nls_object_info_t() : size(0) {}
+
+  static void generate_test_instances(list<pg_nls_object_info_t*>& o);
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::iterator& bl);
+  void dump(Formatter *f) const;
+};
+WRITE_CLASS_ENCODER(pg_nls_object_info_t)
+
 // For backwards compatibility with older OSD requests
 struct pg_ls_response_t {
   collection_list_handle_t handle; 
@@ -2697,10 +2779,14 @@ struct watch_info_t {
 
   void encode(bufferlist& bl) const;
   void decode(bufferlist::iterator& bl);
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<watch_info_t*>& o);
 };
 WRITE_CLASS_ENCODER(watch_info_t)
+WRITE_CLASS_DENC(watch_info_t)
 
 static inline bool operator==(const watch_info_t& l, const watch_info_t& r) {
   return l.cookie == r.cookie && l.timeout_seconds == r.timeout_seconds
@@ -2806,6 +2892,9 @@ struct object_info_t {
     bufferlist::iterator p = bl.begin();
     decode(p);
   }
+  void bound_encode(size_t& p) const;
+  void encode(contiguous_appender& p) const;
+  void decode(contiguous_decoder& p);
   void dump(Formatter *f) const;
   static void generate_test_instances(list<object_info_t*>& o);
 
@@ -3355,6 +3444,15 @@ struct OSDOp {
    * @param in  [out] combined data buffer
    */
   static void merge_osd_op_vector_out_data(vector<OSDOp>& ops, bufferlist& out);
+
+  /**
+   * encode the raw ceph_osd_op headers back to back, with no count
+   *
+   * @param ops [in] vector of OSDOps
+   * @param bl  [out] bufferlist to append to
+   */
+  static void encode_osd_op_vector_nohead(const vector<OSDOp>& ops,
+					  bufferlist& bl);
 };
 
 ostream& operator<<(ostream& out, const OSDOp& op);
@@ -88,6 +88,7 @@ int Filer::probe(inodeno_t ino,
   // start with 1+ periods.
   probe->probing_len = period;
   if (probe->fwd) {
+    probe->probing_len *= _probe_periods();
     if (start_from % period)
       probe->probing_len += period - (start_from % period);
   } else {
@@ -105,6 +106,18 @@ int Filer::probe(inodeno_t ino,
 }
 
 
+/**
+ * Forward probes stat several periods' objects at once, so that finding
+ * the end of a long file (e.g. a journal whose header lags far behind)
+ * doesn't take a round trip per period.  Objects past the end are
+ * simply missing, and only the first short one counts.
+ */
+uint64_t Filer::_probe_periods()
+{
+  int64_t periods = cct->_conf->filer_probe_periods;
+  return periods < 1 ? 1 : periods;
+}
+
 /**
  * probe->lock must be initially locked, this function will release it
  */
@@ -232,7 +245,7 @@ bool Filer::_probed(Probe *probe, const object_t& oid, uint64_t size, utime_t mt
     if (probe->fwd) {
       probe->probing_off += probe->probing_len;
       assert(probe->probing_off % period == 0);
-      probe->probing_len = period;
+      probe->probing_len = period * _probe_periods();
     } else {
       // previous period.
       assert(probe->probing_off % period == 0);
@@ -82,6 +82,7 @@ class Filer {
   
   class C_Probe;
 
+  uint64_t _probe_periods();
   void _probe(Probe *p);
   bool _probed(Probe *p, const object_t& oid, uint64_t size, utime_t mtime);
 
@@ -32,6 +32,7 @@ void Journaler::set_readonly()
 
   ldout(cct, 1) << "set_readonly" << dendl;
   readonly = true;
+  _set_fetch_len();
 }
 
 void Journaler::set_writeable()
@@ -40,6 +41,7 @@ void Journaler::set_writeable()
 
   ldout(cct, 1) << "set_writeable" << dendl;
   readonly = false;
+  _set_fetch_len();
 }
 
 void Journaler::create(ceph_file_layout *l, stream_format_t const sf)
@@ -75,12 +77,21 @@ void Journaler::_set_layout(ceph_file_layout const *l)
   last_written.layout = layout;
   last_committed.layout = layout;
 
+  _set_fetch_len();
+}
+
+void Journaler::_set_fetch_len()
+{
   // prefetch intelligently.
   // (watch out, this is big if you use big objects or weird striping)
-  uint64_t periods = cct->_conf->journaler_prefetch_periods;
+  // a read-only journaler is replaying, and nothing else is waiting on
+  // it, so it reads further ahead to keep every object read in flight.
+  uint64_t periods = readonly ?
+    cct->_conf->journaler_replay_prefetch_periods :
+    cct->_conf->journaler_prefetch_periods;
   if (periods < 2)
     periods = 2;  // we need at least 2 periods to make progress.
-  fetch_len = layout.fl_stripe_count * layout.fl_object_size * periods;
+  fetch_len = (uint64_t)layout.fl_stripe_count * layout.fl_object_size * periods;
 }
 
 
@@ -534,14 +545,16 @@ uint64_t Journaler::append_entry(bufferlist& bl)
   ldout(cct, 10) << "append_entry len " << s << " to " << write_pos << "~" << wrote << dendl;
   write_pos += wrote;
 
-  // flush previous object?
-  uint64_t su = get_layout_period();
+  // flush previous stripe unit(s)?  each lands in its own object, so
+  // sending them as they fill keeps all the objects of the stripe set
+  // writing instead of waiting for a whole period.
+  uint64_t su = layout.fl_stripe_unit;
   assert(su > 0);
   uint64_t write_off = write_pos % su;
-  uint64_t write_obj = write_pos / su;
-  uint64_t flush_obj = flush_pos / su;
-  if (write_obj != flush_obj) {
-    ldout(cct, 10) << " flushing completed object(s) (su " << su << " wro " << write_obj << " flo " << flush_obj << ")" << dendl;
+  uint64_t write_unit = write_pos / su;
+  uint64_t flush_unit = flush_pos / su;
+  if (write_unit != flush_unit) {
+    ldout(cct, 10) << " flushing completed stripe unit(s) (su " << su << " wru " << write_unit << " flu " << flush_unit << ")" << dendl;
     _do_flush(write_buf.length() - write_off);
   }
 
@@ -266,6 +266,7 @@ private:
 
   void _reread_head(Context *onfinish);
   void _set_layout(ceph_file_layout const *l);
+  void _set_fetch_len();
   list<Context*> waitfor_recover;
   void _read_head(Context *on_finish, bufferlist *bl);
   void _finish_read_head(int r, bufferlist& bl);
@@ -27,6 +27,7 @@
 ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left, loff_t off)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   ldout(oc->cct, 20) << "split " << *left << " at " << off << dendl;
   
   // split off right
@@ -35,15 +36,14 @@ ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left, loff_t o
   right->last_read_tid = left->last_read_tid;
   right->set_state(left->get_state());
   right->snapc = left->snapc;
+  right->probation = left->probation;
 
   loff_t newleftlen = off - left->start();
   right->set_start(off);
   right->set_length(left->length() - newleftlen);
   
   // shorten left
-  oc->bh_stat_sub(left);
-  left->set_length(newleftlen);
-  oc->bh_stat_add(left);
+  oc->bh_set_length(left, newleftlen);
   
   // add right
   oc->bh_add(this, right);
@@ -81,14 +81,13 @@ ObjectCacher::BufferHead *ObjectCacher::Object::split(BufferHead *left, loff_t o
 void ObjectCacher::Object::merge_left(BufferHead *left, BufferHead *right)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   assert(left->end() == right->start());
   assert(left->get_state() == right->get_state());
 
   ldout(oc->cct, 10) << "merge_left " << *left << " + " << *right << dendl;
   oc->bh_remove(this, right);
-  oc->bh_stat_sub(left);
-  left->set_length(left->length() + right->length());
-  oc->bh_stat_add(left);
+  oc->bh_set_length(left, left->length() + right->length());
 
   // data
   left->bl.claim_append(right->bl);
@@ -114,6 +113,7 @@ void ObjectCacher::Object::merge_left(BufferHead *left, BufferHead *right)
 void ObjectCacher::Object::try_merge_bh(BufferHead *bh)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   ldout(oc->cct, 10) << "try_merge_bh " << *bh << dendl;
 
   // do not merge rx buffers; last_read_tid may not match
@@ -181,6 +181,7 @@ int ObjectCacher::Object::map_read(OSDRead *rd,
 				   map<loff_t, BufferHead*>& errors)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   for (vector<ObjectExtent>::iterator ex_it = rd->extents.begin();
        ex_it != rd->extents.end();
        ++ex_it) {
@@ -270,6 +271,37 @@ int ObjectCacher::Object::map_read(OSDRead *rd,
   return 0;
 }
 
+/*
+ * map a range of bytes onto readable buffer_heads, without changing
+ * anything.  false if any of it is missing or unreadable.
+ */
+bool ObjectCacher::Object::map_hits(ObjectExtent &ex,
+				    map<loff_t, BufferHead*>& hits)
+{
+  assert(oset->lock.is_locked());
+  loff_t cur = ex.offset;
+  loff_t left = ex.length;
+  map<loff_t, BufferHead*>::iterator p = data_lower_bound(cur);
+  while (left > 0) {
+    if (p == data.end() || p->first > cur)
+      return false;  // gap
+
+    BufferHead *e = p->second;
+    if (!e->is_clean() &&
+	!e->is_dirty() &&
+	!e->is_tx() &&
+	!e->is_zero())
+      return false;
+    hits[cur] = e;
+
+    loff_t lenfromcur = MIN(e->end() - cur, left);
+    cur += lenfromcur;
+    left -= lenfromcur;
+    ++p;
+  }
+  return true;
+}
+
 void ObjectCacher::Object::audit_buffers()
 {
   loff_t offset = 0;
@@ -312,6 +344,7 @@ void ObjectCacher::Object::audit_buffers()
 ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   BufferHead *final = 0;
 
   for (vector<ObjectExtent>::iterator ex_it = wr->extents.begin();
@@ -339,9 +372,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
           oc->bh_add(this, final);
           ldout(oc->cct, 10) << "map_write adding trailing bh " << *final << dendl;
         } else {
-	  oc->bh_stat_sub(final);
-          final->set_length(final->length() + max);
-	  oc->bh_stat_add(final);
+	  oc->bh_set_length(final, final->length() + max);
         }
         left -= max;
         cur += max;
@@ -400,9 +431,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
         loff_t glen = MIN(next - cur, max);
         ldout(oc->cct, 10) << "map_write gap " << cur << "~" << glen << dendl;
         if (final) {
-	  oc->bh_stat_sub(final);
-          final->set_length(final->length() + glen);
-	  oc->bh_stat_add(final);
+	  oc->bh_set_length(final, final->length() + glen);
         } else {
           final = new BufferHead(this);
           final->set_start( cur );
@@ -427,6 +456,7 @@ ObjectCacher::BufferHead *ObjectCacher::Object::map_write(OSDWrite *wr)
 void ObjectCacher::Object::truncate(loff_t s)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   ldout(oc->cct, 10) << "truncate " << *this << " to " << s << dendl;
 
   while (!data.empty()) {
@@ -451,6 +481,7 @@ void ObjectCacher::Object::truncate(loff_t s)
 void ObjectCacher::Object::discard(loff_t off, loff_t len)
 {
   assert(oc->lock.is_locked());
+  assert(oset->lock.is_locked());
   ldout(oc->cct, 10) << "discard " << *this << " " << off << "~" << len << dendl;
 
   if (!exists) {
@@ -504,14 +535,16 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name, WritebackHandler& wb,
 			   double max_dirty_age, bool block_writes_upfront)
   : perfcounter(NULL),
     cct(cct_), writeback_handler(wb), name(name), lock(l),
+    lru_lock("ObjectCacher::lru_lock"),
     max_dirty(max_dirty), target_dirty(target_dirty),
     max_size(max_bytes), max_objects(max_objects),
     block_writes_upfront(block_writes_upfront),
     flush_set_callback(flush_callback), flush_set_callback_arg(flush_callback_arg),
-    last_read_tid(0),
+    unlocked_read_completions(false), last_read_tid(0),
+    policy(POLICY_LRU), ghost_bytes(0),
     flusher_stop(false), flusher_thread(this), finisher(cct),
     stat_clean(0), stat_zero(0), stat_dirty(0), stat_rx(0), stat_tx(0), stat_missing(0),
-    stat_error(0), stat_dirty_waiting(0), reads_outstanding(0)
+    stat_error(0), stat_dirty_waiting(0), stat_probation(0), reads_outstanding(0)
 {
   this->max_dirty_age.set_from_double(max_dirty_age);
   perf_start();
@@ -528,6 +561,7 @@ ObjectCacher::~ObjectCacher()
       ++i)
     assert(i->empty());
   assert(bh_lru_rest.lru_get_size() == 0);
+  assert(bh_lru_probation.lru_get_size() == 0);
   assert(bh_lru_dirty.lru_get_size() == 0);
   assert(ob_lru.lru_get_size() == 0);
   assert(dirty_or_tx_bh.empty());
@@ -550,6 +584,13 @@ void ObjectCacher::perf_start()
   plb.add_u64_counter(l_objectcacher_write_ops_blocked, "write_ops_blocked");
   plb.add_u64_counter(l_objectcacher_write_bytes_blocked, "write_bytes_blocked");
   plb.add_time(l_objectcacher_write_time_blocked, "write_time_blocked");
+  plb.add_u64_counter(l_objectcacher_cache_bytes_evicted, "cache_bytes_evicted");
+  plb.add_u64_counter(l_objectcacher_cache_bytes_ghost_hit,
+		      "cache_bytes_ghost_hit");
+  plb.add_u64_counter(l_objectcacher_cache_bytes_hit_probation,
+		      "cache_bytes_hit_probation");
+  plb.add_u64_counter(l_objectcacher_cache_bytes_hit_rest,
+		      "cache_bytes_hit_rest");
 
   perfcounter = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perfcounter);
@@ -570,20 +611,21 @@ ObjectCacher::Object *ObjectCacher::get_object(sobject_t oid, ObjectSet *oset,
 {
   // XXX: Add handling of nspace in object_locator_t in cache
   assert(lock.is_locked());
+  assert(oset->lock.is_locked());
   // have it?
-  if ((uint32_t)l.pool < objects.size()) {
-    if (objects[l.pool].count(oid)) {
-      Object *o = objects[l.pool][oid];
-      o->truncate_size = truncate_size;
-      o->truncate_seq = truncate_seq;
-      return o;
-    }
-  } else {
-    objects.resize(l.pool+1);
+  if ((uint32_t)l.pool < objects.size() &&
+      objects[l.pool].count(oid)) {
+    Object *o = objects[l.pool][oid];
+    o->truncate_size = truncate_size;
+    o->truncate_seq = truncate_seq;
+    return o;
   }
 
   // create it.
   Object *o = new Object(this, oid, oset, l, truncate_size, truncate_seq);
+  Mutex::Locker ll(lru_lock);
+  if ((uint32_t)l.pool >= objects.size())
+    objects.resize(l.pool+1);
   objects[l.pool][oid] = o;
   ob_lru.lru_insert_top(o);
   return o;
@@ -592,12 +634,16 @@ ObjectCacher::Object *ObjectCacher::get_object(sobject_t oid, ObjectSet *oset,
 void ObjectCacher::close_object(Object *ob) 
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   ldout(cct, 10) << "close_object " << *ob << dendl;
   assert(ob->can_close());
   
   // ok!
-  ob_lru.lru_remove(ob);
-  objects[ob->oloc.pool].erase(ob->get_soid());
+  {
+    Mutex::Locker l(lru_lock);
+    ob_lru.lru_remove(ob);
+    objects[ob->oloc.pool].erase(ob->get_soid());
+  }
   ob->set_item.remove_myself();
   delete ob;
 }
@@ -608,6 +654,7 @@ void ObjectCacher::close_object(Object *ob)
 void ObjectCacher::bh_read(BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(bh->ob->oset->lock.is_locked());
   ldout(cct, 7) << "bh_read on " << *bh << " outstanding reads "
 		<< reads_outstanding << dendl;
 
@@ -656,6 +703,7 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
     ldout(cct, 7) << "bh_read_finish no object cache" << dendl;
   } else {
     Object *ob = objects[poolid][oid];
+    Mutex::Locker l(ob->oset->lock);
     
     if (r == -ENOENT && !ob->complete) {
       // wake up *all* rx waiters, or else we risk reordering identical reads. e.g.
@@ -805,9 +853,13 @@ void ObjectCacher::bh_read_finish(int64_t poolid, sobject_t oid, ceph_tid_t tid,
 void ObjectCacher::bh_write(BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(bh->ob->oset->lock.is_locked());
   ldout(cct, 7) << "bh_write " << *bh << dendl;
 
-  bh->ob->get();
+  {
+    Mutex::Locker l(lru_lock);
+    bh->ob->get();
+  }
 
   // finishers
   C_WriteCommit *oncommit = new C_WriteCommit(this, bh->ob->oloc.pool,
@@ -832,14 +884,81 @@ void ObjectCacher::bh_write(BufferHead *bh)
   mark_tx(bh);
 }
 
-void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid, loff_t start,
-				   uint64_t length, ceph_tid_t tid, int r)
+loff_t ObjectCacher::bh_write_scattered(BufferHead *bh)
+{
+  assert(lock.is_locked());
+  assert(bh->ob->oset->lock.is_locked());
+  if (!writeback_handler.can_scattered_write()) {
+    bh_write(bh);
+    return bh->length();
+  }
+
+  // random writes into one object flush as a single op; only data
+  // dirtied under the same snap context can share it
+  Object *ob = bh->ob;
+  list<BufferHead*> blist;
+  for (map<loff_t, BufferHead*>::iterator p = ob->data.begin();
+       p != ob->data.end(); ++p) {
+    BufferHead *obh = p->second;
+    if (obh->is_dirty() && obh->snapc.seq == bh->snapc.seq)
+      blist.push_back(obh);
+  }
+  if (blist.size() == 1) {
+    bh_write(bh);
+    return bh->length();
+  }
+
+  ldout(cct, 7) << "bh_write_scattered " << blist.size() << " bhs on " << *ob
+		<< dendl;
+  {
+    Mutex::Locker l(lru_lock);
+    ob->get();
+  }
+
+  vector<pair<loff_t, uint64_t> > ranges;
+  vector<pair<uint64_t, bufferlist> > io_vec;
+  utime_t last_write;
+  loff_t total = 0;
+  for (list<BufferHead*>::iterator p = blist.begin(); p != blist.end(); ++p) {
+    BufferHead *obh = *p;
+    ranges.push_back(make_pair(obh->start(), obh->length()));
+    io_vec.push_back(make_pair((uint64_t)obh->start(), obh->bl));
+    if (obh->last_write > last_write)
+      last_write = obh->last_write;
+    total += obh->length();
+  }
+
+  C_WriteCommit *oncommit = new C_WriteCommit(this, ob->oloc.pool,
+					      ob->get_soid(), ranges);
+  ceph_tid_t tid = writeback_handler.write(ob->get_oid(), ob->get_oloc(),
+					   io_vec, bh->snapc, last_write,
+					   ob->truncate_size, ob->truncate_seq,
+					   oncommit);
+  ldout(cct, 20) << " tid " << tid << " on " << ob->get_oid() << dendl;
+
+  oncommit->tid = tid;
+  ob->last_write_tid = tid;
+  for (list<BufferHead*>::iterator p = blist.begin(); p != blist.end(); ++p) {
+    BufferHead *obh = *p;
+    obh->last_write_tid = tid;
+    mark_tx(obh);
+  }
+
+  if (perfcounter) {
+    perfcounter->inc(l_objectcacher_data_flushed, total);
+  }
+  return total;
+}
+
+void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid,
+				   vector<pair<loff_t, uint64_t> >& ranges,
+				   ceph_tid_t tid, int r)
 {
   assert(lock.is_locked());
   ldout(cct, 7) << "bh_write_commit " 
 		<< oid 
 		<< " tid " << tid
-		<< " " << start << "~" << length
+		<< " " << ranges
 		<< " returned " << r
 		<< dendl;
 
@@ -847,55 +966,67 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid, loff_t start,
     ldout(cct, 7) << "bh_write_commit no object cache" << dendl;
   } else {
     Object *ob = objects[poolid][oid];
-    int was_dirty_or_tx = ob->oset->dirty_or_tx;
+    ObjectSet *oset = ob->oset;
+    oset->lock.Lock();
+    int was_dirty_or_tx = oset->dirty_or_tx;
     
     if (!ob->exists) {
       ldout(cct, 10) << "bh_write_commit marking exists on " << *ob << dendl;
       ob->exists = true;
 
-      if (writeback_handler.may_copy_on_write(ob->get_oid(), start, length, ob->get_snap())) {
-	ldout(cct, 10) << "bh_write_commit may copy on write, clearing complete on " << *ob << dendl;
-	ob->complete = false;
+      for (vector<pair<loff_t, uint64_t> >::iterator p = ranges.begin();
+	   p != ranges.end(); ++p) {
+	if (writeback_handler.may_copy_on_write(ob->get_oid(), p->first,
+						p->second, ob->get_snap())) {
+	  ldout(cct, 10) << "bh_write_commit may copy on write, clearing complete on " << *ob << dendl;
+	  ob->complete = false;
+	  break;
+	}
       }
     }
 
     // apply to bh's!
-    for (map<loff_t, BufferHead*>::iterator p = ob->data_lower_bound(start);
-         p != ob->data.end();
-         ++p) {
-      BufferHead *bh = p->second;
-      
-      if (bh->start() > start+(loff_t)length)
-	break;
+    for (vector<pair<loff_t, uint64_t> >::iterator q = ranges.begin();
+	 q != ranges.end(); ++q) {
+      loff_t start = q->first;
+      uint64_t length = q->second;
+      for (map<loff_t, BufferHead*>::iterator p = ob->data_lower_bound(start);
+	   p != ob->data.end();
+	   ++p) {
+	BufferHead *bh = p->second;
 
-      if (bh->start() < start &&
-          bh->end() > start+(loff_t)length) {
-        ldout(cct, 20) << "bh_write_commit skipping " << *bh << dendl;
-        continue;
-      }
-      
-      // make sure bh is tx
-      if (!bh->is_tx()) {
-        ldout(cct, 10) << "bh_write_commit skipping non-tx " << *bh << dendl;
-        continue;
-      }
-      
-      // make sure bh tid matches
-      if (bh->last_write_tid != tid) {
-        assert(bh->last_write_tid > tid);
-        ldout(cct, 10) << "bh_write_commit newer tid on " << *bh << dendl;
-        continue;
-      }
+	if (bh->start() > start+(loff_t)length)
+	  break;
 
-      if (r >= 0) {
-	// ok!  mark bh clean and error-free
-	mark_clean(bh);
-	ldout(cct, 10) << "bh_write_commit clean " << *bh << dendl;
-      } else {
-	mark_dirty(bh);
-	ldout(cct, 10) << "bh_write_commit marking dirty again due to error "
-		       << *bh << " r = " << r << " " << cpp_strerror(-r)
-		       << dendl;
+	if (bh->start() < start &&
+	    bh->end() > start+(loff_t)length) {
+	  ldout(cct, 20) << "bh_write_commit skipping " << *bh << dendl;
+	  continue;
+	}
+
+	// make sure bh is tx
+	if (!bh->is_tx()) {
+	  ldout(cct, 10) << "bh_write_commit skipping non-tx " << *bh << dendl;
+	  continue;
+	}
+
+	// make sure bh tid matches
+	if (bh->last_write_tid != tid) {
+	  assert(bh->last_write_tid > tid);
+	  ldout(cct, 10) << "bh_write_commit newer tid on " << *bh << dendl;
+	  continue;
+	}
+
+	if (r >= 0) {
+	  // ok!  mark bh clean and error-free
+	  mark_clean(bh);
+	  ldout(cct, 10) << "bh_write_commit clean " << *bh << dendl;
+	} else {
+	  mark_dirty(bh);
+	  ldout(cct, 10) << "bh_write_commit marking dirty again due to error "
+			 << *bh << " r = " << r << " " << cpp_strerror(-r)
+			 << dendl;
+	}
       }
     }
 
@@ -910,10 +1041,13 @@ void ObjectCacher::bh_write_commit(int64_t poolid, sobject_t oid, loff_t start,
       ob->waitfor_commit.erase(tid);
     }
 
-    // is the entire object set now clean and fully committed?
-    ObjectSet *oset = ob->oset;
-    ob->put();
+    {
+      Mutex::Locker l(lru_lock);
+      ob->put();
+    }
+    oset->lock.Unlock();
 
+    // is the entire object set now clean and fully committed?
     if (flush_set_callback &&
 	was_dirty_or_tx > 0 &&
 	oset->dirty_or_tx == 0) {        // nothing dirty/tx
@@ -939,12 +1073,12 @@ void ObjectCacher::flush(loff_t amount)
    */
   loff_t did = 0;
   while (amount == 0 || did < amount) {
-    BufferHead *bh = static_cast<BufferHead*>(bh_lru_dirty.lru_get_next_expire());
+    BufferHead *bh = bh_lru_dirty_next();
     if (!bh) break;
     if (bh->last_write > cutoff) break;
 
-    did += bh->length();
-    bh_write(bh);
+    Mutex::Locker l(bh->ob->oset->lock);
+    did += bh_write_scattered(bh);
   }    
 }
 
@@ -956,16 +1090,43 @@ void ObjectCacher::trim()
 		 << ", objects: max " << max_objects << " current " << ob_lru.lru_get_size()
 		 << dendl;
 
-  while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_size) {
-    BufferHead *bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
-    if (!bh)
-      break;
+  // pick everything to evict in one go under lru_lock, then drop each
+  // bh under its own set's lock so hits elsewhere aren't held up.
+  // nothing but us can free them in between, as we hold the lock.
+  list<BufferHead*> bhs;
+  {
+    Mutex::Locker l(lru_lock);
+    loff_t clean = get_stat_clean();
+    loff_t probation = stat_probation;
+    while (clean > 0 && (uint64_t) clean > max_size) {
+      BufferHead *bh = bh_lru_expire(probation);
+      if (!bh)
+	break;
+      assert(bh->is_clean() || bh->is_zero());
+
+      // with 2q, hot data that ages out isn't worth promoting straight
+      // back when it's read again
+      if (policy == POLICY_LRU || bh->probation)
+	ghost_add(bh);
+      if (bh->is_clean()) {
+	clean -= bh->length();
+	if (bh->probation)
+	  probation -= bh->length();
+      }
+      bhs.push_back(bh);
+    }
+  }
 
+  for (list<BufferHead*>::iterator p = bhs.begin(); p != bhs.end(); ++p) {
+    BufferHead *bh = *p;
     ldout(cct, 10) << "trim trimming " << *bh << dendl;
-    assert(bh->is_clean() || bh->is_zero());
+    if (perfcounter && bh->is_clean())
+      perfcounter->inc(l_objectcacher_cache_bytes_evicted, bh->length());
 
     Object *ob = bh->ob;
+    Mutex::Locker l(ob->oset->lock);
     bh_remove(ob, bh);
+    trimmed_data.claim_append(bh->bl);
     delete bh;
 
     if (ob->complete) {
@@ -974,14 +1135,32 @@ void ObjectCacher::trim()
     }
   }
 
-  while (ob_lru.lru_get_size() > max_objects) {
-    Object *ob = static_cast<Object*>(ob_lru.lru_expire());
-    if (!ob)
-      break;
+  list<Object*> obs;
+  {
+    Mutex::Locker l(lru_lock);
+    while (ob_lru.lru_get_size() > max_objects) {
+      Object *ob = static_cast<Object*>(ob_lru.lru_expire());
+      if (!ob)
+	break;
+      obs.push_back(ob);
+    }
+  }
 
+  for (list<Object*>::iterator p = obs.begin(); p != obs.end(); ++p) {
+    Object *ob = *p;
     ldout(cct, 10) << "trim trimming " << *ob << dendl;
+    Mutex::Locker l(ob->oset->lock);
     close_object(ob);
   }
+
+  // freeing large buffers is slow, so let the flusher do it outside
+  // the lock if it's running
+  if (!trimmed_data.buffers().empty()) {
+    if (flusher_thread.is_started() && !flusher_stop)
+      flusher_cond.Signal();
+    else
+      trimmed_data.clear();
+  }
   
   ldout(cct, 10) << "trim finish:  max " << max_size << "  clean " << get_stat_clean()
 		 << ", objects: max " << max_objects << " current " << ob_lru.lru_get_size()
@@ -992,6 +1171,18 @@ void ObjectCacher::trim()
 
 /* public */
 
+void ObjectCacher::set_policy(const string& name)
+{
+  assert(bh_lru_rest.lru_get_size() == 0);
+  if (name == "2q") {
+    policy = POLICY_2Q;
+  } else {
+    if (name != "lru")
+      lderr(cct) << "unknown cache policy '" << name << "', using lru" << dendl;
+    policy = POLICY_LRU;
+  }
+}
+
 bool ObjectCacher::is_cached(ObjectSet *oset, vector<ObjectExtent>& extents, snapid_t snapid)
 {
   assert(lock.is_locked());
@@ -1021,15 +1212,86 @@ int ObjectCacher::readx(OSDRead *rd, ObjectSet *oset, Context *onfinish)
   return _readx(rd, oset, onfinish, true);
 }
 
+int ObjectCacher::readx_hit(OSDRead *rd, ObjectSet *oset)
+{
+  uint64_t bytes_in_cache = 0;
+  uint64_t bytes_hit_probation = 0;
+  map<uint64_t, bufferlist> stripe_map;  // final buffer offset -> substring
+
+  {
+    Mutex::Locker l(oset->lock);
+    list<BufferHead*> hit_ls;
+    for (vector<ObjectExtent>::iterator ex_it = rd->extents.begin();
+	 ex_it != rd->extents.end();
+	 ++ex_it) {
+      ldout(cct, 10) << "readx_hit " << *ex_it << dendl;
+
+      sobject_t soid(ex_it->oid, rd->snap);
+      Object *o;
+      {
+	Mutex::Locker ll(lru_lock);
+	o = get_object_maybe(soid, ex_it->oloc);
+      }
+      // anything that would change the object is up to readx()
+      if (!o || !o->exists ||
+	  o->truncate_size != ex_it->truncate_size ||
+	  o->truncate_seq != oset->truncate_seq) {
+	ldout(cct, 20) << "readx_hit no usable object " << soid << dendl;
+	return -EAGAIN;
+      }
+
+      map<loff_t, BufferHead*> hits;
+      if (!o->map_hits(*ex_it, hits)) {
+	ldout(cct, 20) << "readx_hit miss on " << *o << dendl;
+	return -EAGAIN;
+      }
+      for (map<loff_t, BufferHead*>::iterator bh_it = hits.begin();
+	   bh_it != hits.end();
+	   ++bh_it) {
+	hit_ls.push_back(bh_it->second);
+	bytes_in_cache += bh_it->second->length();
+	if (bh_it->second->probation)
+	  bytes_hit_probation += bh_it->second->length();
+      }
+      map_hits_to_buffers(*ex_it, hits, stripe_map);
+    }
+
+    // bump hits in lru
+    for (list<BufferHead*>::iterator bhit = hit_ls.begin();
+	 bhit != hit_ls.end();
+	 ++bhit)
+      touch_bh(*bhit);
+  }
+
+  if (perfcounter) {
+    uint64_t total_bytes_read = 0;
+    for (vector<ObjectExtent>::iterator ex_it = rd->extents.begin();
+	 ex_it != rd->extents.end();
+	 ++ex_it)
+      total_bytes_read += ex_it->length;
+    perfcounter->inc(l_objectcacher_data_read, total_bytes_read);
+    perfcounter->inc(l_objectcacher_cache_bytes_hit, bytes_in_cache);
+    perfcounter->inc(l_objectcacher_cache_bytes_hit_probation,
+		     bytes_hit_probation);
+    perfcounter->inc(l_objectcacher_cache_bytes_hit_rest,
+		     bytes_in_cache - bytes_hit_probation);
+    perfcounter->inc(l_objectcacher_cache_ops_hit);
+  }
+
+  return assemble_read(rd, stripe_map, 0);
+}
+
 int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 			 bool external_call)
 {
   assert(lock.is_locked());
+  oset->lock.Lock();
   bool success = true;
   int error = 0;
   list<BufferHead*> hit_ls;
   uint64_t bytes_in_cache = 0;
   uint64_t bytes_not_in_cache = 0;
+  uint64_t bytes_hit_probation = 0;
   uint64_t total_bytes_read = 0;
   map<uint64_t, bufferlist> stripe_map;  // final buffer offset -> substring
 
@@ -1072,6 +1334,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 	  ldout(cct, 10) << "readx  waiting on tid " << o->last_write_tid << " on " << *o << dendl;
 	  o->waitfor_commit[o->last_write_tid].push_back(new C_RetryRead(this, rd, oset, onfinish));
 	  // FIXME: perfcounter!
+	  oset->lock.Unlock();
 	  return 0;
 	}
       }
@@ -1089,6 +1352,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
       }
       if (allzero) {
 	ldout(cct, 10) << "readx  ob has all zero|rx, returning ENOENT" << dendl;
+	oset->lock.Unlock();
 	delete rd;
 	return -ENOENT;
       }
@@ -1164,58 +1428,11 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 	  error = bh_it->second->error;
         hit_ls.push_back(bh_it->second);
         bytes_in_cache += bh_it->second->length();
+	if (bh_it->second->probation)
+	  bytes_hit_probation += bh_it->second->length();
       }
 
-      // create reverse map of buffer offset -> object for the eventual result.
-      // this is over a single ObjectExtent, so we know that
-      //  - the bh's are contiguous
-      //  - the buffer frags need not be (and almost certainly aren't)
-      loff_t opos = ex_it->offset;
-      map<loff_t, BufferHead*>::iterator bh_it = hits.begin();
-      assert(bh_it->second->start() <= opos);
-      uint64_t bhoff = opos - bh_it->second->start();
-      vector<pair<uint64_t,uint64_t> >::iterator f_it = ex_it->buffer_extents.begin();
-      uint64_t foff = 0;
-      while (1) {
-        BufferHead *bh = bh_it->second;
-        assert(opos == (loff_t)(bh->start() + bhoff));
-
-        uint64_t len = MIN(f_it->second - foff, bh->length() - bhoff);
-        ldout(cct, 10) << "readx rmap opos " << opos
-		       << ": " << *bh << " +" << bhoff
-		       << " frag " << f_it->first << "~" << f_it->second << " +" << foff << "~" << len
-		       << dendl;
-
-	bufferlist bit;  // put substr here first, since substr_of clobbers, and
-	                 // we may get multiple bh's at this stripe_map position
-	if (bh->is_zero()) {
-	  bufferptr bp(len);
-	  bp.zero();
-	  stripe_map[f_it->first].push_back(bp);
-	} else {
-	  bit.substr_of(bh->bl,
-			opos - bh->start(),
-			len);
-	  stripe_map[f_it->first].claim_append(bit);
-	}
-
-        opos += len;
-        bhoff += len;
-        foff += len;
-        if (opos == bh->end()) {
-          ++bh_it;
-          bhoff = 0;
-        }
-        if (foff == f_it->second) {
-          ++f_it;
-          foff = 0;
-        }
-        if (bh_it == hits.end()) break;
-        if (f_it == ex_it->buffer_extents.end())
-	  break;
-      }
-      assert(f_it == ex_it->buffer_extents.end());
-      assert(opos == (loff_t)ex_it->offset + (loff_t)ex_it->length);
+      map_hits_to_buffers(*ex_it, hits, stripe_map);
     }
   }
   
@@ -1224,6 +1441,7 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
        bhit != hit_ls.end();
        ++bhit) 
     touch_bh(*bhit);
+  oset->lock.Unlock();
   
   if (!success) {
     if (perfcounter && external_call) {
@@ -1242,6 +1460,10 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
   if (perfcounter && external_call) {
     perfcounter->inc(l_objectcacher_data_read, total_bytes_read);
     perfcounter->inc(l_objectcacher_cache_bytes_hit, bytes_in_cache);
+    perfcounter->inc(l_objectcacher_cache_bytes_hit_probation,
+		     bytes_hit_probation);
+    perfcounter->inc(l_objectcacher_cache_bytes_hit_rest,
+		     bytes_in_cache - bytes_hit_probation);
     perfcounter->inc(l_objectcacher_cache_ops_hit);
   }
 
@@ -1249,6 +1471,74 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
   assert(!hit_ls.empty());
   ldout(cct, 10) << "readx has all buffers" << dendl;
 
+  int ret = assemble_read(rd, stripe_map, error);
+  trim();
+
+  return ret;
+}
+
+/*
+ * create reverse map of buffer offset -> object for the eventual result.
+ * this is over a single ObjectExtent, so we know that
+ *  - the bh's are contiguous
+ *  - the buffer frags need not be (and almost certainly aren't)
+ */
+void ObjectCacher::map_hits_to_buffers(ObjectExtent &ex,
+				       map<loff_t, BufferHead*>& hits,
+				       map<uint64_t, bufferlist>& stripe_map)
+{
+  loff_t opos = ex.offset;
+  map<loff_t, BufferHead*>::iterator bh_it = hits.begin();
+  assert(bh_it->second->start() <= opos);
+  uint64_t bhoff = opos - bh_it->second->start();
+  vector<pair<uint64_t,uint64_t> >::iterator f_it = ex.buffer_extents.begin();
+  uint64_t foff = 0;
+  while (1) {
+    BufferHead *bh = bh_it->second;
+    assert(opos == (loff_t)(bh->start() + bhoff));
+
+    uint64_t len = MIN(f_it->second - foff, bh->length() - bhoff);
+    ldout(cct, 10) << "readx rmap opos " << opos
+		   << ": " << *bh << " +" << bhoff
+		   << " frag " << f_it->first << "~" << f_it->second << " +" << foff << "~" << len
+		   << dendl;
+
+    bufferlist bit;  // put substr here first, since substr_of clobbers, and
+		     // we may get multiple bh's at this stripe_map position
+    if (bh->is_zero()) {
+      bufferptr bp(len);
+      bp.zero();
+      stripe_map[f_it->first].push_back(bp);
+    } else {
+      bit.substr_of(bh->bl,
+		    opos - bh->start(),
+		    len);
+      stripe_map[f_it->first].claim_append(bit);
+    }
+
+    opos += len;
+    bhoff += len;
+    foff += len;
+    if (opos == bh->end()) {
+      ++bh_it;
+      bhoff = 0;
+    }
+    if (foff == f_it->second) {
+      ++f_it;
+      foff = 0;
+    }
+    if (bh_it == hits.end()) break;
+    if (f_it == ex.buffer_extents.end())
+      break;
+  }
+  assert(f_it == ex.buffer_extents.end());
+  assert(opos == (loff_t)ex.offset + (loff_t)ex.length);
+}
+
+int ObjectCacher::assemble_read(OSDRead *rd,
+				map<uint64_t, bufferlist>& stripe_map,
+				int error)
+{
   // ok, assemble into result buffer.
   uint64_t pos = 0;
   if (rd->bl && !error) {
@@ -1275,9 +1565,6 @@ int ObjectCacher::_readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
   assert(pos <= (uint64_t) INT_MAX);
 
   delete rd;
-
-  trim();
-
   return ret;
 }
 
@@ -1302,6 +1589,7 @@ int ObjectCacher::writex(OSDWrite *wr, ObjectSet *oset, Mutex& wait_on_lock,
   uint64_t bytes_written = 0;
   uint64_t bytes_written_in_flush = 0;
   
+  oset->lock.Lock();
   for (vector<ObjectExtent>::iterator ex_it = wr->extents.begin();
        ex_it != wr->extents.end();
        ++ex_it) {
@@ -1353,6 +1641,7 @@ int ObjectCacher::writex(OSDWrite *wr, ObjectSet *oset, Mutex& wait_on_lock,
 
     o->try_merge_bh(bh);
   }
+  oset->lock.Unlock();
 
   if (perfcounter) {
     perfcounter->inc(l_objectcacher_data_written, bytes_written);
@@ -1457,6 +1746,15 @@ void ObjectCacher::flusher_entry()
   ldout(cct, 10) << "flusher start" << dendl;
   lock.Lock();
   while (!flusher_stop) {
+    if (!trimmed_data.buffers().empty()) {
+      bufferlist bl;
+      bl.swap(trimmed_data);
+      lock.Unlock();
+      bl.clear();
+      lock.Lock();
+      continue;
+    }
+
     loff_t all = get_stat_tx() + get_stat_rx() + get_stat_clean() + get_stat_dirty();
     ldout(cct, 11) << "flusher "
 		   << all << " / " << max_size << ":  "
@@ -1482,11 +1780,12 @@ void ObjectCacher::flusher_entry()
       cutoff -= max_dirty_age;
       BufferHead *bh = 0;
       int max = MAX_FLUSH_UNDER_LOCK;
-      while ((bh = static_cast<BufferHead*>(bh_lru_dirty.lru_get_next_expire())) != 0 &&
+      while ((bh = bh_lru_dirty_next()) != 0 &&
 	     bh->last_write < cutoff &&
 	     --max > 0) {
 	ldout(cct, 10) << "flusher flushing aged dirty bh " << *bh << dendl;
-	bh_write(bh);
+	Mutex::Locker l(bh->ob->oset->lock);
+	bh_write_scattered(bh);
       }
       if (!max) {
 	// back off the lock to avoid starving other threads
@@ -1580,6 +1879,7 @@ bool ObjectCacher::set_is_dirty_or_committing(ObjectSet *oset)
 void ObjectCacher::purge(Object *ob)
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   ldout(cct, 10) << "purge " << *ob << dendl;
 
   ob->truncate(0);
@@ -1593,6 +1893,7 @@ void ObjectCacher::purge(Object *ob)
 bool ObjectCacher::flush(Object *ob, loff_t offset, loff_t length)
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   bool clean = true;
   ldout(cct, 10) << "flush " << *ob << " " << offset << "~" << length << dendl;
   for (map<loff_t,BufferHead*>::iterator p = ob->data_lower_bound(offset); p != ob->data.end(); ++p) {
@@ -1608,7 +1909,7 @@ bool ObjectCacher::flush(Object *ob, loff_t offset, loff_t length)
     if (!bh->is_dirty()) {
       continue;
     }
-    bh_write(bh);
+    bh_write_scattered(bh);
     clean = false;
   }
   return clean;
@@ -1653,8 +1954,10 @@ bool ObjectCacher::flush_set(ObjectSet *oset, Context *onfinish)
     BufferHead *bh = *it;
     waitfor_commit.insert(bh->ob);
 
-    if (bh->is_dirty())
+    if (bh->is_dirty()) {
+      Mutex::Locker l(bh->ob->oset->lock);
       bh_write(bh);
+    }
 
     it = next;
   }
@@ -1692,6 +1995,7 @@ bool ObjectCacher::flush_set(ObjectSet *oset, vector<ObjectExtent>& exv, Context
   // we'll need to wait for all objects to flush!
   C_GatherBuilder gather(cct);
 
+  oset->lock.Lock();
   for (vector<ObjectExtent>::iterator p = exv.begin();
        p != exv.end();
        ++p) {
@@ -1710,6 +2014,7 @@ bool ObjectCacher::flush_set(ObjectSet *oset, vector<ObjectExtent>& exv, Context
       ob->waitfor_commit[ob->last_write_tid].push_back(gather.new_sub());
     }
   }
+  oset->lock.Unlock();
 
   return _flush_set_finish(&gather, onfinish);
 }
@@ -1724,6 +2029,7 @@ void ObjectCacher::purge_set(ObjectSet *oset)
 
   ldout(cct, 10) << "purge_set " << oset << dendl;
 
+  Mutex::Locker l(oset->lock);
   for (xlist<Object*>::iterator i = oset->objects.begin();
        !i.end(); ++i) {
     Object *ob = *i;
@@ -1735,6 +2041,7 @@ void ObjectCacher::purge_set(ObjectSet *oset)
 loff_t ObjectCacher::release(Object *ob)
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   list<BufferHead*> clean;
   loff_t o_unclean = 0;
 
@@ -1787,6 +2094,7 @@ loff_t ObjectCacher::release_set(ObjectSet *oset)
 
   ldout(cct, 10) << "release_set " << oset << dendl;
 
+  Mutex::Locker l(oset->lock);
   xlist<Object*>::iterator q;
   for (xlist<Object*>::iterator p = oset->objects.begin();
        !p.end(); ) {
@@ -1828,6 +2136,7 @@ uint64_t ObjectCacher::release_all()
 
       Object *ob = p->second;
 
+      Mutex::Locker l(ob->oset->lock);
       loff_t o_unclean = release(ob);
       unclean += o_unclean;
 
@@ -1852,6 +2161,7 @@ void ObjectCacher::clear_nonexistence(ObjectSet *oset)
   assert(lock.is_locked());
   ldout(cct, 10) << "clear_nonexistence() " << oset << dendl;
 
+  Mutex::Locker l(oset->lock);
   for (xlist<Object*>::iterator p = oset->objects.begin();
        !p.end(); ++p) {
     Object *ob = *p;
@@ -1883,6 +2193,7 @@ void ObjectCacher::discard_set(ObjectSet *oset, vector<ObjectExtent>& exls)
 
   bool were_dirty = oset->dirty_or_tx > 0;
 
+  oset->lock.Lock();
   for (vector<ObjectExtent>::iterator p = exls.begin();
        p != exls.end();
        ++p) {
@@ -1895,6 +2206,7 @@ void ObjectCacher::discard_set(ObjectSet *oset, vector<ObjectExtent>& exls)
     
     ob->discard(ex.offset, ex.length);
   }
+  oset->lock.Unlock();
 
   // did we truncate off dirty data?
   if (flush_set_callback &&
@@ -1908,6 +2220,7 @@ void ObjectCacher::verify_stats() const
   ldout(cct, 10) << "verify_stats" << dendl;
 
   loff_t clean = 0, zero = 0, dirty = 0, rx = 0, tx = 0, missing = 0, error = 0;
+  loff_t probation = 0;
   for (vector<ceph::unordered_map<sobject_t, Object*> >::const_iterator i = objects.begin();
       i != objects.end();
       ++i) {
@@ -1925,6 +2238,8 @@ void ObjectCacher::verify_stats() const
           break;
         case BufferHead::STATE_CLEAN:
           clean += bh->length();
+          if (bh->probation)
+            probation += bh->length();
           break;
         case BufferHead::STATE_ZERO:
           zero += bh->length();
@@ -1954,8 +2269,10 @@ void ObjectCacher::verify_stats() const
 	   << " dirty " << dirty
 	   << " missing " << missing
 	   << " error " << error
+	   << " probation " << probation
 	   << dendl;
   assert(clean == stat_clean);
+  assert(probation == stat_probation);
   assert(rx == stat_rx);
   assert(tx == stat_tx);
   assert(dirty == stat_dirty);
@@ -1967,12 +2284,15 @@ void ObjectCacher::verify_stats() const
 void ObjectCacher::bh_stat_add(BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(lru_lock.is_locked());
   switch (bh->get_state()) {
   case BufferHead::STATE_MISSING:
     stat_missing += bh->length();
     break;
   case BufferHead::STATE_CLEAN:
     stat_clean += bh->length();
+    if (bh->probation)
+      stat_probation += bh->length();
     break;
   case BufferHead::STATE_ZERO:
     stat_zero += bh->length();
@@ -2003,12 +2323,15 @@ void ObjectCacher::bh_stat_add(BufferHead *bh)
 void ObjectCacher::bh_stat_sub(BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(lru_lock.is_locked());
   switch (bh->get_state()) {
   case BufferHead::STATE_MISSING:
     stat_missing -= bh->length();
     break;
   case BufferHead::STATE_CLEAN:
     stat_clean -= bh->length();
+    if (bh->probation)
+      stat_probation -= bh->length();
     break;
   case BufferHead::STATE_ZERO:
     stat_zero -= bh->length();
@@ -2034,17 +2357,28 @@ void ObjectCacher::bh_stat_sub(BufferHead *bh)
   }
 }
 
+void ObjectCacher::bh_set_length(BufferHead *bh, loff_t len)
+{
+  assert(bh->ob->oset->lock.is_locked());
+  Mutex::Locker l(lru_lock);
+  bh_stat_sub(bh);
+  bh->set_length(len);
+  bh_stat_add(bh);
+}
+
 void ObjectCacher::bh_set_state(BufferHead *bh, int s)
 {
   assert(lock.is_locked());
+  assert(bh->ob->oset->lock.is_locked());
+  Mutex::Locker l(lru_lock);
   int state = bh->get_state();
   // move between lru lists?
   if (s == BufferHead::STATE_DIRTY && state != BufferHead::STATE_DIRTY) {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_remove(bh);
     bh_lru_dirty.lru_insert_top(bh);
   } else if (s != BufferHead::STATE_DIRTY && state == BufferHead::STATE_DIRTY) {
     bh_lru_dirty.lru_remove(bh);
-    bh_lru_rest.lru_insert_top(bh);
+    bh_lru_insert(bh, true);
   }
 
   if ((s == BufferHead::STATE_TX ||
@@ -2072,13 +2406,15 @@ void ObjectCacher::bh_set_state(BufferHead *bh, int s)
 void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   ldout(cct, 30) << "bh_add " << *ob << " " << *bh << dendl;
+  Mutex::Locker l(lru_lock);
   ob->add_bh(bh);
   if (bh->is_dirty()) {
     bh_lru_dirty.lru_insert_top(bh);
     dirty_or_tx_bh.insert(bh);
   } else {
-    bh_lru_rest.lru_insert_top(bh);
+    bh_lru_insert(bh, bh->is_missing());
   }
 
   if (bh->is_tx()) {
@@ -2090,13 +2426,15 @@ void ObjectCacher::bh_add(Object *ob, BufferHead *bh)
 void ObjectCacher::bh_remove(Object *ob, BufferHead *bh)
 {
   assert(lock.is_locked());
+  assert(ob->oset->lock.is_locked());
   ldout(cct, 30) << "bh_remove " << *ob << " " << *bh << dendl;
+  Mutex::Locker l(lru_lock);
   ob->remove_bh(bh);
   if (bh->is_dirty()) {
     bh_lru_dirty.lru_remove(bh);
     dirty_or_tx_bh.erase(bh);
   } else {
-    bh_lru_rest.lru_remove(bh);
+    bh_lru_remove(bh);
   }
 
   if (bh->is_tx()) {
@@ -2105,3 +2443,95 @@ void ObjectCacher::bh_remove(Object *ob, BufferHead *bh)
   bh_stat_sub(bh);
 }
 
+// is_new is for data about to be read in or just written back; bhs
+// split off of another one keep its place
+void ObjectCacher::bh_lru_insert(BufferHead *bh, bool is_new)
+{
+  assert(lru_lock.is_locked());
+  if (is_new) {
+    bool ghost = bh->is_missing() && ghost_hit(bh);
+    bh->probation = (policy == POLICY_2Q && !ghost);
+  }
+  if (bh->probation)
+    bh_lru_probation.lru_insert_top(bh);
+  else
+    bh_lru_rest.lru_insert_top(bh);
+}
+
+void ObjectCacher::bh_lru_remove(BufferHead *bh)
+{
+  assert(lru_lock.is_locked());
+  if (bh->probation)
+    bh_lru_probation.lru_remove(bh);
+  else
+    bh_lru_rest.lru_remove(bh);
+}
+
+// probation is the clean bytes on probation, less any already chosen
+ObjectCacher::BufferHead *ObjectCacher::bh_lru_expire(loff_t probation)
+{
+  assert(lru_lock.is_locked());
+  // 2q keeps a quarter of the cache for data on probation, so it lives
+  // long enough to be read again
+  LRUObject *o = NULL;
+  if (policy == POLICY_2Q && (uint64_t)probation > max_size / 4)
+    o = bh_lru_probation.lru_expire();
+  if (!o)
+    o = bh_lru_rest.lru_expire();
+  if (!o)
+    o = bh_lru_probation.lru_expire();
+  return static_cast<BufferHead*>(o);
+}
+
+void ObjectCacher::ghost_add(BufferHead *bh)
+{
+  assert(lru_lock.is_locked());
+  GhostKey key(bh->ob->oloc.pool, bh->ob->get_soid(), bh->start());
+  map<GhostKey, ghost_list_t::iterator>::iterator p = ghost_map.find(key);
+  if (p != ghost_map.end()) {
+    ghost_bytes -= p->second->second;
+    ghost_lru.erase(p->second);
+    ghost_map.erase(p);
+  }
+  ghost_lru.push_front(make_pair(key, bh->length()));
+  ghost_map[key] = ghost_lru.begin();
+  ghost_bytes += bh->length();
+  ghost_trim();
+}
+
+bool ObjectCacher::ghost_hit(BufferHead *bh)
+{
+  assert(lru_lock.is_locked());
+  if (ghost_map.empty())
+    return false;
+
+  // the closest evicted extent starting at or before bh
+  GhostKey key(bh->ob->oloc.pool, bh->ob->get_soid(), bh->start());
+  map<GhostKey, ghost_list_t::iterator>::iterator p =
+    ghost_map.upper_bound(key);
+  if (p == ghost_map.begin())
+    return false;
+  --p;
+  if (p->first.poolid != key.poolid || p->first.oid != key.oid ||
+      p->first.start + p->second->second <= bh->start())
+    return false;
+
+  ldout(cct, 20) << "ghost hit " << *bh << dendl;
+  if (perfcounter)
+    perfcounter->inc(l_objectcacher_cache_bytes_ghost_hit, bh->length());
+  ghost_bytes -= p->second->second;
+  ghost_lru.erase(p->second);
+  ghost_map.erase(p);
+  return true;
+}
+
+void ObjectCacher::ghost_trim()
+{
+  // remember evictions covering half the cache size
+  while (!ghost_lru.empty() && (uint64_t)ghost_bytes > max_size / 2) {
+    ghost_bytes -= ghost_lru.back().second;
+    ghost_map.erase(ghost_lru.back().first);
+    ghost_lru.pop_back();
+  }
+}
+
@@ -37,6 +37,11 @@ enum {
   l_objectcacher_write_bytes_blocked, // total number of write bytes we delayed due to dirty limits
   l_objectcacher_write_time_blocked, // total time in seconds spent blocking a write due to dirty limits
 
+  l_objectcacher_cache_bytes_evicted, // clean bytes trimmed from cache
+  l_objectcacher_cache_bytes_ghost_hit, // bytes missed shortly after being evicted
+  l_objectcacher_cache_bytes_hit_probation, // hit bytes served from the probation queue
+  l_objectcacher_cache_bytes_hit_rest, // hit bytes served from the main lru
+
   l_objectcacher_last,
 };
 
@@ -108,6 +113,7 @@ class ObjectCacher {
     utime_t last_write;
     SnapContext snapc;
     int error; // holds return value for failed reads
+    bool probation; // on bh_lru_probation rather than bh_lru_rest, if clean
     
     map< loff_t, list<Context*> > waitfor_read;
     
@@ -118,7 +124,8 @@ class ObjectCacher {
       ob(o),
       last_write_tid(0),
       last_read_tid(0),
-      error(0) {
+      error(0),
+      probation(false) {
       ex.start = ex.length = 0;
     }
   
@@ -284,6 +291,7 @@ class ObjectCacher {
                  map<loff_t, BufferHead*>& missing,
                  map<loff_t, BufferHead*>& rx,
 		 map<loff_t, BufferHead*>& errors);
+    bool map_hits(ObjectExtent &ex, map<loff_t, BufferHead*>& hits);
     BufferHead *map_write(OSDWrite *wr);
     
     void truncate(loff_t s);
@@ -316,21 +324,44 @@ class ObjectCacher {
     int dirty_or_tx;
     bool return_enoent;
 
+    /// guards the objects in this set and their bhs against readx_hit()
+    Mutex lock;
+
     ObjectSet(void *p, int64_t _poolid, inodeno_t i)
       : parent(p), ino(i), truncate_seq(0),
 	truncate_size(0), poolid(_poolid), dirty_or_tx(0),
-	return_enoent(false) {}
+	return_enoent(false), lock("ObjectCacher::ObjectSet::lock") {}
 
   };
 
 
+  // replacement policies for clean data
+  enum {
+    POLICY_LRU,
+    /**
+     * 2Q: new data sits in a FIFO probation queue, and only data that
+     * is read again soon after being evicted from it (a ghost hit) is
+     * cached in the LRU of hot data, so a scan can't flush that out.
+     */
+    POLICY_2Q
+  };
+
   // ******* ObjectCacher *********
   // ObjectCacher fields
  private:
   WritebackHandler& writeback_handler;
 
   string name;
+  /**
+   * The owner's lock, which everything but readx_hit() needs.  Holders
+   * that change an object or its bhs also take its ObjectSet::lock, and
+   * lru_lock to change the LRUs, the object index or the stats, so
+   * readx_hit() can serve hits with only those two.  Locks are taken in
+   * that order, and neither of the others is held across a callback.
+   */
   Mutex& lock;
+  /// guards the LRUs and pins, the object index, the ghosts and the stats
+  Mutex lru_lock;
   
   uint64_t max_dirty, target_dirty, max_size, max_objects;
   utime_t max_dirty_age;
@@ -339,6 +370,11 @@ class ObjectCacher {
   flush_set_callback_t flush_set_callback;
   void *flush_set_callback_arg;
 
+  /// complete reads that had to wait through the finisher, without lock
+  bool unlocked_read_completions;
+  /// data of trimmed bhs, freed by the flusher without the lock held
+  bufferlist trimmed_data;
+
   vector<ceph::unordered_map<sobject_t, Object*> > objects; // indexed by pool_id
 
   list<Context*> waitfor_read;
@@ -346,9 +382,32 @@ class ObjectCacher {
   ceph_tid_t last_read_tid;
 
   set<BufferHead*>    dirty_or_tx_bh;
-  LRU   bh_lru_dirty, bh_lru_rest;
+  LRU   bh_lru_dirty, bh_lru_rest, bh_lru_probation;
   LRU   ob_lru;
 
+  int policy;
+
+  // recently evicted extents, newest first, to recognize data that's
+  // read again soon after it's trimmed
+  struct GhostKey {
+    int64_t poolid;
+    sobject_t oid;
+    loff_t start;
+    GhostKey(int64_t p, const sobject_t& o, loff_t s)
+      : poolid(p), oid(o), start(s) {}
+    bool operator<(const GhostKey& rhs) const {
+      if (poolid != rhs.poolid)
+	return poolid < rhs.poolid;
+      if (oid != rhs.oid)
+	return oid < rhs.oid;
+      return start < rhs.start;
+    }
+  };
+  typedef list<pair<GhostKey, loff_t> > ghost_list_t;
+  ghost_list_t ghost_lru;
+  map<GhostKey, ghost_list_t::iterator> ghost_map;
+  loff_t ghost_bytes;
+
   Cond flusher_cond;
   bool flusher_stop;
   void flusher_entry();
@@ -388,8 +447,7 @@ class ObjectCacher {
   loff_t stat_missing;
   loff_t stat_error;
   loff_t stat_dirty_waiting;   // bytes that writers are waiting on to write
-
-  void verify_stats() const;
+  loff_t stat_probation;       // clean bytes on bh_lru_probation
 
   void bh_stat_add(BufferHead *bh);
   void bh_stat_sub(BufferHead *bh);
@@ -400,14 +458,18 @@ class ObjectCacher {
   loff_t get_stat_clean() { return stat_clean; }
   loff_t get_stat_zero() { return stat_zero; }
 
+  void bh_set_length(BufferHead *bh, loff_t len);
+
   void touch_bh(BufferHead *bh) {
+    Mutex::Locker l(lru_lock);
     if (bh->is_dirty())
       bh_lru_dirty.lru_touch(bh);
-    else
+    else if (!bh->probation)  // probation is first in, first out
       bh_lru_rest.lru_touch(bh);
-    touch_ob(bh->ob);
+    ob_lru.lru_touch(bh->ob);
   }
   void touch_ob(Object *ob) {
+    Mutex::Locker l(lru_lock);
     ob_lru.lru_touch(ob);
   }
 
@@ -425,16 +487,30 @@ class ObjectCacher {
   void mark_error(BufferHead *bh) { bh_set_state(bh, BufferHead::STATE_ERROR); }
   void mark_dirty(BufferHead *bh) { 
     bh_set_state(bh, BufferHead::STATE_DIRTY); 
+    Mutex::Locker l(lru_lock);
     bh_lru_dirty.lru_touch(bh);
     //bh->set_dirty_stamp(ceph_clock_now(g_ceph_context));
   }
 
   void bh_add(Object *ob, BufferHead *bh);
   void bh_remove(Object *ob, BufferHead *bh);
+  void bh_lru_insert(BufferHead *bh, bool is_new);
+  void bh_lru_remove(BufferHead *bh);
+  BufferHead *bh_lru_expire(loff_t probation);
+  BufferHead *bh_lru_dirty_next() {
+    Mutex::Locker l(lru_lock);
+    return static_cast<BufferHead*>(bh_lru_dirty.lru_get_next_expire());
+  }
+
+  void ghost_add(BufferHead *bh);
+  bool ghost_hit(BufferHead *bh);
+  void ghost_trim();
 
   // io
   void bh_read(BufferHead *bh);
   void bh_write(BufferHead *bh);
+  /// write bh along with the rest of its object's dirty data in one op
+  loff_t bh_write_scattered(BufferHead *bh);
 
   void trim();
   void flush(loff_t amount=0);
@@ -459,6 +535,10 @@ class ObjectCacher {
 
   int _readx(OSDRead *rd, ObjectSet *oset, Context *onfinish,
 	     bool external_call);
+  void map_hits_to_buffers(ObjectExtent &ex, map<loff_t, BufferHead*>& hits,
+			   map<uint64_t, bufferlist>& stripe_map);
+  int assemble_read(OSDRead *rd, map<uint64_t, bufferlist>& stripe_map,
+		    int error);
   void retry_waiting_reads();
 
  public:
@@ -466,8 +546,9 @@ class ObjectCacher {
 		      loff_t offset, uint64_t length,
 		      bufferlist &bl, int r,
 		      bool trust_enoent);
-  void bh_write_commit(int64_t poolid, sobject_t oid, loff_t offset,
-		       uint64_t length, ceph_tid_t t, int r);
+  void bh_write_commit(int64_t poolid, sobject_t oid,
+		       vector<pair<loff_t, uint64_t> >& ranges,
+		       ceph_tid_t t, int r);
 
   class C_ReadFinish : public Context {
     ObjectCacher *oc;
@@ -505,14 +586,20 @@ class ObjectCacher {
     ObjectCacher *oc;
     int64_t poolid;
     sobject_t oid;
-    loff_t start;
-    uint64_t length;
+    vector<pair<loff_t, uint64_t> > ranges;
   public:
     ceph_tid_t tid;
     C_WriteCommit(ObjectCacher *c, int64_t _poolid, sobject_t o, loff_t s, uint64_t l) :
-      oc(c), poolid(_poolid), oid(o), start(s), length(l), tid(0) {}
+      oc(c), poolid(_poolid), oid(o), tid(0) {
+      ranges.push_back(make_pair(s, l));
+    }
+    C_WriteCommit(ObjectCacher *c, int64_t _poolid, sobject_t o,
+		  vector<pair<loff_t, uint64_t> >& _ranges) :
+      oc(c), poolid(_poolid), oid(o), tid(0) {
+      ranges.swap(_ranges);
+    }
     void finish(int r) {
-      oc->bh_write_commit(poolid, oid, start, length, tid, r);
+      oc->bh_write_commit(poolid, oid, ranges, tid, r);
     }
   };
 
@@ -563,16 +650,23 @@ class ObjectCacher {
     void finish(int r) {
       if (r < 0) {
 	if (onfinish)
-	  onfinish->complete(r);
+	  oc->complete_read(onfinish, r);
 	return;
       }
       int ret = oc->_readx(rd, oset, onfinish, false);
       if (ret != 0 && onfinish) {
-        onfinish->complete(ret);
+	oc->complete_read(onfinish, ret);
       }
     }
   };
 
+  void complete_read(Context *onfinish, int r) {
+    if (unlocked_read_completions)
+      finisher.queue(onfinish, r);
+    else
+      onfinish->complete(r);
+  }
+
 
 
   // non-blocking.  async.
@@ -582,10 +676,21 @@ class ObjectCacher {
    * the return value is total bytes read
    */
   int readx(OSDRead *rd, ObjectSet *oset, Context *onfinish);
+  /**
+   * Serve a read that is entirely cached, without the owner's lock.
+   * Only clean, zero, dirty and tx data counts, and nothing in the
+   * cache is created or read in.
+   *
+   * @return bytes read, or -EAGAIN with rd untouched for readx()
+   */
+  int readx_hit(OSDRead *rd, ObjectSet *oset);
   int writex(OSDWrite *wr, ObjectSet *oset, Mutex& wait_on_lock,
 	     Context *onfreespace);
   bool is_cached(ObjectSet *oset, vector<ObjectExtent>& extents, snapid_t snapid);
 
+  /// assert the bh stats match what is actually cached
+  void verify_stats() const;
+
 private:
   // write blocking
   int _wait_for_write(OSDWrite *wr, uint64_t len, ObjectSet *oset, Mutex& lock,
@@ -634,6 +739,18 @@ public:
   void set_max_objects(int64_t v) {
     max_objects = v;
   }
+  /// choose the replacement policy ("lru" or "2q") before caching anything
+  void set_policy(const string& name);
+
+  /**
+   * Complete reads that missed the cache from the finisher thread
+   * instead of the one that finished the read, which holds the lock.
+   *
+   * Only for owners whose read callbacks don't need the lock.
+   */
+  void set_unlocked_read_completions(bool v) {
+    unlocked_read_completions = v;
+  }
 
 
   // file functions
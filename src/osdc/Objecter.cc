@@ -23,6 +23,7 @@
 
 #include "messages/MPing.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpBatch.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDMap.h"
 
@@ -877,6 +878,7 @@ void Objecter::handle_osd_map(MOSDMap *m)
       _cancel_linger_op(op);
     }
     s->lock.unlock();
+    _flush_sends(s);
     put_session(s);
   }
   for (list<LingerOp*>::iterator p = need_resend_linger.begin();
@@ -1503,6 +1505,7 @@ void Objecter::_kick_requests(OSDSession *session, map<uint64_t, LingerOp *>& lr
     _send_op(resend.begin()->second);
     resend.erase(resend.begin());
   }
+  _flush_sends(session);
 
   // resend lingers
   for (map<ceph_tid_t, LingerOp*>::iterator j = session->linger_ops.begin(); j != session->linger_ops.end(); ++j) {
@@ -1696,7 +1699,44 @@ ceph_tid_t Objecter::op_submit(Op *op, int *ctx_budget)
   return _op_submit_with_budget(op, lc, ctx_budget);
 }
 
-ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget)
+void Objecter::op_submit_batch(vector<Op*>& ops)
+{
+  RWLock::RLocker rl(rwlock);
+  RWLock::Context lc(rwlock, RWLock::Context::TakenForRead);
+  set<OSDSession*> sessions;
+  for (vector<Op*>::iterator p = ops.begin(); p != ops.end(); ++p) {
+    // taking the budget can wait for in-flight ops to finish, and some
+    // of those may be ours, still waiting to be sent
+    if (!sessions.empty() && _op_budget_would_block(*p))
+      _flush_deferred_sends(sessions);
+    _op_submit_with_budget(*p, lc, NULL, &sessions);
+  }
+  _flush_deferred_sends(sessions);
+}
+
+bool Objecter::_op_budget_would_block(Op *op)
+{
+  if (op->ctx_budgeted || !keep_balanced_budget)
+    return false;
+  int64_t max_ops = op_throttle_ops.get_max();
+  int64_t max_bytes = op_throttle_bytes.get_max();
+  return (max_ops && op_throttle_ops.get_current() + 1 > max_ops) ||
+    (max_bytes &&
+     op_throttle_bytes.get_current() + calc_op_budget(op) > max_bytes);
+}
+
+void Objecter::_flush_deferred_sends(set<OSDSession*>& sessions)
+{
+  for (set<OSDSession*>::iterator p = sessions.begin();
+       p != sessions.end(); ++p) {
+    _flush_sends(*p);
+    put_session(*p);
+  }
+  sessions.clear();
+}
+
+ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget,
+					    set<OSDSession*> *deferred_sends)
 {
   assert(initialized.read());
 
@@ -1715,7 +1755,7 @@ ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ct
     }
   }
 
-  ceph_tid_t tid = _op_submit(op, lc);
+  ceph_tid_t tid = _op_submit(op, lc, deferred_sends);
 
   if (osd_timeout > 0) {
     Mutex::Locker l(timer_lock);
@@ -1726,7 +1766,8 @@ ceph_tid_t Objecter::_op_submit_with_budget(Op *op, RWLock::Context& lc, int *ct
   return tid;
 }
 
-ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc)
+ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc,
+				set<OSDSession*> *deferred_sends)
 {
   assert(rwlock.is_locked());
 
@@ -1866,7 +1907,13 @@ ceph_tid_t Objecter::_op_submit(Op *op, RWLock::Context& lc)
   op = NULL;
 
   s->lock.unlock();
-  put_session(s);
+  if (!deferred_sends) {
+    _flush_sends(s);
+    put_session(s);
+  } else if (!deferred_sends->insert(s).second) {
+    // the caller flushes it and drops the reference it already holds
+    put_session(s);
+  }
 
   ldout(cct, 5) << num_unacked.read() << " unacked, " << num_uncommitted.read() << " uncommitted" << dendl;
 
@@ -2382,6 +2429,40 @@ void Objecter::finish_op(OSDSession *session, ceph_tid_t tid)
   _finish_op(op);
 }
 
+/*
+ * OSDs without CEPH_FEATURE_OSD_WRITESAME would reject the op, so
+ * send them the write it stands for instead.  The pattern copies
+ * share its buffers.
+ */
+static void expand_writesame(vector<OSDOp>& ops)
+{
+  for (vector<OSDOp>::iterator p = ops.begin(); p != ops.end(); ++p) {
+    if (p->op.op != CEPH_OSD_OP_WRITESAME || p->indata.length() == 0)
+      continue;
+    uint64_t off = p->op.writesame.offset;
+    uint64_t len = p->op.writesame.length;
+    uint64_t data_length = p->indata.length();
+
+    bufferlist bl;
+    for (uint64_t pos = 0; pos < len; pos += data_length) {
+      if (len - pos >= data_length) {
+	bl.append(p->indata);
+      } else {
+	bufferlist tail;
+	tail.substr_of(p->indata, 0, len - pos);
+	bl.claim_append(tail);
+      }
+    }
+
+    p->op.op = CEPH_OSD_OP_WRITE;
+    p->op.extent.offset = off;
+    p->op.extent.length = len;
+    p->op.extent.truncate_size = 0;
+    p->op.extent.truncate_seq = 0;
+    p->indata.claim(bl);
+  }
+}
+
 MOSDOp *Objecter::_prepare_osd_op(Op *op)
 {
   assert(rwlock.is_locked());
@@ -2439,6 +2520,9 @@ void Objecter::_send_op(Op *op, MOSDOp *m)
   ConnectionRef con = op->session->con;
   assert(con);
 
+  if (!con->has_feature(CEPH_FEATURE_OSD_WRITESAME))
+    expand_writesame(m->ops);
+
   // preallocated rx buffer?
   if (op->con) {
     ldout(cct, 20) << " revoking rx buffer for " << op->tid << " on " << op->con << dendl;
@@ -2456,7 +2540,79 @@ void Objecter::_send_op(Op *op, MOSDOp *m)
 
   m->set_tid(op->tid);
 
-  op->session->con->send_message(m);
+  Mutex::Locker l(op->session->send_queue_lock);
+  op->session->send_queue.push_back(make_pair(con, (Message*)m));
+}
+
+void Objecter::_flush_sends(OSDSession *s)
+{
+  Mutex::Locker l(s->send_lock);
+  while (true) {
+    list<pair<ConnectionRef, Message*> > sends;
+    {
+      Mutex::Locker l2(s->send_queue_lock);
+      sends.swap(s->send_queue);
+    }
+    if (sends.empty())
+      break;
+
+    ldout(cct, 20) << __func__ << " sending " << sends.size()
+		   << " messages to osd." << s->osd << dendl;
+    list<pair<ConnectionRef, Message*> >::iterator p = sends.begin();
+    while (p != sends.end()) {
+      ConnectionRef con = p->first;
+      MOSDOpBatch *batch = _take_batch(con, sends, p);
+      if (batch) {
+	con->send_message(batch);
+      } else {
+	con->send_message(p->second);
+	++p;
+      }
+    }
+  }
+}
+
+MOSDOpBatch *Objecter::_take_batch(
+  const ConnectionRef& con,
+  list<pair<ConnectionRef, Message*> >& sends,
+  list<pair<ConnectionRef, Message*> >::iterator& p)
+{
+  int max_ops = cct->_conf->objecter_batch_max_ops;
+  uint64_t max_bytes = cct->_conf->objecter_batch_max_bytes;
+  if (max_ops < 2 || !con->has_feature(CEPH_FEATURE_OSD_OP_BATCH))
+    return NULL;
+
+  // consecutive ops on the same connection that are small enough
+  list<pair<ConnectionRef, Message*> >::iterator q = p;
+  int n = 0;
+  uint64_t bytes = 0;
+  while (q != sends.end() && n < max_ops && q->first == con &&
+	 q->second->get_type() == CEPH_MSG_OSD_OP) {
+    MOSDOp *m = static_cast<MOSDOp*>(q->second);
+    uint64_t len = 0;
+    for (vector<OSDOp>::iterator i = m->ops.begin(); i != m->ops.end(); ++i)
+      len += i->indata.length();
+    if (n > 0 && bytes + len > max_bytes)
+      break;
+    bytes += len;
+    ++n;
+    ++q;
+  }
+  if (n < 2)
+    return NULL;
+
+  MOSDOpBatch *batch = new MOSDOpBatch;
+  unsigned priority = 0;
+  for (; p != q; ++p) {
+    if (p->second->get_priority() > priority)
+      priority = p->second->get_priority();
+    batch->ops.push_back(static_cast<MOSDOp*>(p->second));
+  }
+  if (priority)
+    batch->set_priority(priority);
+  ldout(cct, 20) << __func__ << " " << n << " ops, " << bytes << " bytes"
+		 << dendl;
+  return batch;
 }
 
 int Objecter::calc_op_budget(Op *op)
@@ -2614,6 +2770,7 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 
     _send_op(op);
     s->lock.unlock();
+    _flush_sends(s);
     put_session(s);
     m->put();
     return;
@@ -2857,6 +3014,364 @@ void Objecter::put_nlist_context_budget(NListContext *list_context) {
     }
   }
 
+// range listing
+
+Objecter::NListCursor Objecter::NListCursor::rebase(uint32_t n) const
+{
+  if (pg_num)
+    return *this;
+  NListCursor c;
+  c.pg_num = n;
+  c.ps = is_end() ? n : 0;
+  return c;
+}
+
+void Objecter::NListCursor::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(pg_num, bl);
+  ::encode(ps, bl);
+  ::encode(pos, bl);
+  ENCODE_FINISH(bl);
+}
+
+void Objecter::NListCursor::decode(bufferlist::iterator& bl)
+{
+  DECODE_START(1, bl);
+  ::decode(pg_num, bl);
+  ::decode(ps, bl);
+  ::decode(pos, bl);
+  DECODE_FINISH(bl);
+}
+
+struct Objecter::NRangeContext {
+  struct Piece {
+    pg_t pgid;
+    bufferlist bl;
+    int r;
+    Piece(pg_t p) : pgid(p), r(0) {}
+  };
+  struct Entry {
+    hobject_t pos;
+    librados::ListObjectImpl obj;
+    pg_nls_object_info_t info;
+    bool operator<(const Entry& rhs) const {
+      return pos < rhs.pos;
+    }
+  };
+
+  int64_t pool_id;
+  string nspace;
+  bufferlist filter;
+  NListCursor cur;
+  NListCursor finish;       ///< relative to cur.pg_num
+  NListCursor orig_finish;  ///< as the caller gave it
+  size_t max;
+  std::list<librados::ListObjectImpl> *result;
+  std::list<pg_nls_object_info_t> *info;
+  NListCursor *next;
+  Context *onfinish;
+
+  std::list<Piece> pieces;  ///< the pgs cur.ps has split into
+
+  void complete(int r) {
+    if (r >= 0)
+      *next = cur < finish ? cur : orig_finish;
+    onfinish->complete(r);
+    delete this;
+  }
+};
+
+struct Objecter::C_NRangePiece : public Context {
+  NRangeContext::Piece *piece;
+  Context *on_finish;
+  C_NRangePiece(NRangeContext::Piece *p, Context *c)
+    : piece(p), on_finish(c) {}
+  void finish(int r) {
+    piece->r = r;
+    on_finish->complete(r);
+  }
+};
+
+struct Objecter::C_NRangeReply : public Context {
+  Objecter *objecter;
+  NRangeContext *range_context;
+  C_NRangeReply(Objecter *o, NRangeContext *rc)
+    : objecter(o), range_context(rc) {}
+  void finish(int r) {
+    objecter->_list_range_reply(range_context, r);
+  }
+};
+
+void Objecter::list_nobjects_range(int64_t pool_id, const string& nspace,
+				   const NListCursor& start,
+				   const NListCursor& finish, size_t max,
+				   const bufferlist& filter,
+				   std::list<librados::ListObjectImpl> *result,
+				   std::list<pg_nls_object_info_t> *info,
+				   NListCursor *next, Context *onfinish)
+{
+  ldout(cct, 10) << "list_nobjects_range " << start << " to " << finish
+		 << " max " << max << dendl;
+  if (start.pg_num && finish.pg_num && start.pg_num != finish.pg_num) {
+    onfinish->complete(-EINVAL);
+    return;
+  }
+
+  uint32_t pg_num = 0;
+  {
+    RWLock::RLocker rl(rwlock);
+    const pg_pool_t *pool = osdmap->get_pg_pool(pool_id);
+    if (pool)
+      pg_num = pool->get_pg_num();
+  }
+  if (!pg_num) {
+    onfinish->complete(-ENOENT);
+    return;
+  }
+  if (start.pg_num)
+    pg_num = start.pg_num;
+  else if (finish.pg_num)
+    pg_num = finish.pg_num;
+
+  NRangeContext *rc = new NRangeContext;
+  rc->pool_id = pool_id;
+  rc->nspace = nspace;
+  rc->cur = start.rebase(pg_num);
+  rc->finish = finish.rebase(pg_num);
+  rc->orig_finish = finish;
+  rc->max = max;
+  rc->filter = filter;
+  rc->result = result;
+  rc->info = info;
+  rc->next = next;
+  rc->onfinish = onfinish;
+  _list_range_send(rc);
+}
+
+void Objecter::_list_range_send(NRangeContext *rc)
+{
+  if (rc->result->size() >= rc->max || !(rc->cur < rc->finish)) {
+    ldout(cct, 20) << "list_nobjects_range stopping at " << rc->cur << dendl;
+    rc->complete(0);
+    return;
+  }
+
+  int r = 0;
+  set<pg_t> children;
+  {
+    RWLock::RLocker rl(rwlock);
+    const pg_pool_t *pool = osdmap->get_pg_pool(rc->pool_id);
+    if (!pool)
+      r = -ENOENT;
+    else if (pool->get_pg_num() < rc->cur.pg_num)
+      r = -ERANGE;
+    else
+      pg_t(rc->cur.ps, rc->pool_id).is_split(rc->cur.pg_num,
+					     pool->get_pg_num(), &children);
+  }
+  if (r < 0) {
+    rc->complete(r);
+    return;
+  }
+
+  rc->pieces.clear();
+  rc->pieces.push_back(NRangeContext::Piece(pg_t(rc->cur.ps, rc->pool_id)));
+  for (set<pg_t>::iterator p = children.begin(); p != children.end(); ++p)
+    rc->pieces.push_back(NRangeContext::Piece(*p));
+  ldout(cct, 20) << "list_nobjects_range listing " << rc->pieces.size()
+		 << " pgs from " << rc->cur << dendl;
+
+  // all of them at once, the results are merged by position
+  C_GatherBuilder gather(cct, new C_NRangeReply(this, rc));
+  object_locator_t oloc(rc->pool_id, rc->nspace);
+  for (std::list<NRangeContext::Piece>::iterator p = rc->pieces.begin();
+       p != rc->pieces.end(); ++p) {
+    ObjectOperation op;
+    op.pg_nls(rc->max - rc->result->size(), rc->filter, rc->cur.pos, 0);
+    pg_read(p->pgid.ps(), oloc, op, &p->bl, 0,
+	    new C_NRangePiece(&*p, gather.new_sub()), NULL, NULL);
+  }
+  gather.activate();
+}
+
+void Objecter::_list_range_reply(NRangeContext *rc, int r)
+{
+  if (r < 0) {
+    ldout(cct, 10) << "list_nobjects_range got " << r << dendl;
+    rc->complete(r);
+    return;
+  }
+
+  hobject_t stop = rc->cur.ps == rc->finish.ps ? rc->finish.pos :
+    hobject_t::get_max();
+  // every object of the pg before bound has been seen
+  hobject_t bound = stop;
+  vector<NRangeContext::Entry> entries;
+  {
+    RWLock::RLocker rl(rwlock);
+    const pg_pool_t *pool = osdmap->get_pg_pool(rc->pool_id);
+    if (!pool)
+      r = -ENOENT;
+    for (std::list<NRangeContext::Piece>::iterator p = rc->pieces.begin();
+	 r == 0 && p != rc->pieces.end(); ++p) {
+      pg_nls_response_t response;
+      bufferlist extra_info;
+      try {
+	bufferlist::iterator iter = p->bl.begin();
+	::decode(response, iter);
+	if (rc->filter.length())
+	  ::decode(extra_info, iter);
+      } catch (buffer::error& e) {
+	r = -EIO;
+	break;
+      }
+      // the osd returns 1 once it reaches the end of the pg
+      if (p->r != 1 && response.handle < bound)
+	bound = response.handle;
+
+      bufferlist::iterator info_iter = extra_info.begin();
+      for (list<librados::ListObjectImpl>::iterator q =
+	     response.entries.begin();
+	   r == 0 && q != response.entries.end(); ++q) {
+	NRangeContext::Entry e;
+	const string& key = q->locator.empty() ? q->oid : q->locator;
+	e.pos = hobject_t(object_t(q->oid), q->locator, CEPH_NOSNAP,
+			  pool->hash_key(key, q->nspace), rc->pool_id,
+			  q->nspace);
+	e.obj = *q;
+	if (rc->info) {
+	  try {
+	    ::decode(e.info, info_iter);
+	  } catch (buffer::error& err) {
+	    r = -EIO;
+	  }
+	}
+	entries.push_back(e);
+      }
+    }
+  }
+  if (r < 0) {
+    rc->complete(r);
+    return;
+  }
+
+  sort(entries.begin(), entries.end());
+  size_t room = rc->max - rc->result->size();
+  for (vector<NRangeContext::Entry>::iterator p = entries.begin();
+       p != entries.end() && p->pos < bound; ++p) {
+    if (room == 0) {
+      bound = p->pos;
+      break;
+    }
+    rc->result->push_back(p->obj);
+    if (rc->info)
+      rc->info->push_back(p->info);
+    --room;
+  }
+
+  if (bound >= stop) {
+    if (rc->cur.ps == rc->finish.ps) {
+      rc->cur = rc->finish;
+    } else {
+      ++rc->cur.ps;
+      rc->cur.pos = hobject_t();
+    }
+  } else {
+    rc->cur.pos = bound;
+  }
+  _list_range_send(rc);
+}
+
+// hash keys the objects of a pg sort between
+static void pg_key_range(uint32_t ps, uint32_t pg_num,
+			 uint32_t *kmin, uint32_t *kmax)
+{
+  uint32_t mask = (1u << pg_pool_t::calc_bits_of(pg_num)) - 1;
+  *kmin = hobject_t::_reverse_nibbles(ps);
+  *kmax = hobject_t::_reverse_nibbles(ps | ~mask);
+
+  // hashes of a sibling pg that hasn't split off yet land here too
+  uint32_t half = (mask + 1) >> 1;
+  if (ps < half && (ps | half) >= pg_num) {
+    *kmin = MIN(*kmin, hobject_t::_reverse_nibbles(ps | half));
+    *kmax = MAX(*kmax, hobject_t::_reverse_nibbles(ps | half | ~mask));
+  }
+}
+
+// a cursor as pg and the fraction of the pg's hash keys before it
+static uint64_t cursor_to_offset(const Objecter::NListCursor& c)
+{
+  uint64_t v = (uint64_t)c.ps << 32;
+  if (c.pos.is_min() || c.ps >= c.pg_num)
+    return v;
+
+  uint32_t kmin, kmax;
+  pg_key_range(c.ps, c.pg_num, &kmin, &kmax);
+  uint32_t k = c.pos.is_max() ? kmax : c.pos.get_filestore_key_u32();
+  k = MAX(kmin, MIN(kmax, k));
+  return v + (((uint64_t)(k - kmin) << 32) / ((uint64_t)kmax - kmin + 1));
+}
+
+static Objecter::NListCursor offset_to_cursor(uint64_t v, uint32_t pg_num,
+					      int64_t pool_id)
+{
+  Objecter::NListCursor c;
+  c.pg_num = pg_num;
+  c.ps = v >> 32;
+  uint32_t off = v & 0xffffffff;
+  if (off && c.ps < pg_num) {
+    uint32_t kmin, kmax;
+    pg_key_range(c.ps, pg_num, &kmin, &kmax);
+    uint32_t k = kmin + (((uint64_t)off * ((uint64_t)kmax - kmin + 1)) >> 32);
+    // sorts before every object with this hash
+    c.pos = hobject_t(object_t(), string(), 0, hobject_t::_reverse_nibbles(k),
+		      pool_id, string());
+  }
+  return c;
+}
+
+int Objecter::split_nlist_range(int64_t pool_id,
+				const NListCursor& start,
+				const NListCursor& finish,
+				size_t n, size_t m,
+				NListCursor *split_start,
+				NListCursor *split_finish)
+{
+  if (m == 0 || n >= m)
+    return -EINVAL;
+  if (start.pg_num && finish.pg_num && start.pg_num != finish.pg_num)
+    return -EINVAL;
+
+  uint32_t pg_num = 0;
+  {
+    RWLock::RLocker rl(rwlock);
+    const pg_pool_t *pool = osdmap->get_pg_pool(pool_id);
+    if (pool)
+      pg_num = pool->get_pg_num();
+  }
+  if (!pg_num)
+    return -ENOENT;
+  if (start.pg_num)
+    pg_num = start.pg_num;
+  else if (finish.pg_num)
+    pg_num = finish.pg_num;
+
+  // objects are spread evenly over hash keys, so split those
+  uint64_t vs = cursor_to_offset(start.rebase(pg_num));
+  uint64_t vf = cursor_to_offset(finish.rebase(pg_num));
+  uint64_t d = vf > vs ? vf - vs : 0;
+  uint64_t a = vs + (d / m) * n + (d % m) * n / m;
+  uint64_t b = vs + (d / m) * (n + 1) + (d % m) * (n + 1) / m;
+
+  *split_start = n == 0 ? start : offset_to_cursor(a, pg_num, pool_id);
+  *split_finish = n + 1 == m ? finish : offset_to_cursor(b, pg_num, pool_id);
+  ldout(cct, 10) << "split_nlist_range " << start << " to " << finish
+		 << " " << n << "/" << m << ": " << *split_start << " to "
+		 << *split_finish << dendl;
+  return 0;
+}
+
 uint32_t Objecter::list_objects_seek(ListContext *list_context,
 				     uint32_t pos)
 {
@@ -4141,6 +4656,7 @@ Objecter::OSDSession::~OSDSession()
   assert(ops.empty());
   assert(linger_ops.empty());
   assert(command_ops.empty());
+  assert(send_queue.empty());
 
   for (int i = 0; i < num_locks; i++) {
     delete completion_locks[i];
@@ -38,6 +38,7 @@ class OSDMap;
 class MonClient;
 class Message;
 
+class MOSDOpBatch;
 class MPoolOpReply;
 
 class MGetPoolStatsReply;
@@ -320,6 +321,11 @@ struct ObjectOperation {
     out_handler[p] = h;
     out_rval[p] = prval;
   }
+  void cmpext(uint64_t off, bufferlist& cmp_bl, int *prval) {
+    add_data(CEPH_OSD_OP_CMPEXT, off, cmp_bl.length(), cmp_bl);
+    unsigned p = ops.size() - 1;
+    out_rval[p] = prval;
+  }
   void write(uint64_t off, bufferlist& bl,
              uint64_t truncate_size,
              uint32_t truncate_seq) {
@@ -334,6 +340,13 @@ struct ObjectOperation {
   void write_full(bufferlist& bl) {
     add_data(CEPH_OSD_OP_WRITEFULL, 0, bl.length(), bl);
   }
+  void writesame(uint64_t off, uint64_t write_len, bufferlist& bl) {
+    OSDOp& osd_op = add_op(CEPH_OSD_OP_WRITESAME);
+    osd_op.op.writesame.offset = off;
+    osd_op.op.writesame.length = write_len;
+    osd_op.op.writesame.data_length = bl.length();
+    osd_op.indata.claim_append(bl);
+  }
   void append(bufferlist& bl) {
     add_data(CEPH_OSD_OP_APPEND, 0, bl.length(), bl);
   }
@@ -862,10 +875,12 @@ struct ObjectOperation {
     add_watch(CEPH_OSD_OP_NOTIFY, cookie, ver, 1, inbl); 
   }
 
-  void notify_ack(uint64_t notify_id, uint64_t ver, uint64_t cookie) {
+  void notify_ack(uint64_t notify_id, uint64_t ver, uint64_t cookie,
+		  const bufferlist& reply_bl = bufferlist()) {
     bufferlist bl;
     ::encode(notify_id, bl);
     ::encode(cookie, bl);
+    ::encode(reply_bl, bl);
     add_watch(CEPH_OSD_OP_NOTIFY_ACK, notify_id, ver, 0, bl);
   }
 
@@ -1310,6 +1325,43 @@ public:
     }
   };
 
+  /**
+   * A position in a pool, for listing it in independent ranges.
+   *
+   * Objects are ordered by placement group, and within one by the
+   * OSD's hobject_t sort order.  The placement group is relative to
+   * the pg_num the cursor was created for, so a range still covers the
+   * same objects after the pool's placement groups split.  The
+   * beginning and end of a pool aren't tied to any pg_num.
+   */
+  struct NListCursor {
+    uint32_t pg_num;  ///< 0 for the beginning or end of a pool
+    uint32_t ps;
+    hobject_t pos;
+
+    NListCursor() : pg_num(0), ps(0) {}
+    static NListCursor end() {
+      NListCursor c;
+      c.pos = hobject_t::get_max();
+      return c;
+    }
+    bool is_begin() const {
+      return pg_num == 0 && !pos.is_max();
+    }
+    bool is_end() const {
+      return pg_num == 0 && pos.is_max();
+    }
+    /// the same position relative to a pg_num, if it's the beginning or end
+    NListCursor rebase(uint32_t pg_num) const;
+
+    void encode(bufferlist& bl) const;
+    void decode(bufferlist::iterator& bl);
+  };
+
+  struct NRangeContext;
+  struct C_NRangePiece;
+  struct C_NRangeReply;
+
   // Old pgls context we still use for talking to older OSDs
   struct ListContext {
     int current_pg;
@@ -1539,11 +1591,23 @@ public:
     int num_locks;
     ConnectionRef con;
 
+    /**
+     * Messages are queued in tid order under the session lock and sent
+     * after it's dropped, so submitters don't hold it across the
+     * messenger and one flush can send a burst of ops.  send_lock keeps
+     * concurrent flushes from reordering them.
+     */
+    Mutex send_lock;
+    Mutex send_queue_lock;
+    list<pair<ConnectionRef, Message*> > send_queue;
+
     OSDSession(CephContext *cct, int o) :
       lock("OSDSession"),
       osd(o),
       incarnation(0),
-      con(NULL)
+      con(NULL),
+      send_lock("OSDSession::send_lock"),
+      send_queue_lock("OSDSession::send_queue_lock")
     {
       num_locks = cct->_conf->objecter_completion_locks_per_session;
       completion_locks = new Mutex *[num_locks];
@@ -1583,6 +1647,10 @@ public:
 
   MOSDOp *_prepare_osd_op(Op *op);
   void _send_op(Op *op, MOSDOp *m = NULL);
+  void _flush_sends(OSDSession *s);
+  MOSDOpBatch *_take_batch(const ConnectionRef& con,
+			   list<pair<ConnectionRef, Message*> >& sends,
+			   list<pair<ConnectionRef, Message*> >::iterator& p);
   void _cancel_linger_op(Op *op);
   void finish_op(OSDSession *session, ceph_tid_t tid);
   void _finish_op(Op *op);
@@ -1645,6 +1713,8 @@ public:
   
   void _nlist_reply(NListContext *list_context, int r, Context *final_finish,
 		   epoch_t reply_epoch);
+  void _list_range_send(NRangeContext *range_context);
+  void _list_range_reply(NRangeContext *range_context, int r);
   void _list_reply(ListContext *list_context, int r, Context *final_finish,
 		   epoch_t reply_epoch);
 
@@ -1777,13 +1847,23 @@ private:
   bool _promote_lock_check_race(RWLock::Context& lc);
 
   // low-level
-  ceph_tid_t _op_submit(Op *op, RWLock::Context& lc);
-  ceph_tid_t _op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget = NULL);
+  ceph_tid_t _op_submit(Op *op, RWLock::Context& lc,
+			set<OSDSession*> *deferred_sends = NULL);
+  ceph_tid_t _op_submit_with_budget(Op *op, RWLock::Context& lc, int *ctx_budget = NULL,
+				    set<OSDSession*> *deferred_sends = NULL);
+  bool _op_budget_would_block(Op *op);
+  void _flush_deferred_sends(set<OSDSession*>& sessions);
   inline void unregister_op(Op *op);
 
   // public interface
 public:
   ceph_tid_t op_submit(Op *op, int *ctx_budget = NULL);
+  /**
+   * Submit independent ops together.  They're all queued before any
+   * are sent, so the ones for the same OSD go out in as few messages
+   * as the OSD's features and objecter_batch_max_* allow.
+   */
+  void op_submit_batch(vector<Op*>& ops);
   bool is_active() {
     return !((!inflight_ops.read()) && linger_ops.empty() && poolstat_ops.empty() && statfs_ops.empty());
   }
@@ -2264,6 +2344,31 @@ public:
 
   void list_nobjects(NListContext *p, Context *onfinish);
   uint32_t list_nobjects_seek(NListContext *p, uint32_t pos);
+
+  /**
+   * List up to max objects from [start, finish).
+   *
+   * The placement groups a pg of the cursors split into since are
+   * listed at the same time.  *next is where the listing stopped; it's
+   * finish once the whole range is listed.
+   *
+   * A non-empty filter is an encoded PGLS filter.  For the "expr" type
+   * *info gets a pg_nls_object_info_t for each object in *result.
+   */
+  void list_nobjects_range(int64_t pool_id, const string& nspace,
+			   const NListCursor& start, const NListCursor& finish,
+			   size_t max, const bufferlist& filter,
+			   std::list<librados::ListObjectImpl> *result,
+			   std::list<pg_nls_object_info_t> *info,
+			   NListCursor *next, Context *onfinish);
+  /**
+   * Split [start, finish) into m ranges of about the same number of
+   * objects, and get the nth one.
+   */
+  int split_nlist_range(int64_t pool_id,
+			const NListCursor& start, const NListCursor& finish,
+			size_t n, size_t m,
+			NListCursor *split_start, NListCursor *split_finish);
   void list_objects(ListContext *p, Context *onfinish);
   uint32_t list_objects_seek(ListContext *p, uint32_t pos);
 
@@ -2396,4 +2501,34 @@ public:
   void blacklist_self(bool set);
 };
 
+WRITE_CLASS_ENCODER(Objecter::NListCursor)
+
+inline bool operator==(const Objecter::NListCursor& l,
+		       const Objecter::NListCursor& r) {
+  if (l.pg_num == 0 || r.pg_num == 0)
+    return l.pg_num == r.pg_num && l.pos.is_max() == r.pos.is_max();
+  return l.ps == r.ps && l.pos == r.pos;
+}
+inline bool operator!=(const Objecter::NListCursor& l,
+		       const Objecter::NListCursor& r) {
+  return !(l == r);
+}
+inline bool operator<(const Objecter::NListCursor& l,
+		      const Objecter::NListCursor& r) {
+  if (l.is_end() || r.is_begin())
+    return false;
+  if (l.is_begin() || r.is_end())
+    return true;
+  if (l.ps != r.ps)
+    return l.ps < r.ps;
+  return l.pos < r.pos;
+}
+inline ostream& operator<<(ostream& out, const Objecter::NListCursor& c) {
+  if (c.is_begin())
+    return out << "begin";
+  if (c.is_end())
+    return out << "end";
+  return out << c.ps << "/" << c.pg_num << ":" << c.pos;
+}
+
 #endif
@@ -33,6 +33,20 @@ class WritebackHandler {
 			   const bufferlist &bl, utime_t mtime,
 			   uint64_t trunc_size, __u32 trunc_seq,
 			   Context *oncommit) = 0;
+  /// whether write() can take several extents of one object at once
+  virtual bool can_scattered_write() { return false; }
+  /**
+   * write several non-overlapping extents of an object in one op
+   *
+   * Only called if can_scattered_write() returns true.
+   */
+  virtual ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+			   vector<pair<uint64_t, bufferlist> >& io_vec,
+			   const SnapContext& snapc, utime_t mtime,
+			   uint64_t trunc_size, __u32 trunc_seq,
+			   Context *oncommit) {
+    assert(0 == "this WritebackHandler does not support scattered writes");
+  }
   virtual ceph_tid_t lock(const object_t& oid, const object_locator_t& oloc,
 			  int op, int flags, Context *onack, Context *oncommit) {
     assert(0 == "this WritebackHandler does not support the lock operation");
@@ -0,0 +1,339 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <cxxabi.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "common/profile_tag.h"
+#include "perfglue/sampling_profiler.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+#define SAMPLE_MAX_FRAMES 32
+#define SAMPLE_SKIP 2         // signal handler and the signal trampoline
+#define SAMPLE_WQ_LEN 32
+
+struct sample_t {
+  volatile int depth;         // 0 until the sample is complete
+  void *frames[SAMPLE_MAX_FRAMES];
+  char wq[SAMPLE_WQ_LEN];
+  char op[PROFILE_TAG_OP_LEN];
+};
+
+// start/stop/reset/dump are serialized by sp_lock; the signal handler
+// only claims slots via sp_next and never blocks.
+static pthread_mutex_t sp_lock = PTHREAD_MUTEX_INITIALIZER;
+static sample_t *sp_samples = NULL;
+static unsigned sp_max = 0;
+static unsigned sp_next = 0;
+static unsigned sp_inflight = 0;
+static volatile int sp_running = 0;
+static int sp_hz = 0;
+static struct sigaction sp_old_action;
+static pthread_once_t sp_prime_once = PTHREAD_ONCE_INIT;
+
+// backtrace() isn't async-signal-safe until it has been called once:
+// the first call loads libgcc_s, which may allocate or take the
+// dynamic loader's lock.  do that before the handler is ever installed.
+static void sp_prime()
+{
+  void *prime[1];
+  backtrace(prime, 1);
+}
+
+static void sp_copy(char *dst, const char *src, size_t len)
+{
+  size_t i = 0;
+  if (src)
+    for (; i < len - 1 && src[i]; ++i)
+      dst[i] = src[i];
+  dst[i] = 0;
+}
+
+static void sp_handler(int sig, siginfo_t *info, void *ctx)
+{
+  if (!sp_running)
+    return;
+  int saved_errno = errno;
+  __sync_fetch_and_add(&sp_inflight, 1);
+  unsigned i = __sync_fetch_and_add(&sp_next, 1);
+  if (i < sp_max) {
+    sample_t *s = &sp_samples[i];
+    int n = backtrace(s->frames, SAMPLE_MAX_FRAMES);
+    sp_copy(s->wq, t_profile_tag.wq, sizeof(s->wq));
+    sp_copy(s->op, t_profile_tag.op, sizeof(s->op));
+    __sync_synchronize();
+    s->depth = n;
+  }
+  __sync_fetch_and_sub(&sp_inflight, 1);
+  errno = saved_errno;
+}
+
+static void sp_set_timer(int hz)
+{
+  struct itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = hz ? 1000000 / hz : 0;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, 0);
+}
+
+// stop taking samples and wait for in-progress handlers to finish
+static void sp_quiesce()
+{
+  sp_set_timer(0);
+  sp_running = 0;
+  __sync_synchronize();
+  while (__sync_fetch_and_add(&sp_inflight, 0))
+    usleep(1000);
+}
+
+int sampling_profiler_start(int hz, int max_samples)
+{
+  if (hz <= 0 || hz > 10000 || max_samples <= 0)
+    return -EINVAL;
+
+  pthread_mutex_lock(&sp_lock);
+  if (sp_running) {
+    pthread_mutex_unlock(&sp_lock);
+    return -EBUSY;
+  }
+  if (!sp_samples || sp_max != (unsigned)max_samples) {
+    free(sp_samples);
+    sp_samples = (sample_t *)calloc(max_samples, sizeof(sample_t));
+    if (!sp_samples) {
+      sp_max = 0;
+      pthread_mutex_unlock(&sp_lock);
+      return -ENOMEM;
+    }
+    sp_max = max_samples;
+    sp_next = 0;
+  }
+
+  pthread_once(&sp_prime_once, sp_prime);
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_sigaction = sp_handler;
+  sa.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, &sp_old_action);
+
+  sp_hz = hz;
+  g_profile_tag = 1;
+  sp_running = 1;
+  __sync_synchronize();
+  sp_set_timer(hz);
+  pthread_mutex_unlock(&sp_lock);
+  return 0;
+}
+
+void sampling_profiler_stop()
+{
+  pthread_mutex_lock(&sp_lock);
+  if (sp_running) {
+    sp_quiesce();
+    g_profile_tag = 0;
+    sigaction(SIGPROF, &sp_old_action, NULL);
+  }
+  pthread_mutex_unlock(&sp_lock);
+}
+
+bool sampling_profiler_running()
+{
+  return sp_running;
+}
+
+void sampling_profiler_reset()
+{
+  pthread_mutex_lock(&sp_lock);
+  bool was_running = sp_running;
+  if (was_running)
+    sp_quiesce();
+  if (sp_samples)
+    memset(sp_samples, 0, sp_max * sizeof(sample_t));
+  sp_next = 0;
+  if (was_running) {
+    sp_running = 1;
+    __sync_synchronize();
+    sp_set_timer(sp_hz);
+  }
+  pthread_mutex_unlock(&sp_lock);
+}
+
+// ';' separates frames in the folded format
+static void sp_escape(string& s)
+{
+  for (string::iterator p = s.begin(); p != s.end(); ++p)
+    if (*p == ';')
+      *p = ':';
+}
+
+static string sp_symbolize(const char *sym)
+{
+  // backtrace_symbols gives "module(mangled+0xoff) [0xaddr]"
+  const char *begin = strchr(sym, '(');
+  const char *end = begin ? strchr(begin, '+') : NULL;
+  string out;
+  if (begin && end && end > begin + 1) {
+    string mangled(begin + 1, end);
+    int status;
+    char *demangled = abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status);
+    if (demangled) {
+      out = demangled;
+      free(demangled);
+    } else {
+      out = mangled;
+    }
+  } else if (begin) {
+    // no symbol; use "module+0xoff"
+    const char *slash = sym;
+    for (const char *p = sym; p < begin; ++p)
+      if (*p == '/')
+	slash = p + 1;
+    const char *close = strchr(begin, ')');
+    out = string(slash, begin) + (close ? string(begin + 1, close) : "");
+  } else {
+    out = sym;
+  }
+  sp_escape(out);
+  return out;
+}
+
+int sampling_profiler_dump(std::ostream& out)
+{
+  pthread_mutex_lock(&sp_lock);
+  unsigned n = sp_next < sp_max ? sp_next : sp_max;
+
+  // snapshot depths; slots still being filled in are skipped
+  vector<int> depth(n);
+  for (unsigned i = 0; i < n; ++i)
+    depth[i] = sp_samples[i].depth;
+  __sync_synchronize();
+
+  // symbolize each distinct address once
+  map<void*, string> syms;
+  for (unsigned i = 0; i < n; ++i)
+    for (int j = SAMPLE_SKIP; j < depth[i]; ++j)
+      syms[sp_samples[i].frames[j]];
+  vector<void*> addrs;
+  for (map<void*, string>::iterator p = syms.begin(); p != syms.end(); ++p)
+    addrs.push_back(p->first);
+  char **strings = addrs.empty() ? NULL :
+    backtrace_symbols(&addrs[0], addrs.size());
+  for (unsigned i = 0; i < addrs.size(); ++i) {
+    if (strings) {
+      syms[addrs[i]] = sp_symbolize(strings[i]);
+    } else {
+      std::ostringstream ss;
+      ss << addrs[i];
+      syms[addrs[i]] = ss.str();
+    }
+  }
+  free(strings);
+
+  map<string, unsigned> folded;
+  unsigned taken = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    sample_t *s = &sp_samples[i];
+    if (depth[i] <= SAMPLE_SKIP)
+      continue;
+    string wq = string("[") + (s->wq[0] ? s->wq : "-") + "]";
+    sp_escape(wq);
+    string key = wq;
+    if (s->op[0]) {
+      string op = string("[") + s->op + "]";
+      sp_escape(op);
+      key += ";" + op;
+    }
+    for (int j = depth[i] - 1; j >= SAMPLE_SKIP; --j) {
+      key += ";";
+      key += syms[s->frames[j]];
+    }
+    folded[key]++;
+    taken++;
+  }
+  for (map<string, unsigned>::iterator p = folded.begin();
+       p != folded.end();
+       ++p)
+    out << p->first << " " << p->second << "\n";
+  pthread_mutex_unlock(&sp_lock);
+  return taken;
+}
+
+void sampling_profiler_handle_command(const std::vector<std::string> &cmd,
+				      int max_samples,
+				      std::ostream& out)
+{
+  if (cmd.size() < 2) {
+    out << "sampling_profiler: expected one of start, stop, status, reset, dump";
+    return;
+  }
+  if (cmd[1] == "start") {
+    int hz = 99;
+    if (cmd.size() > 2)
+      hz = atoi(cmd[2].c_str());
+    int r = sampling_profiler_start(hz, max_samples);
+    if (r < 0)
+      out << "sampling_profiler: start failed: " << strerror(-r);
+    else
+      out << "sampling_profiler: started at " << hz << " Hz";
+  }
+  else if (cmd[1] == "stop") {
+    sampling_profiler_stop();
+    out << "sampling_profiler: stopped";
+  }
+  else if (cmd[1] == "status") {
+    pthread_mutex_lock(&sp_lock);
+    unsigned taken = sp_next;
+    out << "sampling_profiler " << (sp_running ? "running" : "not running")
+	<< " hz " << sp_hz
+	<< " samples " << (taken < sp_max ? taken : sp_max)
+	<< " dropped " << (taken > sp_max ? taken - sp_max : 0)
+	<< " max_samples " << sp_max;
+    pthread_mutex_unlock(&sp_lock);
+  }
+  else if (cmd[1] == "reset") {
+    sampling_profiler_reset();
+    out << "sampling_profiler: reset";
+  }
+  else if (cmd[1] == "dump") {
+    if (cmd.size() < 3) {
+      out << "sampling_profiler: dump requires an output path";
+      return;
+    }
+    std::ofstream f(cmd[2].c_str());
+    if (!f.is_open()) {
+      out << "sampling_profiler: unable to open " << cmd[2];
+      return;
+    }
+    int n = sampling_profiler_dump(f);
+    out << "sampling_profiler: wrote " << n << " samples to " << cmd[2];
+  }
+  else {
+    out << "sampling_profiler: unrecognized command " << cmd[1]
+	<< "; expected one of start, stop, status, reset, dump.";
+  }
+}
@@ -0,0 +1,46 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_PERFGLUE_SAMPLING_PROFILER
+#define CEPH_PERFGLUE_SAMPLING_PROFILER
+
+/*
+ * Built-in SIGPROF sampling profiler.
+ *
+ * Each sample records the interrupted thread's stack together with
+ * its profile tag (work queue and current op, see common/profile_tag.h).
+ * Samples are written out as folded stacks, one "frame;frame;... count"
+ * line per distinct stack, ready for flamegraph.pl.  The tags appear
+ * as the outermost frames so that a flame graph splits by work queue
+ * and op first.
+ *
+ * This shares SIGPROF with the gperftools CPU profiler; only one of
+ * them can be running at a time.
+ */
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+int sampling_profiler_start(int hz, int max_samples);
+void sampling_profiler_stop();
+bool sampling_profiler_running();
+void sampling_profiler_reset();
+int sampling_profiler_dump(std::ostream& out);
+
+/*
+ * cmd is { "sampling_profiler", <action>, [arg] } with action one of
+ * start [hz], stop, status, reset, dump <path>
+ */
+void sampling_profiler_handle_command(const std::vector<std::string> &cmd,
+				      int max_samples,
+				      std::ostream& out);
+
+#endif
@@ -25,6 +25,7 @@
 #include "include/byteorder.h"
 
 #include "include/intarith.h"
+#include "include/interval_set.h"
 
 #include "include/compat.h"
 #include "common/blkdev.h"
@@ -32,7 +33,6 @@
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics/stats.hpp>
 #include <boost/accumulators/statistics/rolling_sum.hpp>
-#include <boost/scope_exit.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <errno.h>
 #include <iostream>
@@ -146,6 +146,11 @@ void usage()
 "  --image-format <format-number>     format to use when creating an image\n"
 "                                     format 1 is the original format (default)\n"
 "                                     format 2 supports cloning\n"
+"  --image-features <features>        optional format 2 features to enable, as\n"
+"                                     a sum of: +1 layering, +2 striping,\n"
+"                                     +4 exclusive lock, +8 object map;\n"
+"                                     defaults to layering for create/import\n"
+"                                     and layering and striping for clone\n"
 "  --id <username>                    rados user (without 'client.'prefix) to\n"
 "                                     authenticate as\n"
 "  --keyfile <path>                   file containing secret key for use with cephx\n"
@@ -165,6 +170,10 @@ static string feature_str(uint64_t feature)
     return "layering";
   case RBD_FEATURE_STRIPINGV2:
     return "striping";
+  case RBD_FEATURE_OBJECT_MAP:
+    return "object map";
+  case RBD_FEATURE_EXCLUSIVE_LOCK:
+    return "exclusive lock";
   default:
     return "";
   }
@@ -174,7 +183,7 @@ static string features_str(uint64_t features)
 {
   string s = "";
 
-  for (uint64_t feature = 1; feature <= RBD_FEATURE_STRIPINGV2;
+  for (uint64_t feature = 1; feature <= RBD_FEATURE_OBJECT_MAP;
        feature <<= 1) {
     if (feature & features) {
       if (s.size())
@@ -188,7 +197,7 @@ static string features_str(uint64_t features)
 static void format_features(Formatter *f, uint64_t features)
 {
   f->open_array_section("features");
-  for (uint64_t feature = 1; feature <= RBD_FEATURE_STRIPINGV2;
+  for (uint64_t feature = 1; feature <= RBD_FEATURE_OBJECT_MAP;
        feature <<= 1) {
     f->dump_string("feature", feature_str(feature));
   }
@@ -447,8 +456,11 @@ static int do_clone(librbd::RBD &rbd, librados::IoCtx &p_ioctx,
 		    librados::IoCtx &c_ioctx, const char *c_name,
 		    uint64_t features, int *c_order)
 {
+  // the object map and exclusive lock are opt-in, since the kernel
+  // client can't map images that use them
   if (features == 0)
-    features = RBD_FEATURES_ALL;
+    features = RBD_FEATURES_ALL &
+      ~(RBD_FEATURE_OBJECT_MAP | RBD_FEATURE_EXCLUSIVE_LOCK);
   else if ((features & RBD_FEATURE_LAYERING) != RBD_FEATURE_LAYERING)
     return -EINVAL;
 
@@ -999,51 +1011,49 @@ static int do_bench_write(librbd::Image& image, uint64_t io_size,
   return 0;
 }
 
-struct ExportContext {
-  librbd::Image *image;
-  int fd;
-  uint64_t totalsize;
-  MyProgressContext pc;
-
-  ExportContext(librbd::Image *i, int f, uint64_t t) :
-    image(i),
-    fd(f),
-    totalsize(t),
-    pc("Exporting image")
-  {}
-};
-
 class AioExportContext : public Context
 {
 public:
-  AioExportContext(SimpleThrottle &simple_throttle, librbd::Image &image,
+  AioExportContext(OrderedThrottle &ordered_throttle, librbd::Image &image,
                    uint64_t offset, uint64_t length, int fd)
     : m_aio_completion(
         new librbd::RBD::AioCompletion(this, &AioExportContext::aio_callback)),
-      m_throttle(simple_throttle),
+      m_throttle(ordered_throttle),
+      m_image(image),
       m_offset(offset),
-      m_fd(fd)
+      m_length(length),
+      m_fd(fd),
+      m_ctx(NULL)
   {
-    m_throttle.start_op();
-    int r = image.aio_read(offset, length, m_bufferlist, m_aio_completion);
+  }
+
+  virtual ~AioExportContext()
+  {
+    m_aio_completion->release();
+  }
+
+  void send()
+  {
+    m_ctx = m_throttle.start_op(this, m_length);
+    int r = m_image.aio_read(m_offset, m_length, m_bufferlist,
+                             m_aio_completion);
     if (r < 0) {
       cerr << "rbd: error requesting read from source image" << std::endl;
-      m_throttle.end_op(r);
+      m_ctx->complete(r);
     }
   }
 
-  virtual ~AioExportContext()
+  // a stream still needs the zeros for a hole
+  void send_hole()
   {
-    m_aio_completion->release();
+    m_ctx = m_throttle.start_op(this, m_length);
+    m_bufferlist.append_zero(m_length);
+    m_ctx->complete(m_length);
   }
 
+  // runs in order, in the thread starting the exports
   virtual void finish(int r)
   {
-    BOOST_SCOPE_EXIT((&m_throttle) (&r))
-    {
-      m_throttle.end_op(r);
-    } BOOST_SCOPE_EXIT_END
-
     if (r < 0) {
       cerr << "rbd: error reading from source image at offset "
            << m_offset << ": " << cpp_strerror(r) << std::endl;
@@ -1060,7 +1070,7 @@ public:
       if (chkret != m_offset) {
         cerr << "rbd: error seeking destination image to offset "
              << m_offset << std::endl;
-        r = -errno;
+        m_throttle.fail(-errno);
         return;
       }
     }
@@ -1069,6 +1079,7 @@ public:
     if (r < 0) {
       cerr << "rbd: error writing to destination image at offset "
            << m_offset << std::endl;
+      m_throttle.fail(r);
     }
   }
 
@@ -1077,17 +1088,29 @@ public:
     librbd::RBD::AioCompletion *aio_completion =
       reinterpret_cast<librbd::RBD::AioCompletion*>(completion);
     AioExportContext *export_context = reinterpret_cast<AioExportContext*>(arg);
-    export_context->complete(aio_completion->get_return_value());
+    export_context->m_ctx->complete(aio_completion->get_return_value());
   }
 
 private:
   librbd::RBD::AioCompletion *m_aio_completion;
-  SimpleThrottle &m_throttle;
+  OrderedThrottle &m_throttle;
+  librbd::Image &m_image;
   bufferlist m_bufferlist;
   uint64_t m_offset;
+  uint64_t m_length;
   int m_fd;
+  Context *m_ctx;
 };
 
+static int data_extents_cb(uint64_t ofs, size_t len, int exists, void *arg)
+{
+  interval_set<uint64_t> *data_extents =
+    static_cast<interval_set<uint64_t> *>(arg);
+  if (exists)
+    data_extents->insert(ofs, len);
+  return 0;
+}
+
 static int do_export(librbd::Image& image, const char *path)
 {
   librbd::image_info_t info;
@@ -1095,14 +1118,26 @@ static int do_export(librbd::Image& image, const char *path)
   if (r < 0)
     return r;
 
+  // with an object map, listing the data is much cheaper than
+  // reading the holes
+  uint64_t features;
+  r = image.features(&features);
+  if (r < 0)
+    return r;
+  bool skip_holes = (features & RBD_FEATURE_OBJECT_MAP) != 0;
+  interval_set<uint64_t> data_extents;
+  if (skip_holes) {
+    r = image.diff_iterate(NULL, 0, info.size, data_extents_cb,
+                           &data_extents);
+    if (r < 0)
+      return r;
+  }
+
   int fd;
-  int max_concurrent_ops;
   bool to_stdout = (strcmp(path, "-") == 0);
   if (to_stdout) {
     fd = STDOUT_FILENO;
-    max_concurrent_ops = 1;
   } else {
-    max_concurrent_ops = max(g_conf->rbd_concurrent_management_ops, 1);
     fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
     if (fd < 0) {
       return -errno;
@@ -1111,11 +1146,27 @@ static int do_export(librbd::Image& image, const char *path)
 
   MyProgressContext pc("Exporting image");
 
-  SimpleThrottle throttle(max_concurrent_ops, false);
+  // results are written in order, so a stream can have as many reads
+  // in flight as a file
+  OrderedThrottle throttle(max(g_conf->rbd_concurrent_management_ops, 1),
+                           g_conf->rbd_concurrent_management_bytes, false);
   uint64_t period = image.get_stripe_count() * (1ull << info.order);
   for (uint64_t offset = 0; offset < info.size; offset += period) {
+    if (throttle.pending_error())
+      break;
+
     uint64_t length = min(period, info.size - offset);
-    new AioExportContext(throttle, image, offset, length, fd);
+    if (skip_holes && !data_extents.intersects(offset, length)) {
+      if (to_stdout) {
+        AioExportContext *ctx = new AioExportContext(throttle, image, offset,
+                                                     length, fd);
+        ctx->send_hole();
+      }
+    } else {
+      AioExportContext *ctx = new AioExportContext(throttle, image, offset,
+                                                   length, fd);
+      ctx->send();
+    }
     pc.update_progress(offset, info.size);
   }
 
@@ -1135,33 +1186,121 @@ static int do_export(librbd::Image& image, const char *path)
   return r;
 }
 
-static int export_diff_cb(uint64_t ofs, size_t _len, int exists, void *arg)
+class AioExportDiffContext : public Context
 {
-  ExportContext *ec = static_cast<ExportContext *>(arg);
-  int r;
+public:
+  AioExportDiffContext(OrderedThrottle &ordered_throttle,
+                       librbd::Image &image, uint64_t offset,
+                       uint64_t length, bool exists, int fd)
+    : m_aio_completion(
+        new librbd::RBD::AioCompletion(this,
+                                       &AioExportDiffContext::aio_callback)),
+      m_throttle(ordered_throttle),
+      m_image(image),
+      m_offset(offset),
+      m_length(length),
+      m_exists(exists),
+      m_fd(fd),
+      m_ctx(NULL)
+  {
+  }
 
-  // extent
-  bufferlist bl;
-  __u8 tag = exists ? 'w' : 'z';
-  ::encode(tag, bl);
-  ::encode(ofs, bl);
-  uint64_t len = _len;
-  ::encode(len, bl);
-  r = bl.write_fd(ec->fd);
-  if (r < 0)
-    return r;
+  virtual ~AioExportDiffContext()
+  {
+    m_aio_completion->release();
+  }
 
-  if (exists) {
-    // read block
-    bl.clear();
-    r = ec->image->read(ofs, len, bl);
-    if (r < 0)
-      return r;
-    r = bl.write_fd(ec->fd);
-    if (r < 0)
-      return r;
+  void send()
+  {
+    m_ctx = m_throttle.start_op(this, m_exists ? m_length : 0);
+    if (!m_exists) {
+      m_ctx->complete(0);
+      return;
+    }
+
+    int r = m_image.aio_read(m_offset, m_length, m_bufferlist,
+                             m_aio_completion);
+    if (r < 0) {
+      cerr << "rbd: error requesting read from source image" << std::endl;
+      m_ctx->complete(r);
+    }
+  }
+
+  // runs in order, in the thread iterating over the diff
+  virtual void finish(int r)
+  {
+    if (r < 0) {
+      cerr << "rbd: error reading from source image at offset "
+           << m_offset << ": " << cpp_strerror(r) << std::endl;
+      return;
+    }
+
+    // extent
+    bufferlist bl;
+    __u8 tag = m_exists ? 'w' : 'z';
+    ::encode(tag, bl);
+    ::encode(m_offset, bl);
+    ::encode(m_length, bl);
+    if (m_exists) {
+      assert(m_bufferlist.length() == m_length);
+      bl.claim_append(m_bufferlist);
+    }
+    r = bl.write_fd(m_fd);
+    if (r < 0) {
+      cerr << "rbd: error writing diff at offset " << m_offset << std::endl;
+      m_throttle.fail(r);
+    }
   }
 
+  static void aio_callback(librbd::completion_t completion, void *arg)
+  {
+    librbd::RBD::AioCompletion *aio_completion =
+      reinterpret_cast<librbd::RBD::AioCompletion*>(completion);
+    AioExportDiffContext *export_context =
+      reinterpret_cast<AioExportDiffContext*>(arg);
+    export_context->m_ctx->complete(aio_completion->get_return_value());
+  }
+
+private:
+  librbd::RBD::AioCompletion *m_aio_completion;
+  OrderedThrottle &m_throttle;
+  librbd::Image &m_image;
+  bufferlist m_bufferlist;
+  uint64_t m_offset;
+  uint64_t m_length;
+  bool m_exists;
+  int m_fd;
+  Context *m_ctx;
+};
+
+struct ExportContext {
+  librbd::Image *image;
+  int fd;
+  uint64_t totalsize;
+  MyProgressContext pc;
+  OrderedThrottle throttle;
+
+  ExportContext(librbd::Image *i, int f, uint64_t t) :
+    image(i),
+    fd(f),
+    totalsize(t),
+    pc("Exporting image"),
+    throttle(max(g_conf->rbd_concurrent_management_ops, 1),
+             g_conf->rbd_concurrent_management_bytes, false)
+  {}
+};
+
+static int export_diff_cb(uint64_t ofs, size_t _len, int exists, void *arg)
+{
+  ExportContext *ec = static_cast<ExportContext *>(arg);
+  if (ec->throttle.pending_error())
+    return 0;
+
+  AioExportDiffContext *ctx = new AioExportDiffContext(ec->throttle,
+                                                       *ec->image, ofs, _len,
+                                                       exists, ec->fd);
+  ctx->send();
+
   ec->pc.update_progress(ofs, ec->totalsize);
 
   return 0;
@@ -1220,6 +1359,11 @@ static int do_export_diff(librbd::Image& image, const char *fromsnapname,
 
   ExportContext ec(&image, fd, info.size);
   r = image.diff_iterate(fromsnapname, 0, info.size, export_diff_cb, (void *)&ec);
+  {
+    int wait_r = ec.throttle.wait_for_ret();
+    if (r >= 0)
+      r = wait_r;
+  }
   if (r < 0)
     goto out;
 
@@ -1355,20 +1499,16 @@ done_img:
 class AioImportContext : public Context
 {
 public:
-  AioImportContext(SimpleThrottle &simple_throttle, librbd::Image &image,
+  AioImportContext(OrderedThrottle &ordered_throttle, librbd::Image &image,
                    bufferlist &bl, uint64_t offset)
-    : m_throttle(simple_throttle),
-      m_aio_completion(
+    : m_aio_completion(
         new librbd::RBD::AioCompletion(this, &AioImportContext::aio_callback)),
-      m_offset(offset)
+      m_throttle(ordered_throttle),
+      m_image(image),
+      m_bufferlist(bl),
+      m_offset(offset),
+      m_ctx(NULL)
   {
-    m_throttle.start_op();
-
-    int r = image.aio_write(m_offset, bl.length(), bl, m_aio_completion);
-    if (r < 0) {
-      cerr << "rbd: error requesting write to destination image" << std::endl;
-      m_throttle.end_op(r);
-    }
   }
 
   virtual ~AioImportContext()
@@ -1376,13 +1516,25 @@ public:
     m_aio_completion->release();
   }
 
+  void send()
+  {
+    m_ctx = m_throttle.start_op(NULL, m_bufferlist.length());
+
+    int r = m_image.aio_write(m_offset, m_bufferlist.length(), m_bufferlist,
+                              m_aio_completion);
+    if (r < 0) {
+      cerr << "rbd: error requesting write to destination image" << std::endl;
+      complete(r);
+    }
+  }
+
   virtual void finish(int r)
   {
     if (r < 0) {
       cerr << "rbd: error writing to destination image at offset "
            << m_offset << ": " << cpp_strerror(r) << std::endl;
     }
-    m_throttle.end_op(r);
+    m_ctx->complete(r);
   }
 
   static void aio_callback(librbd::completion_t completion, void *arg)
@@ -1394,9 +1546,12 @@ public:
   }
 
 private:
-  SimpleThrottle &m_throttle;
   librbd::RBD::AioCompletion *m_aio_completion;
+  OrderedThrottle &m_throttle;
+  librbd::Image &m_image;
+  bufferlist m_bufferlist;
   uint64_t m_offset;
+  Context *m_ctx;
 };
 
 static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
@@ -1422,15 +1577,13 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
   size_t blklen = 0;		// amount accumulated from reads to fill blk
   librbd::Image image;
 
-  boost::scoped_ptr<SimpleThrottle> throttle;
+  OrderedThrottle throttle(max(g_conf->rbd_concurrent_management_ops, 1),
+                           g_conf->rbd_concurrent_management_bytes, false);
   bool from_stdin = !strcmp(path, "-");
   if (from_stdin) {
-    throttle.reset(new SimpleThrottle(1, false));
     fd = 0;
     size = 1ULL << *order;
   } else {
-    throttle.reset(new SimpleThrottle(
-      max(g_conf->rbd_concurrent_management_ops, 1), false));
     if ((fd = open(path, O_RDONLY)) < 0) {
       r = -errno;
       cerr << "rbd: error opening " << path << std::endl;
@@ -1491,6 +1644,7 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
       r = image.resize(size);
       if (r < 0) {
 	cerr << "rbd: can't resize image during import" << std::endl;
+	throttle.wait_for_ret();
 	goto done;
       }
     }
@@ -1498,7 +1652,11 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
     // write as much as we got; perhaps less than imgblklen
     // but skip writing zeros to create sparse images
     if (!bl.is_zero()) {
-      new AioImportContext(*throttle, image, bl, image_pos);
+      AioImportContext *ctx = new AioImportContext(throttle, image, bl,
+                                                   image_pos);
+      ctx->send();
+      if (throttle.pending_error())
+        break;
     }
 
     // done with whole block, whether written or not
@@ -1509,7 +1667,7 @@ static int do_import(librbd::RBD &rbd, librados::IoCtx& io_ctx,
     blklen = 0;
     reqlen = imgblklen;
   }
-  r = throttle->wait_for_ret();
+  r = throttle.wait_for_ret();
   if (r < 0) {
     goto done;
   }
@@ -1561,6 +1719,80 @@ static int read_string(int fd, unsigned max, string *out)
   return len;
 }
 
+class AioImportDiffContext : public Context
+{
+public:
+  AioImportDiffContext(OrderedThrottle &ordered_throttle,
+                       librbd::Image &image, uint64_t offset, uint64_t length,
+                       bufferlist &bl, interval_set<uint64_t> *in_flight)
+    : m_aio_completion(
+        new librbd::RBD::AioCompletion(this,
+                                       &AioImportDiffContext::aio_callback)),
+      m_throttle(ordered_throttle),
+      m_image(image),
+      m_offset(offset),
+      m_length(length),
+      m_bufferlist(bl),
+      m_in_flight(in_flight),
+      m_ctx(NULL)
+  {
+  }
+
+  virtual ~AioImportDiffContext()
+  {
+    m_aio_completion->release();
+  }
+
+  // writes the data, or discards the extent if there's none
+  void send()
+  {
+    m_ctx = m_throttle.start_op(this, m_bufferlist.length());
+    m_in_flight->insert(m_offset, m_length);
+
+    int r;
+    if (m_bufferlist.length() > 0) {
+      r = m_image.aio_write(m_offset, m_length, m_bufferlist,
+                            m_aio_completion);
+    } else {
+      r = m_image.aio_discard(m_offset, m_length, m_aio_completion);
+    }
+    if (r < 0) {
+      cerr << "rbd: error requesting update of destination image"
+           << std::endl;
+      m_ctx->complete(r);
+    }
+  }
+
+  // runs in order, in the thread reading the diff
+  virtual void finish(int r)
+  {
+    m_in_flight->erase(m_offset, m_length);
+    if (r < 0) {
+      cerr << "rbd: error updating destination image at offset "
+           << m_offset << ": " << cpp_strerror(r) << std::endl;
+    }
+  }
+
+  static void aio_callback(librbd::completion_t completion, void *arg)
+  {
+    librbd::RBD::AioCompletion *aio_completion =
+      reinterpret_cast<librbd::RBD::AioCompletion*>(completion);
+    AioImportDiffContext *import_context =
+      reinterpret_cast<AioImportDiffContext*>(arg);
+    import_context->m_ctx->complete(aio_completion->get_return_value());
+  }
+
+private:
+  librbd::RBD::AioCompletion *m_aio_completion;
+  OrderedThrottle &m_throttle;
+  librbd::Image &m_image;
+  uint64_t m_offset;
+  uint64_t m_length;
+  bufferlist m_bufferlist;
+  interval_set<uint64_t> *m_in_flight;
+  Context *m_ctx;
+};
+
 static int do_import_diff(librbd::Image &image, const char *path)
 {
   int fd, r;
@@ -1569,6 +1801,9 @@ static int do_import_diff(librbd::Image &image, const char *path)
   uint64_t size = 0;
   uint64_t off = 0;
   string from, to;
+  OrderedThrottle throttle(max(g_conf->rbd_concurrent_management_ops, 1),
+                           g_conf->rbd_concurrent_management_bytes, false);
+  interval_set<uint64_t> in_flight;
 
   bool from_stdin = !strcmp(path, "-");
   if (from_stdin) {
@@ -1598,6 +1833,11 @@ static int do_import_diff(librbd::Image &image, const char *path)
   }
 
   while (true) {
+    if (throttle.pending_error()) {
+      r = throttle.wait_for_ret();
+      goto done;
+    }
+
     __u8 tag;
     r = safe_read_exact(fd, &tag, 1);
     if (r < 0) {
@@ -1645,6 +1885,9 @@ static int do_import_diff(librbd::Image &image, const char *path)
       image.size(&cur_size);
       if (cur_size != end_size) {
 	dout(2) << "resize " << cur_size << " -> " << end_size << dendl;
+	r = throttle.wait_for_ret();
+	if (r < 0)
+	  goto done;
 	image.resize(end_size);
       } else {
 	dout(2) << "size " << end_size << " (no change)" << dendl;
@@ -1663,18 +1906,29 @@ static int do_import_diff(librbd::Image &image, const char *path)
       ::decode(off, p);
       ::decode(len, p);
 
+      bufferlist data;
       if (tag == 'w') {
 	bufferptr bp = buffer::create(len);
 	r = safe_read_exact(fd, bp.c_str(), len);
 	if (r < 0)
 	  goto done;
-	bufferlist data;
 	data.append(bp);
 	dout(2) << " write " << off << "~" << len << dendl;
-	image.write(off, len, data);
       } else {
 	dout(2) << " zero " << off << "~" << len << dendl;
-	image.discard(off, len);
+      }
+
+      // later extents must land after earlier ones they overlap
+      if (len > 0 && in_flight.intersects(off, len)) {
+	r = throttle.wait_for_ret();
+	if (r < 0)
+	  goto done;
+      }
+      if (len > 0) {
+	AioImportDiffContext *ctx = new AioImportDiffContext(throttle, image,
+							     off, len, data,
+							     &in_flight);
+	ctx->send();
       }
     } else {
       cerr << "unrecognized tag byte " << (int)tag << " in stream; aborting" << std::endl;
@@ -1692,6 +1946,10 @@ static int do_import_diff(librbd::Image &image, const char *path)
     }
   }
 
+  r = throttle.wait_for_ret();
+  if (r < 0)
+    goto done;
+
   // take final snap
   if (to.length()) {
     dout(2) << " create end snap " << to << dendl;
@@ -1699,6 +1957,11 @@ static int do_import_diff(librbd::Image &image, const char *path)
   }
 
  done:
+  {
+    int wait_r = throttle.wait_for_ret();
+    if (r >= 0)
+      r = wait_r;
+  }
   if (r < 0)
     pc.fail();
   else
@@ -2087,9 +2350,10 @@ int main(int argc, const char **argv)
   uint64_t size = 0;  // in bytes
   int order = 0;
   bool format_specified = false,
-    output_format_specified = false;
+    output_format_specified = false,
+    features_specified = false;
   int format = 1;
-  uint64_t features = RBD_FEATURE_LAYERING;
+  uint64_t features = 0;
   const char *imgname = NULL, *snapname = NULL, *destname = NULL,
     *dest_poolname = NULL, *dest_snapname = NULL, *path = NULL,
     *devpath = NULL, *lock_cookie = NULL, *lock_client = NULL,
@@ -2126,6 +2390,15 @@ int main(int argc, const char **argv)
       }
       format_specified = true;
       g_conf->set_val_or_die("rbd_default_format", val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--image-features",
+				     (char*)NULL)) {
+      features = strict_strtoll(val.c_str(), 10, &parse_err);
+      if (!parse_err.empty()) {
+	cerr << "rbd: error parsing --image-features: " << parse_err
+	     << std::endl;
+	return EXIT_FAILURE;
+      }
+      features_specified = true;
     } else if (ceph_argparse_witharg(args, i, &val, "-p", "--pool", (char*)NULL)) {
       poolname = strdup(val.c_str());
     } else if (ceph_argparse_witharg(args, i, &val, "--dest-pool", (char*)NULL)) {
@@ -2327,6 +2600,13 @@ if (!set_conf_param(v, p1, p2, p3)) { \
     return EXIT_FAILURE;
   }
 
+  if (features_specified && opt_cmd != OPT_IMPORT && opt_cmd != OPT_CREATE &&
+      opt_cmd != OPT_CLONE) {
+    cerr << "rbd: image features can only be set when "
+	 << "creating, cloning or importing an image" << std::endl;
+    return EXIT_FAILURE;
+  }
+
   if (pretty_format && !strcmp(output_format, "plain")) {
     cerr << "rbd: --pretty-format only works when --format is json or xml"
 	 << std::endl;
@@ -2352,6 +2632,18 @@ if (!set_conf_param(v, p1, p2, p3)) { \
     }
   }
 
+  if (features_specified) {
+    if ((features & ~RBD_FEATURES_ALL) != 0) {
+      cerr << "rbd: unknown image features " << (features & ~RBD_FEATURES_ALL)
+	   << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (format == 1 && opt_cmd != OPT_CLONE) {
+      cerr << "rbd: image features require --image-format 2" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   if (opt_cmd == OPT_EXPORT && !imgname) {
     cerr << "rbd: image name was not specified" << std::endl;
     return EXIT_FAILURE;
@@ -68,6 +68,11 @@
     --image-format <format-number>     format to use when creating an image
                                        format 1 is the original format (default)
                                        format 2 supports cloning
+    --image-features <features>        optional format 2 features to enable, as
+                                       a sum of: +1 layering, +2 striping,
+                                       +4 exclusive lock, +8 object map;
+                                       defaults to layering for create/import
+                                       and layering and striping for clone
     --id <username>                    rados user (without 'client.'prefix) to
                                        authenticate as
     --keyfile <path>                   file containing secret key for use with cephx
@@ -1,10 +1,12 @@
 // -*- mode:C; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+#include "common/bit_vector.hpp"
 #include "common/snap_types.h"
 #include "include/encoding.h"
 #include "include/types.h"
 #include "include/rados/librados.h"
+#include "include/rbd/object_map_types.h"
 #include "include/stringify.h"
 #include "cls/rbd/cls_rbd.h"
 #include "cls/rbd/cls_rbd_client.h"
@@ -48,6 +50,9 @@ using ::librbd::cls_client::set_protection_status;
 using ::librbd::cls_client::get_stripe_unit_count;
 using ::librbd::cls_client::set_stripe_unit_count;
 using ::librbd::cls_client::old_snapshot_add;
+using ::librbd::cls_client::object_map_load;
+using ::librbd::cls_client::object_map_resize;
+using ::librbd::cls_client::object_map_update;
 
 static char *random_buf(size_t len)
 {
@@ -887,3 +892,60 @@ TEST_F(TestClsRbd, stripingv2)
 
   ioctx.close();
 }
+
+TEST_F(TestClsRbd, object_map)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, _rados.ioctx_create(_pool_name.c_str(), ioctx));
+
+  string oid = get_temp_image_name();
+  ceph::BitVector<2> object_map;
+  ASSERT_EQ(-ENOENT, object_map_load(&ioctx, oid, &object_map));
+
+  librados::ObjectWriteOperation op1;
+  object_map_resize(&op1, 100, OBJECT_NONEXISTENT);
+  ASSERT_EQ(0, ioctx.operate(oid, &op1));
+  ASSERT_EQ(0, object_map_load(&ioctx, oid, &object_map));
+  ASSERT_EQ(100U, object_map.size());
+  for (uint64_t i = 0; i < object_map.size(); ++i)
+    ASSERT_EQ(OBJECT_NONEXISTENT, object_map[i]);
+
+  librados::ObjectWriteOperation op2;
+  object_map_update(&op2, 10, 20, OBJECT_EXISTS, boost::optional<uint8_t>());
+  ASSERT_EQ(0, ioctx.operate(oid, &op2));
+
+  // only objects in the current state are updated
+  librados::ObjectWriteOperation op3;
+  object_map_update(&op3, 0, 15, OBJECT_PENDING, OBJECT_EXISTS);
+  ASSERT_EQ(0, ioctx.operate(oid, &op3));
+
+  ASSERT_EQ(0, object_map_load(&ioctx, oid, &object_map));
+  for (uint64_t i = 0; i < object_map.size(); ++i) {
+    uint8_t state = OBJECT_NONEXISTENT;
+    if (i >= 10 && i < 15)
+      state = OBJECT_PENDING;
+    else if (i >= 15 && i < 20)
+      state = OBJECT_EXISTS;
+    ASSERT_EQ(state, object_map[i]);
+  }
+
+  librados::ObjectWriteOperation op4;
+  object_map_update(&op4, 90, 101, OBJECT_EXISTS, boost::optional<uint8_t>());
+  ASSERT_EQ(-ERANGE, ioctx.operate(oid, &op4));
+
+  // can't drop objects that may still exist
+  librados::ObjectWriteOperation op5;
+  object_map_resize(&op5, 12, OBJECT_NONEXISTENT);
+  ASSERT_EQ(-ESTALE, ioctx.operate(oid, &op5));
+
+  librados::ObjectWriteOperation op6;
+  object_map_resize(&op6, 150, OBJECT_EXISTS);
+  ASSERT_EQ(0, ioctx.operate(oid, &op6));
+  ASSERT_EQ(0, object_map_load(&ioctx, oid, &object_map));
+  ASSERT_EQ(150U, object_map.size());
+  ASSERT_EQ(OBJECT_NONEXISTENT, object_map[99]);
+  ASSERT_EQ(OBJECT_EXISTS, object_map[100]);
+  ASSERT_EQ(OBJECT_EXISTS, object_map[149]);
+
+  ioctx.close();
+}
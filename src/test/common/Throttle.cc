@@ -238,6 +238,44 @@ TEST_F(ThrottleTest, destructor) {
   }
 }
 
+class C_RecordOrder : public Context {
+public:
+  C_RecordOrder(std::vector<int> *order, int i) : m_order(order), m_i(i) {}
+  virtual void finish(int r) {
+    m_order->push_back(m_i);
+  }
+private:
+  std::vector<int> *m_order;
+  int m_i;
+};
+
+TEST(OrderedThrottle, ordered) {
+  OrderedThrottle throttle(4, 0, false);
+  std::vector<int> order;
+  std::vector<Context*> ops;
+  for (int i = 0; i < 4; ++i)
+    ops.push_back(throttle.start_op(new C_RecordOrder(&order, i)));
+
+  // completed in reverse, run in the order they were started
+  for (int i = 3; i >= 0; --i)
+    ops[i]->complete(0);
+  ASSERT_EQ(0, throttle.wait_for_ret());
+  ASSERT_EQ(4U, order.size());
+  for (int i = 0; i < 4; ++i)
+    ASSERT_EQ(i, order[i]);
+}
+
+TEST(OrderedThrottle, error) {
+  OrderedThrottle throttle(2, 0, true);
+  throttle.start_op(NULL)->complete(-ENOENT);
+  ASSERT_FALSE(throttle.pending_error());
+  throttle.start_op(NULL)->complete(-EIO);
+  ASSERT_TRUE(throttle.pending_error());
+  throttle.start_op(NULL)->complete(0);
+  throttle.fail(-EINVAL);
+  ASSERT_EQ(-EIO, throttle.wait_for_ret());
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -0,0 +1,109 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * LGPL2.1 (see COPYING-LGPL2.1) or later
+ */
+
+#include <gtest/gtest.h>
+
+#include "common/bit_vector.hpp"
+
+using ceph::BitVector;
+
+TEST(BitVector, Basic) {
+  BitVector<2> bv;
+  ASSERT_EQ(0U, bv.size());
+
+  bv.resize(10);
+  ASSERT_EQ(10U, bv.size());
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    ASSERT_EQ(0, bv[i]);
+
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    bv[i] = i % 4;
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    ASSERT_EQ(i % 4, (uint64_t)bv[i]);
+}
+
+TEST(BitVector, Resize) {
+  BitVector<2> bv;
+  bv.resize(9);
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    bv[i] = 3;
+
+  // shrinking clears the dropped elements sharing the last byte
+  bv.resize(5);
+  bv.resize(9);
+  for (uint64_t i = 0; i < 5; ++i)
+    ASSERT_EQ(3, bv[i]);
+  for (uint64_t i = 5; i < 9; ++i)
+    ASSERT_EQ(0, bv[i]);
+}
+
+TEST(BitVector, EncodeDecode) {
+  BitVector<2> bv;
+  bv.resize(1023);
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    bv[i] = rand() % 4;
+
+  bufferlist bl;
+  ::encode(bv, bl);
+  ASSERT_EQ(BitVector<2>::get_header_length() + BitVector<2>::byte_length(1023),
+	    bl.length());
+
+  BitVector<2> bv2;
+  bufferlist::iterator it = bl.begin();
+  ::decode(bv2, it);
+  ASSERT_TRUE(bv == bv2);
+}
+
+TEST(BitVector, PartialDecode) {
+  BitVector<2> bv;
+  bv.resize(100);
+  for (uint64_t i = 0; i < bv.size(); ++i)
+    bv[i] = 1;
+
+  bufferlist bl;
+  ::encode(bv, bl);
+
+  // rewrite elements 10..29 in place, as the rbd class does
+  uint64_t byte_offset, byte_len;
+  BitVector<2>::get_data_extents(10, 20, &byte_offset, &byte_len);
+  ASSERT_EQ(2U, byte_offset);
+  ASSERT_EQ(6U, byte_len);
+
+  bufferlist header_bl;
+  header_bl.substr_of(bl, 0, BitVector<2>::get_header_length());
+  BitVector<2> partial;
+  bufferlist::iterator it = header_bl.begin();
+  partial.decode_header(it);
+  ASSERT_EQ(100U, partial.size());
+
+  bufferlist data_bl;
+  data_bl.substr_of(bl, BitVector<2>::get_header_length() + byte_offset,
+		    byte_len);
+  it = data_bl.begin();
+  partial.decode_data(it, byte_offset, byte_len);
+  for (uint64_t i = 10; i < 30; ++i) {
+    ASSERT_EQ(1, partial[i]);
+    partial[i] = 2;
+  }
+
+  bufferlist update_bl;
+  partial.encode_data(update_bl, byte_offset, byte_len);
+  bufferlist new_bl;
+  new_bl.substr_of(bl, 0, BitVector<2>::get_header_length() + byte_offset);
+  new_bl.append(update_bl);
+  bufferlist tail;
+  uint64_t tail_off = BitVector<2>::get_header_length() + byte_offset + byte_len;
+  tail.substr_of(bl, tail_off, bl.length() - tail_off);
+  new_bl.append(tail);
+
+  BitVector<2> result;
+  it = new_bl.begin();
+  ::decode(result, it);
+  for (uint64_t i = 0; i < result.size(); ++i)
+    ASSERT_EQ((i >= 10 && i < 30) ? 2 : 1, result[i]);
+}
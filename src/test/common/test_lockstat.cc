@@ -0,0 +1,107 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <unistd.h>
+#include <sstream>
+#include <gtest/gtest.h>
+
+#include "common/Formatter.h"
+#include "common/Mutex.h"
+#include "common/RWLock.h"
+#include "common/Thread.h"
+#include "common/lockstat.h"
+
+static std::string dump()
+{
+  JSONFormatter f;
+  lockstat_dump(&f);
+  std::ostringstream ss;
+  f.flush(ss);
+  return ss.str();
+}
+
+class Holder : public Thread {
+public:
+  Mutex &m;
+  Holder(Mutex &_m) : m(_m) {}
+  void *entry() {
+    m.Lock();
+    usleep(100000);
+    m.Unlock();
+    return NULL;
+  }
+};
+
+TEST(lockstat, Disabled) {
+  g_lockstat = 0;
+  Mutex m("test_lockstat::disabled");
+  m.Lock();
+  m.Unlock();
+  ASSERT_EQ(std::string::npos, dump().find("test_lockstat::disabled"));
+}
+
+TEST(lockstat, Hold) {
+  g_lockstat = 1;
+  Mutex m("test_lockstat::hold");
+  m.Lock();
+  m.Unlock();
+  m.Lock();
+  m.Unlock();
+  g_lockstat = 0;
+  ASSERT_NE(std::string::npos,
+	    dump().find("\"name\":\"test_lockstat::hold\","
+			"\"acquired\":2,\"contended\":0,"));
+}
+
+TEST(lockstat, Contended) {
+  g_lockstat = 1;
+  g_lockstat_backtrace_sample = 1;
+  Mutex m("test_lockstat::contended");
+  Holder h(m);
+  h.create();
+  usleep(10000);
+  m.Lock();
+  m.Unlock();
+  h.join();
+  g_lockstat = 0;
+  g_lockstat_backtrace_sample = 0;
+  std::string s = dump();
+  ASSERT_NE(std::string::npos,
+	    s.find("\"name\":\"test_lockstat::contended\","
+		   "\"acquired\":2,\"contended\":1,\"contended_write\":1,"));
+  ASSERT_NE(std::string::npos, s.find("\"backtraces\":[{\"count\":1,"));
+}
+
+TEST(lockstat, RWLock) {
+  g_lockstat = 1;
+  RWLock l("test_lockstat::rwlock");
+  l.get_read();
+  l.unlock();
+  l.get_write();
+  l.unlock();
+  g_lockstat = 0;
+  // only write holds are timed
+  ASSERT_NE(std::string::npos,
+	    dump().find("\"name\":\"test_lockstat::rwlock\","
+			"\"acquired\":1,\"contended\":0,"));
+}
+
+TEST(lockstat, Reset) {
+  g_lockstat = 1;
+  Mutex m("test_lockstat::reset");
+  m.Lock();
+  m.Unlock();
+  g_lockstat = 0;
+  ASSERT_NE(std::string::npos, dump().find("test_lockstat::reset"));
+  lockstat_reset();
+  ASSERT_EQ(std::string::npos, dump().find("test_lockstat::reset"));
+}
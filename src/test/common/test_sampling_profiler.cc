@@ -0,0 +1,71 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <errno.h>
+#include <sys/time.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/profile_tag.h"
+#include "perfglue/sampling_profiler.h"
+
+// keep a CPU busy so ITIMER_PROF fires
+static void spin(int ms)
+{
+  struct timeval start, now;
+  gettimeofday(&start, NULL);
+  volatile unsigned x = 0;
+  do {
+    for (int i = 0; i < 100000; ++i)
+      x += i;
+    gettimeofday(&now, NULL);
+  } while ((now.tv_sec - start.tv_sec) * 1000 +
+	   (now.tv_usec - start.tv_usec) / 1000 < ms);
+}
+
+TEST(SamplingProfiler, StartStop) {
+  ASSERT_FALSE(sampling_profiler_running());
+  ASSERT_EQ(-EINVAL, sampling_profiler_start(0, 100));
+  ASSERT_EQ(0, sampling_profiler_start(1000, 10000));
+  ASSERT_TRUE(sampling_profiler_running());
+  ASSERT_EQ(-EBUSY, sampling_profiler_start(1000, 10000));
+  sampling_profiler_stop();
+  ASSERT_FALSE(sampling_profiler_running());
+  sampling_profiler_reset();
+}
+
+TEST(SamplingProfiler, CollectsSamples) {
+  profile_tag_set_wq("test_wq");
+  ASSERT_EQ(0, sampling_profiler_start(1000, 10000));
+  spin(500);
+  sampling_profiler_stop();
+  profile_tag_set_wq(NULL);
+
+  std::ostringstream out;
+  int n = sampling_profiler_dump(out);
+  ASSERT_GT(n, 0);
+  // samples are attributed to the work queue the thread was serving
+  ASSERT_NE(std::string::npos, out.str().find("[test_wq];"));
+
+  std::vector<std::string> cmd;
+  cmd.push_back("sampling_profiler");
+  cmd.push_back("status");
+  std::ostringstream status;
+  sampling_profiler_handle_command(cmd, 10000, status);
+  ASSERT_EQ(0u, status.str().find("sampling_profiler not running"));
+
+  sampling_profiler_reset();
+  std::ostringstream empty;
+  ASSERT_EQ(0, sampling_profiler_dump(empty));
+}
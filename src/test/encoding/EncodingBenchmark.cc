@@ -0,0 +1,142 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Compare the field-by-field bufferlist encoders with the contiguous
+ * ones in include/denc.h for the hot OSD types.
+ *
+ *   ceph_perf_encoding [iterations]
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <iostream>
+
+#include "common/Cycles.h"
+#include "include/denc.h"
+#include "osd/osd_types.h"
+#include "test/encoding/legacy_encoding.h"
+
+using namespace std;
+
+struct Result {
+  const char *name;
+  uint64_t legacy, denc;
+};
+
+static void report(const Result& r, int iterations)
+{
+  uint64_t l = Cycles::to_nanoseconds(r.legacy) / iterations;
+  uint64_t d = Cycles::to_nanoseconds(r.denc) / iterations;
+  cout << r.name << ": legacy " << l << " ns, denc " << d << " ns";
+  if (d)
+    cout << " (" << (double)l / (double)d << "x)";
+  cout << std::endl;
+}
+
+static pg_log_entry_t make_entry()
+{
+  hobject_t oid(object_t("rbd_data.1234567890ab.0000000000000042"), "",
+		CEPH_NOSNAP, 0x4f2a13c1, 3, "");
+  pg_log_entry_t e(pg_log_entry_t::MODIFY, oid, eversion_t(12, 3456),
+		   eversion_t(12, 3455), 3456,
+		   osd_reqid_t(entity_name_t::CLIENT(4123), 0, 987654),
+		   utime_t(1418000000, 123456789));
+  e.mod_desc.append(4194304);
+  return e;
+}
+
+// fragmented like a message payload: the entry straddles segments
+static bufferlist fragment(bufferlist bl, unsigned seg)
+{
+  bufferlist out;
+  for (unsigned off = 0; off < bl.length(); off += seg) {
+    unsigned len = MIN(seg, bl.length() - off);
+    out.append(bufferptr(bl.c_str() + off, len));
+  }
+  return out;
+}
+
+template<class E, class D>
+static Result bench_encode(const char *name, const E& e, D legacy_enc,
+			   int iterations)
+{
+  Result r = { name, 0, 0 };
+  for (int i = 0; i < iterations; ++i) {
+    bufferlist a, b;
+    uint64_t start = Cycles::rdtsc();
+    legacy_enc(e, a);
+    r.legacy += Cycles::rdtsc() - start;
+    start = Cycles::rdtsc();
+    ::encode(e, b);
+    r.denc += Cycles::rdtsc() - start;
+  }
+  return r;
+}
+
+static void legacy_encode_entry(const pg_log_entry_t& e, bufferlist& bl)
+{
+  legacy::encode(e, bl);
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = 1000000;
+  if (argc > 1)
+    iterations = atoi(argv[1]);
+  if (iterations <= 0) {
+    cerr << "usage: " << argv[0] << " [iterations]" << std::endl;
+    return 1;
+  }
+  Cycles::init();
+
+  pg_log_entry_t e = make_entry();
+  report(bench_encode("pg_log_entry_t encode", e, legacy_encode_entry,
+		      iterations), iterations);
+
+  bufferlist bl;
+  ::encode(e, bl);
+  bufferlist frags[] = { bl, fragment(bl, 16) };
+  const char *names[] = { "pg_log_entry_t decode (contiguous)",
+			  "pg_log_entry_t decode (16 byte segments)" };
+  for (unsigned f = 0; f < 2; ++f) {
+    Result r = { names[f], 0, 0 };
+    for (int i = 0; i < iterations; ++i) {
+      pg_log_entry_t a, b;
+      bufferlist::iterator p = frags[f].begin();
+      uint64_t start = Cycles::rdtsc();
+      legacy::decode(a, p);
+      r.legacy += Cycles::rdtsc() - start;
+      p = frags[f].begin();
+      start = Cycles::rdtsc();
+      ::decode(b, p);
+      r.denc += Cycles::rdtsc() - start;
+    }
+    report(r, iterations);
+  }
+
+  vector<OSDOp> ops(4);
+  for (unsigned i = 0; i < ops.size(); ++i)
+    ops[i].op.op = CEPH_OSD_OP_WRITE;
+  Result r = { "OSDOp vector(4) encode", 0, 0 };
+  for (int i = 0; i < iterations; ++i) {
+    bufferlist a, b;
+    uint64_t start = Cycles::rdtsc();
+    legacy::encode_ops(ops, a);
+    r.legacy += Cycles::rdtsc() - start;
+    start = Cycles::rdtsc();
+    OSDOp::encode_osd_op_vector_nohead(ops, b);
+    r.denc += Cycles::rdtsc() - start;
+  }
+  report(r, iterations);
+  return 0;
+}
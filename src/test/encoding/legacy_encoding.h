@@ -0,0 +1,133 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+#ifndef CEPH_TEST_ENCODING_LEGACY_ENCODING_H
+#define CEPH_TEST_ENCODING_LEGACY_ENCODING_H
+
+/*
+ * Field-by-field bufferlist encoders for the types ported to denc.h,
+ * as they were before the port.  The tests check that the contiguous
+ * encoders produce the same bytes; the benchmark compares the two.
+ */
+
+#include "include/encoding.h"
+#include "osd/osd_types.h"
+
+namespace legacy {
+
+inline void encode(const hobject_t& o, bufferlist& bl)
+{
+  ENCODE_START(4, 3, bl);
+  ::encode(o.get_key(), bl);
+  ::encode(o.oid, bl);
+  ::encode(o.snap, bl);
+  ::encode(o.hash, bl);
+  ::encode(o.is_max(), bl);
+  ::encode(o.nspace, bl);
+  ::encode(o.pool, bl);
+  ENCODE_FINISH(bl);
+}
+
+inline void decode(hobject_t& o, bufferlist::iterator& bl)
+{
+  DECODE_START_LEGACY_COMPAT_LEN(4, 3, 3, bl);
+  string key, nspace;
+  object_t oid;
+  snapid_t snap;
+  uint32_t hash;
+  bool max;
+  int64_t pool;
+  ::decode(key, bl);
+  ::decode(oid, bl);
+  ::decode(snap, bl);
+  ::decode(hash, bl);
+  ::decode(max, bl);
+  ::decode(nspace, bl);
+  ::decode(pool, bl);
+  o = max ? hobject_t::get_max() : hobject_t(oid, key, snap, hash, pool, nspace);
+  DECODE_FINISH(bl);
+}
+
+inline void encode(const osd_reqid_t& o, bufferlist& bl)
+{
+  ENCODE_START(2, 2, bl);
+  ::encode(o.name, bl);
+  ::encode(o.tid, bl);
+  ::encode(o.inc, bl);
+  ENCODE_FINISH(bl);
+}
+
+inline void decode(osd_reqid_t& o, bufferlist::iterator& bl)
+{
+  DECODE_START_LEGACY_COMPAT_LEN(2, 2, 2, bl);
+  ::decode(o.name, bl);
+  ::decode(o.tid, bl);
+  ::decode(o.inc, bl);
+  DECODE_FINISH(bl);
+}
+
+/// struct_v 8 drops mod_desc, as written by pre-firefly OSDs
+inline void encode(const pg_log_entry_t& e, bufferlist& bl, __u8 v = 9)
+{
+  ENCODE_START(v, 4, bl);
+  ::encode(e.op, bl);
+  legacy::encode(e.soid, bl);
+  ::encode(e.version, bl);
+  if (e.op == pg_log_entry_t::LOST_REVERT)
+    ::encode(e.reverting_to, bl);
+  else
+    ::encode(e.prior_version, bl);
+  legacy::encode(e.reqid, bl);
+  ::encode(e.mtime, bl);
+  if (e.op == pg_log_entry_t::LOST_REVERT)
+    ::encode(e.prior_version, bl);
+  ::encode(e.snaps, bl);
+  ::encode(e.user_version, bl);
+  if (v >= 9) {
+    // ObjectModDesc v1: can_local_rollback, rollback_info_completed, bl
+    ENCODE_START(1, 1, bl);
+    ::encode(e.mod_desc.can_rollback(), bl);
+    ::encode(false, bl);
+    ::encode(e.mod_desc.bl, bl);
+    ENCODE_FINISH(bl);
+  }
+  ENCODE_FINISH(bl);
+}
+
+inline void decode(pg_log_entry_t& e, bufferlist::iterator& bl)
+{
+  DECODE_START_LEGACY_COMPAT_LEN(9, 4, 4, bl);
+  ::decode(e.op, bl);
+  legacy::decode(e.soid, bl);
+  ::decode(e.version, bl);
+  if (e.op == pg_log_entry_t::LOST_REVERT)
+    ::decode(e.reverting_to, bl);
+  else
+    ::decode(e.prior_version, bl);
+  legacy::decode(e.reqid, bl);
+  ::decode(e.mtime, bl);
+  if (e.op == pg_log_entry_t::LOST_REVERT)
+    ::decode(e.prior_version, bl);
+  ::decode(e.snaps, bl);
+  ::decode(e.user_version, bl);
+  ::decode(e.mod_desc, bl);
+  DECODE_FINISH(bl);
+}
+
+inline void encode_ops(const vector<OSDOp>& ops, bufferlist& bl)
+{
+  for (unsigned i = 0; i < ops.size(); i++)
+    ::encode(ops[i].op, bl);
+}
+
+}
+
+#endif
@@ -0,0 +1,222 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "include/denc.h"
+#include "osd/osd_types.h"
+#include "test/encoding/legacy_encoding.h"
+
+// split bl into one-byte segments so nothing is contiguous
+static bufferlist fragment(bufferlist bl)
+{
+  bufferlist out;
+  for (unsigned i = 0; i < bl.length(); ++i)
+    out.append(bufferptr(bl.c_str() + i, 1));
+  return out;
+}
+
+static pg_log_entry_t make_entry(int op)
+{
+  hobject_t oid(object_t("objname"), "key", 123, 456, 7, "ns");
+  pg_log_entry_t e(op, oid, eversion_t(1,2), eversion_t(3,4), 5,
+		   osd_reqid_t(entity_name_t::CLIENT(777), 8, 999),
+		   utime_t(8,9));
+  if (op == pg_log_entry_t::LOST_REVERT)
+    e.reverting_to = eversion_t(1,1);
+  vector<snapid_t> snaps;
+  snaps.push_back(3);
+  snaps.push_back(1);
+  ::encode(snaps, e.snaps);
+  e.mod_desc.append(4096);
+  return e;
+}
+
+static void assert_same(const pg_log_entry_t& a, const pg_log_entry_t& b)
+{
+  bufferlist ba, bb;
+  legacy::encode(a, ba);
+  legacy::encode(b, bb);
+  ASSERT_TRUE(ba.contents_equal(bb));
+}
+
+TEST(denc, ContiguousSpace) {
+  bufferlist bl;
+  bl.append("abc", 3);
+  char *p = bl.obtain_contiguous_space(10000);
+  memcpy(p, "defg", 4);
+  bl.commit_contiguous_space(4);
+  bl.append("h", 1);
+  ASSERT_EQ(8u, bl.length());
+  ASSERT_EQ(0, memcmp(bl.c_str(), "abcdefgh", 8));
+}
+
+TEST(denc, GetContiguous) {
+  bufferlist bl;
+  bl.append("abcd", 4);
+  bl.append(bufferptr("efgh", 4));
+  bufferlist::iterator p = bl.begin();
+  bufferptr a = p.get_contiguous(3);
+  ASSERT_EQ(bl.buffers().front().get_raw(), a.get_raw());  // zero-copy
+  bufferptr b = p.get_contiguous(3);
+  ASSERT_EQ(0, memcmp(b.c_str(), "def", 3));
+  ASSERT_EQ(6u, p.get_off());
+  ASSERT_THROW(p.get_contiguous(3), buffer::end_of_buffer);
+}
+
+TEST(denc, Header) {
+  // DENC_START/DENC_FINISH must match ENCODE_START/ENCODE_FINISH
+  ObjectModDesc d;
+  bufferlist bl;
+  ::encode(d, bl);
+  const char expected[] = { 1, 1, 6, 0, 0, 0, 1, 0, 0, 0, 0, 0 };
+  ASSERT_EQ(sizeof(expected), bl.length());
+  ASSERT_EQ(0, memcmp(expected, bl.c_str(), sizeof(expected)));
+
+  object_locator_t oloc(1, 2);   // hash set: compat bumped to 6
+  bufferlist a;
+  ::encode(oloc, a);
+  ASSERT_EQ(6, a[1]);
+  bufferlist::iterator i = a.begin();
+  contiguous_decoder p(i, a.length());
+  object_locator_t out;
+  ::decode(out, p);
+  ASSERT_EQ(0u, p.get_remaining());
+  ASSERT_EQ(oloc, out);
+}
+
+TEST(denc, SameBytes) {
+  list<hobject_t*> hs;
+  hobject_t::generate_test_instances(hs);
+  for (list<hobject_t*>::iterator i = hs.begin(); i != hs.end(); ++i) {
+    bufferlist a, b;
+    ::encode(**i, a);
+    legacy::encode(**i, b);
+    ASSERT_TRUE(a.contents_equal(b));
+    delete *i;
+  }
+
+  osd_reqid_t r(entity_name_t::CLIENT(1), 2, 3);
+  bufferlist ra, rb;
+  ::encode(r, ra);
+  legacy::encode(r, rb);
+  ASSERT_TRUE(ra.contents_equal(rb));
+
+  int ops[] = { pg_log_entry_t::MODIFY, pg_log_entry_t::DELETE,
+		pg_log_entry_t::LOST_REVERT };
+  for (unsigned i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+    pg_log_entry_t e = make_entry(ops[i]);
+    bufferlist a, b;
+    ::encode(e, a);
+    legacy::encode(e, b);
+    ASSERT_TRUE(a.contents_equal(b));
+  }
+}
+
+TEST(denc, RoundTrip) {
+  pg_log_entry_t e = make_entry(pg_log_entry_t::LOST_REVERT);
+  bufferlist bl;
+  ::encode(e, bl);
+  bl.append("tail", 4);
+
+  // contiguous and fragmented input decode the same and stop at the end
+  bufferlist frag = fragment(bl);
+  bufferlist *inputs[] = { &bl, &frag };
+  for (unsigned i = 0; i < 2; ++i) {
+    pg_log_entry_t d;
+    bufferlist::iterator p = inputs[i]->begin();
+    ::decode(d, p);
+    ASSERT_EQ(bl.length() - 4, p.get_off());
+    assert_same(e, d);
+    ASSERT_EQ(e.reverting_to, d.reverting_to);
+  }
+
+  list<object_info_t*> ois;
+  object_info_t::generate_test_instances(ois);
+  for (list<object_info_t*>::iterator i = ois.begin(); i != ois.end(); ++i) {
+    bufferlist a, b;
+    ::encode(**i, a);
+    bufferlist f = fragment(a);
+    bufferlist::iterator p = f.begin();
+    object_info_t d;
+    ::decode(d, p);
+    ::encode(d, b);
+    ASSERT_TRUE(a.contents_equal(b));
+    delete *i;
+  }
+}
+
+TEST(denc, LegacyFallback) {
+  // struct_v 8 predates mod_desc and must take the slow path
+  pg_log_entry_t e = make_entry(pg_log_entry_t::MODIFY);
+  bufferlist bl;
+  legacy::encode(e, bl, 8);
+  bufferlist::iterator p = bl.begin();
+  pg_log_entry_t d;
+  ::decode(d, p);
+  ASSERT_TRUE(p.end());
+  ASSERT_EQ(e.soid, d.soid);
+  ASSERT_EQ(e.reqid, d.reqid);
+  ASSERT_FALSE(d.mod_desc.can_rollback());
+}
+
+TEST(denc, Truncated) {
+  pg_log_entry_t e = make_entry(pg_log_entry_t::MODIFY);
+  bufferlist bl, t;
+  ::encode(e, bl);
+  t.substr_of(bl, 0, bl.length() - 1);
+  bufferlist::iterator p = t.begin();
+  pg_log_entry_t d;
+  ASSERT_THROW(::decode(d, p), buffer::error);
+}
+
+TEST(denc, BogusLength) {
+  // a struct claiming more bytes than the message holds is rejected
+  // before anything is allocated for it
+  pg_log_entry_t e = make_entry(pg_log_entry_t::MODIFY);
+  bufferlist bl;
+  ::encode(e, bl);
+  ceph_le32 len;
+  len = 0xfffffff0;
+  bufferlist patched;
+  patched.append(bl.c_str(), 2);
+  patched.append((char *)&len, sizeof(len));
+  patched.append(bl.c_str() + DENC_HEADER_LEN, bl.length() - DENC_HEADER_LEN);
+  bufferlist::iterator p = patched.begin();
+  ASSERT_THROW(denc_struct_len(p, 1), buffer::end_of_buffer);
+  bufferlist frag = fragment(patched);
+  bufferlist::iterator f = frag.begin();
+  pg_log_entry_t d;
+  ASSERT_THROW(::decode(d, f), buffer::error);
+}
+
+TEST(denc, AppenderOverflow) {
+  bufferlist bl;
+  contiguous_appender *a = new contiguous_appender(bl, 4);
+  a->append("abcd", 4);
+  ASSERT_DEATH(a->append("e", 1), "");
+  delete a;
+  ASSERT_EQ(4u, bl.length());
+}
+
+TEST(denc, OSDOpVector) {
+  vector<OSDOp> ops(3);
+  for (unsigned i = 0; i < ops.size(); ++i) {
+    ops[i].op.op = CEPH_OSD_OP_WRITE;
+    ops[i].op.extent.offset = i * 4096;
+    ops[i].op.extent.length = 4096;
+  }
+  bufferlist a, b;
+  OSDOp::encode_osd_op_vector_nohead(ops, a);
+  legacy::encode_ops(ops, b);
+  ASSERT_TRUE(a.contents_equal(b));
+}
@@ -8,6 +8,9 @@ TYPE(filepath)
 TYPE(bloom_filter)
 TYPE(compressible_bloom_filter)
 
+#include "common/bit_vector.hpp"
+TYPE(ceph::BitVector<2>)
+
 #include "common/snap_types.h"
 TYPE(SnapContext)
 TYPE(SnapRealmInfo)
@@ -64,6 +67,8 @@ TYPE(pg_missing_t::item)
 TYPE(pg_missing_t)
 TYPE(pg_ls_response_t)
 TYPE(pg_nls_response_t)
+TYPE(pg_nls_filter_t)
+TYPE(pg_nls_object_info_t)
 TYPE(object_copy_cursor_t)
 TYPE(object_copy_data_t)
 TYPE(pg_create_t)
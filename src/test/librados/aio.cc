@@ -362,6 +362,46 @@ TEST(LibRadosAio, RoundTrip2) {
   rados_aio_release(my_completion2);
 }
 
+TEST(LibRadosAio, RoundTripIOVec) {
+  AioTestData test_data;
+  rados_completion_t my_completion;
+  ASSERT_EQ("", test_data.init());
+  ASSERT_EQ(0, rados_aio_create_completion((void*)&test_data,
+	      set_completion_complete, set_completion_safe, &my_completion));
+  char buf[128], buf2[64];
+  memset(buf, 0xcc, sizeof(buf));
+  memset(buf2, 0xdd, sizeof(buf2));
+  struct iovec iov[2] = { { buf, sizeof(buf) }, { buf2, sizeof(buf2) } };
+  ASSERT_EQ(0, rados_aio_writev(test_data.m_ioctx, "foo",
+				my_completion, iov, 2, 0));
+  {
+    TestAlarm alarm;
+    sem_wait(&test_data.m_sem);
+    sem_wait(&test_data.m_sem);
+  }
+  ASSERT_EQ(0, rados_aio_get_return_value(my_completion));
+  char rbuf[64], rbuf2[128];
+  memset(rbuf, 0, sizeof(rbuf));
+  memset(rbuf2, 0, sizeof(rbuf2));
+  struct iovec riov[2] = { { rbuf, sizeof(rbuf) }, { rbuf2, sizeof(rbuf2) } };
+  rados_completion_t my_completion2;
+  ASSERT_EQ(0, rados_aio_create_completion((void*)&test_data,
+	      set_completion_complete, set_completion_safe, &my_completion2));
+  ASSERT_EQ(0, rados_aio_readv(test_data.m_ioctx, "foo",
+			       my_completion2, riov, 2, 0));
+  {
+    TestAlarm alarm;
+    ASSERT_EQ(0, rados_aio_wait_for_complete(my_completion2));
+  }
+  ASSERT_EQ((int)(sizeof(buf) + sizeof(buf2)),
+	    rados_aio_get_return_value(my_completion2));
+  ASSERT_EQ(0, memcmp(buf, rbuf, sizeof(rbuf)));
+  ASSERT_EQ(0, memcmp(buf + sizeof(rbuf), rbuf2, sizeof(buf) - sizeof(rbuf)));
+  ASSERT_EQ(0, memcmp(buf2, rbuf2 + sizeof(buf) - sizeof(rbuf), sizeof(buf2)));
+  rados_aio_release(my_completion);
+  rados_aio_release(my_completion2);
+}
+
 TEST(LibRadosAio, RoundTripPP) {
   AioTestDataPP test_data;
   ASSERT_EQ("", test_data.init());
@@ -119,6 +119,82 @@ TEST(LibRadosCWriteOps, Write) {
   ASSERT_EQ(0, destroy_one_pool(pool_name, &cluster));
 }
 
+TEST(LibRadosCWriteOps, CmpExt) {
+  rados_t cluster;
+  rados_ioctx_t ioctx;
+  std::string pool_name = get_temp_pool_name();
+  ASSERT_EQ("", create_one_pool(pool_name, &cluster));
+  rados_ioctx_create(cluster, pool_name.c_str(), &ioctx);
+
+  ASSERT_EQ(0, rados_write(ioctx, "test", "four", 4, 0));
+
+  // matching compare lets the write through
+  rados_write_op_t op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  int val = 1;
+  rados_write_op_cmpext(op, "four", 4, 0, &val);
+  rados_write_op_write(op, "five", 4, 0);
+  ASSERT_EQ(0, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  ASSERT_EQ(0, val);
+  rados_release_write_op(op);
+
+  // a mismatch reports its offset and writes nothing
+  op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  rados_write_op_cmpext(op, "fivx", 4, 0, NULL);
+  rados_write_op_write(op, "six!", 4, 0);
+  ASSERT_EQ(-4095 - 3, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  rados_release_write_op(op);
+  char buf[4];
+  ASSERT_EQ(4, rados_read(ioctx, "test", buf, 4, 0));
+  ASSERT_EQ(0, memcmp("five", buf, 4));
+
+  // past the end of the object compares as zeros
+  op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  rados_write_op_cmpext(op, "e\0\0", 3, 3, NULL);
+  ASSERT_EQ(0, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  rados_release_write_op(op);
+
+  rados_ioctx_destroy(ioctx);
+  ASSERT_EQ(0, destroy_one_pool(pool_name, &cluster));
+}
+
+TEST(LibRadosCWriteOps, WriteSame) {
+  rados_t cluster;
+  rados_ioctx_t ioctx;
+  std::string pool_name = get_temp_pool_name();
+  ASSERT_EQ("", create_one_pool(pool_name, &cluster));
+  rados_ioctx_create(cluster, pool_name.c_str(), &ioctx);
+
+  rados_write_op_t op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  rados_write_op_writesame(op, "abc", 3, 10, 2);
+  ASSERT_EQ(0, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  rados_release_write_op(op);
+
+  char buf[16];
+  ASSERT_EQ(12, rados_read(ioctx, "test", buf, sizeof(buf), 0));
+  ASSERT_EQ(0, memcmp("\0\0abcabcabca", buf, 12));
+
+  // the pattern can't be empty
+  op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  rados_write_op_writesame(op, "", 0, 10, 0);
+  ASSERT_EQ(-EINVAL, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  rados_release_write_op(op);
+
+  // nor expand to more than an OSD accepts in one write
+  op = rados_create_write_op();
+  ASSERT_TRUE(op);
+  rados_write_op_writesame(op, "abc", 3, 1ull << 30, 0);
+  ASSERT_EQ(-EFBIG, rados_write_op_operate(op, ioctx, "test", NULL, 0));
+  rados_release_write_op(op);
+
+  rados_ioctx_destroy(ioctx);
+  ASSERT_EQ(0, destroy_one_pool(pool_name, &cluster));
+}
+
 TEST(LibRadosCWriteOps, Exec) {
   rados_t cluster;
   rados_ioctx_t ioctx;
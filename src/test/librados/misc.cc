@@ -468,6 +468,52 @@ TEST_F(LibRadosMiscPP, AioOperatePP) {
   ASSERT_EQ(1024U, size);
 }
 
+TEST_F(LibRadosMiscPP, OperateBatchPP) {
+  const int num = 100;
+  std::vector<ObjectWriteOperation*> writes;
+  std::vector<std::pair<std::string, ObjectOperation*> > ops;
+  for (int i = 0; i < num; ++i) {
+    ObjectWriteOperation *o = new ObjectWriteOperation;
+    bufferlist bl;
+    bl.append(std::string(i + 1, 'x'));
+    o->write_full(bl);
+    writes.push_back(o);
+    ops.push_back(std::make_pair("obj" + stringify(i), (ObjectOperation*)o));
+  }
+  std::vector<int> results;
+  ASSERT_EQ(0, ioctx.operate_batch(ops, &results));
+  ASSERT_EQ((size_t)num, results.size());
+  for (int i = 0; i < num; ++i)
+    ASSERT_EQ(0, results[i]);
+
+  // a missing object fails on its own
+  std::vector<ObjectReadOperation*> reads;
+  std::vector<uint64_t> sizes(num + 1);
+  std::vector<int> rvals(num + 1);
+  ops.clear();
+  for (int i = 0; i <= num; ++i) {
+    ObjectReadOperation *o = new ObjectReadOperation;
+    o->stat(&sizes[i], NULL, &rvals[i]);
+    reads.push_back(o);
+    ops.push_back(std::make_pair("obj" + stringify(i), (ObjectOperation*)o));
+  }
+  AioCompletion *c = cluster.aio_create_completion();
+  ASSERT_EQ(0, ioctx.aio_operate_batch(ops, c, &results));
+  ASSERT_EQ(0, c->wait_for_complete());
+  ASSERT_EQ(0, c->get_return_value());
+  c->release();
+  for (int i = 0; i < num; ++i) {
+    ASSERT_EQ(0, results[i]);
+    ASSERT_EQ((uint64_t)i + 1, sizes[i]);
+  }
+  ASSERT_EQ(-ENOENT, results[num]);
+
+  for (int i = 0; i < num; ++i)
+    delete writes[i];
+  for (int i = 0; i <= num; ++i)
+    delete reads[i];
+}
+
 TEST_F(LibRadosMiscPP, CloneRangePP) {
   char buf[64];
   memset(buf, 0xcc, sizeof(buf));
@@ -687,3 +687,139 @@ TEST_F(LibRadosListECPP, ListObjectsStartPP) {
     ++p;
   }
 }
+
+TEST_F(LibRadosListPP, ObjectListPP) {
+  bufferlist bl;
+  bl.append("foo");
+  std::set<std::string> expected;
+  for (int i=0; i<256; ++i) {
+    ASSERT_EQ(0, ioctx.write(stringify(i), bl, bl.length(), 0));
+    expected.insert(stringify(i));
+  }
+
+  std::set<std::string> seen;
+  ObjectCursor c = ioctx.object_list_begin();
+  ObjectCursor end = ioctx.object_list_end();
+  while (!ioctx.object_list_is_end(c)) {
+    std::vector<ObjectItem> result;
+    ObjectCursor next;
+    ASSERT_EQ(0, ioctx.object_list(c, end, 12, &result, &next));
+    ASSERT_GE(12u, result.size());
+    for (std::vector<ObjectItem>::iterator p = result.begin();
+	 p != result.end(); ++p) {
+      ASSERT_TRUE(seen.insert(p->oid).second);
+    }
+    ASSERT_TRUE(c < next || ioctx.object_list_is_end(next));
+
+    // resuming from a saved cursor gets the same place
+    ObjectCursor saved;
+    ASSERT_TRUE(saved.from_str(next.to_str()));
+    ASSERT_TRUE(saved == next);
+    c = saved;
+  }
+  ASSERT_EQ(expected, seen);
+}
+
+TEST_F(LibRadosListPP, ObjectListSlicePP) {
+  bufferlist bl;
+  bl.append("foo");
+  std::set<std::string> expected;
+  for (int i=0; i<256; ++i) {
+    ASSERT_EQ(0, ioctx.write(stringify(i), bl, bl.length(), 0));
+    expected.insert(stringify(i));
+  }
+
+  const size_t m = 5;
+  std::set<std::string> seen;
+  ObjectCursor begin = ioctx.object_list_begin();
+  ObjectCursor end = ioctx.object_list_end();
+  ObjectCursor last_finish = begin;
+  for (size_t n = 0; n < m; ++n) {
+    ObjectCursor start, finish;
+    ASSERT_EQ(0, ioctx.object_list_slice(begin, end, n, m, &start, &finish));
+    // the slices are contiguous
+    ASSERT_TRUE(start == last_finish);
+    last_finish = finish;
+
+    while (start != finish) {
+      std::vector<ObjectItem> result;
+      ASSERT_EQ(0, ioctx.object_list(start, finish, 100, &result, &start));
+      for (std::vector<ObjectItem>::iterator p = result.begin();
+	   p != result.end(); ++p) {
+	ASSERT_TRUE(seen.insert(p->oid).second);
+      }
+    }
+  }
+  ASSERT_TRUE(ioctx.object_list_is_end(last_finish));
+  ASSERT_EQ(expected, seen);
+}
+
+TEST_F(LibRadosList, ObjectList) {
+  char buf[128];
+  memset(buf, 0xcc, sizeof(buf));
+  std::set<std::string> expected;
+  for (int i=0; i<64; ++i) {
+    ASSERT_EQ(0, rados_write(ioctx, stringify(i).c_str(), buf, sizeof(buf), 0));
+    expected.insert(stringify(i));
+  }
+
+  std::set<std::string> seen;
+  rados_object_list_cursor c = rados_object_list_begin(ioctx);
+  rados_object_list_cursor end = rados_object_list_end(ioctx);
+  while (!rados_object_list_is_end(ioctx, c)) {
+    rados_object_list_item results[10];
+    rados_object_list_cursor next;
+    int r = rados_object_list(ioctx, c, end, 10, results, &next);
+    ASSERT_LE(0, r);
+    for (int i = 0; i < r; ++i) {
+      std::string oid(results[i].oid, results[i].oid_length);
+      ASSERT_TRUE(seen.insert(oid).second);
+    }
+    rados_object_list_free(r, results);
+    rados_object_list_cursor_free(ioctx, c);
+    c = next;
+  }
+  rados_object_list_cursor_free(ioctx, c);
+  rados_object_list_cursor_free(ioctx, end);
+  ASSERT_EQ(expected, seen);
+}
+
+TEST_F(LibRadosListPP, ObjectListFilterPP) {
+  bufferlist tag;
+  tag.append("stale");
+  std::set<std::string> expected;
+  for (int i=0; i<64; ++i) {
+    bufferlist bl;
+    bl.append(std::string(i + 1, 'x'));
+    std::string oid = (i % 2 ? "a" : "b") + stringify(i);
+    ASSERT_EQ(0, ioctx.write(oid, bl, bl.length(), 0));
+    if (i % 4 == 1) {
+      ASSERT_EQ(0, ioctx.setxattr(oid, "tag", tag));
+      if (i >= 16)
+	expected.insert(oid);
+    }
+  }
+
+  ObjectListFilter filter;
+  filter.name_prefix = "a";
+  filter.min_size = 17;
+  filter.xattrs_equal["tag"] = tag;
+  filter.want_size = true;
+  filter.want_xattrs.insert("tag");
+
+  std::set<std::string> seen;
+  ObjectCursor c = ioctx.object_list_begin();
+  ObjectCursor end = ioctx.object_list_end();
+  while (!ioctx.object_list_is_end(c)) {
+    std::vector<ObjectItem> result;
+    ASSERT_EQ(0, ioctx.object_list(c, end, 10, filter, &result, &c));
+    for (std::vector<ObjectItem>::iterator p = result.begin();
+	 p != result.end(); ++p) {
+      ASSERT_TRUE(seen.insert(p->oid).second);
+      ASSERT_EQ(atoi(p->oid.c_str() + 1) + 1, (int)p->size);
+      ASSERT_EQ(1u, p->xattrs.count("tag"));
+      ASSERT_TRUE(p->xattrs["tag"].contents_equal(tag));
+    }
+  }
+  ASSERT_EQ(expected, seen);
+}
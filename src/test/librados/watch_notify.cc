@@ -85,6 +85,50 @@ TEST_P(LibRadosWatchNotifyPP, WatchNotifyTimeoutTestPP) {
   ASSERT_EQ(0, ioctx.unwatch("foo", handle));
 }
 
+class WatchNotifyReplyCtx : public WatchReplyCtx
+{
+public:
+  std::string name;
+  explicit WatchNotifyReplyCtx(const std::string& n) : name(n) {}
+  void notify(uint8_t opcode, uint64_t ver, bufferlist& bl, bufferlist *reply)
+  {
+    std::cout << __func__ << " " << name << std::endl;
+    reply->append(name);
+    sem_post(&sem);
+  }
+};
+
+TEST_P(LibRadosWatchNotifyPP, WatchNotifyReplyTestPP) {
+  ASSERT_EQ(0, sem_init(&sem, 0, 0));
+  bufferlist bl1;
+  bl1.append("foo");
+  ASSERT_EQ(0, ioctx.write("foo", bl1, bl1.length(), 0));
+
+  // two watches on the same connection share one notification
+  WatchNotifyReplyCtx ctx1("one"), ctx2("two");
+  uint64_t handle1, handle2;
+  ASSERT_EQ(0, ioctx.watch("foo", 0, &handle1, &ctx1));
+  ASSERT_EQ(0, ioctx.watch("foo", 0, &handle2, &ctx2));
+
+  bufferlist bl2;
+  std::map<std::pair<uint64_t, uint64_t>, bufferlist> replies;
+  ASSERT_EQ(0, ioctx.notify("foo", 0, bl2, &replies));
+  TestAlarm alarm;
+  sem_wait(&sem);
+  sem_wait(&sem);
+
+  uint64_t gid = Rados(ioctx).get_instance_id();
+  ASSERT_EQ(2u, replies.size());
+  bufferlist& r1 = replies[std::make_pair(gid, handle1)];
+  bufferlist& r2 = replies[std::make_pair(gid, handle2)];
+  ASSERT_EQ(std::string("one"), std::string(r1.c_str(), r1.length()));
+  ASSERT_EQ(std::string("two"), std::string(r2.c_str(), r2.length()));
+
+  ioctx.unwatch("foo", handle1);
+  ioctx.unwatch("foo", handle2);
+  sem_destroy(&sem);
+}
+
 TEST_F(LibRadosWatchNotifyEC, WatchNotifyTest) {
   ASSERT_EQ(0, sem_init(&sem, 0, 0));
   char buf[128];
@@ -442,6 +442,86 @@ TEST_F(StriperTestPP, RoundTripAppendPP) {
   my_completion3->release();
 }
 
+TEST_F(StriperTestPP, ConcurrentAppendPP) {
+  // appends reserve their range up front, so they may all be in flight
+  const int n = 16;
+  char buf[1000];
+  AioCompletion *completions[n];
+  for (int i = 0; i < n; i++) {
+    memset(buf, 'a' + i, sizeof(buf));
+    bufferlist bl;
+    bl.append(buf, sizeof(buf));
+    completions[i] = librados::Rados::aio_create_completion();
+    ASSERT_EQ(0, striper.aio_append("ConcurrentAppendPP", completions[i], bl, sizeof(buf)));
+  }
+  for (int i = 0; i < n; i++) {
+    {
+      TestAlarm alarm;
+      completions[i]->wait_for_safe();
+    }
+    ASSERT_EQ(0, completions[i]->get_return_value());
+    completions[i]->release();
+  }
+  uint64_t size;
+  time_t mtime;
+  ASSERT_EQ(0, striper.stat("ConcurrentAppendPP", &size, &mtime));
+  ASSERT_EQ(n * sizeof(buf), size);
+  bufferlist bl;
+  ASSERT_EQ((int)(n * sizeof(buf)), striper.read("ConcurrentAppendPP", &bl, n * sizeof(buf), 0));
+  for (int i = 0; i < n; i++) {
+    memset(buf, 'a' + i, sizeof(buf));
+    ASSERT_EQ(0, memcmp(bl.c_str() + i * sizeof(buf), buf, sizeof(buf)));
+  }
+}
+
+TEST_F(StriperTestPP, ConcurrentWriteSequentialReadPP) {
+  // small stripe units so that readahead spans several objects
+  ASSERT_EQ(0, striper.set_object_layout_stripe_unit(4096));
+  ASSERT_EQ(0, striper.set_object_layout_stripe_count(3));
+  ASSERT_EQ(0, striper.set_object_layout_object_size(16384));
+  const size_t size = 256 * 1024;
+  const size_t chunk = 3000;
+  bufferlist bl;
+  for (size_t i = 0; i < size; i++)
+    bl.append((char)(i % 251));
+  ASSERT_EQ(0, striper.write("ConcurrentWriteSequentialReadPP", bl, size, 0));
+  AioCompletion *my_completion = NULL;
+  for (size_t off = 0; off < size; off += chunk) {
+    size_t len = std::min(chunk, size - off);
+    // reads racing with the write may see either data
+    bool written = !my_completion || my_completion->is_complete();
+    bufferlist cl;
+    ASSERT_EQ((int)len, striper.read("ConcurrentWriteSequentialReadPP", &cl, len, off));
+    if (written) {
+      ASSERT_EQ(0, memcmp(bl.c_str() + off, cl.c_str(), len));
+    }
+    if (off == 20 * chunk) {
+      // overwrite what is being read ahead while reading on
+      char buf[64 * 1024];
+      memset(buf, 0xee, sizeof(buf));
+      bufferlist wl;
+      wl.append(buf, sizeof(buf));
+      bl.copy_in(off + chunk, sizeof(buf), wl);
+      my_completion = librados::Rados::aio_create_completion();
+      ASSERT_EQ(0, striper.aio_write("ConcurrentWriteSequentialReadPP", my_completion,
+				     wl, sizeof(buf), off + chunk));
+    }
+  }
+  {
+    TestAlarm alarm;
+    my_completion->wait_for_complete();
+  }
+  ASSERT_EQ(0, my_completion->get_return_value());
+  my_completion->release();
+  // everything read once the write completed is new data
+  for (size_t off = 0; off < size; off += chunk) {
+    size_t len = std::min(chunk, size - off);
+    bufferlist cl;
+    ASSERT_EQ((int)len, striper.read("ConcurrentWriteSequentialReadPP", &cl, len, off));
+    ASSERT_EQ(0, memcmp(bl.c_str() + off, cl.c_str(), len));
+  }
+}
+
 TEST_F(StriperTest, Flush) {
   AioTestData test_data;
   rados_completion_t my_completion;
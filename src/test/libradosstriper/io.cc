@@ -267,6 +267,60 @@ TEST_F(StriperTestPP, RemoveTestPP) {
   ASSERT_EQ(-ENOENT, striper.read("RemoveTestPP", &bl2, sizeof(buf), 0));
 }
 
+TEST_F(StriperTestPP, WriteWhileLockedPP) {
+  // small stripe units so that the write spans several rados objects
+  ASSERT_EQ(0, striper.set_object_layout_stripe_unit(4096));
+  ASSERT_EQ(0, striper.set_object_layout_stripe_count(3));
+  ASSERT_EQ(0, striper.set_object_layout_object_size(16384));
+  char buf[3 * 4096];
+  memset(buf, 0xaa, sizeof(buf));
+  bufferlist bl;
+  bl.append(buf, sizeof(buf));
+  ASSERT_EQ(0, striper.write("WriteWhileLockedPP", bl, sizeof(buf), 0));
+  // take the lock trunc and remove hold
+  std::string firstObj = "WriteWhileLockedPP.0000000000000000";
+  ASSERT_EQ(0, ioctx.lock_exclusive(firstObj, "striper.lock", "cookie", "", NULL, 0));
+  // a write to the next object set must fail without writing anything
+  ASSERT_EQ(-EBUSY, striper.write("WriteWhileLockedPP", bl, sizeof(buf), 3 * 16384));
+  uint64_t psize;
+  time_t pmtime;
+  ASSERT_EQ(-ENOENT, ioctx.stat("WriteWhileLockedPP.0000000000000003", &psize, &pmtime));
+  ASSERT_EQ(0, striper.stat("WriteWhileLockedPP", &psize, &pmtime));
+  ASSERT_EQ(sizeof(buf), psize);
+  ASSERT_EQ(0, ioctx.unlock(firstObj, "striper.lock", "cookie"));
+  ASSERT_EQ(0, striper.write("WriteWhileLockedPP", bl, sizeof(buf), 3 * 16384));
+  ASSERT_EQ(0, striper.stat("WriteWhileLockedPP", &psize, &pmtime));
+  ASSERT_EQ(3 * 16384 + sizeof(buf), psize);
+}
+
+TEST_F(StriperTestPP, SequentialReadPP) {
+  // small stripe units so that readahead spans several objects
+  ASSERT_EQ(0, striper.set_object_layout_stripe_unit(4096));
+  ASSERT_EQ(0, striper.set_object_layout_stripe_count(3));
+  ASSERT_EQ(0, striper.set_object_layout_object_size(16384));
+  const size_t size = 256 * 1024;
+  const size_t chunk = 3000;
+  bufferlist bl;
+  for (size_t i = 0; i < size; i++)
+    bl.append((char)(i % 251));
+  ASSERT_EQ(0, striper.write("SequentialReadPP", bl, size, 0));
+  for (size_t off = 0; off < size; off += chunk) {
+    size_t len = std::min(chunk, size - off);
+    bufferlist cl;
+    ASSERT_EQ((int)len, striper.read("SequentialReadPP", &cl, len, off));
+    ASSERT_EQ(0, memcmp(bl.c_str() + off, cl.c_str(), len));
+    if (off == 20 * chunk) {
+      // overwrite what was just read ahead, which must not be returned
+      char buf[chunk];
+      memset(buf, 0xee, sizeof(buf));
+      bufferlist wl;
+      wl.append(buf, sizeof(buf));
+      bl.copy_in(off + chunk, sizeof(buf), wl);
+      ASSERT_EQ(0, striper.write("SequentialReadPP", wl, sizeof(buf), off + chunk));
+    }
+  }
+}
+
 TEST_F(StriperTest, XattrsRoundTrip) {
   char buf[128];
   char attr1_buf[] = "foo bar baz";
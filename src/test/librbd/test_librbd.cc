@@ -1906,6 +1906,136 @@ TEST_F(TestLibRBD, DiffIterateRegression6926)
   ioctx.close();
 }
 
+static void write_objects(librbd::Image &image, int order,
+			  uint64_t start_object_no, uint64_t end_object_no)
+{
+  bufferlist bl;
+  bl.append(std::string(4096, '1'));
+  for (uint64_t i = start_object_no; i < end_object_no; ++i)
+    ASSERT_EQ(4096, image.write(i << order, 4096, bl));
+}
+
+static vector<diff_extent> object_extents(int order, uint64_t start_object_no,
+					  uint64_t end_object_no)
+{
+  vector<diff_extent> extents;
+  for (uint64_t i = start_object_no; i < end_object_no; ++i)
+    extents.push_back(diff_extent(i << order, 4096, true));
+  return extents;
+}
+
+TEST_F(TestLibRBD, ObjectMapRequiresExclusiveLock)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, _rados.ioctx_create(m_pool_name.c_str(), ioctx));
+
+  librbd::RBD rbd;
+  int order = 0;
+  std::string name = get_temp_image_name();
+  ASSERT_EQ(-EINVAL, rbd.create2(ioctx, name.c_str(), 2 << 20,
+				 RBD_FEATURE_LAYERING | RBD_FEATURE_OBJECT_MAP,
+				 &order));
+  ASSERT_EQ(0, rbd.create2(ioctx, name.c_str(), 2 << 20,
+			   RBD_FEATURE_LAYERING | RBD_FEATURE_EXCLUSIVE_LOCK |
+			   RBD_FEATURE_OBJECT_MAP, &order));
+  ioctx.close();
+}
+
+TEST_F(TestLibRBD, DiffIterateObjectMap)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, _rados.ioctx_create(m_pool_name.c_str(), ioctx));
+
+  librbd::RBD rbd;
+  librbd::Image image;
+  int order = 22;
+  std::string name = get_temp_image_name();
+  uint64_t size = 8 << order;
+  uint64_t features = RBD_FEATURE_LAYERING | RBD_FEATURE_EXCLUSIVE_LOCK |
+		      RBD_FEATURE_OBJECT_MAP;
+
+  ASSERT_EQ(0, rbd.create2(ioctx, name.c_str(), size, features, &order));
+  ASSERT_EQ(0, rbd.open(ioctx, image, name.c_str(), NULL));
+
+  vector<diff_extent> extents;
+  write_objects(image, order, 0, 1);
+  ASSERT_EQ(0, image.snap_create("one"));
+  write_objects(image, order, 1, 2);
+  ASSERT_EQ(0, image.snap_create("two"));
+  write_objects(image, order, 2, 3);
+
+  ASSERT_EQ(0, image.diff_iterate(NULL, 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 0, 3) == extents);
+
+  extents.clear();
+  ASSERT_EQ(0, image.diff_iterate("one", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 1, 3) == extents);
+
+  extents.clear();
+  ASSERT_EQ(0, image.diff_iterate("two", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 2, 3) == extents);
+
+  // a rewrite of an object that existed at the snapshot is a change too
+  write_objects(image, order, 0, 1);
+  extents.clear();
+  ASSERT_EQ(0, image.diff_iterate("two", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_EQ(2u, extents.size());
+  ASSERT_EQ(diff_extent(0, 4096, true), extents[0]);
+
+  ASSERT_EQ(0, image.snap_set("two"));
+  extents.clear();
+  ASSERT_EQ(0, image.diff_iterate("one", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 1, 2) == extents);
+  ioctx.close();
+}
+
+TEST_F(TestLibRBD, DiffIterateRemovedSnap)
+{
+  librados::IoCtx ioctx;
+  ASSERT_EQ(0, _rados.ioctx_create(m_pool_name.c_str(), ioctx));
+
+  librbd::RBD rbd;
+  librbd::Image image;
+  int order = 22;
+  std::string name = get_temp_image_name();
+  uint64_t size = 8 << order;
+  uint64_t features = RBD_FEATURE_LAYERING | RBD_FEATURE_EXCLUSIVE_LOCK |
+		      RBD_FEATURE_OBJECT_MAP;
+
+  ASSERT_EQ(0, rbd.create2(ioctx, name.c_str(), size, features, &order));
+  ASSERT_EQ(0, rbd.open(ioctx, image, name.c_str(), NULL));
+
+  write_objects(image, order, 0, 1);
+  ASSERT_EQ(0, image.snap_create("one"));
+  write_objects(image, order, 1, 2);
+  ASSERT_EQ(0, image.snap_create("two"));
+  write_objects(image, order, 2, 3);
+  ASSERT_EQ(0, image.snap_create("three"));
+  write_objects(image, order, 3, 4);
+
+  // object 1 only changed in the removed snapshot's interval
+  ASSERT_EQ(0, image.snap_remove("two"));
+  vector<diff_extent> extents;
+  ASSERT_EQ(0, image.snap_set("three"));
+  ASSERT_EQ(0, image.diff_iterate("one", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 1, 3) == extents);
+
+  // and the head inherits the changes of the newest snapshot
+  ASSERT_EQ(0, image.snap_set(NULL));
+  ASSERT_EQ(0, image.snap_remove("three"));
+  extents.clear();
+  ASSERT_EQ(0, image.diff_iterate("one", 0, size,
+				  vector_iterate_cb, (void *) &extents));
+  ASSERT_TRUE(object_extents(order, 1, 4) == extents);
+  ioctx.close();
+}
+
 TEST_F(TestLibRBD, ZeroLengthWrite)
 {
   rados_ioctx_t ioctx;
@@ -1976,6 +2106,164 @@ TEST_F(TestLibRBD, ZeroLengthRead)
   rados_ioctx_destroy(ioctx);
 }
 
+TEST_F(TestLibRBD, TestIOVec)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  rbd_image_t image;
+  int order = 16;
+  std::string name = get_temp_image_name();
+  uint64_t size = 1 << 20;
+
+  ASSERT_EQ(0, create_image(ioctx, name.c_str(), size, &order));
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+
+  // segments straddle an object boundary
+  char a[4096], b[16384], c[512];
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  memset(c, 'c', sizeof(c));
+  struct iovec iov[3] = {
+    { a, sizeof(a) }, { b, sizeof(b) }, { c, sizeof(c) }
+  };
+  uint64_t off = (1 << order) - 8192;
+  size_t len = sizeof(a) + sizeof(b) + sizeof(c);
+
+  rbd_completion_t comp;
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_writev(image, iov, 3, off, comp));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ(0, rbd_aio_get_return_value(comp));
+  rbd_aio_release(comp);
+
+  char expected[len];
+  memcpy(expected, a, sizeof(a));
+  memcpy(expected + sizeof(a), b, sizeof(b));
+  memcpy(expected + sizeof(a) + sizeof(b), c, sizeof(c));
+  read_test_data(image, expected, off, len);
+
+  // read back into differently sized segments
+  char r1[100], r2[len - 100];
+  struct iovec riov[2] = { { r1, sizeof(r1) }, { r2, sizeof(r2) } };
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_read_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_readv(image, riov, 2, off, comp));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ((int)len, rbd_aio_get_return_value(comp));
+  rbd_aio_release(comp);
+  ASSERT_EQ(0, memcmp(expected, r1, sizeof(r1)));
+  ASSERT_EQ(0, memcmp(expected + sizeof(r1), r2, sizeof(r2)));
+
+  ASSERT_EQ(-EINVAL, rbd_aio_writev(image, iov, 0, off, comp));
+
+  ASSERT_EQ(0, rbd_close(image));
+
+  rados_ioctx_destroy(ioctx);
+}
+
+TEST_F(TestLibRBD, CompareAndWrite)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  rbd_image_t image;
+  int order = 16;
+  std::string name = get_temp_image_name();
+  uint64_t size = 1 << 20;
+
+  ASSERT_EQ(0, create_image(ioctx, name.c_str(), size, &order));
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+
+  char zeros[512], data[512], data2[512];
+  memset(zeros, 0, sizeof(zeros));
+  memset(data, 'a', sizeof(data));
+  memset(data2, 'b', sizeof(data2));
+
+  // an unwritten extent reads as zeros
+  rbd_completion_t comp;
+  uint64_t mismatch_off = 0;
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_compare_and_write(image, 4096, sizeof(data), zeros,
+					 data, comp, &mismatch_off));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ(0, rbd_aio_get_return_value(comp));
+  rbd_aio_release(comp);
+  read_test_data(image, data, 4096, sizeof(data));
+
+  data2[100] = 'a';
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_compare_and_write(image, 4096, sizeof(data), data2,
+					 zeros, comp, &mismatch_off));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ(-EILSEQ, rbd_aio_get_return_value(comp));
+  ASSERT_EQ(4096u, mismatch_off);
+  rbd_aio_release(comp);
+  read_test_data(image, data, 4096, sizeof(data));
+
+  // extents crossing objects are rejected
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(-EINVAL, rbd_aio_compare_and_write(image, (1 << order) - 256,
+					       sizeof(data), data, data, comp,
+					       &mismatch_off));
+  rbd_aio_release(comp);
+
+  ASSERT_EQ(0, rbd_close(image));
+
+  rados_ioctx_destroy(ioctx);
+}
+
+TEST_F(TestLibRBD, WriteSame)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  rbd_image_t image;
+  int order = 16;
+  std::string name = get_temp_image_name();
+  uint64_t size = 1 << 20;
+
+  ASSERT_EQ(0, create_image(ioctx, name.c_str(), size, &order));
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+
+  // the pattern runs across an object boundary unbroken
+  const char *pattern = "0123456789abcdef";
+  size_t data_len = strlen(pattern);
+  uint64_t off = (1 << order) - 40;
+  size_t len = data_len * 8;
+
+  rbd_completion_t comp;
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_writesame(image, off, len, pattern, data_len, comp));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ(0, rbd_aio_get_return_value(comp));
+  rbd_aio_release(comp);
+
+  char expected[len];
+  for (size_t i = 0; i < len; i += data_len)
+    memcpy(expected + i, pattern, data_len);
+  read_test_data(image, expected, off, len);
+
+  // zeroing
+  char zeros[16];
+  memset(zeros, 0, sizeof(zeros));
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(0, rbd_aio_writesame(image, off, len, zeros, sizeof(zeros), comp));
+  ASSERT_EQ(0, rbd_aio_wait_for_complete(comp));
+  ASSERT_EQ(0, rbd_aio_get_return_value(comp));
+  rbd_aio_release(comp);
+  memset(expected, 0, len);
+  read_test_data(image, expected, off, len);
+
+  ASSERT_EQ(0, rbd_aio_create_completion(NULL, (rbd_callback_t) simple_write_cb, &comp));
+  ASSERT_EQ(-EINVAL, rbd_aio_writesame(image, off, len + 1, pattern,
+				       data_len, comp));
+  rbd_aio_release(comp);
+
+  ASSERT_EQ(0, rbd_close(image));
+
+  rados_ioctx_destroy(ioctx);
+}
+
 TEST_F(TestLibRBD, LargeCacheRead)
 {
   if (!g_conf->rbd_cache) {
@@ -2018,6 +2306,247 @@ TEST_F(TestLibRBD, LargeCacheRead)
   rados_ioctx_destroy(ioctx);
 }
 
+TEST_F(TestLibRBD, PersistentCache)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  char dir[] = "/tmp/test_librbd_pcache.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+
+  std::string orig_path = g_conf->rbd_persistent_cache_path;
+  uint64_t orig_size = g_conf->rbd_persistent_cache_size;
+  g_conf->set_val("rbd_persistent_cache_path", dir);
+  g_conf->set_val("rbd_persistent_cache_size", "1048576");
+  BOOST_SCOPE_EXIT( (orig_path) (orig_size) ) {
+    g_conf->set_val("rbd_persistent_cache_path", orig_path.c_str());
+    g_conf->set_val("rbd_persistent_cache_size",
+		    stringify(orig_size).c_str());
+  } BOOST_SCOPE_EXIT_END;
+
+  rbd_image_t image;
+  int order = 18;
+  std::string name = get_temp_image_name();
+  uint64_t size = 4 << 20;
+  ASSERT_EQ(0, create_image_full(ioctx, name.c_str(), size, &order, false,
+				 RBD_FEATURE_LAYERING |
+				 RBD_FEATURE_EXCLUSIVE_LOCK));
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+
+  // several times the log, so it wraps and waits for writeback
+  char data[4096];
+  for (int i = 0; i < 1024; ++i) {
+    memset(data, 'a' + i % 26, sizeof(data));
+    aio_write_test_data(image, data, (i % 512) * sizeof(data), sizeof(data));
+    read_test_data(image, data, (i % 512) * sizeof(data), sizeof(data));
+  }
+  ASSERT_EQ(0, rbd_flush(image));
+
+  // a read spanning logged and written back data
+  std::string expected;
+  for (int i = 512; i < 1024; ++i)
+    expected.append(sizeof(data), 'a' + i % 26);
+  read_test_data(image, expected.c_str(), 0, expected.size());
+  ASSERT_EQ(0, rbd_close(image));
+
+  // closing wrote everything back
+  g_conf->set_val("rbd_persistent_cache_path", "");
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+  read_test_data(image, expected.c_str(), 0, expected.size());
+  ASSERT_EQ(0, rbd_close(image));
+
+  ASSERT_EQ(0, rbd_remove(ioctx, name.c_str()));
+  rados_ioctx_destroy(ioctx);
+
+  std::string cmd = std::string("rm -rf ") + dir;
+  ASSERT_EQ(0, system(cmd.c_str()));
+}
+
+TEST_F(TestLibRBD, PersistentCacheCrashAfterBypass)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  char dir[] = "/tmp/test_librbd_pcache.XXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+
+  std::string orig_path = g_conf->rbd_persistent_cache_path;
+  uint64_t orig_size = g_conf->rbd_persistent_cache_size;
+  g_conf->set_val("rbd_persistent_cache_path", dir);
+  g_conf->set_val("rbd_persistent_cache_size", "1048576");
+  BOOST_SCOPE_EXIT( (orig_path) (orig_size) ) {
+    g_conf->set_val("rbd_persistent_cache_path", orig_path.c_str());
+    g_conf->set_val("rbd_persistent_cache_size",
+		    stringify(orig_size).c_str());
+  } BOOST_SCOPE_EXIT_END;
+
+  rbd_image_t image;
+  int order = 18;
+  std::string name = get_temp_image_name();
+  uint64_t size = 4 << 20;
+  ASSERT_EQ(0, create_image_full(ioctx, name.c_str(), size, &order, false,
+				 RBD_FEATURE_LAYERING |
+				 RBD_FEATURE_EXCLUSIVE_LOCK));
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+
+  // logged, then overwritten by a write too large for the log
+  std::string logged(4096, 'a');
+  write_test_data(image, logged.c_str(), 0, logged.size());
+  ASSERT_EQ(0, rbd_flush(image));
+  std::string bypass(512 << 10, 'z');
+  write_test_data(image, bypass.c_str(), 0, bypass.size());
+  ASSERT_EQ(0, rbd_flush(image));
+
+  // crash: keep the log as it is now, not as closing leaves it
+  std::string cmd = std::string("cp ") + dir + "/rbd-*.log " + dir +
+    "/crash.bak";
+  ASSERT_EQ(0, system(cmd.c_str()));
+  ASSERT_EQ(0, rbd_close(image));
+  cmd = std::string("cd ") + dir + " && for f in rbd-*.log; do " +
+    "mv crash.bak $f; done";
+  ASSERT_EQ(0, system(cmd.c_str()));
+
+  // replaying the log must not resurrect the older logged write
+  ASSERT_EQ(0, rbd_open(ioctx, name.c_str(), &image, NULL));
+  read_test_data(image, bypass.c_str(), 0, bypass.size());
+  ASSERT_EQ(0, rbd_close(image));
+
+  ASSERT_EQ(0, rbd_remove(ioctx, name.c_str()));
+  rados_ioctx_destroy(ioctx);
+
+  cmd = std::string("rm -rf ") + dir;
+  ASSERT_EQ(0, system(cmd.c_str()));
+}
+
+TEST_F(TestLibRBD, ParentCache)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  uint64_t orig_size = g_conf->rbd_parent_cache_size;
+  g_conf->set_val("rbd_parent_cache_size", "16777216");
+  BOOST_SCOPE_EXIT( (orig_size) ) {
+    g_conf->set_val("rbd_parent_cache_size", stringify(orig_size).c_str());
+  } BOOST_SCOPE_EXIT_END;
+
+  int features = RBD_FEATURE_LAYERING;
+  int order = 18;
+  std::string parent_name = get_temp_image_name();
+  std::string child1_name = get_temp_image_name();
+  std::string child2_name = get_temp_image_name();
+
+  rbd_image_t parent;
+  ASSERT_EQ(0, create_image_full(ioctx, parent_name.c_str(), 4 << 20, &order,
+				 false, features));
+  ASSERT_EQ(0, rbd_open(ioctx, parent_name.c_str(), &parent, NULL));
+  char data[4096];
+  for (int i = 0; i < 16; ++i) {
+    memset(data, 'a' + i, sizeof(data));
+    write_test_data(parent, data, i << order, sizeof(data));
+  }
+  ASSERT_EQ(0, rbd_snap_create(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_snap_protect(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_clone(ioctx, parent_name.c_str(), "parent_snap", ioctx,
+			 child1_name.c_str(), features, &order));
+  ASSERT_EQ(0, rbd_clone(ioctx, parent_name.c_str(), "parent_snap", ioctx,
+			 child2_name.c_str(), features, &order));
+
+  rbd_image_t child1, child2;
+  ASSERT_EQ(0, rbd_open(ioctx, child1_name.c_str(), &child1, NULL));
+  ASSERT_EQ(0, rbd_open(ioctx, child2_name.c_str(), &child2, NULL));
+
+  // the head of the parent changing doesn't reach the cached snapshot
+  memset(data, 'z', sizeof(data));
+  write_test_data(parent, data, 0, sizeof(data));
+
+  for (int i = 0; i < 16; ++i) {
+    memset(data, 'a' + i, sizeof(data));
+    read_test_data(child1, data, i << order, sizeof(data));
+    read_test_data(child2, data, i << order, sizeof(data));
+  }
+
+  // a write to one clone doesn't show through the cache in the other
+  memset(data, 'y', sizeof(data));
+  write_test_data(child1, data, 1 << order, sizeof(data));
+  read_test_data(child1, data, 1 << order, sizeof(data));
+  memset(data, 'b', sizeof(data));
+  read_test_data(child2, data, 1 << order, sizeof(data));
+
+  // holes in the parent read as zeros
+  memset(data, 0, sizeof(data));
+  read_test_data(child2, data, (1 << order) + sizeof(data), sizeof(data));
+
+  ASSERT_EQ(0, rbd_close(child1));
+  ASSERT_EQ(0, rbd_close(child2));
+  ASSERT_EQ(0, rbd_remove(ioctx, child1_name.c_str()));
+  ASSERT_EQ(0, rbd_remove(ioctx, child2_name.c_str()));
+  ASSERT_EQ(0, rbd_snap_unprotect(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_snap_remove(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_close(parent));
+  ASSERT_EQ(0, rbd_remove(ioctx, parent_name.c_str()));
+  rados_ioctx_destroy(ioctx);
+}
+
+TEST_F(TestLibRBD, CopyOnRead)
+{
+  rados_ioctx_t ioctx;
+  rados_ioctx_create(_cluster, m_pool_name.c_str(), &ioctx);
+
+  bool orig_copy_on_read = g_conf->rbd_clone_copy_on_read;
+  g_conf->set_val("rbd_clone_copy_on_read", "true");
+  BOOST_SCOPE_EXIT( (orig_copy_on_read) ) {
+    g_conf->set_val("rbd_clone_copy_on_read",
+		    orig_copy_on_read ? "true" : "false");
+  } BOOST_SCOPE_EXIT_END;
+
+  int features = RBD_FEATURE_LAYERING;
+  int order = 18;
+  std::string parent_name = get_temp_image_name();
+  std::string child_name = get_temp_image_name();
+
+  rbd_image_t parent;
+  ASSERT_EQ(0, create_image_full(ioctx, parent_name.c_str(), 4 << 20, &order,
+				 false, features));
+  ASSERT_EQ(0, rbd_open(ioctx, parent_name.c_str(), &parent, NULL));
+  char data[4096];
+  memset(data, 'a', sizeof(data));
+  write_test_data(parent, data, 0, sizeof(data));
+  ASSERT_EQ(0, rbd_snap_create(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_snap_protect(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_clone(ioctx, parent_name.c_str(), "parent_snap", ioctx,
+			 child_name.c_str(), features, &order));
+
+  rbd_image_t child;
+  ASSERT_EQ(0, rbd_open(ioctx, child_name.c_str(), &child, NULL));
+  rbd_image_info_t info;
+  ASSERT_EQ(0, rbd_stat(child, &info, sizeof(info)));
+  char oid[RBD_MAX_BLOCK_NAME_SIZE + 32];
+  snprintf(oid, sizeof(oid), "%s.%016llx", info.block_name_prefix, 0ULL);
+  uint64_t object_size;
+  time_t mtime;
+  ASSERT_EQ(-ENOENT, rados_stat(ioctx, oid, &object_size, &mtime));
+
+  read_test_data(child, data, 0, sizeof(data));
+
+  // the copyup happens in the background
+  int r = -ENOENT;
+  for (int i = 0; i < 100 && r == -ENOENT; ++i) {
+    r = rados_stat(ioctx, oid, &object_size, &mtime);
+    if (r == -ENOENT)
+      usleep(100000);
+  }
+  ASSERT_EQ(0, r);
+  read_test_data(child, data, 0, sizeof(data));
+
+  ASSERT_EQ(0, rbd_close(child));
+  ASSERT_EQ(0, rbd_remove(ioctx, child_name.c_str()));
+  ASSERT_EQ(0, rbd_snap_unprotect(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_snap_remove(parent, "parent_snap"));
+  ASSERT_EQ(0, rbd_close(parent));
+  ASSERT_EQ(0, rbd_remove(ioctx, parent_name.c_str()));
+  rados_ioctx_destroy(ioctx);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -43,6 +43,7 @@ class Transaction {
   };
   static Tick write_ticks, setattr_ticks, omap_setkeys_ticks, omap_rmkeys_ticks;
   static Tick encode_ticks, decode_ticks, iterate_ticks;
+  static Tick legacy_encode_ticks, legacy_decode_ticks;
 
   void write(coll_t cid, const ghobject_t& oid, uint64_t off, uint64_t len,
              const bufferlist& data) {
@@ -81,21 +82,33 @@ class Transaction {
     start_time = Cycles::rdtsc();
     d.decode(bliter);
     decode_ticks.add(Cycles::rdtsc() - start_time);
+
+    // the pre-index encoding, as sent to peers without
+    // CEPH_FEATURE_OSD_TRANSACTION_INDEX
+    bufferlist lbl;
+    ObjectStore::Transaction ld;
+    start_time = Cycles::rdtsc();
+    t.encode(lbl, 0);
+    legacy_encode_ticks.add(Cycles::rdtsc() - start_time);
+
+    bliter = lbl.begin();
+    start_time = Cycles::rdtsc();
+    ld.decode(bliter);
+    legacy_decode_ticks.add(Cycles::rdtsc() - start_time);
   }
 
   void apply_iterate() {
     uint64_t start_time = Cycles::rdtsc();
     ObjectStore::Transaction::iterator i = t.begin();
     while (i.have_op()) {
-      int op = i.decode_op();
+      ObjectStore::Transaction::Op *op = i.decode_op();
 
-      switch (op) {
+      switch (op->op) {
       case ObjectStore::Transaction::OP_WRITE:
         {
-          coll_t cid = i.decode_cid();
-          ghobject_t oid = i.decode_oid();
-          i.decode_length();
-          i.decode_length();
+          const coll_t &cid = i.get_cid(op->cid);
+          const ghobject_t &oid = i.get_oid(op->oid);
+          (void)cid; (void)oid;
           i.get_replica();
           bufferlist bl;
           i.decode_bl(bl);
@@ -103,8 +116,9 @@ class Transaction {
         break;
       case ObjectStore::Transaction::OP_SETATTR:
         {
-          coll_t cid = i.decode_cid();
-          ghobject_t oid = i.decode_oid();
+          const coll_t &cid = i.get_cid(op->cid);
+          const ghobject_t &oid = i.get_oid(op->oid);
+          (void)cid; (void)oid;
           string name = i.decode_attrname();
           bufferlist bl;
           i.decode_bl(bl);
@@ -114,16 +128,18 @@ class Transaction {
         break;
       case ObjectStore::Transaction::OP_OMAP_SETKEYS:
         {
-          coll_t cid(i.decode_cid());
-          ghobject_t oid = i.decode_oid();
+          const coll_t &cid = i.get_cid(op->cid);
+          const ghobject_t &oid = i.get_oid(op->oid);
+          (void)cid; (void)oid;
           map<string, bufferlist> aset;
           i.decode_attrset(aset);
         }
         break;
       case ObjectStore::Transaction::OP_OMAP_RMKEYS:
         {
-          coll_t cid(i.decode_cid());
-          ghobject_t oid = i.decode_oid();
+          const coll_t &cid = i.get_cid(op->cid);
+          const ghobject_t &oid = i.get_oid(op->oid);
+          (void)cid; (void)oid;
           set<string> keys;
           i.decode_keyset(keys);
         }
@@ -140,6 +156,8 @@ class Transaction {
     cerr << " omap_rmkeys op: " << Cycles::to_microseconds(Transaction::omap_rmkeys_ticks.ticks) << "us count: " << Transaction::omap_rmkeys_ticks.count << std::endl;
     cerr << " encode op: " << Cycles::to_microseconds(Transaction::encode_ticks.ticks) << "us count: " << Transaction::encode_ticks.count << std::endl;
     cerr << " decode op: " << Cycles::to_microseconds(Transaction::decode_ticks.ticks) << "us count: " << Transaction::decode_ticks.count << std::endl;
+    cerr << " legacy encode op: " << Cycles::to_microseconds(Transaction::legacy_encode_ticks.ticks) << "us count: " << Transaction::legacy_encode_ticks.count << std::endl;
+    cerr << " legacy decode op: " << Cycles::to_microseconds(Transaction::legacy_decode_ticks.ticks) << "us count: " << Transaction::legacy_decode_ticks.count << std::endl;
     cerr << " iterate op: " << Cycles::to_microseconds(Transaction::iterate_ticks.ticks) << "us count: " << Transaction::iterate_ticks.count << std::endl;
   }
 };
@@ -241,6 +259,7 @@ const ghobject_t PerfCase::pglog_oid(hobject_t(sobject_t(object_t("cid_pglog"),
 const ghobject_t PerfCase::info_oid(hobject_t(sobject_t(object_t("infos"), 0)));
 Transaction::Tick Transaction::write_ticks, Transaction::setattr_ticks, Transaction::omap_setkeys_ticks, Transaction::omap_rmkeys_ticks;
 Transaction::Tick Transaction::encode_ticks, Transaction::decode_ticks, Transaction::iterate_ticks;
+Transaction::Tick Transaction::legacy_encode_ticks, Transaction::legacy_decode_ticks;
 
 void usage(const string &name) {
   cerr << "Usage: " << name << " [times] "
@@ -0,0 +1,139 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "include/ceph_features.h"
+#include "os/ObjectStore.h"
+
+typedef ObjectStore::Transaction Transaction;
+
+static ghobject_t make_oid(const char *name)
+{
+  return ghobject_t(hobject_t(sobject_t(name, CEPH_NOSNAP)));
+}
+
+// one line per op, with the collections and objects it names resolved
+static std::vector<std::string> describe(Transaction& t)
+{
+  std::vector<std::string> r;
+  Transaction::iterator i = t.begin();
+  while (i.have_op()) {
+    Transaction::Op *op = i.decode_op();
+    std::ostringstream ss;
+    ss << op->op << " " << i.get_cid(op->cid) << " " << i.get_oid(op->oid);
+    switch (op->op) {
+    case Transaction::OP_TOUCH:
+    case Transaction::OP_REMOVE:
+      break;
+    case Transaction::OP_WRITE:
+      {
+	bufferlist bl;
+	i.decode_bl(bl);
+	ss << " " << op->off << "~" << op->len << " "
+	   << std::string(bl.c_str(), bl.length());
+      }
+      break;
+    case Transaction::OP_SETATTR:
+      {
+	std::string name = i.decode_attrname();
+	bufferlist bl;
+	i.decode_bl(bl);
+	ss << " " << name << "=" << std::string(bl.c_str(), bl.length());
+      }
+      break;
+    case Transaction::OP_CLONE:
+      ss << " -> " << i.get_oid(op->dest_oid);
+      break;
+    default:
+      ADD_FAILURE() << "unexpected op " << op->op;
+    }
+    r.push_back(ss.str());
+  }
+  return r;
+}
+
+static void build(Transaction& t, coll_t cid, const char *a, const char *b)
+{
+  bufferlist data;
+  data.append("data");
+  bufferlist val;
+  val.append("val");
+  t.touch(cid, make_oid(a));
+  t.write(cid, make_oid(b), 10, data.length(), data);
+  t.setattr(cid, make_oid(a), "attr", val);
+  t.clone(cid, make_oid(b), make_oid(a));
+  t.remove(cid, make_oid(b));
+}
+
+TEST(Transaction, LegacyRoundTrip) {
+  Transaction t;
+  build(t, coll_t("coll"), "obj1", "obj2");
+
+  // peers without the index feature get the v7 tbl encoding
+  bufferlist bl;
+  t.encode(bl, CEPH_FEATURES_ALL & ~CEPH_FEATURE_OSD_TRANSACTION_INDEX);
+  ASSERT_EQ(7, bl[0]);
+  bufferlist::iterator p = bl.begin();
+  Transaction d;
+  d.decode(p);
+  ASSERT_TRUE(p.end());
+  ASSERT_EQ(t.get_num_ops(), d.get_num_ops());
+  ASSERT_TRUE(describe(t) == describe(d));
+
+  // and the rebuilt transaction encodes like the original
+  bufferlist a, b;
+  t.encode(a);
+  d.encode(b);
+  ASSERT_EQ(8, a[0]);
+  Transaction da(a), db(b);
+  ASSERT_TRUE(describe(da) == describe(db));
+}
+
+TEST(Transaction, LegacyEmpty) {
+  Transaction t;
+  bufferlist bl;
+  t.encode(bl, 0);
+  bufferlist::iterator p = bl.begin();
+  Transaction d;
+  d.decode(p);
+  ASSERT_TRUE(d.empty());
+}
+
+TEST(Transaction, AppendRemapsIndexes) {
+  // the two transactions number their collections and objects
+  // differently, so the appended ops must be remapped
+  Transaction t1, t2;
+  build(t1, coll_t("coll1"), "obj1", "obj2");
+  build(t2, coll_t("coll2"), "obj3", "obj1");
+  t2.touch(coll_t("coll1"), make_oid("obj2"));
+  std::vector<std::string> expected = describe(t1);
+  std::vector<std::string> appended = describe(t2);
+  expected.insert(expected.end(), appended.begin(), appended.end());
+
+  t1.append(t2);
+  ASSERT_EQ(expected.size(), (size_t)t1.get_num_ops());
+  ASSERT_TRUE(expected == describe(t1));
+
+  // both encodings carry the remapped ops
+  bufferlist bl;
+  t1.encode(bl);
+  Transaction d(bl);
+  ASSERT_TRUE(expected == describe(d));
+  bufferlist lbl;
+  t1.encode(lbl, 0);
+  Transaction ld(lbl);
+  ASSERT_TRUE(expected == describe(ld));
+}
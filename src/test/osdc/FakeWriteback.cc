@@ -45,8 +45,10 @@ public:
   }
 };
 
-FakeWriteback::FakeWriteback(CephContext *cct, Mutex *lock, uint64_t delay_ns)
-  : m_cct(cct), m_lock(lock), m_delay_ns(delay_ns)
+FakeWriteback::FakeWriteback(CephContext *cct, Mutex *lock, uint64_t delay_ns,
+			     bool scattered_writes)
+  : m_cct(cct), m_lock(lock), m_delay_ns(delay_ns),
+    m_scattered_writes(scattered_writes)
 {
   m_finisher = new Finisher(cct);
   m_finisher->start();
@@ -81,6 +83,30 @@ ceph_tid_t FakeWriteback::write(const object_t& oid,
   return m_tid.inc();
 }
 
+ceph_tid_t FakeWriteback::write(const object_t& oid,
+				const object_locator_t& oloc,
+				vector<pair<uint64_t, bufferlist> >& io_vec,
+				const SnapContext& snapc, utime_t mtime,
+				uint64_t trunc_size, __u32 trunc_seq,
+				Context *oncommit)
+{
+  assert(m_scattered_writes);
+  assert(!io_vec.empty());
+  // the extents must be sorted and must not overlap
+  for (size_t i = 1; i < io_vec.size(); ++i) {
+    assert(io_vec[i - 1].first + io_vec[i - 1].second.length() <=
+	   io_vec[i].first);
+  }
+  ldout(m_cct, 20) << "scattered write of " << io_vec.size() << " extents to "
+		   << oid << dendl;
+  m_num_scattered_writes.inc();
+
+  C_Delay *wrapper = new C_Delay(m_cct, oncommit, m_lock, io_vec[0].first,
+				 NULL, m_delay_ns);
+  m_finisher->queue(wrapper, 0);
+  return m_tid.inc();
+}
+
 bool FakeWriteback::may_copy_on_write(const object_t&, uint64_t, uint64_t, snapid_t)
 {
   return false;
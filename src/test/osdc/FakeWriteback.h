@@ -14,9 +14,12 @@ class Mutex;
 
 class FakeWriteback : public WritebackHandler {
 public:
-  FakeWriteback(CephContext *cct, Mutex *lock, uint64_t delay_ns);
+  FakeWriteback(CephContext *cct, Mutex *lock, uint64_t delay_ns,
+		bool scattered_writes=false);
   virtual ~FakeWriteback();
 
+  using WritebackHandler::write;
+
   virtual void read(const object_t& oid, const object_locator_t& oloc,
 		    uint64_t off, uint64_t len, snapid_t snapid,
 		    bufferlist *pbl, uint64_t trunc_size,  __u32 trunc_seq,
@@ -28,12 +31,24 @@ public:
 			   utime_t mtime, uint64_t trunc_size,
 			   __u32 trunc_seq, Context *oncommit);
 
+  virtual bool can_scattered_write() { return m_scattered_writes; }
+  virtual ceph_tid_t write(const object_t& oid, const object_locator_t& oloc,
+			   vector<pair<uint64_t, bufferlist> >& io_vec,
+			   const SnapContext& snapc, utime_t mtime,
+			   uint64_t trunc_size, __u32 trunc_seq,
+			   Context *oncommit);
+
   virtual bool may_copy_on_write(const object_t&, uint64_t, uint64_t, snapid_t);
+
+  /// how many writes covered more than one extent
+  uint64_t get_num_scattered_writes() { return m_num_scattered_writes.read(); }
 private:
   CephContext *m_cct;
   Mutex *m_lock;
   uint64_t m_delay_ns;
+  bool m_scattered_writes;
   atomic_t m_tid;
+  atomic_t m_num_scattered_writes;
   Finisher *m_finisher;
 };
 
@@ -13,6 +13,7 @@
 #include "common/config.h"
 #include "common/Mutex.h"
 #include "common/snap_types.h"
+#include "common/Thread.h"
 #include "global/global_init.h"
 #include "include/atomic.h"
 #include "include/buffer.h"
@@ -40,22 +41,63 @@ struct op_data {
 class C_Count : public Context {
   op_data *m_op;
   atomic_t *m_outstanding;
+  Mutex *m_unlocked; ///< lock that must not be held on completion, if any
 public:
-  C_Count(op_data *op, atomic_t *outstanding)
-    : m_op(op), m_outstanding(outstanding) {}
+  C_Count(op_data *op, atomic_t *outstanding, Mutex *unlocked=NULL)
+    : m_op(op), m_outstanding(outstanding), m_unlocked(unlocked) {}
   void finish(int r) {
+    assert(m_unlocked == NULL || !m_unlocked->is_locked_by_me());
     m_op->done.inc();
     assert(m_outstanding->read() > 0);
     m_outstanding->dec();
   }
 };
 
+// reads whatever is cached without the cache lock, while the main
+// thread reads and writes through it.  only zeros are ever written.
+class HitThread : public Thread {
+  ObjectCacher *m_obc;
+  ObjectCacher::ObjectSet *m_oset;
+  uint64_t m_num_objs, m_max_obj_size, m_max_op_len;
+  atomic_t *m_stop;
+public:
+  atomic_t hits;
+  HitThread(ObjectCacher *obc, ObjectCacher::ObjectSet *oset,
+	    uint64_t num_objs, uint64_t max_obj_size, uint64_t max_op_len,
+	    atomic_t *stop)
+    : m_obc(obc), m_oset(oset), m_num_objs(num_objs),
+      m_max_obj_size(max_obj_size), m_max_op_len(max_op_len), m_stop(stop) {}
+  void *entry() {
+    while (!m_stop->read()) {
+      uint64_t offset = random() % m_max_obj_size;
+      uint64_t max_len = MIN(m_max_obj_size - offset, m_max_op_len);
+      uint64_t length = random() % (MAX(max_len - 1, 1)) + 1;
+      std::string oid = "test" + stringify(random() % m_num_objs);
+      op_data op(oid, offset, length, true);
+      ObjectCacher::OSDRead *rd = m_obc->prepare_read(CEPH_NOSNAP, &op.result, 0);
+      rd->extents.push_back(op.extent);
+      int r = m_obc->readx_hit(rd, m_oset);
+      if (r == -EAGAIN) {
+	delete rd;
+	continue;
+      }
+      assert((uint64_t)r == length);
+      assert(op.result.length() == length);
+      assert(op.result.is_zero());
+      hits.inc();
+    }
+    return 0;
+  }
+};
+
 int stress_test(uint64_t num_ops, uint64_t num_objs,
 		uint64_t max_obj_size, uint64_t delay_ns,
-		uint64_t max_op_len, float percent_reads)
+		uint64_t max_op_len, float percent_reads,
+		bool scattered_writes, bool unlocked_read_completions,
+		int hit_threads)
 {
   Mutex lock("object_cacher_stress::object_cacher");
-  FakeWriteback writeback(g_ceph_context, &lock, delay_ns);
+  FakeWriteback writeback(g_ceph_context, &lock, delay_ns, scattered_writes);
 
   ObjectCacher obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
 		   g_conf->client_oc_size,
@@ -64,6 +106,8 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
 		   g_conf->client_oc_target_dirty,
 		   g_conf->client_oc_max_dirty_age,
 		   true);
+  obc.set_unlocked_read_completions(unlocked_read_completions);
+  obc.set_policy(g_conf->client_oc_policy);
   obc.start();
 
   atomic_t outstanding_reads;
@@ -82,7 +126,22 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
 	    << setw(10) << "obj size: " << max_obj_size << "\n"
 	    << setw(10) << "delay: " << delay_ns << "\n"
 	    << setw(10) << "max op len: " << max_op_len << "\n"
-	    << setw(10) << "percent reads: " << percent_reads << "\n\n";
+	    << setw(10) << "percent reads: " << percent_reads << "\n"
+	    << setw(10) << "scattered writes: " << scattered_writes << "\n"
+	    << setw(10) << "unlocked read completions: "
+	    << unlocked_read_completions << "\n"
+	    << setw(10) << "policy: " << g_conf->client_oc_policy << "\n"
+	    << setw(10) << "hit threads: " << hit_threads << "\n\n";
+
+  atomic_t stop_hits;
+  vector<ceph::shared_ptr<HitThread> > hitters;
+  for (int i = 0; i < hit_threads; ++i) {
+    ceph::shared_ptr<HitThread> t(new HitThread(&obc, &object_set, num_objs,
+						max_obj_size, max_op_len,
+						&stop_hits));
+    t->create();
+    hitters.push_back(t);
+  }
 
   for (uint64_t i = 0; i < num_ops; ++i) {
     uint64_t offset = random() % max_obj_size;
@@ -99,7 +158,9 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
       ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &op->result, 0);
       rd->extents.push_back(op->extent);
       outstanding_reads.inc();
-      Context *completion = new C_Count(op.get(), &outstanding_reads);
+      Context *completion = new C_Count(
+	op.get(), &outstanding_reads,
+	unlocked_read_completions ? &lock : NULL);
       lock.Lock();
       int r = obc.readx(rd, &object_set, completion);
       lock.Unlock();
@@ -135,6 +196,13 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
     }
   }
 
+  stop_hits.set(1);
+  for (vector<ceph::shared_ptr<HitThread> >::iterator p = hitters.begin();
+       p != hitters.end(); ++p) {
+    (*p)->join();
+    std::cout << "hits without the lock: " << (*p)->hits.read() << std::endl;
+  }
+
   lock.Lock();
   obc.release_set(&object_set);
   lock.Unlock();
@@ -155,6 +223,7 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
   mylock.Unlock();
 
   lock.Lock();
+  obc.verify_stats();
   bool unclean = obc.release_set(&object_set);
   lock.Unlock();
 
@@ -165,6 +234,9 @@ int stress_test(uint64_t num_ops, uint64_t num_objs,
 
   obc.stop();
 
+  if (scattered_writes)
+    std::cout << "scattered writes sent: "
+	      << writeback.get_num_scattered_writes() << std::endl;
   std::cout << "Test completed successfully." << std::endl;
 
   return EXIT_SUCCESS;
@@ -184,6 +256,9 @@ int main(int argc, const char **argv)
   long long num_objs = 10;
   float percent_reads = 0.90;
   int seed = time(0) % 100000;
+  bool scattered_writes = false;
+  bool unlocked_read_completions = false;
+  int hit_threads = 0;
   std::ostringstream err;
   std::vector<const char*>::iterator i;
   for (i = args.begin(); i != args.end();) {
@@ -222,6 +297,16 @@ int main(int argc, const char **argv)
 	cerr << argv[0] << ": " << err.str() << std::endl;
 	return EXIT_FAILURE;
       }
+    } else if (ceph_argparse_withint(args, i, &hit_threads, &err, "--hit-threads", (char*)NULL)) {
+      if (!err.str().empty()) {
+	cerr << argv[0] << ": " << err.str() << std::endl;
+	return EXIT_FAILURE;
+      }
+    } else if (ceph_argparse_flag(args, i, "--scattered-writes", (char*)NULL)) {
+      scattered_writes = true;
+    } else if (ceph_argparse_flag(args, i, "--unlocked-read-completions",
+				  (char*)NULL)) {
+      unlocked_read_completions = true;
     } else {
       cerr << "unknown option " << *i << std::endl;
       return EXIT_FAILURE;
@@ -229,5 +314,7 @@ int main(int argc, const char **argv)
   }
 
   srandom(seed);
-  return stress_test(num_ops, num_objs, obj_bytes, delay_ns, max_len, percent_reads);
+  return stress_test(num_ops, num_objs, obj_bytes, delay_ns, max_len,
+		     percent_reads, scattered_writes,
+		     unlocked_read_completions, hit_threads);
 }
@@ -0,0 +1,153 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/ceph_argparse.h"
+#include "common/common_init.h"
+#include "common/Cond.h"
+#include "common/Mutex.h"
+#include "global/global_context.h"
+#include "global/global_init.h"
+#include "include/stringify.h"
+#include "osdc/ObjectCacher.h"
+
+#include "FakeWriteback.h"
+
+#define CACHE_SIZE (4 << 20)
+#define READ_SIZE (256 << 10)
+
+class ObjectCacherPolicy : public ::testing::Test {
+public:
+  ObjectCacherPolicy()
+    : lock("ObjectCacherPolicy::lock"),
+      writeback(g_ceph_context, &lock, 0),
+      obc(g_ceph_context, "test", writeback, lock, NULL, NULL,
+	  CACHE_SIZE, 1000, 0, 0, 0, true),
+      object_set(NULL, 0, 0) {}
+
+  void start(const std::string& policy) {
+    obc.set_policy(policy);
+    obc.start();
+  }
+
+  virtual void TearDown() {
+    lock.Lock();
+    obc.verify_stats();
+    obc.release_set(&object_set);
+    lock.Unlock();
+    obc.stop();
+  }
+
+  ObjectExtent extent(const std::string& oid) {
+    ObjectExtent ex(oid, 0, 0, READ_SIZE, 0);
+    ex.oloc.pool = 0;
+    ex.buffer_extents.push_back(make_pair(0, READ_SIZE));
+    return ex;
+  }
+
+  // read the first READ_SIZE bytes of oid, waiting out a miss
+  int read(const std::string& oid) {
+    bufferlist bl;
+    ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &bl, 0);
+    rd->extents.push_back(extent(oid));
+    C_SaferCond onfinish;
+    lock.Lock();
+    int r = obc.readx(rd, &object_set, &onfinish);
+    lock.Unlock();
+    if (r == 0)
+      r = onfinish.wait();
+    return r;
+  }
+
+  // read `count` objects nobody will look at again
+  void scan(const std::string& prefix, int count) {
+    for (int i = 0; i < count; ++i)
+      ASSERT_EQ(READ_SIZE, read(prefix + stringify(i)));
+  }
+
+  bool is_cached(const std::string& oid) {
+    vector<ObjectExtent> extents;
+    extents.push_back(extent(oid));
+    Mutex::Locker l(lock);
+    return obc.is_cached(&object_set, extents, CEPH_NOSNAP);
+  }
+
+  Mutex lock;
+  FakeWriteback writeback;
+  ObjectCacher obc;
+  ObjectCacher::ObjectSet object_set;
+};
+
+TEST_F(ObjectCacherPolicy, LRUScanEvictsHotData)
+{
+  start("lru");
+
+  ASSERT_EQ(READ_SIZE, read("hot"));
+  scan("first", CACHE_SIZE / READ_SIZE + 1);
+  ASSERT_FALSE(is_cached("hot"));
+
+  // read again, but a scan bigger than the cache still pushes it out
+  ASSERT_EQ(READ_SIZE, read("hot"));
+  ASSERT_TRUE(is_cached("hot"));
+  scan("second", 2 * CACHE_SIZE / READ_SIZE);
+  ASSERT_FALSE(is_cached("hot"));
+}
+
+TEST_F(ObjectCacherPolicy, TwoQScanKeepsHotData)
+{
+  start("2q");
+
+  // first read only puts the data on probation, which a scan flushes
+  ASSERT_EQ(READ_SIZE, read("hot"));
+  scan("first", CACHE_SIZE / READ_SIZE + 1);
+  ASSERT_FALSE(is_cached("hot"));
+
+  // reading it again soon after is a ghost hit, which promotes it
+  ASSERT_EQ(READ_SIZE, read("hot"));
+  ASSERT_TRUE(is_cached("hot"));
+  scan("second", 2 * CACHE_SIZE / READ_SIZE);
+  ASSERT_TRUE(is_cached("hot"));
+}
+
+TEST_F(ObjectCacherPolicy, TwoQNoGhostHitStaysOnProbation)
+{
+  start("2q");
+
+  // a one-time read that was never evicted gets no promotion
+  ASSERT_EQ(READ_SIZE, read("cold"));
+  ASSERT_EQ(READ_SIZE, read("cold"));
+  scan("first", CACHE_SIZE / READ_SIZE + 1);
+  ASSERT_FALSE(is_cached("cold"));
+}
+
+TEST_F(ObjectCacherPolicy, HitWithoutLock)
+{
+  start("lru");
+
+  // nothing is cached yet, so it's up to readx()
+  bufferlist bl;
+  ObjectCacher::OSDRead *rd = obc.prepare_read(CEPH_NOSNAP, &bl, 0);
+  rd->extents.push_back(extent("obj"));
+  ASSERT_EQ(-EAGAIN, obc.readx_hit(rd, &object_set));
+
+  ASSERT_EQ(READ_SIZE, read("obj"));
+  ASSERT_EQ(READ_SIZE, obc.readx_hit(rd, &object_set));
+  ASSERT_EQ((unsigned)READ_SIZE, bl.length());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+
+  vector<const char*> args;
+  argv_to_vec(argc, (const char **)argv, args);
+  env_to_vec(args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  return RUN_ALL_TESTS();
+}